@@ -16,6 +16,11 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <vector>
+#include <cstddef>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
 
 namespace
 {
@@ -24,18 +29,108 @@ namespace
 	const GLuint g_FloatsPerVertex = 3;	// Number of coordinates per vertex
 	const GLuint g_FloatsPerNormal = 3;	// Number of values per vertex color
 	const GLuint g_FloatsPerUV = 2;		// Number of texture coordinate values
+
+	const GLuint g_FloatsPerShapeVertex = g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV;
+
+	// attribute locations of the per-instance data
+	const GLuint g_InstanceModelLocation = 3;
+	const GLuint g_InstanceColorLocation = 7;
+	const GLuint g_InstanceUVScaleLocation = 8;
+	const GLuint g_InstanceMaterialLocation = 9;
+
+	// buffer bindings of the shared vertex array
+	const GLuint g_VertexBufferBinding = 0;
+	const GLuint g_InstanceBufferBinding = 1;
 }
 
 ShapeMeshes::ShapeMeshes()
 {
-	m_bMemoryLayoutDone = false;
+	m_geometry.resize(MESH_COUNT);
+	for (size_t i = 0; i < m_geometry.size(); i++)
+	{
+		m_geometry[i].rangeCount = 0;
+		memset(&m_geometry[i].bounds, 0, sizeof(GEOMETRY_BOUNDS));
+	}
+	m_vertexArray = 0;
+	m_vertexBuffer = 0;
+	m_indexBuffer = 0;
+	m_indirectBuffer = 0;
+	m_vertexCount = 0;
+	m_indexCount = 0;
+	m_uploadedVertices = 0;
+	m_uploadedIndices = 0;
+	m_vertexCapacity = 0;
+	m_indexCapacity = 0;
+	m_indirectCapacity = 0;
+	m_pStateCache = NULL;
+	m_instanceBuffer = 0;
+	m_instanceCapacity = 0;
+	m_baseInstance = 0;
+	m_instanceCount = 1;
+	m_bCollectCommands = false;
+}
+
+///////////////////////////////////////////////////
+//	~ShapeMeshes()
+//
+//	Free the shared geometry, instance and indirect
+//  buffers and the shared vertex array.
+//
+///////////////////////////////////////////////////
+ShapeMeshes::~ShapeMeshes()
+{
+	GLuint buffers[] = { m_vertexBuffer, m_indexBuffer, m_indirectBuffer, m_instanceBuffer };
+	for (int i = 0; i < 4; i++)
+	{
+		if (0 != buffers[i])
+		{
+			glDeleteBuffers(1, &buffers[i]);
+		}
+	}
+	if (0 != m_vertexArray)
+	{
+		glDeleteVertexArrays(1, &m_vertexArray);
+	}
+}
+
+///////////////////////////////////////////////////
+//	SetStateCache()
+//
+//	Route the vertex array binds of the draw methods
+//  through a GL state cache.  With a cache the shared
+//  VAO stays bound between submissions so that the
+//  rebind is skipped.
+//
+///////////////////////////////////////////////////
+void ShapeMeshes::SetStateCache(GLStateCache* pStateCache)
+{
+	m_pStateCache = pStateCache;
+}
+
+///////////////////////////////////////////////////
+//	BindVertexArray()
+//
+//	Bind the shared VAO for drawing or for changing
+//  its buffer bindings.
+//
+///////////////////////////////////////////////////
+void ShapeMeshes::BindVertexArray(GLuint vao)
+{
+	if (NULL != m_pStateCache)
+	{
+		m_pStateCache->BindVertexArray(vao);
+	}
+	else
+	{
+		glBindVertexArray(vao);
+	}
 }
 
 ///////////////////////////////////////////////////
 //	LoadBoxMesh()
 //
 //	Create a box mesh by specifying the vertices and 
-//  store it in a VAO/VBO.  The normals and texture
+//  store it in the shared buffers.  The normals and texture
 //  coordinates are also set.
 //
 //	Correct triangle drawing command:
@@ -102,31 +197,18 @@ void ShapeMeshes::LoadBoxMesh()
 		20,23,22
 	};
 
-	m_BoxMesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV));
-	m_BoxMesh.nIndices = sizeof(indices) / sizeof(indices[0]);
-
-	glGenVertexArrays(1, &m_BoxMesh.vao); // we can also generate multiple VAOs or buffers at the same time
-	glBindVertexArray(m_BoxMesh.vao);
-
-	// Create 2 buffers: first one for the vertex data; second one for the indices
-	glGenBuffers(2, m_BoxMesh.vbos);
-	glBindBuffer(GL_ARRAY_BUFFER, m_BoxMesh.vbos[0]); // Activates the buffer
-	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_BoxMesh.vbos[1]); // Activates the buffer
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+	GLuint nVertices = sizeof(verts) / (sizeof(verts[0]) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV));
+	GLuint nIndices = sizeof(indices) / sizeof(indices[0]);
 
-	if (m_bMemoryLayoutDone == false)
-	{
-		SetShaderMemoryLayout();
-	}
+	GLint baseVertex = AddVertices(verts, nVertices);
+	AddIndexedRange(MESH_BOX, MESH_PART_ALL, baseVertex, indices, nIndices);
 }
 
 ///////////////////////////////////////////////////
 //	LoadConeMesh()
 //
 //	Create a cole mesh by specifying the vertices and 
-//  store it in a VAO/VBO.  The normals and texture
+//  store it in the shared buffers.  The normals and texture
 //  coordinates are also set.
 //
 //  Correct triangle drawing commands:
@@ -288,29 +370,19 @@ void ShapeMeshes::LoadConeMesh()
 	};
 
 	// store vertex and index count
-	m_ConeMesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV));
-	m_ConeMesh.nIndices = 0;
-
-	// Create VAO
-	glGenVertexArrays(1, &m_ConeMesh.vao); // we can also generate multiple VAOs or buffers at the same time
-	glBindVertexArray(m_ConeMesh.vao);
-
-	// Create VBO
-	glGenBuffers(1, m_ConeMesh.vbos);
-	glBindBuffer(GL_ARRAY_BUFFER, m_ConeMesh.vbos[0]); // Activates the buffer
-	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
+	GLuint nVertices = sizeof(verts) / (sizeof(verts[0]) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV));
 
-	if (m_bMemoryLayoutDone == false)
-	{
-		SetShaderMemoryLayout();
-	}
+	// the sides are drawn with every part selection
+	GLint baseVertex = AddVertices(verts, nVertices);
+	AddArrayRange(MESH_CONE, MESH_PART_BOTTOM, baseVertex, GL_TRIANGLE_FAN, 0, 36);
+	AddArrayRange(MESH_CONE, MESH_PART_ALL, baseVertex, GL_TRIANGLE_STRIP, 36, 108);
 }
 
 ///////////////////////////////////////////////////
 //	LoadCylinderMesh()
 //
 //	Create a cylinder mesh by specifying the vertices and 
-//  store it in a VAO/VBO.  The normals and texture
+//  store it in the shared buffers.  The normals and texture
 //  coordinates are also set.
 //
 //  Correct triangle drawing commands:
@@ -552,29 +624,19 @@ void ShapeMeshes::LoadCylinderMesh()
 	normal = CalculateTriangleNormal(glm::vec3(.98f, 1.0f, 0.17f), glm::vec3(.98f, 0.0f, 0.17f), glm::vec3(1.0f, 0.0f, 0.0f));
 
 	// store vertex and index count
-	m_CylinderMesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV));
-	m_CylinderMesh.nIndices = 0;
-
-	// Create VAO
-	glGenVertexArrays(1, &m_CylinderMesh.vao); // we can also generate multiple VAOs or buffers at the same time
-	glBindVertexArray(m_CylinderMesh.vao);
+	GLuint nVertices = sizeof(verts) / (sizeof(verts[0]) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV));
 
-	// Create VBO
-	glGenBuffers(1, m_CylinderMesh.vbos);
-	glBindBuffer(GL_ARRAY_BUFFER, m_CylinderMesh.vbos[0]); // Activates the buffer
-	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
-
-	if (m_bMemoryLayoutDone == false)
-	{
-		SetShaderMemoryLayout();
-	}
+	GLint baseVertex = AddVertices(verts, nVertices);
+	AddArrayRange(MESH_CYLINDER, MESH_PART_BOTTOM, baseVertex, GL_TRIANGLE_FAN, 0, 36);
+	AddArrayRange(MESH_CYLINDER, MESH_PART_TOP, baseVertex, GL_TRIANGLE_FAN, 36, 36);
+	AddArrayRange(MESH_CYLINDER, MESH_PART_SIDES, baseVertex, GL_TRIANGLE_STRIP, 72, 146);
 }
 
 ///////////////////////////////////////////////////
 //	LoadPlaneMesh()
 //
 //	Create a plane mesh by specifying the vertices and 
-//  store it in a VAO/VBO.  The normals and texture
+//  store it in the shared buffers.  The normals and texture
 //  coordinates are also set.
 // 
 //  Correct triangle drawing command:
@@ -599,32 +661,18 @@ void ShapeMeshes::LoadPlaneMesh()
 	};
 
 	// store vertex and index count
-	m_PlaneMesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV));
-	m_PlaneMesh.nIndices = sizeof(indices) / sizeof(indices[0]);
-
-	// Generate the VAO for the mesh
-	glGenVertexArrays(1, &m_PlaneMesh.vao);
-	glBindVertexArray(m_PlaneMesh.vao);	// activate the VAO
-
-	// Create VBOs for the mesh
-	glGenBuffers(2, m_PlaneMesh.vbos);
-	glBindBuffer(GL_ARRAY_BUFFER, m_PlaneMesh.vbos[0]); // Activates the buffer
-	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends data to the GPU
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_PlaneMesh.vbos[1]); // Activates the buffer
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+	GLuint nVertices = sizeof(verts) / (sizeof(verts[0]) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV));
+	GLuint nIndices = sizeof(indices) / sizeof(indices[0]);
 
-	if (m_bMemoryLayoutDone == false)
-	{
-		SetShaderMemoryLayout();
-	}
+	GLint baseVertex = AddVertices(verts, nVertices);
+	AddIndexedRange(MESH_PLANE, MESH_PART_ALL, baseVertex, indices, nIndices);
 }
 
 ///////////////////////////////////////////////////
 //	LoadPrismMesh()
 //
 //	Create a prism mesh by specifying the vertices and 
-//  store it in a VAO/VBO.  The normals and texture
+//  store it in the shared buffers.  The normals and texture
 //  coordinates are also set.
 //
 //	Correct triangle drawing command:
@@ -682,27 +730,17 @@ void ShapeMeshes::LoadPrismMesh()
 
 	};
 
-	m_PrismMesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV));
-
-	glGenVertexArrays(1, &m_PrismMesh.vao); // we can also generate multiple VAOs or buffers at the same time
-	glBindVertexArray(m_PrismMesh.vao);
-
-	// Create 2 buffers: first one for the vertex data; second one for the indices
-	glGenBuffers(1, m_PrismMesh.vbos);
-	glBindBuffer(GL_ARRAY_BUFFER, m_PrismMesh.vbos[0]); // Activates the buffer
-	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
+	GLuint nVertices = sizeof(verts) / (sizeof(verts[0]) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV));
 
-	if (m_bMemoryLayoutDone == false)
-	{
-		SetShaderMemoryLayout();
-	}
+	GLint baseVertex = AddVertices(verts, nVertices);
+	AddArrayRange(MESH_PRISM, MESH_PART_ALL, baseVertex, GL_TRIANGLE_STRIP, 0, nVertices);
 }
 
 ///////////////////////////////////////////////////
 //	LoadPyramid3Mesh()
 //
 //	Create a 3-sided pyramid mesh by specifying the 
-//  vertices and store it in a VAO/VBO.  The normals 
+//  vertices and store it in the shared buffers.  The normals 
 //  and texture coordinates are also set.
 //
 //  Correct triangle drawing command:
@@ -737,26 +775,17 @@ void ShapeMeshes::LoadPyramid3Mesh()
 	};
 
 	// Calculate total defined vertices
-	m_Pyramid3Mesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV));
-
-	glGenVertexArrays(1, &m_Pyramid3Mesh.vao);				// Creates 1 VAO
-	glGenBuffers(1, m_Pyramid3Mesh.vbos);					// Creates 1 VBO
-	glBindVertexArray(m_Pyramid3Mesh.vao);					// Activates the VAO
-	glBindBuffer(GL_ARRAY_BUFFER, m_Pyramid3Mesh.vbos[0]);	// Activates the VBO
-	// Sends vertex or coordinate data to the GPU
-	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW);
+	GLuint nVertices = sizeof(verts) / (sizeof(verts[0]) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV));
 
-	if (m_bMemoryLayoutDone == false)
-	{
-		SetShaderMemoryLayout();
-	}
+	GLint baseVertex = AddVertices(verts, nVertices);
+	AddArrayRange(MESH_PYRAMID3, MESH_PART_ALL, baseVertex, GL_TRIANGLE_STRIP, 0, nVertices);
 }
 
 ///////////////////////////////////////////////////
 //	LoadPyramid4Mesh()
 //
 //	Create a 4-sided pyramid mesh by specifying the 
-//  vertices and store it in a VAO/VBO.  The normals 
+//  vertices and store it in the shared buffers.  The normals 
 //  and texture coordinates are also set.
 //
 //  Correct triangle drawing command:
@@ -800,26 +829,17 @@ void ShapeMeshes::LoadPyramid4Mesh()
 	};
 
 	// Calculate total defined vertices
-	m_Pyramid4Mesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV));
+	GLuint nVertices = sizeof(verts) / (sizeof(verts[0]) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV));
 
-	glGenVertexArrays(1, &m_Pyramid4Mesh.vao);				// Creates 1 VAO
-	glGenBuffers(1, m_Pyramid4Mesh.vbos);					// Creates 1 VBO
-	glBindVertexArray(m_Pyramid4Mesh.vao);					// Activates the VAO
-	glBindBuffer(GL_ARRAY_BUFFER, m_Pyramid4Mesh.vbos[0]);	// Activates the VBO
-	// Sends vertex or coordinate data to the GPU
-	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW);
-
-	if (m_bMemoryLayoutDone == false)
-	{
-		SetShaderMemoryLayout();
-	}
+	GLint baseVertex = AddVertices(verts, nVertices);
+	AddArrayRange(MESH_PYRAMID4, MESH_PART_ALL, baseVertex, GL_TRIANGLE_STRIP, 0, nVertices);
 }
 
 ///////////////////////////////////////////////////
 //	LoadSphereMesh()
 //
 //	Create a sphere mesh by specifying the vertices and 
-//  store it in a VAO/VBO.  The normals and texture
+//  store it in the shared buffers.  The normals and texture
 //  coordinates are also set.
 //
 //  Correct triangle drawing command:
@@ -1656,9 +1676,7 @@ void ShapeMeshes::LoadSphereMesh()
 	const GLuint floatsPerNormal = 3;
 	const GLuint floatsPerUV = 2;
 
-	// store vertex and index count
-	m_SphereMesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (floatsPerVertex));
-	m_SphereMesh.nIndices = sizeof(indices) / (sizeof(indices[0]));
+	GLuint nIndices = sizeof(indices) / (sizeof(indices[0]));
 
 	glm::vec3 normal;
 	glm::vec3 vert;
@@ -1683,29 +1701,21 @@ void ShapeMeshes::LoadSphereMesh()
 		combined_values.push_back(verts[i + 4]);
 	}
 
-	// Create VAO
-	glGenVertexArrays(1, &m_SphereMesh.vao); // we can also generate multiple VAOs or buffers at the same time
-	glBindVertexArray(m_SphereMesh.vao);
-
-	// Create VBOs
-	glGenBuffers(2, m_SphereMesh.vbos);
-	glBindBuffer(GL_ARRAY_BUFFER, m_SphereMesh.vbos[0]); // Activates the vertex buffer
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * combined_values.size(), combined_values.data(), GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
+	GLuint nVertices = (GLuint)(combined_values.size() / (floatsPerVertex + floatsPerNormal + floatsPerUV));
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_SphereMesh.vbos[1]); // Activates the index buffer
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-	if (m_bMemoryLayoutDone == false)
-	{
-		SetShaderMemoryLayout();
-	}
+	// the half sphere draws the first half of the sphere indices
+	GLint baseVertex = AddVertices(combined_values.data(), nVertices);
+	AddIndexedRange(MESH_SPHERE, MESH_PART_ALL, baseVertex, indices, nIndices);
+	GEOMETRY_RANGE halfRange = m_geometry[MESH_SPHERE].ranges[0];
+	halfRange.indexCount /= 2;
+	AddRange(MESH_HALF_SPHERE, halfRange);
 }
 
 ///////////////////////////////////////////////////
 //	LoadTaperedCylinderMesh()
 //
 //	Create a tapered cylinder mesh by specifying the 
-//  vertices and store it in a VAO/VBO.  The normals 
+//  vertices and store it in the shared buffers.  The normals 
 //  and texture coordinates are also set.
 //
 //  Correct triangle drawing commands:
@@ -1943,29 +1953,19 @@ void ShapeMeshes::LoadTaperedCylinderMesh()
 	};
 
 	// store vertex and index count
-	m_TaperedCylinderMesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV));
-	m_TaperedCylinderMesh.nIndices = 0;
-
-	// Create VAO
-	glGenVertexArrays(1, &m_TaperedCylinderMesh.vao); // we can also generate multiple VAOs or buffers at the same time
-	glBindVertexArray(m_TaperedCylinderMesh.vao);
+	GLuint nVertices = sizeof(verts) / (sizeof(verts[0]) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV));
 
-	// Create VBO
-	glGenBuffers(1, m_TaperedCylinderMesh.vbos);
-	glBindBuffer(GL_ARRAY_BUFFER, m_TaperedCylinderMesh.vbos[0]); // Activates the buffer
-	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
-
-	if (m_bMemoryLayoutDone == false)
-	{
-		SetShaderMemoryLayout();
-	}
+	GLint baseVertex = AddVertices(verts, nVertices);
+	AddArrayRange(MESH_TAPERED_CYLINDER, MESH_PART_BOTTOM, baseVertex, GL_TRIANGLE_FAN, 0, 36);
+	AddArrayRange(MESH_TAPERED_CYLINDER, MESH_PART_TOP, baseVertex, GL_TRIANGLE_FAN, 36, 72);
+	AddArrayRange(MESH_TAPERED_CYLINDER, MESH_PART_SIDES, baseVertex, GL_TRIANGLE_STRIP, 72, 146);
 }
 
 ///////////////////////////////////////////////////
 //	LoadTorusMesh()
 //
 //	Create a torus mesh by specifying the vertices and 
-//  store it in a VAO/VBO.  The normals and texture
+//  store it in the shared buffers.  The normals and texture
 //  coordinates are also set.
 //
 //	Correct triangle drawing command:
@@ -2165,23 +2165,14 @@ void ShapeMeshes::LoadTorusMesh(float thickness)
 		combined_values.push_back(text_coord.y);
 	}
 
-	// store vertex and index count
-	m_TorusMesh.nVertices = vertex_list.size();
-	m_TorusMesh.nIndices = 0;
-
-	// Create VAO
-	glGenVertexArrays(1, &m_TorusMesh.vao); // we can also generate multiple VAOs or buffers at the same time
-	glBindVertexArray(m_TorusMesh.vao);
-
-	// Create VBOs
-	glGenBuffers(1, m_TorusMesh.vbos);
-	glBindBuffer(GL_ARRAY_BUFFER, m_TorusMesh.vbos[0]); // Activates the buffer
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * combined_values.size(), combined_values.data(), GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
+	GLuint nVertices = (GLuint)vertex_list.size();
 
-	if (m_bMemoryLayoutDone == false)
-	{
-		SetShaderMemoryLayout();
-	}
+	// the half torus draws the first half of the torus triangles
+	GLint baseVertex = AddVertices(combined_values.data(), nVertices);
+	AddArrayRange(MESH_TORUS, MESH_PART_ALL, baseVertex, GL_TRIANGLES, 0, nVertices);
+	GEOMETRY_RANGE halfRange = m_geometry[MESH_TORUS].ranges[0];
+	halfRange.indexCount = (nVertices / 2) - ((nVertices / 2) % 3);
+	AddRange(MESH_HALF_TORUS, halfRange);
 }
 
 
@@ -2194,11 +2185,7 @@ void ShapeMeshes::LoadTorusMesh(float thickness)
 ///////////////////////////////////////////////////
 void ShapeMeshes::DrawBoxMesh()
 {
-	glBindVertexArray(m_BoxMesh.vao);
-
-	glDrawElements(GL_TRIANGLES, m_BoxMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
-
-	glBindVertexArray(0);
+	DrawGeometry(MESH_BOX);
 }
 
 ///////////////////////////////////////////////////
@@ -2210,15 +2197,12 @@ void ShapeMeshes::DrawBoxMesh()
 void ShapeMeshes::DrawConeMesh(
 	bool bDrawBottom)
 {
-	glBindVertexArray(m_ConeMesh.vao);
-
+	unsigned int parts = MESH_PART_SIDES;
 	if (bDrawBottom == true)
 	{
-		glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
+		parts |= MESH_PART_BOTTOM;
 	}
-	glDrawArrays(GL_TRIANGLE_STRIP, 36, 108);	//sides
-
-	glBindVertexArray(0);
+	DrawGeometry(MESH_CONE, parts);
 }
 
 ///////////////////////////////////////////////////
@@ -2232,22 +2216,20 @@ void ShapeMeshes::DrawCylinderMesh(
 	bool bDrawBottom,
 	bool bDrawSides)
 {
-	glBindVertexArray(m_CylinderMesh.vao);
-
-	if (bDrawBottom == true)
+	unsigned int parts = 0;
+	if (bDrawTop == true)
 	{
-		glDrawArrays(GL_TRIANGLE_FAN, 0, 36);	//bottom
+		parts |= MESH_PART_TOP;
 	}
-	if (bDrawTop == true)
+	if (bDrawBottom == true)
 	{
-		glDrawArrays(GL_TRIANGLE_FAN, 36, 36);	//top
+		parts |= MESH_PART_BOTTOM;
 	}
 	if (bDrawSides == true)
 	{
-		glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
+		parts |= MESH_PART_SIDES;
 	}
-
-	glBindVertexArray(0);
+	DrawGeometry(MESH_CYLINDER, parts);
 }
 
 ///////////////////////////////////////////////////
@@ -2258,11 +2240,7 @@ void ShapeMeshes::DrawCylinderMesh(
 ///////////////////////////////////////////////////
 void ShapeMeshes::DrawPlaneMesh()
 {
-	glBindVertexArray(m_PlaneMesh.vao);
-
-	glDrawElements(GL_TRIANGLES, m_PlaneMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
-	
-	glBindVertexArray(0);
+	DrawGeometry(MESH_PLANE);
 }
 
 ///////////////////////////////////////////////////
@@ -2273,11 +2251,7 @@ void ShapeMeshes::DrawPlaneMesh()
 ///////////////////////////////////////////////////
 void ShapeMeshes::DrawPrismMesh()
 {
-	glBindVertexArray(m_PrismMesh.vao);
-
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, m_PrismMesh.nVertices);
-
-	glBindVertexArray(0);
+	DrawGeometry(MESH_PRISM);
 }
 
 ///////////////////////////////////////////////////
@@ -2288,11 +2262,7 @@ void ShapeMeshes::DrawPrismMesh()
 ///////////////////////////////////////////////////
 void ShapeMeshes::DrawPyramid3Mesh()
 {
-	glBindVertexArray(m_Pyramid3Mesh.vao);
-
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, m_Pyramid3Mesh.nVertices);
-
-	glBindVertexArray(0);
+	DrawGeometry(MESH_PYRAMID3);
 }
 
 ///////////////////////////////////////////////////
@@ -2303,11 +2273,7 @@ void ShapeMeshes::DrawPyramid3Mesh()
 ///////////////////////////////////////////////////
 void ShapeMeshes::DrawPyramid4Mesh()
 {
-	glBindVertexArray(m_Pyramid4Mesh.vao);
-
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, m_Pyramid4Mesh.nVertices);
-
-	glBindVertexArray(0);
+	DrawGeometry(MESH_PYRAMID4);
 }
 
 ///////////////////////////////////////////////////
@@ -2318,11 +2284,7 @@ void ShapeMeshes::DrawPyramid4Mesh()
 ///////////////////////////////////////////////////
 void ShapeMeshes::DrawSphereMesh()
 {
-	glBindVertexArray(m_SphereMesh.vao);
-
-	glDrawElements(GL_TRIANGLES, m_SphereMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
-
-	glBindVertexArray(0);
+	DrawGeometry(MESH_SPHERE);
 }
 
 ///////////////////////////////////////////////////
@@ -2333,11 +2295,7 @@ void ShapeMeshes::DrawSphereMesh()
 ///////////////////////////////////////////////////
 void ShapeMeshes::DrawHalfSphereMesh()
 {
-	glBindVertexArray(m_SphereMesh.vao);
-
-	glDrawElements(GL_TRIANGLES, m_SphereMesh.nIndices/2, GL_UNSIGNED_INT, (void*)0);
-
-	glBindVertexArray(0);
+	DrawGeometry(MESH_HALF_SPHERE);
 }
 
 ///////////////////////////////////////////////////
@@ -2351,22 +2309,20 @@ void ShapeMeshes::DrawTaperedCylinderMesh(
 	bool bDrawBottom,
 	bool bDrawSides)
 {
-	glBindVertexArray(m_TaperedCylinderMesh.vao);
-
-	if (bDrawBottom == true)
+	unsigned int parts = 0;
+	if (bDrawTop == true)
 	{
-		glDrawArrays(GL_TRIANGLE_FAN, 0, 36);	//bottom
+		parts |= MESH_PART_TOP;
 	}
-	if (bDrawTop == true)
+	if (bDrawBottom == true)
 	{
-		glDrawArrays(GL_TRIANGLE_FAN, 36, 72);	//top
+		parts |= MESH_PART_BOTTOM;
 	}
 	if (bDrawSides == true)
 	{
-		glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
+		parts |= MESH_PART_SIDES;
 	}
-
-	glBindVertexArray(0);
+	DrawGeometry(MESH_TAPERED_CYLINDER, parts);
 }
 
 ///////////////////////////////////////////////////
@@ -2377,11 +2333,7 @@ void ShapeMeshes::DrawTaperedCylinderMesh(
 ///////////////////////////////////////////////////
 void ShapeMeshes::DrawTorusMesh()
 {
-	glBindVertexArray(m_TorusMesh.vao);
-
-	glDrawArrays(GL_TRIANGLES, 0, m_TorusMesh.nVertices);
-
-	glBindVertexArray(0);
+	DrawGeometry(MESH_TORUS);
 }
 
 ///////////////////////////////////////////////////
@@ -2392,11 +2344,7 @@ void ShapeMeshes::DrawTorusMesh()
 ///////////////////////////////////////////////////
 void ShapeMeshes::DrawHalfTorusMesh()
 {
-	glBindVertexArray(m_TorusMesh.vao);
-
-	glDrawArrays(GL_TRIANGLES, 0, m_TorusMesh.nVertices/2);
-
-	glBindVertexArray(0);
+	DrawGeometry(MESH_HALF_TORUS);
 }
 
 glm::vec3 ShapeMeshes::CalculateTriangleNormal(glm::vec3 p0, glm::vec3 p1, glm::vec3 p2)
@@ -2427,21 +2375,753 @@ glm::vec3 ShapeMeshes::CalculateTriangleNormal(glm::vec3 p0, glm::vec3 p1, glm::
 
 
 
+///////////////////////////////////////////////////
+//	SetShaderMemoryLayout()
+//
+//	Create the shared VAO and define the memory layout
+//  of the vertex and instance data read by the shaders.
+//  The attribute formats are set once, the shared
+//  buffers are attached to the two buffer bindings.
+//
+///////////////////////////////////////////////////
 void ShapeMeshes::SetShaderMemoryLayout()
 {
-	// The following code defines the layout of the mesh data in memory - each mesh needs
-	// to have the same memory layout so that the data is retrieved properly by the shaders
+	if (0 != m_vertexArray)
+	{
+		return;
+	}
+
+	glGenVertexArrays(1, &m_vertexArray);
+	glGenBuffers(1, &m_instanceBuffer);
+	BindVertexArray(m_vertexArray);
 
-	// Strides between vertex coordinates is 6 (x, y, z, r, g, b, a). A tightly packed stride is 0.
-	GLint stride = sizeof(float) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV);// The number of floats before each
+	// The following code defines the layout of the mesh data in memory - every
+	// geometry is stored in the shared buffers with the same memory layout
 
-	// Create Vertex Attribute Pointers
-	glVertexAttribPointer(0, g_FloatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
+	// Position, normal and texture coordinate are tightly interleaved per vertex
+	glVertexAttribFormat(0, g_FloatsPerVertex, GL_FLOAT, GL_FALSE, 0);
+	glVertexAttribBinding(0, g_VertexBufferBinding);
 	glEnableVertexAttribArray(0);
 
-	glVertexAttribPointer(1, g_FloatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * g_FloatsPerVertex));
+	glVertexAttribFormat(1, g_FloatsPerNormal, GL_FLOAT, GL_FALSE, sizeof(float) * g_FloatsPerVertex);
+	glVertexAttribBinding(1, g_VertexBufferBinding);
 	glEnableVertexAttribArray(1);
 
-	glVertexAttribPointer(2, g_FloatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (g_FloatsPerVertex + g_FloatsPerNormal)));
+	glVertexAttribFormat(2, g_FloatsPerUV, GL_FLOAT, GL_FALSE, sizeof(float) * (g_FloatsPerVertex + g_FloatsPerNormal));
+	glVertexAttribBinding(2, g_VertexBufferBinding);
 	glEnableVertexAttribArray(2);
-}
\ No newline at end of file
+
+	// The model matrix takes the four locations 3 to 6, followed by the
+	// color (7), the UV scale (8) and the material index (9), each
+	// advancing once per drawn instance
+	for (GLuint column = 0; column < 4; column++)
+	{
+		GLuint location = g_InstanceModelLocation + column;
+		glVertexAttribFormat(location, 4, GL_FLOAT, GL_FALSE,
+			(GLuint)(offsetof(INSTANCE_DATA, model) + sizeof(glm::vec4) * column));
+		glVertexAttribBinding(location, g_InstanceBufferBinding);
+		glEnableVertexAttribArray(location);
+	}
+
+	glVertexAttribFormat(g_InstanceColorLocation, 4, GL_FLOAT, GL_FALSE,
+		(GLuint)offsetof(INSTANCE_DATA, color));
+	glVertexAttribBinding(g_InstanceColorLocation, g_InstanceBufferBinding);
+	glEnableVertexAttribArray(g_InstanceColorLocation);
+
+	glVertexAttribFormat(g_InstanceUVScaleLocation, 2, GL_FLOAT, GL_FALSE,
+		(GLuint)offsetof(INSTANCE_DATA, uvScale));
+	glVertexAttribBinding(g_InstanceUVScaleLocation, g_InstanceBufferBinding);
+	glEnableVertexAttribArray(g_InstanceUVScaleLocation);
+
+	glVertexAttribIFormat(g_InstanceMaterialLocation, 1, GL_INT,
+		(GLuint)offsetof(INSTANCE_DATA, materialIndex));
+	glVertexAttribBinding(g_InstanceMaterialLocation, g_InstanceBufferBinding);
+	glEnableVertexAttribArray(g_InstanceMaterialLocation);
+
+	glVertexBindingDivisor(g_InstanceBufferBinding, 1);
+	glBindVertexBuffer(g_InstanceBufferBinding, m_instanceBuffer, 0, sizeof(INSTANCE_DATA));
+}
+
+///////////////////////////////////////////////////
+//	AddVertices()
+//
+//	Stage the vertices of a shape for the next upload
+//  to the shared vertex buffer and return the index
+//  of its first vertex.
+//
+///////////////////////////////////////////////////
+GLint ShapeMeshes::AddVertices(const GLfloat* vertices, GLuint vertexCount)
+{
+	GLint baseVertex = (GLint)m_vertexCount;
+
+	m_stagedVertices.insert(m_stagedVertices.end(),
+		vertices, vertices + vertexCount * g_FloatsPerShapeVertex);
+	m_vertexCount += vertexCount;
+
+	return(baseVertex);
+}
+
+///////////////////////////////////////////////////
+//	AddIndexedRange()
+//
+//	Stage the triangle indices of a shape part and
+//  add the part to the shape geometry.
+//
+///////////////////////////////////////////////////
+void ShapeMeshes::AddIndexedRange(
+	unsigned int geometry, unsigned int partMask, GLint baseVertex,
+	const GLuint* indices, GLuint indexCount)
+{
+	GEOMETRY_RANGE range;
+	range.firstIndex = m_indexCount;
+	range.indexCount = indexCount;
+	range.baseVertex = baseVertex;
+	range.partMask = partMask;
+
+	m_stagedIndices.insert(m_stagedIndices.end(), indices, indices + indexCount);
+	m_indexCount += indexCount;
+
+	AddRange(geometry, range);
+}
+
+///////////////////////////////////////////////////
+//	AddArrayRange()
+//
+//	Convert consecutive vertices drawn as triangles,
+//  a triangle strip or a triangle fan into triangle
+//  indices and add them as a shape part.  Strips keep
+//  the winding of every other triangle flipped, the
+//  same way GL assembles them.
+//
+///////////////////////////////////////////////////
+void ShapeMeshes::AddArrayRange(
+	unsigned int geometry, unsigned int partMask, GLint baseVertex,
+	GLenum mode, GLuint first, GLuint count)
+{
+	std::vector<GLuint> indices;
+
+	if (mode == GL_TRIANGLES)
+	{
+		for (GLuint i = 0; i < count; i++)
+		{
+			indices.push_back(first + i);
+		}
+	}
+	else if ((mode == GL_TRIANGLE_STRIP) && (count >= 3))
+	{
+		for (GLuint i = 0; i < count - 2; i++)
+		{
+			if ((i % 2) == 0)
+			{
+				indices.push_back(first + i);
+				indices.push_back(first + i + 1);
+			}
+			else
+			{
+				indices.push_back(first + i + 1);
+				indices.push_back(first + i);
+			}
+			indices.push_back(first + i + 2);
+		}
+	}
+	else if ((mode == GL_TRIANGLE_FAN) && (count >= 3))
+	{
+		for (GLuint i = 1; i < count - 1; i++)
+		{
+			indices.push_back(first);
+			indices.push_back(first + i);
+			indices.push_back(first + i + 1);
+		}
+	}
+
+	if (indices.size() > 0)
+	{
+		AddIndexedRange(geometry, partMask, baseVertex, &indices[0], (GLuint)indices.size());
+	}
+}
+
+///////////////////////////////////////////////////
+//	AddRange()
+//
+//	Add a drawable range to a geometry and update the
+//  bounds of the geometry.
+//
+///////////////////////////////////////////////////
+void ShapeMeshes::AddRange(unsigned int geometry, const GEOMETRY_RANGE& range)
+{
+	GEOMETRY& target = m_geometry[geometry];
+	if (target.rangeCount < 3)
+	{
+		target.ranges[target.rangeCount] = range;
+		target.rangeCount++;
+		UpdateBounds(geometry);
+	}
+}
+
+///////////////////////////////////////////////////
+//	UpdateBounds()
+//
+//	Compute the box around every vertex used by the
+//  ranges of a geometry, then the sphere around the
+//  center of the box that holds the same vertices.
+//  Ranges are added while their indices and vertices
+//  are still staged, so they are read from the staged
+//  arrays.
+//
+///////////////////////////////////////////////////
+void ShapeMeshes::UpdateBounds(unsigned int geometry)
+{
+	GEOMETRY& target = m_geometry[geometry];
+	for (int i = 0; i < target.rangeCount; i++)
+	{
+		if ((target.ranges[i].firstIndex < m_uploadedIndices) ||
+			((GLuint)target.ranges[i].baseVertex < m_uploadedVertices))
+		{
+			return;
+		}
+	}
+
+	glm::vec3 boxMin(FLT_MAX);
+	glm::vec3 boxMax(-FLT_MAX);
+	for (int pass = 0; pass < 2; pass++)
+	{
+		glm::vec3 center = (boxMin + boxMax) * 0.5f;
+		float radiusSquared = 0.0f;
+
+		for (int i = 0; i < target.rangeCount; i++)
+		{
+			const GEOMETRY_RANGE& range = target.ranges[i];
+			const GLuint* indices = &m_stagedIndices[range.firstIndex - m_uploadedIndices];
+			for (GLuint j = 0; j < range.indexCount; j++)
+			{
+				size_t vertex = range.baseVertex + indices[j] - m_uploadedVertices;
+				const GLfloat* source = &m_stagedVertices[vertex * g_FloatsPerShapeVertex];
+				glm::vec3 position(source[0], source[1], source[2]);
+
+				if (pass == 0)
+				{
+					boxMin = glm::min(boxMin, position);
+					boxMax = glm::max(boxMax, position);
+				}
+				else
+				{
+					glm::vec3 offset = position - center;
+					radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+				}
+			}
+		}
+
+		if (pass == 1)
+		{
+			target.bounds.sphereCenter = center;
+			target.bounds.sphereRadius = std::sqrt(radiusSquared);
+		}
+		else if (boxMin.x > boxMax.x)
+		{
+			// no vertices
+			return;
+		}
+	}
+
+	target.bounds.boxMin = boxMin;
+	target.bounds.boxMax = boxMax;
+}
+
+///////////////////////////////////////////////////
+//	AddGeometry()
+//
+//	Add the indexed triangles of a mesh created outside
+//  of this class, such as an imported model, to the
+//  shared buffers.  The returned identifier is drawn
+//  with DrawGeometry().
+//
+///////////////////////////////////////////////////
+unsigned int ShapeMeshes::AddGeometry(
+	const GLfloat* vertices, GLuint vertexCount,
+	const GLuint* indices, GLuint indexCount)
+{
+	unsigned int geometry = (unsigned int)m_geometry.size();
+	GEOMETRY newGeometry;
+	newGeometry.rangeCount = 0;
+	memset(&newGeometry.bounds, 0, sizeof(GEOMETRY_BOUNDS));
+	m_geometry.push_back(newGeometry);
+
+	GLint baseVertex = AddVertices(vertices, vertexCount);
+	AddIndexedRange(geometry, MESH_PART_ALL, baseVertex, indices, indexCount);
+
+	return(geometry);
+}
+
+///////////////////////////////////////////////////
+//	AddGeometryLevel()
+//
+//	Add an index list that draws from the vertices of
+//  an added geometry as a geometry of its own.  The
+//  vertices are not copied, the new range uses the
+//  base vertex of the source.  The bounds are taken
+//  from the source, so culling does not depend on
+//  which level is drawn.
+//
+///////////////////////////////////////////////////
+unsigned int ShapeMeshes::AddGeometryLevel(unsigned int sourceGeometry,
+	const GLuint* indices, GLuint indexCount)
+{
+	if ((sourceGeometry >= m_geometry.size()) ||
+		(m_geometry[sourceGeometry].rangeCount == 0))
+	{
+		return(INVALID_GEOMETRY);
+	}
+
+	unsigned int geometry = (unsigned int)m_geometry.size();
+	GEOMETRY newGeometry;
+	newGeometry.rangeCount = 0;
+	newGeometry.bounds = m_geometry[sourceGeometry].bounds;
+	m_geometry.push_back(newGeometry);
+
+	AddIndexedRange(geometry, MESH_PART_ALL, m_geometry[sourceGeometry].ranges[0].baseVertex,
+		indices, indexCount);
+	m_geometry[geometry].bounds = m_geometry[sourceGeometry].bounds;
+
+	return(geometry);
+}
+
+///////////////////////////////////////////////////
+//	GetIndexCount()
+//
+//	Sum the indices of the selected parts of a
+//  geometry, three for every triangle drawn.
+//
+///////////////////////////////////////////////////
+GLuint ShapeMeshes::GetIndexCount(unsigned int geometry, unsigned int parts) const
+{
+	if (geometry >= m_geometry.size())
+	{
+		return(0);
+	}
+
+	GLuint indexCount = 0;
+	const GEOMETRY& source = m_geometry[geometry];
+	for (int i = 0; i < source.rangeCount; i++)
+	{
+		if (source.ranges[i].partMask & parts)
+		{
+			indexCount += source.ranges[i].indexCount;
+		}
+	}
+	return(indexCount);
+}
+
+///////////////////////////////////////////////////
+//	GetGeometryData()
+//
+//	Read the index ranges of the selected parts of a
+//  geometry and the vertices they use back from the
+//  shared buffers.  Staged geometry is uploaded first,
+//  so this needs a current GL context and is meant for
+//  load time tools such as baking.
+//
+///////////////////////////////////////////////////
+bool ShapeMeshes::GetGeometryData(unsigned int geometry, unsigned int parts,
+	std::vector<GLfloat>& vertices, std::vector<GLuint>& indices)
+{
+	if (geometry >= m_geometry.size())
+	{
+		return(false);
+	}
+	UploadGeometry();
+
+	const GEOMETRY& source = m_geometry[geometry];
+	for (int i = 0; i < source.rangeCount; i++)
+	{
+		const GEOMETRY_RANGE& range = source.ranges[i];
+		if (((range.partMask & parts) == 0) || (0 == range.indexCount))
+		{
+			continue;
+		}
+
+		std::vector<GLuint> rangeIndices(range.indexCount);
+		glBindBuffer(GL_COPY_READ_BUFFER, m_indexBuffer);
+		glGetBufferSubData(GL_COPY_READ_BUFFER, range.firstIndex * sizeof(GLuint),
+			range.indexCount * sizeof(GLuint), &rangeIndices[0]);
+
+		// only the vertices between the lowest and highest
+		// index of the range are read
+		GLuint lowest = *std::min_element(rangeIndices.begin(), rangeIndices.end());
+		GLuint highest = *std::max_element(rangeIndices.begin(), rangeIndices.end());
+		GLuint vertexCount = highest - lowest + 1;
+
+		size_t firstFloat = vertices.size();
+		GLuint firstVertex = (GLuint)(firstFloat / g_FloatsPerShapeVertex);
+		vertices.resize(firstFloat + vertexCount * g_FloatsPerShapeVertex);
+		glBindBuffer(GL_COPY_READ_BUFFER, m_vertexBuffer);
+		glGetBufferSubData(GL_COPY_READ_BUFFER,
+			(range.baseVertex + lowest) * g_FloatsPerShapeVertex * sizeof(GLfloat),
+			vertexCount * g_FloatsPerShapeVertex * sizeof(GLfloat), &vertices[firstFloat]);
+
+		for (size_t j = 0; j < rangeIndices.size(); j++)
+		{
+			indices.push_back(rangeIndices[j] - lowest + firstVertex);
+		}
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+	return(true);
+}
+
+///////////////////////////////////////////////////
+//	UploadGeometry()
+//
+//	Append the staged vertices and indices to the
+//  shared buffers.  The staged copies are released
+//  afterwards, so geometry only lives on the GPU.
+//
+///////////////////////////////////////////////////
+void ShapeMeshes::UploadGeometry()
+{
+	if (m_stagedVertices.empty() && m_stagedIndices.empty())
+	{
+		return;
+	}
+	SetShaderMemoryLayout();
+
+	const size_t vertexSize = sizeof(GLfloat) * g_FloatsPerShapeVertex;
+	if (m_vertexCount > m_vertexCapacity)
+	{
+		m_vertexCapacity = std::max(m_vertexCount, m_vertexCapacity * 2);
+		GrowBuffer(m_vertexBuffer, m_uploadedVertices * vertexSize, m_vertexCapacity * vertexSize);
+	}
+	if (m_indexCount > m_indexCapacity)
+	{
+		m_indexCapacity = std::max(m_indexCount, m_indexCapacity * 2);
+		GrowBuffer(m_indexBuffer, m_uploadedIndices * sizeof(GLuint), m_indexCapacity * sizeof(GLuint));
+	}
+
+	// the copy target keeps the element binding of the VAO untouched
+	if (!m_stagedVertices.empty())
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, m_vertexBuffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, m_uploadedVertices * vertexSize,
+			m_stagedVertices.size() * sizeof(GLfloat), &m_stagedVertices[0]);
+	}
+	if (!m_stagedIndices.empty())
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, m_indexBuffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, m_uploadedIndices * sizeof(GLuint),
+			m_stagedIndices.size() * sizeof(GLuint), &m_stagedIndices[0]);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	// the buffers are replaced when they grow, so attach them again
+	BindVertexArray(m_vertexArray);
+	glBindVertexBuffer(g_VertexBufferBinding, m_vertexBuffer, 0, (GLsizei)vertexSize);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+
+	m_uploadedVertices = m_vertexCount;
+	m_uploadedIndices = m_indexCount;
+	std::vector<GLfloat>().swap(m_stagedVertices);
+	std::vector<GLuint>().swap(m_stagedIndices);
+}
+
+///////////////////////////////////////////////////
+//	GrowBuffer()
+//
+//	Replace a shared buffer with a larger one and copy
+//  the already uploaded contents over on the GPU.
+//
+///////////////////////////////////////////////////
+void ShapeMeshes::GrowBuffer(GLuint& buffer, size_t usedBytes, size_t capacityBytes)
+{
+	GLuint newBuffer = 0;
+	glGenBuffers(1, &newBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, capacityBytes, NULL, GL_STATIC_DRAW);
+
+	if (0 != buffer)
+	{
+		if (usedBytes > 0)
+		{
+			glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedBytes);
+			glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		}
+		glDeleteBuffers(1, &buffer);
+	}
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	buffer = newBuffer;
+}
+
+///////////////////////////////////////////////////
+//	UploadInstances()
+//
+//	Write the per-instance data of a frame into the
+//  shared instance buffer.  The buffer storage is
+//  orphaned so the upload does not wait for draws of
+//  the previous frame that still read from it.
+//
+///////////////////////////////////////////////////
+void ShapeMeshes::UploadInstances(const INSTANCE_DATA* instances, size_t count)
+{
+	if (0 == count)
+	{
+		return;
+	}
+	SetShaderMemoryLayout();
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+	if (count > m_instanceCapacity)
+	{
+		m_instanceCapacity = count * 2;
+	}
+	glBufferData(GL_ARRAY_BUFFER, m_instanceCapacity * sizeof(INSTANCE_DATA), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(INSTANCE_DATA), instances);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+///////////////////////////////////////////////////
+//	SetInstanceRange()
+//
+//	Select the instances of the shared instance buffer
+//  that the following draw methods render.
+//
+///////////////////////////////////////////////////
+void ShapeMeshes::SetInstanceRange(GLuint baseInstance, GLsizei instanceCount)
+{
+	m_baseInstance = baseInstance;
+	m_instanceCount = instanceCount;
+}
+
+///////////////////////////////////////////////////
+//	BeginCommands()
+//
+//	Collect the following draws as indirect draw
+//  commands until SubmitCommands() is called.
+//
+///////////////////////////////////////////////////
+void ShapeMeshes::BeginCommands()
+{
+	m_bCollectCommands = true;
+}
+
+///////////////////////////////////////////////////
+//	SubmitCommands()
+//
+//	Write the collected draw commands to the indirect
+//  buffer and issue all of them with one call of
+//  glMultiDrawElementsIndirect on the shared VAO.
+//
+///////////////////////////////////////////////////
+GLsizei ShapeMeshes::SubmitCommands()
+{
+	m_bCollectCommands = false;
+
+	GLsizei commandCount = (GLsizei)m_commands.size();
+	if (0 == commandCount)
+	{
+		return(0);
+	}
+
+	UploadGeometry();
+	BindVertexArray(m_vertexArray);
+
+	if (0 == m_indirectBuffer)
+	{
+		glGenBuffers(1, &m_indirectBuffer);
+	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+	if ((size_t)commandCount > m_indirectCapacity)
+	{
+		m_indirectCapacity = commandCount * 2;
+	}
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, m_indirectCapacity * sizeof(DRAW_ELEMENTS_COMMAND), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commandCount * sizeof(DRAW_ELEMENTS_COMMAND), &m_commands[0]);
+
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, commandCount, 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	// without a state cache the VAO binding is not tracked
+	if (NULL == m_pStateCache)
+	{
+		glBindVertexArray(0);
+	}
+
+	m_commands.clear();
+	return(commandCount);
+}
+
+///////////////////////////////////////////////////
+//	SupportsIndirectCount()
+//
+//	Check for the indirect draw that reads its draw
+//  count from a buffer.
+//
+///////////////////////////////////////////////////
+bool ShapeMeshes::SupportsIndirectCount()
+{
+	return(GLEW_VERSION_4_6 || GLEW_ARB_indirect_parameters);
+}
+
+///////////////////////////////////////////////////
+//	SubmitIndirectCount()
+//
+//	Issue the draw commands that were written into an
+//  indirect buffer on the GPU with one multi-draw
+//  call, taking the number of commands from the
+//  parameter buffer.  The instance buffer written
+//  with them replaces the shared instance buffer for
+//  the call, the base instance of every command
+//  selects its entry.
+//
+///////////////////////////////////////////////////
+void ShapeMeshes::SubmitIndirectCount(GLuint indirectBuffer, GLintptr indirectOffset,
+	GLuint parameterBuffer, GLintptr drawCountOffset, GLsizei maxDrawCount,
+	GLuint instanceBuffer)
+{
+	if (0 == maxDrawCount)
+	{
+		return;
+	}
+
+	UploadGeometry();
+	SetShaderMemoryLayout();
+	BindVertexArray(m_vertexArray);
+	glBindVertexBuffer(g_InstanceBufferBinding, instanceBuffer, 0, sizeof(INSTANCE_DATA));
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+	glBindBuffer(GL_PARAMETER_BUFFER, parameterBuffer);
+	if (GLEW_VERSION_4_6)
+	{
+		glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)indirectOffset,
+			drawCountOffset, maxDrawCount, 0);
+	}
+	else
+	{
+		glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)indirectOffset,
+			drawCountOffset, maxDrawCount, 0);
+	}
+	glBindBuffer(GL_PARAMETER_BUFFER, 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	glBindVertexBuffer(g_InstanceBufferBinding, m_instanceBuffer, 0, sizeof(INSTANCE_DATA));
+
+	// without a state cache the VAO binding is not tracked
+	if (NULL == m_pStateCache)
+	{
+		glBindVertexArray(0);
+	}
+}
+
+///////////////////////////////////////////////////
+//	DrawGeometry()
+//
+//	Add a draw command for every range of a geometry
+//  that belongs to the selected parts.  Ranges that
+//  follow each other in the index buffer are merged
+//  into one command.  Outside of BeginCommands() and
+//  SubmitCommands() the draw is issued right away.
+//
+///////////////////////////////////////////////////
+void ShapeMeshes::DrawGeometry(unsigned int geometry, unsigned int parts)
+{
+	if (geometry >= m_geometry.size())
+	{
+		return;
+	}
+
+	const GEOMETRY& source = m_geometry[geometry];
+	for (int i = 0; i < source.rangeCount; i++)
+	{
+		const GEOMETRY_RANGE& range = source.ranges[i];
+		if ((range.partMask & parts) == 0)
+		{
+			continue;
+		}
+
+		if (!m_commands.empty())
+		{
+			DRAW_ELEMENTS_COMMAND& last = m_commands.back();
+			if ((last.baseVertex == range.baseVertex) &&
+				(last.firstIndex + last.count == range.firstIndex) &&
+				(last.baseInstance == m_baseInstance) &&
+				(last.instanceCount == (GLuint)m_instanceCount))
+			{
+				last.count += range.indexCount;
+				continue;
+			}
+		}
+
+		DRAW_ELEMENTS_COMMAND command;
+		command.count = range.indexCount;
+		command.instanceCount = (GLuint)m_instanceCount;
+		command.firstIndex = range.firstIndex;
+		command.baseVertex = range.baseVertex;
+		command.baseInstance = m_baseInstance;
+		m_commands.push_back(command);
+	}
+
+	if (!m_bCollectCommands)
+	{
+		SubmitCommands();
+	}
+}
+
+///////////////////////////////////////////////////
+//	GetDrawCommands()
+//
+//	Build the draw commands of the selected parts of a
+//  geometry without issuing them.  Ranges that follow
+//  each other in the index buffer are merged the same
+//  way as in DrawGeometry().
+//
+///////////////////////////////////////////////////
+int ShapeMeshes::GetDrawCommands(unsigned int geometry, unsigned int parts,
+	DRAW_ELEMENTS_COMMAND* commands) const
+{
+	if (geometry >= m_geometry.size())
+	{
+		return(0);
+	}
+
+	int commandCount = 0;
+	const GEOMETRY& source = m_geometry[geometry];
+	for (int i = 0; i < source.rangeCount; i++)
+	{
+		const GEOMETRY_RANGE& range = source.ranges[i];
+		if (((range.partMask & parts) == 0) || (0 == range.indexCount))
+		{
+			continue;
+		}
+
+		if (commandCount > 0)
+		{
+			DRAW_ELEMENTS_COMMAND& last = commands[commandCount - 1];
+			if ((last.baseVertex == range.baseVertex) &&
+				(last.firstIndex + last.count == range.firstIndex))
+			{
+				last.count += range.indexCount;
+				continue;
+			}
+		}
+
+		DRAW_ELEMENTS_COMMAND& command = commands[commandCount];
+		command.count = range.indexCount;
+		command.instanceCount = 1;
+		command.firstIndex = range.firstIndex;
+		command.baseVertex = range.baseVertex;
+		command.baseInstance = 0;
+		commandCount++;
+	}
+	return(commandCount);
+}
+
+///////////////////////////////////////////////////
+//	DrawMesh()
+//
+//	Draw the shape with the passed in identifier.
+//  The part mask selects the drawn caps and sides.
+// 
+///////////////////////////////////////////////////
+void ShapeMeshes::DrawMesh(MeshID mesh, unsigned int parts)
+{
+	DrawGeometry((unsigned int)mesh, parts);
+}
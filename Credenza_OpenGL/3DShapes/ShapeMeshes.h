@@ -12,8 +12,12 @@
 
 #include <GL/glew.h>
 
+#include "GLStateCache.h"
+
 #include <glm/glm.hpp>
 
+#include <vector>
+
 /***********************************************************
  *  ShapeMeshes
  *
@@ -23,33 +27,146 @@
 class ShapeMeshes
 {
 public:
+	// identifiers of the drawable shapes
+	enum MeshID
+	{
+		MESH_BOX = 0,
+		MESH_CONE,
+		MESH_CYLINDER,
+		MESH_PLANE,
+		MESH_PRISM,
+		MESH_PYRAMID3,
+		MESH_PYRAMID4,
+		MESH_SPHERE,
+		MESH_HALF_SPHERE,
+		MESH_TAPERED_CYLINDER,
+		MESH_TORUS,
+		MESH_HALF_TORUS,
+		MESH_COUNT
+	};
+
+	// parts of the shapes that have caps
+	enum MeshPart
+	{
+		MESH_PART_TOP = 1 << 0,
+		MESH_PART_BOTTOM = 1 << 1,
+		MESH_PART_SIDES = 1 << 2,
+		MESH_PART_ALL = MESH_PART_TOP | MESH_PART_BOTTOM | MESH_PART_SIDES
+	};
+
+	// per-instance data read by the vertex shader, one entry
+	// for every drawn object
+	struct INSTANCE_DATA
+	{
+		glm::mat4 model;
+		glm::vec4 color;
+		glm::vec2 uvScale;
+		GLint materialIndex;
+		GLint padding;
+	};
+
+	// what to draw for one object - a basic shape or an added
+	// geometry and the parts of it, resolved to index ranges of
+	// the shared buffers when the draw is issued
+	struct DRAW_RECORD
+	{
+		GLuint geometry;
+		GLuint parts;
+	};
+
+	// geometry identifier of a record that draws nothing
+	static const GLuint INVALID_GEOMETRY = 0xFFFFFFFF;
+
+	// make a draw record for a shape or an added geometry
+	static inline DRAW_RECORD MakeDrawRecord(GLuint geometry, GLuint parts = MESH_PART_ALL)
+	{
+		DRAW_RECORD record = { geometry, parts };
+		return record;
+	}
+
+	// local space bounds of a geometry, an axis aligned box and
+	// a sphere around the center of the box
+	struct GEOMETRY_BOUNDS
+	{
+		glm::vec3 boxMin;
+		glm::vec3 boxMax;
+		glm::vec3 sphereCenter;
+		float sphereRadius;
+	};
+
+	// one draw of the shared geometry buffers, laid out as read
+	// by glMultiDrawElementsIndirect from the indirect buffer
+	struct DRAW_ELEMENTS_COMMAND
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
 	// constructor
 	ShapeMeshes();
+	// destructor
+	~ShapeMeshes();
+
+	// route the draw binds through a GL state cache, NULL to disable
+	void SetStateCache(GLStateCache* pStateCache);
 
 private:
 
-	// stores the GL data relative to a given mesh
-	struct GLMesh
+	// index range of one drawable part of a geometry
+	struct GEOMETRY_RANGE
+	{
+		GLuint firstIndex;		// first index in the shared index buffer
+		GLuint indexCount;		// number of triangle list indices
+		GLint baseVertex;		// first vertex in the shared vertex buffer
+		unsigned int partMask;	// parts of the geometry the range belongs to
+	};
+
+	// drawable ranges of a basic shape or an added mesh
+	struct GEOMETRY
 	{
-		GLuint vao;         // Handle for the vertex array object
-		GLuint vbos[2];     // Handles for the vertex buffer objects
-		GLuint nVertices;	// Number of vertices for the mesh
-		GLuint nIndices;    // Number of indices for the mesh
+		GEOMETRY_RANGE ranges[3];
+		int rangeCount;
+		GEOMETRY_BOUNDS bounds;
 	};
 
-	// the available 3D shapes
-	GLMesh m_BoxMesh;
-	GLMesh m_ConeMesh;
-	GLMesh m_CylinderMesh;
-	GLMesh m_PlaneMesh;
-	GLMesh m_PrismMesh;
-	GLMesh m_Pyramid3Mesh;
-	GLMesh m_Pyramid4Mesh;
-	GLMesh m_SphereMesh;
-	GLMesh m_TaperedCylinderMesh;
-	GLMesh m_TorusMesh;
+	// geometries indexed by MeshID, followed by the added meshes
+	std::vector<GEOMETRY> m_geometry;
+
+	// geometry added since the last upload to the shared buffers
+	std::vector<GLfloat> m_stagedVertices;
+	std::vector<GLuint> m_stagedIndices;
+
+	// shared vertex array and buffers of every geometry
+	GLuint m_vertexArray;
+	GLuint m_vertexBuffer;
+	GLuint m_indexBuffer;
+	GLuint m_indirectBuffer;
+	// vertices and indices in the shared buffers, including staged ones
+	GLuint m_vertexCount;
+	GLuint m_indexCount;
+	// vertices and indices already uploaded and the buffer capacities
+	GLuint m_uploadedVertices;
+	GLuint m_uploadedIndices;
+	GLuint m_vertexCapacity;
+	GLuint m_indexCapacity;
+	size_t m_indirectCapacity;
+
+	// optional cache of the bound GL state
+	GLStateCache* m_pStateCache;
 
-	bool m_bMemoryLayoutDone;
+	// shared per-instance data of every draw
+	GLuint m_instanceBuffer;
+	size_t m_instanceCapacity;
+	// instance range used by the draw methods
+	GLuint m_baseInstance;
+	GLsizei m_instanceCount;
+
+	// draws collected for the next multi-draw submission
+	std::vector<DRAW_ELEMENTS_COMMAND> m_commands;
+	bool m_bCollectCommands;
 
 public:
 	// methods for loading the shape mesh data 
@@ -87,6 +204,64 @@ public:
 	void DrawTorusMesh();
 	void DrawHalfTorusMesh();
 
+	// draw a shape by identifier - the part mask selects the
+	// caps and sides of the cone and cylinder shapes
+	void DrawMesh(MeshID mesh, unsigned int parts = MESH_PART_ALL);
+
+	// add indexed triangles to the shared buffers and get the
+	// geometry identifier used to draw them - the vertices use
+	// the shape layout of position, normal and texture coordinate
+	unsigned int AddGeometry(
+		const GLfloat* vertices, GLuint vertexCount,
+		const GLuint* indices, GLuint indexCount);
+	// add another index list over the vertices of an added geometry,
+	// such as a coarser level of detail, and get its identifier -
+	// the indices are relative to the vertices of the source and
+	// the new geometry keeps the bounds of the source
+	unsigned int AddGeometryLevel(unsigned int sourceGeometry,
+		const GLuint* indices, GLuint indexCount);
+	// draw a basic shape or an added geometry by identifier
+	void DrawGeometry(unsigned int geometry, unsigned int parts = MESH_PART_ALL);
+	// draw the geometry parts selected by a draw record
+	inline void DrawRecord(const DRAW_RECORD& record) { DrawGeometry(record.geometry, record.parts); }
+	// get the draw commands DrawGeometry() would issue for the
+	// selected parts of a geometry, for one instance at instance
+	// 0 - returns the number of commands written, at most three
+	int GetDrawCommands(unsigned int geometry, unsigned int parts,
+		DRAW_ELEMENTS_COMMAND* commands) const;
+	// local bounds of a basic shape or an added geometry, computed
+	// from its vertices when it is loaded
+	inline const GEOMETRY_BOUNDS& GetGeometryBounds(unsigned int geometry) const { return m_geometry[geometry].bounds; }
+	// number of indices drawn for the selected parts of a geometry
+	GLuint GetIndexCount(unsigned int geometry, unsigned int parts = MESH_PART_ALL) const;
+	// read the triangles of the selected parts of a geometry back
+	// from the shared buffers - the shape layout vertices and the
+	// indices are appended, the indices starting at the first
+	// appended vertex
+	bool GetGeometryData(unsigned int geometry, unsigned int parts,
+		std::vector<GLfloat>& vertices, std::vector<GLuint>& indices);
+
+	// write the per-instance data of a frame
+	void UploadInstances(const INSTANCE_DATA* instances, size_t count);
+	// select the instances drawn by the following draw calls
+	void SetInstanceRange(GLuint baseInstance, GLsizei instanceCount);
+
+	// collect the following draws instead of issuing them one by one
+	void BeginCommands();
+	// issue the collected draws with a single multi-draw call and
+	// get the number of draw commands it contained
+	GLsizei SubmitCommands();
+
+	// check whether the draw count of an indirect draw can be
+	// read from a buffer, core in GL 4.6 or ARB_indirect_parameters
+	static bool SupportsIndirectCount();
+	// issue draw commands written to a buffer on the GPU, the
+	// number of commands is read from the parameter buffer and the
+	// per-instance data from the passed in instance buffer
+	void SubmitIndirectCount(GLuint indirectBuffer, GLintptr indirectOffset,
+		GLuint parameterBuffer, GLintptr drawCountOffset, GLsizei maxDrawCount,
+		GLuint instanceBuffer);
+
 
 private:
 
@@ -95,7 +270,33 @@ private:
 	glm::vec3 CalculateTriangleNormal(
 		glm::vec3 px, glm::vec3 py, glm::vec3 pz);
 
-	// called to set the memory layout 
-	// template for shader data
+	// called to create the shared vertex array and
+	// set the memory layout template for shader data
 	void SetShaderMemoryLayout();
+
+	// called to bind the shared vertex array
+	void BindVertexArray(GLuint vao);
+
+	// called to stage shape vertices and get their base vertex
+	GLint AddVertices(const GLfloat* vertices, GLuint vertexCount);
+	// called to add a part of a shape as indexed triangles
+	void AddIndexedRange(
+		unsigned int geometry, unsigned int partMask, GLint baseVertex,
+		const GLuint* indices, GLuint indexCount);
+	// called to add a part of a shape drawn from consecutive
+	// vertices, converted from the passed in primitive mode
+	// into an indexed triangle list
+	void AddArrayRange(
+		unsigned int geometry, unsigned int partMask, GLint baseVertex,
+		GLenum mode, GLuint first, GLuint count);
+	// called to add a range to a geometry
+	void AddRange(unsigned int geometry, const GEOMETRY_RANGE& range);
+	// called to compute the bounds of a geometry from the
+	// staged vertices of its ranges
+	void UpdateBounds(unsigned int geometry);
+
+	// called to upload the staged geometry to the shared buffers
+	void UploadGeometry();
+	// called to grow a shared buffer, keeping its uploaded contents
+	void GrowBuffer(GLuint& buffer, size_t usedBytes, size_t capacityBytes);
 };
\ No newline at end of file
@@ -0,0 +1,561 @@
+///////////////////////////////////////////////////////////////////////////////
+// BoundingVolumeHierarchy.cpp
+// ============
+// group a set of bounding boxes into a four-wide tree, so the nearest box
+// hit by a ray is found without testing every box
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "BoundingVolumeHierarchy.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)) || defined(__SSE2__)
+#define BOUNDING_VOLUME_HIERARCHY_SSE2
+#include <emmintrin.h>
+#endif
+
+// declaration of global variables
+namespace
+{
+	// most primitives of a leaf
+	const size_t g_LeafSize = 4;
+	// bins of the surface area heuristic
+	const int g_BinCount = 16;
+	// below this depth runs are split at the median, which
+	// bounds the depth of the tree and the traversal stack
+	const int g_MaxHeuristicDepth = 40;
+	// entries of the traversal stack, three per level are
+	// enough as every popped node pushes at most four
+	const int g_StackSize = 3 * (g_MaxHeuristicDepth + 64) + 4;
+
+	/***********************************************************
+	 *  HalfArea()
+	 *
+	 *  This function is used for the half surface area of a
+	 *  box, the cost measure of the surface area heuristic.
+	 ***********************************************************/
+	inline float HalfArea(const glm::vec3& boxMin, const glm::vec3& boxMax)
+	{
+		glm::vec3 size = glm::max(boxMax - boxMin, glm::vec3(0.0f));
+		return(size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	// child of a node hit by a ray, with the distance it was entered at
+	struct CHILD_HIT
+	{
+		int slot;
+		float distance;
+	};
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for removing all primitives.
+ ***********************************************************/
+void BoundingVolumeHierarchy::Clear()
+{
+	m_nodes.clear();
+	m_primitives.clear();
+	m_centroids.clear();
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is used for building the tree.  Nodes are
+ *  created depth first, so every child node has a higher
+ *  index than its parent.
+ ***********************************************************/
+void BoundingVolumeHierarchy::Build(const glm::vec3* boxMins, const glm::vec3* boxMaxs, size_t count)
+{
+	Clear();
+	if (0 == count)
+	{
+		return;
+	}
+
+	m_pBoxMins = boxMins;
+	m_pBoxMaxs = boxMaxs;
+	m_primitives.resize(count);
+	m_centroids.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		m_primitives[i] = (uint32_t)i;
+		m_centroids[i] = (boxMins[i] + boxMaxs[i]) * 0.5f;
+	}
+
+	m_nodes.reserve((count / 2) + 1);
+	BuildNode(0, count, 0);
+
+	m_pBoxMins = NULL;
+	m_pBoxMaxs = NULL;
+	std::vector<glm::vec3>().swap(m_centroids);
+}
+
+/***********************************************************
+ *  BuildNode()
+ *
+ *  This method is used for creating a node.  The run of
+ *  primitives is split in two, and each half split again
+ *  when it does not fit a leaf, giving up to four children.
+ ***********************************************************/
+uint32_t BoundingVolumeHierarchy::BuildNode(size_t first, size_t count, int depth)
+{
+	uint32_t node = (uint32_t)m_nodes.size();
+	BVH_NODE empty;
+	for (int slot = 0; slot < 4; slot++)
+	{
+		empty.minX[slot] = empty.minY[slot] = empty.minZ[slot] = FLT_MAX;
+		empty.maxX[slot] = empty.maxY[slot] = empty.maxZ[slot] = -FLT_MAX;
+		empty.children[slot] = EMPTY_CHILD;
+		empty.counts[slot] = 0;
+	}
+	m_nodes.push_back(empty);
+
+	bool bMedian = (depth >= g_MaxHeuristicDepth);
+	size_t runFirst[4];
+	size_t runCount[4];
+	int runs = 0;
+	if (count <= g_LeafSize)
+	{
+		runFirst[0] = first;
+		runCount[0] = count;
+		runs = 1;
+	}
+	else
+	{
+		size_t left = SplitPrimitives(first, count, bMedian);
+		size_t halfFirst[2] = { first, first + left };
+		size_t halfCount[2] = { left, count - left };
+		for (int half = 0; half < 2; half++)
+		{
+			if (halfCount[half] > g_LeafSize)
+			{
+				size_t quarter = SplitPrimitives(halfFirst[half], halfCount[half], bMedian);
+				runFirst[runs] = halfFirst[half];
+				runCount[runs++] = quarter;
+				runFirst[runs] = halfFirst[half] + quarter;
+				runCount[runs++] = halfCount[half] - quarter;
+			}
+			else
+			{
+				runFirst[runs] = halfFirst[half];
+				runCount[runs++] = halfCount[half];
+			}
+		}
+	}
+
+	for (int slot = 0; slot < runs; slot++)
+	{
+		glm::vec3 boxMin(FLT_MAX);
+		glm::vec3 boxMax(-FLT_MAX);
+		for (size_t i = runFirst[slot]; i < runFirst[slot] + runCount[slot]; i++)
+		{
+			boxMin = glm::min(boxMin, m_pBoxMins[m_primitives[i]]);
+			boxMax = glm::max(boxMax, m_pBoxMaxs[m_primitives[i]]);
+		}
+		SetChildBox(node, slot, boxMin, boxMax);
+
+		if (runCount[slot] <= g_LeafSize)
+		{
+			m_nodes[node].children[slot] = (uint32_t)runFirst[slot];
+			m_nodes[node].counts[slot] = (uint32_t)runCount[slot];
+		}
+		else
+		{
+			uint32_t child = BuildNode(runFirst[slot], runCount[slot], depth + 1);
+			m_nodes[node].children[slot] = child;
+		}
+	}
+
+	return(node);
+}
+
+/***********************************************************
+ *  SplitPrimitives()
+ *
+ *  This method is used for splitting a run of primitives
+ *  along the longest axis of their centroids.  The
+ *  centroids are sorted into bins, and the split between
+ *  bins with the lowest area weighted primitive count is
+ *  taken.  Runs whose centroids coincide, or that the
+ *  heuristic leaves empty on one side, are split at the
+ *  median instead.
+ ***********************************************************/
+size_t BoundingVolumeHierarchy::SplitPrimitives(size_t first, size_t count, bool bMedian)
+{
+	glm::vec3 centroidMin(FLT_MAX);
+	glm::vec3 centroidMax(-FLT_MAX);
+	for (size_t i = first; i < first + count; i++)
+	{
+		centroidMin = glm::min(centroidMin, m_centroids[m_primitives[i]]);
+		centroidMax = glm::max(centroidMax, m_centroids[m_primitives[i]]);
+	}
+
+	glm::vec3 extent = centroidMax - centroidMin;
+	int axis = 0;
+	if (extent.y > extent[axis])
+	{
+		axis = 1;
+	}
+	if (extent.z > extent[axis])
+	{
+		axis = 2;
+	}
+
+	uint32_t* primitives = &m_primitives[first];
+	const std::vector<glm::vec3>& centroids = m_centroids;
+	if (!bMedian && (extent[axis] > 0.0f))
+	{
+		int binCounts[g_BinCount] = { 0 };
+		glm::vec3 binMins[g_BinCount];
+		glm::vec3 binMaxs[g_BinCount];
+		for (int bin = 0; bin < g_BinCount; bin++)
+		{
+			binMins[bin] = glm::vec3(FLT_MAX);
+			binMaxs[bin] = glm::vec3(-FLT_MAX);
+		}
+
+		float binScale = g_BinCount / extent[axis];
+		float origin = centroidMin[axis];
+		for (size_t i = 0; i < count; i++)
+		{
+			uint32_t primitive = primitives[i];
+			int bin = std::min(g_BinCount - 1, (int)((centroids[primitive][axis] - origin) * binScale));
+			binCounts[bin]++;
+			binMins[bin] = glm::min(binMins[bin], m_pBoxMins[primitive]);
+			binMaxs[bin] = glm::max(binMaxs[bin], m_pBoxMaxs[primitive]);
+		}
+
+		// area weighted count of the bins right of every split
+		float rightCosts[g_BinCount];
+		glm::vec3 sweepMin(FLT_MAX);
+		glm::vec3 sweepMax(-FLT_MAX);
+		int sweepCount = 0;
+		for (int bin = g_BinCount - 1; bin > 0; bin--)
+		{
+			sweepMin = glm::min(sweepMin, binMins[bin]);
+			sweepMax = glm::max(sweepMax, binMaxs[bin]);
+			sweepCount += binCounts[bin];
+			rightCosts[bin] = (sweepCount > 0) ? HalfArea(sweepMin, sweepMax) * sweepCount : 0.0f;
+		}
+
+		int bestSplit = -1;
+		float bestCost = FLT_MAX;
+		sweepMin = glm::vec3(FLT_MAX);
+		sweepMax = glm::vec3(-FLT_MAX);
+		sweepCount = 0;
+		for (int bin = 0; bin < g_BinCount - 1; bin++)
+		{
+			sweepMin = glm::min(sweepMin, binMins[bin]);
+			sweepMax = glm::max(sweepMax, binMaxs[bin]);
+			sweepCount += binCounts[bin];
+			if ((sweepCount == 0) || (sweepCount == (int)count))
+			{
+				continue;
+			}
+			float cost = HalfArea(sweepMin, sweepMax) * sweepCount + rightCosts[bin + 1];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestSplit = bin;
+			}
+		}
+
+		if (bestSplit >= 0)
+		{
+			uint32_t* middle = std::partition(primitives, primitives + count,
+				[&](uint32_t primitive)
+				{
+					int bin = std::min(g_BinCount - 1, (int)((centroids[primitive][axis] - origin) * binScale));
+					return(bin <= bestSplit);
+				});
+			size_t left = (size_t)(middle - primitives);
+			if ((left > 0) && (left < count))
+			{
+				return(left);
+			}
+		}
+	}
+
+	size_t half = count / 2;
+	std::nth_element(primitives, primitives + half, primitives + count,
+		[&](uint32_t a, uint32_t b) { return(centroids[a][axis] < centroids[b][axis]); });
+	return(half);
+}
+
+/***********************************************************
+ *  SetChildBox()
+ *
+ *  This method is used for storing the box of a child in
+ *  the arrays of its node.
+ ***********************************************************/
+void BoundingVolumeHierarchy::SetChildBox(uint32_t node, int slot, const glm::vec3& boxMin, const glm::vec3& boxMax)
+{
+	BVH_NODE& target = m_nodes[node];
+	target.minX[slot] = boxMin.x;
+	target.minY[slot] = boxMin.y;
+	target.minZ[slot] = boxMin.z;
+	target.maxX[slot] = boxMax.x;
+	target.maxY[slot] = boxMax.y;
+	target.maxZ[slot] = boxMax.z;
+}
+
+/***********************************************************
+ *  Refit()
+ *
+ *  This method is used for recomputing the node boxes.
+ *  Child nodes have higher indices than their parents, so
+ *  walking the nodes backwards visits every child before
+ *  the node that holds its box.
+ ***********************************************************/
+void BoundingVolumeHierarchy::Refit(const glm::vec3* boxMins, const glm::vec3* boxMaxs)
+{
+	for (size_t n = m_nodes.size(); n-- > 0;)
+	{
+		BVH_NODE& node = m_nodes[n];
+		for (int slot = 0; slot < 4; slot++)
+		{
+			if (node.children[slot] == EMPTY_CHILD)
+			{
+				continue;
+			}
+
+			glm::vec3 boxMin(FLT_MAX);
+			glm::vec3 boxMax(-FLT_MAX);
+			if (node.counts[slot] > 0)
+			{
+				for (uint32_t i = node.children[slot]; i < node.children[slot] + node.counts[slot]; i++)
+				{
+					boxMin = glm::min(boxMin, boxMins[m_primitives[i]]);
+					boxMax = glm::max(boxMax, boxMaxs[m_primitives[i]]);
+				}
+			}
+			else
+			{
+				const BVH_NODE& child = m_nodes[node.children[slot]];
+				for (int childSlot = 0; childSlot < 4; childSlot++)
+				{
+					if (child.children[childSlot] != EMPTY_CHILD)
+					{
+						boxMin = glm::min(boxMin, glm::vec3(child.minX[childSlot], child.minY[childSlot], child.minZ[childSlot]));
+						boxMax = glm::max(boxMax, glm::vec3(child.maxX[childSlot], child.maxY[childSlot], child.maxZ[childSlot]));
+					}
+				}
+			}
+			SetChildBox((uint32_t)n, slot, boxMin, boxMax);
+		}
+	}
+}
+
+/***********************************************************
+ *  Intersect()
+ *
+ *  This method is used for finding the nearest primitive
+ *  hit by a ray.  The four child boxes of a node are
+ *  tested together with the slab test, with SSE2 where
+ *  available.  Leaves are tested nearest first, and child
+ *  nodes are pushed so the nearest is visited next; any
+ *  node entered beyond the nearest hit so far is skipped.
+ *  Zero direction components are nudged off zero so the
+ *  slab distances never become undefined.
+ ***********************************************************/
+uint32_t BoundingVolumeHierarchy::Intersect(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+	PRIMITIVE_TEST test, void* pContext, float* pDistance) const
+{
+	uint32_t hitPrimitive = NO_PRIMITIVE;
+	float nearest = maxDistance;
+	if (m_nodes.empty())
+	{
+		return(hitPrimitive);
+	}
+
+	glm::vec3 inverseDirection;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float component = direction[axis];
+		if (std::fabs(component) < 1e-30f)
+		{
+			component = (component < 0.0f) ? -1e-30f : 1e-30f;
+		}
+		inverseDirection[axis] = 1.0f / component;
+	}
+
+#ifdef BOUNDING_VOLUME_HIERARCHY_SSE2
+	const __m128 originX = _mm_set1_ps(origin.x);
+	const __m128 originY = _mm_set1_ps(origin.y);
+	const __m128 originZ = _mm_set1_ps(origin.z);
+	const __m128 inverseX = _mm_set1_ps(inverseDirection.x);
+	const __m128 inverseY = _mm_set1_ps(inverseDirection.y);
+	const __m128 inverseZ = _mm_set1_ps(inverseDirection.z);
+#endif
+
+	uint32_t stackNodes[g_StackSize];
+	float stackDistances[g_StackSize];
+	int stackSize = 0;
+	stackNodes[stackSize] = 0;
+	stackDistances[stackSize++] = 0.0f;
+
+	while (stackSize > 0)
+	{
+		stackSize--;
+		if (stackDistances[stackSize] > nearest)
+		{
+			continue;
+		}
+		const BVH_NODE& node = m_nodes[stackNodes[stackSize]];
+
+		float entries[4];
+		int hitMask = 0;
+#ifdef BOUNDING_VOLUME_HIERARCHY_SSE2
+		__m128 nearX = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minX), originX), inverseX);
+		__m128 farX = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxX), originX), inverseX);
+		__m128 nearY = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minY), originY), inverseY);
+		__m128 farY = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxY), originY), inverseY);
+		__m128 nearZ = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minZ), originZ), inverseZ);
+		__m128 farZ = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxZ), originZ), inverseZ);
+
+		__m128 entry = _mm_max_ps(
+			_mm_max_ps(_mm_min_ps(nearX, farX), _mm_min_ps(nearY, farY)),
+			_mm_max_ps(_mm_min_ps(nearZ, farZ), _mm_setzero_ps()));
+		__m128 exit = _mm_min_ps(
+			_mm_min_ps(_mm_max_ps(nearX, farX), _mm_max_ps(nearY, farY)),
+			_mm_min_ps(_mm_max_ps(nearZ, farZ), _mm_set1_ps(nearest)));
+		hitMask = _mm_movemask_ps(_mm_cmple_ps(entry, exit));
+		_mm_storeu_ps(entries, entry);
+#else
+		for (int slot = 0; slot < 4; slot++)
+		{
+			float nearX = (node.minX[slot] - origin.x) * inverseDirection.x;
+			float farX = (node.maxX[slot] - origin.x) * inverseDirection.x;
+			float nearY = (node.minY[slot] - origin.y) * inverseDirection.y;
+			float farY = (node.maxY[slot] - origin.y) * inverseDirection.y;
+			float nearZ = (node.minZ[slot] - origin.z) * inverseDirection.z;
+			float farZ = (node.maxZ[slot] - origin.z) * inverseDirection.z;
+			float entry = std::max(std::max(std::min(nearX, farX), std::min(nearY, farY)),
+				std::max(std::min(nearZ, farZ), 0.0f));
+			float exit = std::min(std::min(std::max(nearX, farX), std::max(nearY, farY)),
+				std::min(std::max(nearZ, farZ), nearest));
+			entries[slot] = entry;
+			hitMask |= (entry <= exit) ? (1 << slot) : 0;
+		}
+#endif
+
+		// hit children ordered nearest first
+		CHILD_HIT hits[4];
+		int hitCount = 0;
+		for (int slot = 0; slot < 4; slot++)
+		{
+			if ((hitMask & (1 << slot)) && (node.children[slot] != EMPTY_CHILD))
+			{
+				int position = hitCount++;
+				while ((position > 0) && (hits[position - 1].distance > entries[slot]))
+				{
+					hits[position] = hits[position - 1];
+					position--;
+				}
+				hits[position].slot = slot;
+				hits[position].distance = entries[slot];
+			}
+		}
+
+		for (int i = 0; i < hitCount; i++)
+		{
+			int slot = hits[i].slot;
+			if ((node.counts[slot] == 0) || (hits[i].distance > nearest))
+			{
+				continue;
+			}
+			for (uint32_t p = node.children[slot]; p < node.children[slot] + node.counts[slot]; p++)
+			{
+				float distance = test(pContext, m_primitives[p], origin, direction, nearest);
+				if ((distance >= 0.0f) && (distance <= nearest))
+				{
+					nearest = distance;
+					hitPrimitive = m_primitives[p];
+				}
+			}
+		}
+
+		for (int i = hitCount - 1; i >= 0; i--)
+		{
+			int slot = hits[i].slot;
+			if ((node.counts[slot] == 0) && (stackSize < g_StackSize))
+			{
+				stackNodes[stackSize] = node.children[slot];
+				stackDistances[stackSize++] = hits[i].distance;
+			}
+		}
+	}
+
+	if ((hitPrimitive != NO_PRIMITIVE) && (NULL != pDistance))
+	{
+		*pDistance = nearest;
+	}
+	return(hitPrimitive);
+}
+
+/***********************************************************
+ *  TransformBounds()
+ *
+ *  This function is used for moving a box by a matrix.  The
+ *  center goes through the matrix, and the half extent
+ *  through the absolute values of its upper 3x3, so the
+ *  result holds the rotated and scaled box.
+ ***********************************************************/
+void TransformBounds(const glm::vec3& localMin, const glm::vec3& localMax, const glm::mat4& matrix,
+	glm::vec3& worldMin, glm::vec3& worldMax)
+{
+	glm::vec3 center = (localMin + localMax) * 0.5f;
+	glm::vec3 extent = (localMax - localMin) * 0.5f;
+
+	glm::vec3 worldCenter = glm::vec3(matrix * glm::vec4(center, 1.0f));
+	glm::vec3 worldExtent =
+		glm::abs(glm::vec3(matrix[0])) * extent.x +
+		glm::abs(glm::vec3(matrix[1])) * extent.y +
+		glm::abs(glm::vec3(matrix[2])) * extent.z;
+
+	worldMin = worldCenter - worldExtent;
+	worldMax = worldCenter + worldExtent;
+}
+
+/***********************************************************
+ *  IntersectTriangle()
+ *
+ *  This function is used for the Moller-Trumbore ray and
+ *  triangle test.  The distance is in units of the ray
+ *  direction, which does not need to be normalized.
+ ***********************************************************/
+float IntersectTriangle(const glm::vec3& origin, const glm::vec3& direction,
+	const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2)
+{
+	glm::vec3 edge1 = v1 - v0;
+	glm::vec3 edge2 = v2 - v0;
+	glm::vec3 p = glm::cross(direction, edge2);
+	float determinant = glm::dot(edge1, p);
+	if (determinant == 0.0f)
+	{
+		return(-1.0f);
+	}
+
+	float inverseDeterminant = 1.0f / determinant;
+	glm::vec3 toOrigin = origin - v0;
+	float u = glm::dot(toOrigin, p) * inverseDeterminant;
+	if ((u < 0.0f) || (u > 1.0f))
+	{
+		return(-1.0f);
+	}
+
+	glm::vec3 q = glm::cross(toOrigin, edge1);
+	float v = glm::dot(direction, q) * inverseDeterminant;
+	if ((v < 0.0f) || ((u + v) > 1.0f))
+	{
+		return(-1.0f);
+	}
+
+	return(glm::dot(edge2, q) * inverseDeterminant);
+}
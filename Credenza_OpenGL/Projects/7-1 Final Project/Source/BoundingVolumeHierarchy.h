@@ -0,0 +1,106 @@
+///////////////////////////////////////////////////////////////////////////////
+// BoundingVolumeHierarchy.h
+// ============
+// group a set of bounding boxes into a four-wide tree, so the nearest box
+// hit by a ray is found without testing every box
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  BoundingVolumeHierarchy
+ *
+ *  This class contains a tree over the boxes of a set of
+ *  primitives, objects of a scene or triangles of a mesh.
+ *  Every node holds the boxes of up to four children in
+ *  contiguous arrays of each axis, so a ray is tested
+ *  against all four with one pass of SSE2 instructions.
+ *  A child is either another node or a leaf, a short run
+ *  of primitives.
+ *
+ *  Build() splits the primitives with the surface area
+ *  heuristic over binned centroids.  When only the boxes
+ *  moved, Refit() recomputes the node boxes bottom up and
+ *  keeps the tree, which is much cheaper but lets the tree
+ *  degrade as the primitives drift apart.
+ ***********************************************************/
+class BoundingVolumeHierarchy
+{
+public:
+	// the nearest hit of a primitive closer than the passed in
+	// distance, or a negative distance when it is missed
+	typedef float (*PRIMITIVE_TEST)(void* pContext, uint32_t primitive,
+		const glm::vec3& origin, const glm::vec3& direction, float maxDistance);
+
+	// index of the primitive that was not hit
+	static const uint32_t NO_PRIMITIVE = 0xFFFFFFFF;
+
+	// build the tree over the boxes of the primitives
+	void Build(const glm::vec3* boxMins, const glm::vec3* boxMaxs, size_t count);
+	// recompute the node boxes from the moved primitive boxes,
+	// the primitives must be the ones the tree was built with
+	void Refit(const glm::vec3* boxMins, const glm::vec3* boxMaxs);
+	// remove all primitives
+	void Clear();
+
+	// number of primitives and nodes
+	inline size_t Size() const { return m_primitives.size(); }
+	inline size_t GetNodeCount() const { return m_nodes.size(); }
+
+	// find the nearest primitive the ray hits within the distance,
+	// the test is called for every primitive whose box is hit;
+	// returns NO_PRIMITIVE when nothing is hit
+	uint32_t Intersect(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+		PRIMITIVE_TEST test, void* pContext, float* pDistance) const;
+
+private:
+	// node of the tree, with the boxes of its four children
+	struct BVH_NODE
+	{
+		float minX[4];
+		float minY[4];
+		float minZ[4];
+		float maxX[4];
+		float maxY[4];
+		float maxZ[4];
+		// node index of an inner child, first primitive of a
+		// leaf child, or EMPTY_CHILD for an unused slot
+		uint32_t children[4];
+		// number of primitives of a leaf child, 0 for inner children
+		uint32_t counts[4];
+	};
+
+	static const uint32_t EMPTY_CHILD = 0xFFFFFFFF;
+
+	// create the node for a run of primitives and its subtree
+	uint32_t BuildNode(size_t first, size_t count, int depth);
+	// reorder a run of primitives into two runs, returns the
+	// number of primitives of the first
+	size_t SplitPrimitives(size_t first, size_t count, bool bMedian);
+	// set the box of a child slot of a node
+	void SetChildBox(uint32_t node, int slot, const glm::vec3& boxMin, const glm::vec3& boxMax);
+
+	std::vector<BVH_NODE> m_nodes;
+	// primitive indices, in the order the leaves refer to them
+	std::vector<uint32_t> m_primitives;
+	// boxes and centroids of the primitives while building
+	const glm::vec3* m_pBoxMins = NULL;
+	const glm::vec3* m_pBoxMaxs = NULL;
+	std::vector<glm::vec3> m_centroids;
+};
+
+// box that holds a local space box moved by a matrix
+void TransformBounds(const glm::vec3& localMin, const glm::vec3& localMax, const glm::mat4& matrix,
+	glm::vec3& worldMin, glm::vec3& worldMax);
+
+// distance along the ray to the triangle, or a negative value
+// when it is missed; both sides of the triangle are hit
+float IntersectTriangle(const glm::vec3& origin, const glm::vec3& direction,
+	const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2);
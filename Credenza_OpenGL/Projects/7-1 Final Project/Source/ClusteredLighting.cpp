@@ -0,0 +1,410 @@
+///////////////////////////////////////////////////////////////////////////////
+// ClusteredLighting.cpp
+// ============
+// split the view frustum into a grid of clusters and list the point lights
+// that reach each one, so a fragment only shades the lights of its cluster
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ClusteredLighting.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+static_assert(sizeof(LightClusterer::POINT_LIGHT) == 32,
+	"POINT_LIGHT must match the std430 layout of PointLight");
+
+/***********************************************************
+ *  LightClusterer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+LightClusterer::LightClusterer()
+{
+	m_bLightsDirty = true;
+	m_bBoundsValid = false;
+	m_maxClusterLightCount = 0;
+
+	memset(&m_header, 0, sizeof(m_header));
+	m_header.countX = CLUSTER_COUNT_X;
+	m_header.countY = CLUSTER_COUNT_Y;
+	m_header.countZ = CLUSTER_COUNT_Z;
+
+	CLUSTER_RANGE empty = { 0, 0 };
+	m_ranges.assign(CLUSTER_COUNT, empty);
+
+	STORAGE_BUFFER none = { 0, 0 };
+	m_lightBuffer = none;
+	m_clusterBuffer = none;
+	m_indexBuffer = none;
+}
+
+/***********************************************************
+ *  ~LightClusterer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+LightClusterer::~LightClusterer()
+{
+	STORAGE_BUFFER* buffers[] = { &m_lightBuffer, &m_clusterBuffer, &m_indexBuffer };
+	for (size_t i = 0; i < sizeof(buffers) / sizeof(buffers[0]); i++)
+	{
+		DeleteStorageBuffer(*buffers[i]);
+	}
+}
+
+/***********************************************************
+ *  AddLight()
+ *
+ *  This method is used for adding a point light, the lights
+ *  are uploaded again with the next frame.
+ ***********************************************************/
+size_t LightClusterer::AddLight(const POINT_LIGHT& light)
+{
+	m_lights.push_back(light);
+	m_bLightsDirty = true;
+	return(m_lights.size() - 1);
+}
+
+/***********************************************************
+ *  SetLight()
+ *
+ *  This method is used for replacing a point light, only
+ *  marking the lights for upload when it changed.
+ ***********************************************************/
+void LightClusterer::SetLight(size_t index, const POINT_LIGHT& light)
+{
+	if (index >= m_lights.size())
+	{
+		return;
+	}
+
+	if (memcmp(&m_lights[index], &light, sizeof(POINT_LIGHT)) != 0)
+	{
+		m_lights[index] = light;
+		m_bLightsDirty = true;
+	}
+}
+
+/***********************************************************
+ *  Truncate()
+ *
+ *  This method is used for removing the lights from the
+ *  passed in index to the end.
+ ***********************************************************/
+void LightClusterer::Truncate(size_t count)
+{
+	if (count < m_lights.size())
+	{
+		m_lights.resize(count);
+		m_bLightsDirty = true;
+	}
+}
+
+/***********************************************************
+ *  GetDepthRange()
+ *
+ *  This method is used for reading the near and far view
+ *  depths back from a perspective or orthographic
+ *  projection matrix.
+ ***********************************************************/
+void LightClusterer::GetDepthRange(const glm::mat4& projection, float& nearDepth, float& farDepth)
+{
+	// a perspective projection copies the negated view depth
+	// into w, an orthographic one leaves w at 1
+	if (projection[2][3] != 0.0f)
+	{
+		nearDepth = projection[3][2] / (projection[2][2] - 1.0f);
+		farDepth = projection[3][2] / (projection[2][2] + 1.0f);
+	}
+	else
+	{
+		nearDepth = (projection[3][2] + 1.0f) / projection[2][2];
+		farDepth = (projection[3][2] - 1.0f) / projection[2][2];
+	}
+
+	// the slices are spaced by the logarithm of the depth, which
+	// needs a near plane in front of the camera
+	nearDepth = std::max(nearDepth, 0.001f);
+	farDepth = std::max(farDepth, nearDepth * 2.0f);
+}
+
+/***********************************************************
+ *  GetSlice()
+ *
+ *  This method is used for finding the depth slice holding
+ *  a view depth, the same way the fragment shader does.
+ ***********************************************************/
+int LightClusterer::GetSlice(float depth) const
+{
+	int slice = (int)std::floor(std::log(depth / m_header.nearDepth) * m_header.sliceScale);
+	return(std::min(std::max(slice, 0), CLUSTER_COUNT_Z - 1));
+}
+
+/***********************************************************
+ *  ComputeClusterBounds()
+ *
+ *  This method is used for computing the view space box of
+ *  every cluster.  The corners of the tiles are unprojected
+ *  at the near and far planes, and the rays between them
+ *  are cut at the depths where the slices start and end.
+ *  The boxes only change with the projection.
+ ***********************************************************/
+void LightClusterer::ComputeClusterBounds(const glm::mat4& projection)
+{
+	float nearDepth;
+	float farDepth;
+	GetDepthRange(projection, nearDepth, farDepth);
+	m_header.nearDepth = nearDepth;
+	m_header.farDepth = farDepth;
+	m_header.sliceScale = CLUSTER_COUNT_Z / std::log(farDepth / nearDepth);
+
+	glm::mat4 inverseProjection = glm::inverse(projection);
+	const int cornerCountX = CLUSTER_COUNT_X + 1;
+	const int cornerCountY = CLUSTER_COUNT_Y + 1;
+	std::vector<glm::vec3> nearCorners(cornerCountX * cornerCountY);
+	std::vector<glm::vec3> farCorners(cornerCountX * cornerCountY);
+	for (int y = 0; y < cornerCountY; y++)
+	{
+		for (int x = 0; x < cornerCountX; x++)
+		{
+			glm::vec2 ndc(-1.0f + 2.0f * x / CLUSTER_COUNT_X, -1.0f + 2.0f * y / CLUSTER_COUNT_Y);
+			glm::vec4 nearPoint = inverseProjection * glm::vec4(ndc, -1.0f, 1.0f);
+			glm::vec4 farPoint = inverseProjection * glm::vec4(ndc, 1.0f, 1.0f);
+			nearCorners[y * cornerCountX + x] = glm::vec3(nearPoint) / nearPoint.w;
+			farCorners[y * cornerCountX + x] = glm::vec3(farPoint) / farPoint.w;
+		}
+	}
+
+	std::vector<float> sliceDepths(CLUSTER_COUNT_Z + 1);
+	for (int z = 0; z <= CLUSTER_COUNT_Z; z++)
+	{
+		sliceDepths[z] = nearDepth * std::pow(farDepth / nearDepth, (float)z / CLUSTER_COUNT_Z);
+	}
+
+	m_clusterMins.resize(CLUSTER_COUNT);
+	m_clusterMaxs.resize(CLUSTER_COUNT);
+	for (int z = 0; z < CLUSTER_COUNT_Z; z++)
+	{
+		for (int y = 0; y < CLUSTER_COUNT_Y; y++)
+		{
+			for (int x = 0; x < CLUSTER_COUNT_X; x++)
+			{
+				glm::vec3 boxMin(FLT_MAX);
+				glm::vec3 boxMax(-FLT_MAX);
+				for (int corner = 0; corner < 4; corner++)
+				{
+					int index = (y + (corner >> 1)) * cornerCountX + x + (corner & 1);
+					const glm::vec3& a = nearCorners[index];
+					const glm::vec3& b = farCorners[index];
+					for (int end = 0; end < 2; end++)
+					{
+						float t = (-sliceDepths[z + end] - a.z) / (b.z - a.z);
+						glm::vec3 point = a + (b - a) * t;
+						boxMin = glm::min(boxMin, point);
+						boxMax = glm::max(boxMax, point);
+					}
+				}
+
+				int cluster = (z * CLUSTER_COUNT_Y + y) * CLUSTER_COUNT_X + x;
+				m_clusterMins[cluster] = boxMin;
+				m_clusterMaxs[cluster] = boxMax;
+			}
+		}
+	}
+
+	m_boundsProjection = projection;
+	m_bBoundsValid = true;
+}
+
+/***********************************************************
+ *  AssignLight()
+ *
+ *  This method is used for adding every cluster a light
+ *  reaches to the list.  The slices come from the depth
+ *  range of its sphere and the tiles from the projected
+ *  corners of its box, unless the box crosses the near
+ *  plane; the sphere is then tested against the box of
+ *  each cluster in that range.
+ ***********************************************************/
+void LightClusterer::AssignLight(uint32_t index, const glm::vec3& center, float radius,
+	const glm::mat4& projection)
+{
+	float minDepth = -center.z - radius;
+	float maxDepth = -center.z + radius;
+	if ((maxDepth < m_header.nearDepth) || (minDepth > m_header.farDepth))
+	{
+		return;
+	}
+
+	int firstSlice = GetSlice(std::max(minDepth, m_header.nearDepth));
+	int lastSlice = GetSlice(std::min(maxDepth, m_header.farDepth));
+	int firstX = 0;
+	int lastX = CLUSTER_COUNT_X - 1;
+	int firstY = 0;
+	int lastY = CLUSTER_COUNT_Y - 1;
+
+	if (minDepth > m_header.nearDepth)
+	{
+		glm::vec2 ndcMin(FLT_MAX);
+		glm::vec2 ndcMax(-FLT_MAX);
+		for (int corner = 0; corner < 8; corner++)
+		{
+			glm::vec3 offset((corner & 1) ? radius : -radius,
+				(corner & 2) ? radius : -radius, (corner & 4) ? radius : -radius);
+			glm::vec4 clip = projection * glm::vec4(center + offset, 1.0f);
+			glm::vec2 ndc = glm::vec2(clip) / clip.w;
+			ndcMin = glm::min(ndcMin, ndc);
+			ndcMax = glm::max(ndcMax, ndc);
+		}
+		if ((ndcMax.x < -1.0f) || (ndcMin.x > 1.0f) || (ndcMax.y < -1.0f) || (ndcMin.y > 1.0f))
+		{
+			return;
+		}
+
+		firstX = std::max((int)std::floor((ndcMin.x * 0.5f + 0.5f) * CLUSTER_COUNT_X), 0);
+		lastX = std::min((int)std::floor((ndcMax.x * 0.5f + 0.5f) * CLUSTER_COUNT_X), CLUSTER_COUNT_X - 1);
+		firstY = std::max((int)std::floor((ndcMin.y * 0.5f + 0.5f) * CLUSTER_COUNT_Y), 0);
+		lastY = std::min((int)std::floor((ndcMax.y * 0.5f + 0.5f) * CLUSTER_COUNT_Y), CLUSTER_COUNT_Y - 1);
+	}
+
+	float radiusSquared = radius * radius;
+	for (int z = firstSlice; z <= lastSlice; z++)
+	{
+		for (int y = firstY; y <= lastY; y++)
+		{
+			for (int x = firstX; x <= lastX; x++)
+			{
+				uint32_t cluster = (uint32_t)((z * CLUSTER_COUNT_Y + y) * CLUSTER_COUNT_X + x);
+				glm::vec3 closest = glm::clamp(center, m_clusterMins[cluster], m_clusterMaxs[cluster]);
+				glm::vec3 delta = closest - center;
+				if (glm::dot(delta, delta) <= radiusSquared)
+				{
+					CLUSTER_LIGHT entry = { cluster, index };
+					m_clusterLights.push_back(entry);
+				}
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is used for building the light lists of the
+ *  clusters for a view.  Every light adds its clusters to
+ *  one list, which a counting sort then groups by cluster
+ *  into the light index array, keeping the lights of each
+ *  cluster in order.
+ ***********************************************************/
+void LightClusterer::Build(const glm::mat4& view, const glm::mat4& projection)
+{
+	if (!m_bBoundsValid || (projection != m_boundsProjection))
+	{
+		ComputeClusterBounds(projection);
+	}
+
+	m_clusterLights.clear();
+	for (size_t i = 0; i < m_lights.size(); i++)
+	{
+		const POINT_LIGHT& light = m_lights[i];
+		if ((light.radius <= 0.0f) || (light.intensity <= 0.0f))
+		{
+			continue;
+		}
+		glm::vec3 center = glm::vec3(view * glm::vec4(light.position, 1.0f));
+		AssignLight((uint32_t)i, center, light.radius, projection);
+	}
+
+	for (size_t c = 0; c < m_ranges.size(); c++)
+	{
+		m_ranges[c].count = 0;
+	}
+	for (size_t i = 0; i < m_clusterLights.size(); i++)
+	{
+		m_ranges[m_clusterLights[i].cluster].count++;
+	}
+
+	GLuint offset = 0;
+	m_maxClusterLightCount = 0;
+	for (size_t c = 0; c < m_ranges.size(); c++)
+	{
+		m_ranges[c].offset = offset;
+		offset += m_ranges[c].count;
+		m_maxClusterLightCount = std::max(m_maxClusterLightCount, (size_t)m_ranges[c].count);
+		m_ranges[c].count = 0;
+	}
+
+	m_lightIndices.resize(m_clusterLights.size());
+	for (size_t i = 0; i < m_clusterLights.size(); i++)
+	{
+		CLUSTER_RANGE& range = m_ranges[m_clusterLights[i].cluster];
+		m_lightIndices[range.offset + range.count] = m_clusterLights[i].light;
+		range.count++;
+	}
+
+	m_header.lightCount = (GLuint)m_lights.size();
+}
+
+/***********************************************************
+ *  Upload()
+ *
+ *  This method is used for writing the lights, when they
+ *  changed, and the lists of the last build into their
+ *  buffers.  Every buffer holds at least one element so it
+ *  can be bound while there are no lights.
+ ***********************************************************/
+void LightClusterer::Upload()
+{
+	size_t lightBytes = std::max(m_lights.size(), (size_t)1) * sizeof(POINT_LIGHT);
+	if (lightBytes > m_lightBuffer.capacity)
+	{
+		m_bLightsDirty = true;
+	}
+	ReserveStorageBuffer(m_lightBuffer, lightBytes);
+	if (m_bLightsDirty && !m_lights.empty())
+	{
+		WriteStorageBuffer(m_lightBuffer, m_lights.data(), m_lights.size() * sizeof(POINT_LIGHT), 0);
+	}
+	m_bLightsDirty = false;
+
+	size_t rangeBytes = m_ranges.size() * sizeof(CLUSTER_RANGE);
+	ReserveStorageBuffer(m_clusterBuffer, sizeof(CLUSTER_HEADER) + rangeBytes);
+	WriteStorageBuffer(m_clusterBuffer, &m_header, sizeof(CLUSTER_HEADER), 0);
+	WriteStorageBuffer(m_clusterBuffer, m_ranges.data(), rangeBytes, sizeof(CLUSTER_HEADER));
+
+	ReserveStorageBuffer(m_indexBuffer, std::max(m_lightIndices.size(), (size_t)1) * sizeof(uint32_t));
+	if (!m_lightIndices.empty())
+	{
+		WriteStorageBuffer(m_indexBuffer, m_lightIndices.data(), m_lightIndices.size() * sizeof(uint32_t), 0);
+	}
+}
+
+/***********************************************************
+ *  Bind()
+ *
+ *  This method is used for binding the buffers to the
+ *  storage block bindings the lit shader variants read.
+ ***********************************************************/
+void LightClusterer::Bind() const
+{
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, POINT_LIGHTS_BINDING, m_lightBuffer.buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_CLUSTERS_BINDING, m_clusterBuffer.buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_INDICES_BINDING, m_indexBuffer.buffer);
+}
+
+/***********************************************************
+ *  GetClusterLights()
+ *
+ *  This method is used for getting the lights the last
+ *  build listed for one cluster.
+ ***********************************************************/
+void LightClusterer::GetClusterLights(int x, int y, int z, std::vector<uint32_t>& lights) const
+{
+	lights.clear();
+	const CLUSTER_RANGE& range = m_ranges[(z * CLUSTER_COUNT_Y + y) * CLUSTER_COUNT_X + x];
+	lights.insert(lights.end(), m_lightIndices.begin() + range.offset,
+		m_lightIndices.begin() + range.offset + range.count);
+}
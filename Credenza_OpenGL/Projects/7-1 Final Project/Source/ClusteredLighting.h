@@ -0,0 +1,147 @@
+///////////////////////////////////////////////////////////////////////////////
+// ClusteredLighting.h
+// ============
+// split the view frustum into a grid of clusters and list the point lights
+// that reach each one, so a fragment only shades the lights of its cluster
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+#include "StorageBuffer.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  LightClusterer
+ *
+ *  This class contains any number of point lights and the
+ *  lists of the lights that reach every cluster of the view
+ *  frustum.  The frustum is divided into tiles on screen and
+ *  into depth slices that grow exponentially with the view
+ *  distance, so clusters near and far cover about the same
+ *  share of the screen and of the depth.
+ *
+ *  The lists are rebuilt on the CPU every frame: each light
+ *  projects its bounding box to find the range of tiles and
+ *  slices it may reach, its sphere is tested against the
+ *  view space box of every cluster in that range, and a
+ *  counting sort packs the lists of all clusters into one
+ *  index array.  The lights, the range of every cluster in
+ *  the index array and the indices are uploaded to shader
+ *  storage buffers, where the fragment shader finds its
+ *  cluster from its screen position and view depth.
+ ***********************************************************/
+class LightClusterer
+{
+public:
+	// point light, laid out to match PointLight in the fragment
+	// shader with std430 rules
+	struct POINT_LIGHT
+	{
+		glm::vec3 position;
+		// distance where the light fades out
+		float radius;
+		glm::vec3 color;
+		float intensity;
+	};
+
+	// number of tiles across and down the screen and of depth slices
+	static const int CLUSTER_COUNT_X = 16;
+	static const int CLUSTER_COUNT_Y = 9;
+	static const int CLUSTER_COUNT_Z = 24;
+	static const int CLUSTER_COUNT = CLUSTER_COUNT_X * CLUSTER_COUNT_Y * CLUSTER_COUNT_Z;
+
+	LightClusterer();
+	~LightClusterer();
+
+	// add a light, returns its index
+	size_t AddLight(const POINT_LIGHT& light);
+	// replace a light
+	void SetLight(size_t index, const POINT_LIGHT& light);
+	inline const POINT_LIGHT& GetLight(size_t index) const { return m_lights[index]; }
+	// remove the lights from the passed in index to the end
+	void Truncate(size_t count);
+	// remove all lights
+	inline void Clear() { Truncate(0); }
+	inline size_t Size() const { return m_lights.size(); }
+
+	// build the light lists of the clusters for a view and a
+	// perspective or orthographic projection
+	void Build(const glm::mat4& view, const glm::mat4& projection);
+	// upload the lights and the lists of the last build, creating
+	// the buffers the first time
+	void Upload();
+	// bind the buffers to the storage bindings of the fragment shader
+	void Bind() const;
+
+	// lights listed by the cluster at tile x, y and slice z
+	void GetClusterLights(int x, int y, int z, std::vector<uint32_t>& lights) const;
+	// references to lights over all clusters, and the most lights
+	// listed by one cluster, in the last build
+	inline size_t GetLightIndexCount() const { return m_lightIndices.size(); }
+	inline size_t GetMaxClusterLightCount() const { return m_maxClusterLightCount; }
+
+private:
+	// start of the cluster buffer, laid out to match the header
+	// of LightClusters in the fragment shader
+	struct CLUSTER_HEADER
+	{
+		GLuint countX;
+		GLuint countY;
+		GLuint countZ;
+		GLuint lightCount;
+		float nearDepth;
+		float farDepth;
+		// slices per unit of the logarithm of the view depth
+		float sliceScale;
+		float padding;
+	};
+
+	// range of the light index array listed by a cluster
+	struct CLUSTER_RANGE
+	{
+		GLuint offset;
+		GLuint count;
+	};
+
+	// light of a cluster, before the lists are sorted by cluster
+	struct CLUSTER_LIGHT
+	{
+		uint32_t cluster;
+		uint32_t light;
+	};
+
+	// get the near and far view depths of a projection
+	static void GetDepthRange(const glm::mat4& projection, float& nearDepth, float& farDepth);
+	// depth slice holding a view depth
+	int GetSlice(float depth) const;
+	// compute the view space box of every cluster for a projection
+	void ComputeClusterBounds(const glm::mat4& projection);
+	// add the clusters a light in view space reaches to the list
+	void AssignLight(uint32_t index, const glm::vec3& center, float radius, const glm::mat4& projection);
+
+	std::vector<POINT_LIGHT> m_lights;
+	bool m_bLightsDirty;
+
+	// projection the cluster boxes were computed for
+	glm::mat4 m_boundsProjection;
+	bool m_bBoundsValid;
+	std::vector<glm::vec3> m_clusterMins;
+	std::vector<glm::vec3> m_clusterMaxs;
+
+	CLUSTER_HEADER m_header;
+	std::vector<CLUSTER_LIGHT> m_clusterLights;
+	std::vector<CLUSTER_RANGE> m_ranges;
+	std::vector<uint32_t> m_lightIndices;
+	size_t m_maxClusterLightCount;
+
+	STORAGE_BUFFER m_lightBuffer;
+	STORAGE_BUFFER m_clusterBuffer;
+	STORAGE_BUFFER m_indexBuffer;
+};
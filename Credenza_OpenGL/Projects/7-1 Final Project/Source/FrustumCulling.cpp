@@ -0,0 +1,210 @@
+///////////////////////////////////////////////////////////////////////////////
+// FrustumCulling.cpp
+// ============
+// test the world space bounding boxes of a set of objects against the view
+// frustum, so objects outside of it are never queued
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrustumCulling.h"
+
+#include <cmath>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)) || defined(__SSE2__)
+#define FRUSTUM_CULLING_SSE2
+#include <emmintrin.h>
+#endif
+
+/***********************************************************
+ *  SetViewProjection()
+ *
+ *  This method is used for extracting the frustum planes
+ *  from the combined matrix.  Each plane is the sum or the
+ *  difference of the fourth row and one of the other rows,
+ *  normalized so the distance of a point to the plane is
+ *  the dot product with the plane plus its distance.
+ ***********************************************************/
+void FrustumCuller::SetViewProjection(const glm::mat4& viewProjection)
+{
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+	{
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i],
+			viewProjection[2][i], viewProjection[3][i]);
+	}
+
+	m_planes[0] = rows[3] + rows[0];
+	m_planes[1] = rows[3] - rows[0];
+	m_planes[2] = rows[3] + rows[1];
+	m_planes[3] = rows[3] - rows[1];
+	m_planes[4] = rows[3] + rows[2];
+	m_planes[5] = rows[3] - rows[2];
+
+	for (int i = 0; i < 6; i++)
+	{
+		float length = glm::length(glm::vec3(m_planes[i]));
+		if (length > 0.0f)
+		{
+			m_planes[i] /= length;
+		}
+	}
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for removing all boxes.
+ ***********************************************************/
+void FrustumCuller::Clear()
+{
+	m_centerX.clear();
+	m_centerY.clear();
+	m_centerZ.clear();
+	m_extentX.clear();
+	m_extentY.clear();
+	m_extentZ.clear();
+	m_visible.clear();
+}
+
+/***********************************************************
+ *  AddBox()
+ *
+ *  This method is used for adding a box in world space.
+ *  The center goes through the world matrix, and the half
+ *  extent through the absolute values of its upper 3x3, so
+ *  the world box holds the rotated and scaled local box.
+ ***********************************************************/
+size_t FrustumCuller::AddBox(const glm::vec3& localMin, const glm::vec3& localMax, const glm::mat4& world)
+{
+	glm::vec3 center = (localMin + localMax) * 0.5f;
+	glm::vec3 extent = (localMax - localMin) * 0.5f;
+
+	glm::vec3 worldCenter = glm::vec3(world * glm::vec4(center, 1.0f));
+	glm::vec3 worldExtent =
+		glm::abs(glm::vec3(world[0])) * extent.x +
+		glm::abs(glm::vec3(world[1])) * extent.y +
+		glm::abs(glm::vec3(world[2])) * extent.z;
+
+	m_centerX.push_back(worldCenter.x);
+	m_centerY.push_back(worldCenter.y);
+	m_centerZ.push_back(worldCenter.z);
+	m_extentX.push_back(worldExtent.x);
+	m_extentY.push_back(worldExtent.y);
+	m_extentZ.push_back(worldExtent.z);
+	m_visible.push_back(1);
+
+	return(m_centerX.size() - 1);
+}
+
+/***********************************************************
+ *  Cull()
+ *
+ *  This method is used for testing every box against the
+ *  frustum planes.
+ ***********************************************************/
+size_t FrustumCuller::Cull()
+{
+	if (m_centerX.empty())
+	{
+		return(0);
+	}
+
+	return(CullBoxes(m_planes,
+		m_centerX.data(), m_centerY.data(), m_centerZ.data(),
+		m_extentX.data(), m_extentY.data(), m_extentZ.data(),
+		m_centerX.size(), m_visible.data()));
+}
+
+/***********************************************************
+ *  CullBoxes()
+ *
+ *  This function is used for testing boxes against the
+ *  planes.  For each plane the box reaches furthest to the
+ *  inner side at the distance of its center plus the half
+ *  extents projected on the absolute plane normal; when
+ *  that is still negative the box is outside.  With SSE2
+ *  four boxes are tested per iteration, one per lane.
+ ***********************************************************/
+size_t CullBoxes(
+	const glm::vec4* planes,
+	const float* centerX,
+	const float* centerY,
+	const float* centerZ,
+	const float* extentX,
+	const float* extentY,
+	const float* extentZ,
+	size_t count,
+	uint8_t* visible)
+{
+	size_t visibleCount = 0;
+	size_t i = 0;
+
+#ifdef FRUSTUM_CULLING_SSE2
+	__m128 normalX[6], normalY[6], normalZ[6], distance[6];
+	__m128 absNormalX[6], absNormalY[6], absNormalZ[6];
+	for (int p = 0; p < 6; p++)
+	{
+		normalX[p] = _mm_set1_ps(planes[p].x);
+		normalY[p] = _mm_set1_ps(planes[p].y);
+		normalZ[p] = _mm_set1_ps(planes[p].z);
+		distance[p] = _mm_set1_ps(planes[p].w);
+		absNormalX[p] = _mm_set1_ps(std::fabs(planes[p].x));
+		absNormalY[p] = _mm_set1_ps(std::fabs(planes[p].y));
+		absNormalZ[p] = _mm_set1_ps(std::fabs(planes[p].z));
+	}
+	const __m128 zero = _mm_setzero_ps();
+
+	for (; (i + 4) <= count; i += 4)
+	{
+		__m128 cx = _mm_loadu_ps(centerX + i);
+		__m128 cy = _mm_loadu_ps(centerY + i);
+		__m128 cz = _mm_loadu_ps(centerZ + i);
+		__m128 ex = _mm_loadu_ps(extentX + i);
+		__m128 ey = _mm_loadu_ps(extentY + i);
+		__m128 ez = _mm_loadu_ps(extentZ + i);
+
+		// lanes of boxes found outside of any plane
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 centerDistance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(normalX[p], cx), _mm_mul_ps(normalY[p], cy)),
+				_mm_add_ps(_mm_mul_ps(normalZ[p], cz), distance[p]));
+			__m128 radius = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(absNormalX[p], ex), _mm_mul_ps(absNormalY[p], ey)),
+				_mm_mul_ps(absNormalZ[p], ez));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(centerDistance, radius), zero));
+		}
+
+		int mask = _mm_movemask_ps(outside);
+		for (int lane = 0; lane < 4; lane++)
+		{
+			uint8_t bVisible = ((mask >> lane) & 1) ? 0 : 1;
+			visible[i + lane] = bVisible;
+			visibleCount += bVisible;
+		}
+	}
+#endif
+
+	// scalar path of the same test
+	for (; i < count; i++)
+	{
+		uint8_t bVisible = 1;
+		for (int p = 0; p < 6; p++)
+		{
+			const glm::vec4& plane = planes[p];
+			float centerDistance = plane.x * centerX[i] + plane.y * centerY[i] + plane.z * centerZ[i] + plane.w;
+			float radius = std::fabs(plane.x) * extentX[i] + std::fabs(plane.y) * extentY[i] +
+				std::fabs(plane.z) * extentZ[i];
+			if ((centerDistance + radius) < 0.0f)
+			{
+				bVisible = 0;
+				break;
+			}
+		}
+		visible[i] = bVisible;
+		visibleCount += bVisible;
+	}
+
+	return(visibleCount);
+}
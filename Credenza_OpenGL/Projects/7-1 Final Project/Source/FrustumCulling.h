@@ -0,0 +1,89 @@
+///////////////////////////////////////////////////////////////////////////////
+// FrustumCulling.h
+// ============
+// test the world space bounding boxes of a set of objects against the view
+// frustum, so objects outside of it are never queued
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  FrustumCuller
+ *
+ *  This class contains the six planes of the view frustum
+ *  and the world space boxes added since the last clear,
+ *  as centers and half extents in contiguous arrays of
+ *  each axis.  Cull() tests every box against the planes
+ *  in one batch and keeps a visibility flag per box.
+ *
+ *  A box is culled when it lies entirely on the outer side
+ *  of one plane.  Boxes that straddle a corner of the
+ *  frustum may still be kept, which only costs a draw.
+ ***********************************************************/
+class FrustumCuller
+{
+public:
+	// extract the frustum planes of a projection * view
+	// matrix, the planes point inwards and are normalized
+	void SetViewProjection(const glm::mat4& viewProjection);
+	// plane as normal and distance, left, right, bottom,
+	// top, near and far
+	inline const glm::vec4& GetPlane(int index) const { return m_planes[index]; }
+
+	// remove all boxes
+	void Clear();
+	// add a local space box transformed to world space by the
+	// matrix, returns its index
+	size_t AddBox(const glm::vec3& localMin, const glm::vec3& localMax, const glm::mat4& world);
+
+	// number of boxes
+	inline size_t Size() const { return m_centerX.size(); }
+	// world space corners of a box
+	inline void GetBox(size_t index, glm::vec3& boxMin, glm::vec3& boxMax) const
+	{
+		glm::vec3 center(m_centerX[index], m_centerY[index], m_centerZ[index]);
+		glm::vec3 extent(m_extentX[index], m_extentY[index], m_extentZ[index]);
+		boxMin = center - extent;
+		boxMax = center + extent;
+	}
+
+	// test every box against the frustum, returns how many
+	// boxes are visible
+	size_t Cull();
+	// visibility of a box as of the last cull
+	inline bool IsVisible(size_t index) const { return m_visible[index] != 0; }
+
+private:
+	glm::vec4 m_planes[6];
+
+	// world space box centers and half extents
+	std::vector<float> m_centerX;
+	std::vector<float> m_centerY;
+	std::vector<float> m_centerZ;
+	std::vector<float> m_extentX;
+	std::vector<float> m_extentY;
+	std::vector<float> m_extentZ;
+	// visibility flag of every box
+	std::vector<uint8_t> m_visible;
+};
+
+// test boxes given as centers and half extents against a set
+// of six planes - the batched kernel behind FrustumCuller::Cull(),
+// processing four boxes per iteration with SSE2 where available
+size_t CullBoxes(
+	const glm::vec4* planes,
+	const float* centerX,
+	const float* centerY,
+	const float* centerZ,
+	const float* extentX,
+	const float* extentY,
+	const float* extentZ,
+	size_t count,
+	uint8_t* visible);
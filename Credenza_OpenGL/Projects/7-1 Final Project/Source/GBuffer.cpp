@@ -0,0 +1,187 @@
+///////////////////////////////////////////////////////////////////////////////
+// GBuffer.cpp
+// ============
+// hold the surface attributes of every pixel written by the geometry pass of
+// deferred shading, read back by the lighting pass
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GBuffer.h"
+
+#include <iostream>
+
+/***********************************************************
+ *  GBuffer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+GBuffer::GBuffer()
+{
+	m_framebuffer = 0;
+	m_albedoTexture = 0;
+	m_normalTexture = 0;
+	m_depthTexture = 0;
+	m_emptyVertexArray = 0;
+	m_width = 0;
+	m_height = 0;
+}
+
+/***********************************************************
+ *  ~GBuffer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+GBuffer::~GBuffer()
+{
+	Release();
+	if (0 != m_emptyVertexArray)
+	{
+		glDeleteVertexArrays(1, &m_emptyVertexArray);
+	}
+}
+
+/***********************************************************
+ *  Release()
+ *
+ *  This method is used for deleting the framebuffer and
+ *  its textures.
+ ***********************************************************/
+void GBuffer::Release()
+{
+	if (0 != m_framebuffer)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+		m_framebuffer = 0;
+	}
+
+	GLuint* textures[] = { &m_albedoTexture, &m_normalTexture, &m_depthTexture };
+	for (size_t i = 0; i < sizeof(textures) / sizeof(textures[0]); i++)
+	{
+		if (0 != *textures[i])
+		{
+			glDeleteTextures(1, textures[i]);
+			*textures[i] = 0;
+		}
+	}
+
+	m_width = 0;
+	m_height = 0;
+}
+
+/***********************************************************
+ *  Resize()
+ *
+ *  This method is used for creating the textures and the
+ *  framebuffer at the size of the viewport.  Nothing is
+ *  done while the size stays the same.
+ ***********************************************************/
+bool GBuffer::Resize(GLsizei width, GLsizei height)
+{
+	if ((0 != m_framebuffer) && (width == m_width) && (height == m_height))
+	{
+		return(true);
+	}
+
+	Release();
+	if ((width <= 0) || (height <= 0))
+	{
+		return(false);
+	}
+
+	struct TEXTURE_FORMAT
+	{
+		GLuint* pTexture;
+		GLenum internalFormat;
+		GLenum attachment;
+	};
+	TEXTURE_FORMAT formats[] =
+	{
+		{ &m_albedoTexture, GL_RGBA8, GL_COLOR_ATTACHMENT0 },
+		{ &m_normalTexture, GL_RG16_SNORM, GL_COLOR_ATTACHMENT1 },
+		{ &m_depthTexture, GL_DEPTH_COMPONENT32F, GL_DEPTH_ATTACHMENT }
+	};
+
+	GLint previousFramebuffer = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer);
+
+	// the lighting pass reads single texels, so nothing is filtered
+	for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+	{
+		glGenTextures(1, formats[i].pTexture);
+		glBindTexture(GL_TEXTURE_2D, *formats[i].pTexture);
+		glTexStorage2D(GL_TEXTURE_2D, 1, formats[i].internalFormat, width, height);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, formats[i].attachment, GL_TEXTURE_2D, *formats[i].pTexture, 0);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, drawBuffers);
+
+	GLenum status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, (GLuint)previousFramebuffer);
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "G-buffer framebuffer is incomplete: 0x" << std::hex << status << std::dec << std::endl;
+		Release();
+		return(false);
+	}
+
+	if (0 == m_emptyVertexArray)
+	{
+		glGenVertexArrays(1, &m_emptyVertexArray);
+	}
+
+	m_width = width;
+	m_height = height;
+	return(true);
+}
+
+/***********************************************************
+ *  BeginGeometryPass()
+ *
+ *  This method is used for binding the framebuffer and
+ *  clearing it.  Cleared pixels keep the far depth, which
+ *  the lighting pass skips.
+ ***********************************************************/
+void GBuffer::BeginGeometryPass()
+{
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer);
+
+	const GLfloat zeros[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	const GLfloat farDepth = 1.0f;
+	glClearBufferfv(GL_COLOR, 0, zeros);
+	glClearBufferfv(GL_COLOR, 1, zeros);
+	glClearBufferfv(GL_DEPTH, 0, &farDepth);
+}
+
+/***********************************************************
+ *  BindTextures()
+ *
+ *  This method is used for binding the textures to the
+ *  units the lighting pass samples them from.
+ ***********************************************************/
+void GBuffer::BindTextures(GLStateCache* pStateCache) const
+{
+	pStateCache->BindTexture(ALBEDO_UNIT, GL_TEXTURE_2D, m_albedoTexture);
+	pStateCache->BindTexture(NORMAL_UNIT, GL_TEXTURE_2D, m_normalTexture);
+	pStateCache->BindTexture(DEPTH_UNIT, GL_TEXTURE_2D, m_depthTexture);
+}
+
+/***********************************************************
+ *  DrawFullScreen()
+ *
+ *  This method is used for drawing one triangle that covers
+ *  the viewport.  The vertex shader places the corners from
+ *  the vertex index, so no vertex data is bound.
+ ***********************************************************/
+void GBuffer::DrawFullScreen(GLStateCache* pStateCache) const
+{
+	pStateCache->BindVertexArray(m_emptyVertexArray);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+}
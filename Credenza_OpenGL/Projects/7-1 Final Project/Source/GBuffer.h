@@ -0,0 +1,65 @@
+///////////////////////////////////////////////////////////////////////////////
+// GBuffer.h
+// ============
+// hold the surface attributes of every pixel written by the geometry pass of
+// deferred shading, read back by the lighting pass
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+
+/***********************************************************
+ *  GBuffer
+ *
+ *  This class contains the framebuffer of the geometry pass
+ *  and its three textures, sized to the viewport:
+ *
+ *    albedo  RGBA8      surface color, and the material
+ *                       index plus one in alpha, 0 for
+ *                       surfaces drawn without lighting
+ *    normal  RG16_SNORM world normal, octahedral encoded
+ *    depth   32F        depth, for the world position
+ *
+ *  Each pixel takes 12 bytes, and the lighting pass shades
+ *  it once whatever the number of surfaces drawn over it.
+ ***********************************************************/
+class GBuffer
+{
+public:
+	// texture units the lighting pass reads the textures from,
+	// above the 16 slots of the scene textures
+	static const GLuint ALBEDO_UNIT = 16;
+	static const GLuint NORMAL_UNIT = 17;
+	static const GLuint DEPTH_UNIT = 18;
+
+	GBuffer();
+	~GBuffer();
+
+	// size the textures to the passed in viewport, recreating them
+	// only when it changed - false when the framebuffer is incomplete
+	bool Resize(GLsizei width, GLsizei height);
+	inline GLsizei GetWidth() const { return m_width; }
+	inline GLsizei GetHeight() const { return m_height; }
+
+	// bind the framebuffer and clear it for the geometry pass
+	void BeginGeometryPass();
+	// bind the textures to their units for the lighting pass
+	void BindTextures(GLStateCache* pStateCache) const;
+	// draw a triangle covering the viewport, without vertex data
+	void DrawFullScreen(GLStateCache* pStateCache) const;
+
+private:
+	// delete the framebuffer and the textures
+	void Release();
+
+	GLuint m_framebuffer;
+	GLuint m_albedoTexture;
+	GLuint m_normalTexture;
+	GLuint m_depthTexture;
+	// empty vertex array bound for the full screen triangle
+	GLuint m_emptyVertexArray;
+	GLsizei m_width;
+	GLsizei m_height;
+};
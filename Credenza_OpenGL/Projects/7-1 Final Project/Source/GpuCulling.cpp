@@ -0,0 +1,458 @@
+///////////////////////////////////////////////////////////////////////////////
+// GpuCulling.cpp
+// ============
+// cull objects against the view frustum and the occluder depth pyramid and
+// select their level of detail in a compute shader, which writes the draw
+// commands of the visible objects
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GpuCulling.h"
+
+#include <algorithm>
+#include <cstring>
+
+static_assert(sizeof(GpuCuller::GPU_CULL_ITEM) == 160,
+	"GPU_CULL_ITEM must match the std430 layout of CullItem");
+static_assert(sizeof(ShapeMeshes::DRAW_ELEMENTS_COMMAND) == 20,
+	"DRAW_ELEMENTS_COMMAND must match the std430 layout of DrawCommand");
+static_assert(sizeof(ShapeMeshes::INSTANCE_DATA) == 96,
+	"INSTANCE_DATA must match the std430 layout of InstanceData");
+static_assert(sizeof(GpuCuller::GPU_CULL_STATS) == 5 * sizeof(GLuint),
+	"GPU_CULL_STATS must match the statistics of DrawCounts");
+
+namespace
+{
+	// threads of a work group, local_size_x in the shader
+	const GLuint g_GroupSize = 64;
+	// size of occlusionLevels in the shader
+	const int g_MaxOcclusionLevels = 16;
+
+	// shader storage binding points of the compute shader
+	enum CullBufferBinding
+	{
+		CULL_ITEMS_BINDING = 0,
+		LEVEL_COMMANDS_BINDING,
+		PASS_FIRSTS_BINDING,
+		DRAW_COUNTS_BINDING,
+		COMMANDS_BINDING,
+		INSTANCES_BINDING,
+		LOD_LEVELS_BINDING,
+		RESULTS_BINDING
+	};
+}
+
+/***********************************************************
+ *  GpuCuller()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+GpuCuller::GpuCuller()
+{
+	m_pStateCache = NULL;
+	m_program = 0;
+	m_planesLocation = -1;
+	m_viewProjectionLocation = -1;
+	m_lodProjectionScaleLocation = -1;
+	m_lodThresholdsLocation = -1;
+	m_lodHysteresisLocation = -1;
+	m_lodSelectionLocation = -1;
+	m_itemCountLocation = -1;
+	m_statsOffsetLocation = -1;
+	m_occlusionDepthsLocation = -1;
+	m_occlusionLevelsLocation = -1;
+	m_occlusionLevelCountLocation = -1;
+	m_dispatchedCount = 0;
+	m_occlusionTexture = 0;
+	m_bOcclusionTested = false;
+	m_dispatchIndex = 0;
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_statsDispatch = 0;
+	m_bStatsValid = false;
+	for (int i = 0; i < STATS_READBACK_COUNT; i++)
+	{
+		m_statsReadbacks[i].buffer = 0;
+		m_statsReadbacks[i].fence = NULL;
+		m_statsReadbacks[i].dispatch = 0;
+	}
+
+	STORAGE_BUFFER empty = { 0, 0 };
+	m_itemBuffer = empty;
+	m_levelBuffer = empty;
+	m_passBuffer = empty;
+	m_drawCountBuffer = empty;
+	m_commandBuffer = empty;
+	m_instanceBuffer = empty;
+	m_lodLevelBuffer = empty;
+	m_resultBuffer = empty;
+	m_occlusionBuffer = empty;
+}
+
+/***********************************************************
+ *  ~GpuCuller()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+GpuCuller::~GpuCuller()
+{
+	STORAGE_BUFFER* buffers[] = { &m_itemBuffer, &m_levelBuffer, &m_passBuffer,
+		&m_drawCountBuffer, &m_commandBuffer, &m_instanceBuffer, &m_lodLevelBuffer, &m_resultBuffer,
+		&m_occlusionBuffer };
+	for (size_t i = 0; i < sizeof(buffers) / sizeof(buffers[0]); i++)
+	{
+		DeleteStorageBuffer(*buffers[i]);
+	}
+	for (int i = 0; i < STATS_READBACK_COUNT; i++)
+	{
+		if (NULL != m_statsReadbacks[i].fence)
+		{
+			glDeleteSync(m_statsReadbacks[i].fence);
+			m_statsReadbacks[i].fence = NULL;
+		}
+		if (0 != m_statsReadbacks[i].buffer)
+		{
+			glDeleteBuffers(1, &m_statsReadbacks[i].buffer);
+			m_statsReadbacks[i].buffer = 0;
+		}
+	}
+	if (0 != m_occlusionTexture)
+	{
+		glDeleteTextures(1, &m_occlusionTexture);
+		m_occlusionTexture = 0;
+	}
+	if (0 != m_program)
+	{
+		glDeleteProgram(m_program);
+		m_program = 0;
+	}
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for building the compute program
+ *  and looking up its uniforms.  Culling stays on the CPU
+ *  when the context cannot run compute shaders or read
+ *  the draw count of an indirect draw from a buffer.
+ ***********************************************************/
+bool GpuCuller::Initialize(ShaderManager* pShaderManager, const char* computeFilePath)
+{
+	if ((0 != m_program) || !ShapeMeshes::SupportsIndirectCount())
+	{
+		return(IsSupported());
+	}
+
+	m_program = pShaderManager->LoadComputeShader(computeFilePath);
+	if (0 == m_program)
+	{
+		return(false);
+	}
+	m_pStateCache = pShaderManager->GetStateCache();
+
+	m_planesLocation = glGetUniformLocation(m_program, "frustumPlanes");
+	m_viewProjectionLocation = glGetUniformLocation(m_program, "viewProjection");
+	m_lodProjectionScaleLocation = glGetUniformLocation(m_program, "lodProjectionScale");
+	m_lodThresholdsLocation = glGetUniformLocation(m_program, "lodThresholds");
+	m_lodHysteresisLocation = glGetUniformLocation(m_program, "lodHysteresis");
+	m_lodSelectionLocation = glGetUniformLocation(m_program, "lodSelection");
+	m_itemCountLocation = glGetUniformLocation(m_program, "itemCount");
+	m_statsOffsetLocation = glGetUniformLocation(m_program, "statsOffset");
+	m_occlusionDepthsLocation = glGetUniformLocation(m_program, "occlusionDepths");
+	m_occlusionLevelsLocation = glGetUniformLocation(m_program, "occlusionLevels");
+	m_occlusionLevelCountLocation = glGetUniformLocation(m_program, "occlusionLevelCount");
+	glProgramUniform1i(m_program, m_occlusionDepthsLocation, (GLint)OCCLUSION_TEXTURE_UNIT);
+
+	return(true);
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for removing all objects and passes.
+ ***********************************************************/
+void GpuCuller::Clear()
+{
+	m_items.clear();
+	m_levels.clear();
+	m_passFirsts.clear();
+	m_passCounts.clear();
+}
+
+/***********************************************************
+ *  BeginPass()
+ *
+ *  This method is used for starting a pass, the objects
+ *  added until the next pass are drawn by one call.
+ ***********************************************************/
+GLuint GpuCuller::BeginPass()
+{
+	m_passFirsts.push_back((GLuint)m_items.size());
+	m_passCounts.push_back(0);
+	return((GLuint)(m_passFirsts.size() - 1));
+}
+
+/***********************************************************
+ *  AddItem()
+ *
+ *  This method is used for adding an object to the current
+ *  pass.  The draw command of each of its levels is kept
+ *  in a table the compute shader picks the drawn one from.
+ ***********************************************************/
+void GpuCuller::AddItem(const GPU_CULL_ITEM& item, const ShapeMeshes::DRAW_ELEMENTS_COMMAND* levels, int levelCount)
+{
+	if (m_passFirsts.empty() || (levelCount <= 0))
+	{
+		return;
+	}
+
+	GPU_CULL_ITEM added = item;
+	added.pass = (GLuint)(m_passFirsts.size() - 1);
+	added.firstLevel = (GLuint)m_levels.size();
+	added.levelCount = (GLuint)levelCount;
+	memset(added.padding, 0, sizeof(added.padding));
+	m_items.push_back(added);
+	m_levels.insert(m_levels.end(), levels, levels + levelCount);
+	m_passCounts.back()++;
+}
+
+/***********************************************************
+ *  Dispatch()
+ *
+ *  This method is used for culling the objects on the GPU.
+ *  The objects, level commands and pass ranges are
+ *  uploaded, the draw counts are set to zero, and one
+ *  thread runs per object.  The barrier makes the written
+ *  commands and instances visible to the indirect draws.
+ *  The level slots keep their contents when they grow, so
+ *  the hysteresis survives objects being added.  The counts
+ *  of earlier dispatches the GPU has finished are read
+ *  first, and the ones of this dispatch are copied out
+ *  after it.
+ ***********************************************************/
+void GpuCuller::Dispatch(const GPU_CULL_PARAMS& params)
+{
+	m_dispatchedCount = m_items.size();
+	m_bOcclusionTested = false;
+	if ((0 == m_program) || (0 == m_dispatchedCount))
+	{
+		return;
+	}
+
+	CollectStats();
+
+	UploadStorageBuffer(m_itemBuffer, m_items.data(), m_items.size() * sizeof(GPU_CULL_ITEM));
+	UploadStorageBuffer(m_levelBuffer, m_levels.data(), m_levels.size() * sizeof(ShapeMeshes::DRAW_ELEMENTS_COMMAND));
+	UploadStorageBuffer(m_passBuffer, m_passFirsts.data(), m_passFirsts.size() * sizeof(GLuint));
+	// the draw counts start at zero, followed by the statistics
+	// with the number of tested objects filled in
+	std::vector<GLuint> zeros(m_passFirsts.size() + sizeof(GPU_CULL_STATS) / sizeof(GLuint), 0);
+	zeros[m_passFirsts.size()] = (GLuint)m_dispatchedCount;
+	UploadStorageBuffer(m_drawCountBuffer, zeros.data(), zeros.size() * sizeof(GLuint));
+	ReserveStorageBuffer(m_commandBuffer, m_items.size() * sizeof(ShapeMeshes::DRAW_ELEMENTS_COMMAND));
+	ReserveStorageBuffer(m_instanceBuffer, m_items.size() * sizeof(ShapeMeshes::INSTANCE_DATA));
+	ReserveStorageBuffer(m_resultBuffer, m_items.size() * sizeof(GLuint));
+
+	GrowStorageBuffer(m_lodLevelBuffer, std::max(params.lodSlotCount, (size_t)1) * sizeof(GLuint));
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_ITEMS_BINDING, m_itemBuffer.buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LEVEL_COMMANDS_BINDING, m_levelBuffer.buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PASS_FIRSTS_BINDING, m_passBuffer.buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_COUNTS_BINDING, m_drawCountBuffer.buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMANDS_BINDING, m_commandBuffer.buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCES_BINDING, m_instanceBuffer.buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LOD_LEVELS_BINDING, m_lodLevelBuffer.buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RESULTS_BINDING, m_resultBuffer.buffer);
+
+	glProgramUniform4fv(m_program, m_planesLocation, 6, &params.planes[0][0]);
+	glProgramUniformMatrix4fv(m_program, m_viewProjectionLocation, 1, GL_FALSE, &params.viewProjection[0][0]);
+	glProgramUniform1f(m_program, m_lodProjectionScaleLocation, params.lodProjectionScale);
+	glProgramUniform1fv(m_program, m_lodThresholdsLocation, 3, params.lodThresholds);
+	glProgramUniform1f(m_program, m_lodHysteresisLocation, params.lodHysteresis);
+	glProgramUniform1i(m_program, m_lodSelectionLocation, params.bLodSelection ? 1 : 0);
+	glProgramUniform1ui(m_program, m_itemCountLocation, (GLuint)m_dispatchedCount);
+	glProgramUniform1ui(m_program, m_statsOffsetLocation, (GLuint)m_passFirsts.size());
+	UploadOcclusion(params.pOcclusionCuller);
+
+	m_pStateCache->UseProgram(m_program);
+	glDispatchCompute((GLuint)((m_dispatchedCount + g_GroupSize - 1) / g_GroupSize), 1, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT |
+		GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	CopyStats();
+	m_dispatchIndex++;
+}
+
+/***********************************************************
+ *  UploadOcclusion()
+ *
+ *  This method is used for uploading the depth pyramid of
+ *  an occlusion culler.  The levels are packed one after
+ *  the other into a buffer texture, since the compute
+ *  shader already uses the eight storage buffers every
+ *  context has, and the offset and size of each level go
+ *  into a uniform array.
+ ***********************************************************/
+void GpuCuller::UploadOcclusion(const OcclusionCuller* pOcclusionCuller)
+{
+	int levelCount = 0;
+	if (NULL != pOcclusionCuller)
+	{
+		levelCount = std::min(pOcclusionCuller->GetLevelCount(), g_MaxOcclusionLevels);
+	}
+	if (0 == levelCount)
+	{
+		glProgramUniform1ui(m_program, m_occlusionLevelCountLocation, 0);
+		return;
+	}
+
+	GLuint levels[g_MaxOcclusionLevels * 4];
+	m_occlusionDepths.clear();
+	for (int level = 0; level < levelCount; level++)
+	{
+		int width = pOcclusionCuller->GetLevelWidth(level);
+		int height = pOcclusionCuller->GetLevelHeight(level);
+		const float* depths = pOcclusionCuller->GetLevelData(level);
+		levels[level * 4 + 0] = (GLuint)m_occlusionDepths.size();
+		levels[level * 4 + 1] = (GLuint)width;
+		levels[level * 4 + 2] = (GLuint)height;
+		levels[level * 4 + 3] = 0;
+		m_occlusionDepths.insert(m_occlusionDepths.end(), depths, depths + (size_t)width * height);
+	}
+
+	UploadStorageBuffer(m_occlusionBuffer, m_occlusionDepths.data(), m_occlusionDepths.size() * sizeof(float));
+	if (0 == m_occlusionTexture)
+	{
+		glGenTextures(1, &m_occlusionTexture);
+		m_pStateCache->BindTexture(OCCLUSION_TEXTURE_UNIT, GL_TEXTURE_BUFFER, m_occlusionTexture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, m_occlusionBuffer.buffer);
+	}
+	m_pStateCache->BindTexture(OCCLUSION_TEXTURE_UNIT, GL_TEXTURE_BUFFER, m_occlusionTexture);
+
+	glProgramUniform4uiv(m_program, m_occlusionLevelsLocation, levelCount, levels);
+	glProgramUniform1ui(m_program, m_occlusionLevelCountLocation, (GLuint)levelCount);
+	m_bOcclusionTested = true;
+}
+
+/***********************************************************
+ *  CopyStats()
+ *
+ *  This method is used for copying the counts of the last
+ *  dispatch into the next readback buffer and setting a
+ *  fence after the copy.  The counts of this dispatch are
+ *  dropped when that buffer is still on its way back.
+ ***********************************************************/
+void GpuCuller::CopyStats()
+{
+	STATS_READBACK& readback = m_statsReadbacks[m_dispatchIndex % STATS_READBACK_COUNT];
+	if (NULL != readback.fence)
+	{
+		return;
+	}
+
+	if (0 == readback.buffer)
+	{
+		glGenBuffers(1, &readback.buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, readback.buffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, sizeof(GPU_CULL_STATS), NULL, GL_STREAM_READ);
+	}
+
+	glBindBuffer(GL_COPY_READ_BUFFER, m_drawCountBuffer.buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, readback.buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+		(GLintptr)(m_passFirsts.size() * sizeof(GLuint)), 0, sizeof(GPU_CULL_STATS));
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	readback.dispatch = m_dispatchIndex;
+}
+
+/***********************************************************
+ *  CollectStats()
+ *
+ *  This method is used for reading the readback buffers
+ *  whose fence has passed, without waiting for the others.
+ *  The counts of the newest dispatch read are kept.
+ ***********************************************************/
+void GpuCuller::CollectStats()
+{
+	for (int i = 0; i < STATS_READBACK_COUNT; i++)
+	{
+		STATS_READBACK& readback = m_statsReadbacks[i];
+		if (NULL == readback.fence)
+		{
+			continue;
+		}
+
+		GLenum status = glClientWaitSync(readback.fence, 0, 0);
+		if ((GL_ALREADY_SIGNALED != status) && (GL_CONDITION_SATISFIED != status))
+		{
+			continue;
+		}
+		glDeleteSync(readback.fence);
+		readback.fence = NULL;
+
+		if (m_bStatsValid && ((int32_t)(readback.dispatch - m_statsDispatch) <= 0))
+		{
+			continue;
+		}
+		glBindBuffer(GL_COPY_READ_BUFFER, readback.buffer);
+		glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(GPU_CULL_STATS), &m_stats);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		m_statsDispatch = readback.dispatch;
+		m_bStatsValid = true;
+	}
+}
+
+/***********************************************************
+ *  GetPassDraw()
+ *
+ *  This method is used for getting the command range and
+ *  the draw count of a pass, as offsets into the command
+ *  and draw count buffers.
+ ***********************************************************/
+void GpuCuller::GetPassDraw(GLuint pass, GLintptr& indirectOffset, GLintptr& drawCountOffset,
+	GLsizei& maxDrawCount) const
+{
+	indirectOffset = (GLintptr)(m_passFirsts[pass] * sizeof(ShapeMeshes::DRAW_ELEMENTS_COMMAND));
+	drawCountOffset = (GLintptr)(pass * sizeof(GLuint));
+	maxDrawCount = (GLsizei)m_passCounts[pass];
+}
+
+/***********************************************************
+ *  ReadResults()
+ *
+ *  This method is used for reading the result of every
+ *  object of the last dispatch back from the GPU.
+ ***********************************************************/
+bool GpuCuller::ReadResults(std::vector<uint32_t>& results) const
+{
+	results.clear();
+	if ((0 == m_program) || (0 == m_dispatchedCount))
+	{
+		return(false);
+	}
+
+	results.resize(m_dispatchedCount);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_resultBuffer.buffer);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, m_dispatchedCount * sizeof(GLuint), &results[0]);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	return(true);
+}
+
+/***********************************************************
+ *  GetStats()
+ *
+ *  This method is used for getting the counts of the newest
+ *  dispatch read back so far, a few dispatches old.
+ ***********************************************************/
+bool GpuCuller::GetStats(GPU_CULL_STATS& stats) const
+{
+	if (!m_bStatsValid)
+	{
+		return(false);
+	}
+
+	stats = m_stats;
+	return(true);
+}
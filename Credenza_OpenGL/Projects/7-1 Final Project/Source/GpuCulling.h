@@ -0,0 +1,225 @@
+///////////////////////////////////////////////////////////////////////////////
+// GpuCulling.h
+// ============
+// cull objects against the view frustum and the occluder depth pyramid and
+// select their level of detail in a compute shader, which writes the draw
+// commands of the visible objects
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "OcclusionCulling.h"
+#include "ShaderManager.h"
+#include "ShapeMeshes.h"
+#include "StorageBuffer.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  GpuCuller
+ *
+ *  This class contains the objects of the draws of a frame
+ *  and the compute program that culls them.  The objects
+ *  are grouped into passes, one per multi-draw call.  Each
+ *  pass owns a range of the command buffer as long as its
+ *  number of objects, and a draw count in the parameter
+ *  buffer.
+ *
+ *  One thread runs per object.  A visible object reserves
+ *  the next slot of its pass with an atomic add on the
+ *  draw count and writes its draw command and instance
+ *  data there.  The commands of a pass end up compacted
+ *  at the start of its range in no particular order, and
+ *  the draw count tells the indirect draw how many there
+ *  are, so nothing is read back to the CPU.
+ *
+ *  The level of detail drawn for every object is kept on
+ *  the GPU between frames by a slot the caller gives each
+ *  object, for the hysteresis of the selection.
+ *
+ *  Objects inside the frustum are also tested against the
+ *  depth pyramid of an OcclusionCuller, read from a buffer
+ *  texture, the same way the CPU path tests them.  The
+ *  counts of the dispatch are added up on the GPU after
+ *  the draw counts and copied into a ring of readback
+ *  buffers, which are read a few frames later once their
+ *  fence has passed, so the frame never waits on them.
+ ***********************************************************/
+class GpuCuller
+{
+public:
+	// object to cull, laid out to match CullItem in the compute
+	// shader with std430 rules
+	struct GPU_CULL_ITEM
+	{
+		glm::mat4 model;
+		glm::vec4 color;
+		// local box, the UV scale is kept in the w components
+		glm::vec4 boxMin;
+		glm::vec4 boxMax;
+		// local bounding sphere of the full geometry
+		glm::vec4 sphere;
+		GLint materialIndex;
+		GLuint pass;
+		// slot of the level drawn last frame
+		GLuint lodSlot;
+		// draw commands of the levels of detail, full detail first
+		GLuint firstLevel;
+		GLuint levelCount;
+		GLuint padding[3];
+	};
+
+	// view and level of detail settings of a dispatch
+	struct GPU_CULL_PARAMS
+	{
+		glm::mat4 viewProjection;
+		glm::vec4 planes[6];
+		float lodProjectionScale;
+		float lodThresholds[3];
+		float lodHysteresis;
+		bool bLodSelection;
+		// number of level slots in use
+		size_t lodSlotCount;
+		// depth pyramid to test the objects against, NULL to
+		// skip the occlusion test
+		const OcclusionCuller* pOcclusionCuller;
+	};
+
+	// counts of a dispatch, laid out to match the statistics
+	// after the draw counts in the compute shader
+	struct GPU_CULL_STATS
+	{
+		GLuint testedCount;
+		GLuint culledCount;
+		GLuint occludedCount;
+		// triangles of the drawn objects at full detail and at
+		// the selected level
+		GLuint fullTriangleCount;
+		GLuint lodTriangleCount;
+	};
+
+	// texture unit of the depth pyramid, above the units tracked
+	// by the state cache and the ones of the G-buffer
+	static const GLuint OCCLUSION_TEXTURE_UNIT = 19;
+
+	GpuCuller();
+	~GpuCuller();
+
+	// build the compute program, false when the context lacks
+	// compute shaders or indirect draw counts
+	bool Initialize(ShaderManager* pShaderManager, const char* computeFilePath);
+	inline bool IsSupported() const { return m_program != 0; }
+
+	// remove all objects and passes
+	void Clear();
+	// start the next pass, returns its index
+	GLuint BeginPass();
+	// add an object to the current pass with the draw commands of
+	// its levels of detail
+	void AddItem(const GPU_CULL_ITEM& item, const ShapeMeshes::DRAW_ELEMENTS_COMMAND* levels, int levelCount);
+
+	// number of objects and passes
+	inline size_t GetItemCount() const { return m_items.size(); }
+	inline size_t GetPassCount() const { return m_passFirsts.size(); }
+	inline const GPU_CULL_ITEM& GetItem(size_t index) const { return m_items[index]; }
+
+	// upload the objects and run the compute program
+	void Dispatch(const GPU_CULL_PARAMS& params);
+
+	// range of the command buffer and draw count of a pass
+	void GetPassDraw(GLuint pass, GLintptr& indirectOffset, GLintptr& drawCountOffset,
+		GLsizei& maxDrawCount) const;
+	// buffers written by the last dispatch
+	inline GLuint GetCommandBuffer() const { return m_commandBuffer.buffer; }
+	inline GLuint GetDrawCountBuffer() const { return m_drawCountBuffer.buffer; }
+	inline GLuint GetInstanceBuffer() const { return m_instanceBuffer.buffer; }
+
+	// whether the objects of the last dispatch were tested
+	// against a depth pyramid
+	inline bool WasOcclusionTested() const { return m_bOcclusionTested; }
+
+	// read back the result of every object of the last dispatch,
+	// 0 when outside the frustum, 2 when occluded, otherwise 1
+	// with the previous level in bits 8 to 15 and the selected
+	// level in bits 16 to 23 - stalls until the dispatch is
+	// done, meant for checking
+	bool ReadResults(std::vector<uint32_t>& results) const;
+
+	// counts of the newest dispatch whose readback has arrived,
+	// false until one has - never waits on the GPU
+	bool GetStats(GPU_CULL_STATS& stats) const;
+	// dispatches run since the one the counts belong to
+	inline uint32_t GetStatsLatency() const { return m_dispatchIndex - 1 - m_statsDispatch; }
+
+private:
+	// upload the depth pyramid and set the occlusion uniforms,
+	// with no level when the passed in culler is NULL
+	void UploadOcclusion(const OcclusionCuller* pOcclusionCuller);
+	// copy the counts of the dispatch into a readback buffer
+	void CopyStats();
+	// read the counts of the readback buffers the GPU is done with
+	void CollectStats();
+
+	// readback buffer of the counts of one dispatch, pending
+	// while its fence is set
+	struct STATS_READBACK
+	{
+		GLuint buffer;
+		GLsync fence;
+		uint32_t dispatch;
+	};
+	static const int STATS_READBACK_COUNT = 3;
+
+	GLStateCache* m_pStateCache;
+	GLuint m_program;
+
+	// uniform locations of the compute program
+	GLint m_planesLocation;
+	GLint m_viewProjectionLocation;
+	GLint m_lodProjectionScaleLocation;
+	GLint m_lodThresholdsLocation;
+	GLint m_lodHysteresisLocation;
+	GLint m_lodSelectionLocation;
+	GLint m_itemCountLocation;
+	GLint m_statsOffsetLocation;
+	GLint m_occlusionDepthsLocation;
+	GLint m_occlusionLevelsLocation;
+	GLint m_occlusionLevelCountLocation;
+
+	// objects, level commands and first command of every pass
+	std::vector<GPU_CULL_ITEM> m_items;
+	std::vector<ShapeMeshes::DRAW_ELEMENTS_COMMAND> m_levels;
+	std::vector<GLuint> m_passFirsts;
+	std::vector<GLuint> m_passCounts;
+
+	STORAGE_BUFFER m_itemBuffer;
+	STORAGE_BUFFER m_levelBuffer;
+	STORAGE_BUFFER m_passBuffer;
+	STORAGE_BUFFER m_drawCountBuffer;
+	STORAGE_BUFFER m_commandBuffer;
+	STORAGE_BUFFER m_instanceBuffer;
+	STORAGE_BUFFER m_lodLevelBuffer;
+	STORAGE_BUFFER m_resultBuffer;
+	// objects of the last dispatch
+	size_t m_dispatchedCount;
+
+	// every level of the depth pyramid one after the other, and
+	// the buffer texture they are read through
+	std::vector<float> m_occlusionDepths;
+	STORAGE_BUFFER m_occlusionBuffer;
+	GLuint m_occlusionTexture;
+	bool m_bOcclusionTested;
+
+	// counts on their way back from the GPU, and the newest ones
+	// that arrived
+	STATS_READBACK m_statsReadbacks[STATS_READBACK_COUNT];
+	uint32_t m_dispatchIndex;
+	GPU_CULL_STATS m_stats;
+	uint32_t m_statsDispatch;
+	bool m_bStatsValid;
+};
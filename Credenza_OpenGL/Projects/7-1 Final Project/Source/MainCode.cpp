@@ -27,6 +27,11 @@
 #include "ViewManager.h"
 #include "ShapeMeshes.h"
 #include "ShaderManager.h"
+#include "SceneStoreBenchmark.h"
+#include "TransformBenchmark.h"
+#include "SpatialHashBenchmark.h"
+#include "PickBenchmark.h"
+#include "OcclusionBenchmark.h"
 
 // Namespace for declaring global variables
 namespace
@@ -53,7 +58,9 @@ bool InitializeImGui();
 void ShutdownImGui();
 void DrawImGui();
 
-int curMeshIndex = -1;
+// handle of the mesh selected in the editor, it goes stale
+// instead of moving to another mesh when the mesh is deleted
+SceneStore::Handle curMeshHandle = SceneStore::INVALID_HANDLE;
 
 
 /***********************************************************
@@ -118,6 +125,8 @@ int main(int argc, char* argv[])
 		g_ViewManager->PrepareSceneView();
 
 		// refresh the 3D scene
+		g_SceneManager->SetViewPosition(g_ViewManager->GetViewPosition());
+		g_SceneManager->SetViewProjection(g_ViewManager->GetView(), g_ViewManager->GetProjection());
 		g_SceneManager->RenderScene();
 
 		// Begin ImGui frame
@@ -250,6 +259,17 @@ bool InitializeImGui()
  ***********************************************************/
 void DrawImGui()
 {
+	// select the mesh under the cursor when the scene, and not
+	// one of the windows, is clicked
+	if (ImGui::IsMouseClicked(0) && !ImGui::GetIO().WantCaptureMouse)
+	{
+		glm::vec3 origin;
+		glm::vec3 direction;
+		ImVec2 mouse = ImGui::GetMousePos();
+		g_ViewManager->GetPickRay(mouse.x, mouse.y, origin, direction);
+		curMeshHandle = g_SceneManager->PickMesh(origin, direction);
+	}
+
 	ImGui::Begin("Scene Objects");
 
 	if (ImGui::CollapsingHeader("Meshes"))
@@ -300,58 +320,81 @@ void DrawImGui()
 	{
 		if (ImGui::Button("Stanford Bunny"))
 		{
-			g_SceneManager->LoadModel("../../Models/bunny.obj", "Stanford Bunny", 
+			g_SceneManager->LoadModel("../../Models/bunny.obj", InternString("Stanford Bunny"), 
 				glm::vec3(0.2f, 3.0f, 10.0f), glm::vec3(0.0f, 0.0f, 0.0f), 
-				glm::vec3(1.0f, 1.0f, 1.0f), "default", 
-				"", glm::vec2(1.0f, 1.0f), glm::vec4(1.0), 
+				glm::vec3(1.0f, 1.0f, 1.0f), InternString("default"),
+				EMPTY_STRING_ID, glm::vec2(1.0f, 1.0f), glm::vec4(1.0), 
 				false);
 		}
 		if (ImGui::Button("Lucy"))
 		{
-			g_SceneManager->LoadModel("../../Models/lucy.obj", "Lucy", 
+			g_SceneManager->LoadModel("../../Models/lucy.obj", InternString("Lucy"), 
 				glm::vec3(0.2f, 3.0f, 10.0f), glm::vec3(0.0f, 0.0f, 0.0f), 
-				glm::vec3(1.5f, 1.5f, 1.5f), "default",
-				"", glm::vec2(1.0f, 1.0f), glm::vec4(1.0),
+				glm::vec3(1.5f, 1.5f, 1.5f), InternString("default"),
+				EMPTY_STRING_ID, glm::vec2(1.0f, 1.0f), glm::vec4(1.0),
 				false);
 		}
 		if (ImGui::Button("Teapot"))
 		{
-			g_SceneManager->LoadModel("../../Models/teapot.obj", "Teapot", 
+			g_SceneManager->LoadModel("../../Models/teapot.obj", InternString("Teapot"), 
 				glm::vec3(0.2f, 3.0f, 10.0f), glm::vec3(0.0f, 0.0f, 0.0f), 
-				glm::vec3(1.0f, 1.0f, 1.0f), "default",
-				"", glm::vec2(1.0f, 1.0f), glm::vec4(1.0),
+				glm::vec3(1.0f, 1.0f, 1.0f), InternString("default"),
+				EMPTY_STRING_ID, glm::vec2(1.0f, 1.0f), glm::vec4(1.0),
 				false);
 		}
 		if (ImGui::Button("Suzanne"))
 		{
-			g_SceneManager->LoadModel("../../Models/suzanne.obj", "Suzanne", 
+			g_SceneManager->LoadModel("../../Models/suzanne.obj", InternString("Suzanne"), 
 				glm::vec3(0.2f, 4.0f, 10.0f), glm::vec3(0.0f, 0.0f, 0.0f), 
-				glm::vec3(1.5f, 1.5f, 1.5f), "default",
-				"", glm::vec2(1.0f, 1.0f), glm::vec4(1.0),
+				glm::vec3(1.5f, 1.5f, 1.5f), InternString("default"),
+				EMPTY_STRING_ID, glm::vec2(1.0f, 1.0f), glm::vec4(1.0),
 				false);
 		}
 	}
 
-	if (g_SceneManager->GetNumMeshes() > 0)
+	// the slider needs at least one mesh, an empty store has
+	// nothing to select
+	int meshCount = g_SceneManager->GetNumMeshes();
+	if (meshCount <= 0)
+	{
+		curMeshHandle = SceneStore::INVALID_HANDLE;
+	}
+	else
 	{
 		ImGui::Separator();
 		ImGui::Text("Edit Mesh Transform");
 
-		// Select which mesh to edit
-		ImGui::SliderInt("Selected Mesh", &curMeshIndex, 0, g_SceneManager->GetNumMeshes() - 1);
+		SceneStore& store = g_SceneManager->GetSceneStore();
+
+		// Select which mesh to edit, the slider walks the dense
+		// indices and the selection is kept as a handle
+		int curMeshIndex = store.IsValid(curMeshHandle) ? (int)store.GetIndex(curMeshHandle) : -1;
+		if (ImGui::SliderInt("Selected Mesh", &curMeshIndex, 0, meshCount - 1))
+		{
+			curMeshHandle = store.GetHandle((size_t)std::max(0, std::min(curMeshIndex, meshCount - 1)));
+		}
 
-		if (curMeshIndex >= 0 && curMeshIndex < g_SceneManager->GetNumMeshes())
+		if (store.IsValid(curMeshHandle))
 		{
-			SceneManager::MESH_OBJECT& mesh = g_SceneManager->GetMesh(curMeshIndex);
+			curMeshIndex = (int)store.GetIndex(curMeshHandle);
+
+			// Parts of a model move with their parent, their
+			// transform is relative to it
+			ImGui::Text("Mesh: %s", GetInternedString(store.GetTag(curMeshIndex)).c_str());
+			SceneStore::Handle parent = store.GetParent(curMeshIndex);
+			if (parent != SceneStore::INVALID_HANDLE)
+			{
+				ImGui::Text("Parent: %s", GetInternedString(store.GetTag(store.GetIndex(parent))).c_str());
+			}
 
 			// Position Controls
-			ImGui::DragFloat3("Position", &mesh.position.x, 0.1f, -10.0f, 10.0f);
+			ImGui::DragFloat3("Position", &store.Position(curMeshIndex).x, 0.1f, -10.0f, 10.0f);
 
 			// Rotation Controls
-			ImGui::DragFloat3("Rotation", &mesh.rotation.x, 1.0f, -180.0f, 180.0f);
+			ImGui::DragFloat3("Rotation", &store.Rotation(curMeshIndex).x, 1.0f, -180.0f, 180.0f);
 
 			// Scale Controls
-			ImGui::DragFloat3("Scale", &mesh.scale.x, 0.1f, 0.1f, 5.0f);
+			ImGui::DragFloat3("Scale", &store.Scale(curMeshIndex).x, 0.1f, 0.1f, 5.0f);
 
 			// Material Controls
 			ImGui::Text("Material");
@@ -360,12 +403,15 @@ void DrawImGui()
 			// see the "Text Input > Resize Callback" section of this demo, and the misc/cpp/imgui_stdlib.h file.
 			// (Reference: https://github.com/ocornut/imgui/blob/master/imgui_demo.cpp)
 			static char materialTag[64];
-			strncpy_s(materialTag, mesh.materialTag.c_str(), sizeof(materialTag) - 1);
+			strncpy_s(materialTag, GetInternedString(store.GetMaterialTag(curMeshIndex)).c_str(), sizeof(materialTag) - 1);
 			materialTag[sizeof(materialTag) - 1] = '\0';
 
 			if (ImGui::InputText("Material##", materialTag, sizeof(materialTag)))
 			{
-				mesh.materialTag = std::string(materialTag);
+				// resolve the material index once when the tag is edited
+				StringID materialID = InternString(materialTag);
+				store.SetMaterial(curMeshIndex, materialID,
+					std::max(0, g_SceneManager->FindMaterialIndex(materialID)));
 			}
 
 			// Texture Controls
@@ -375,21 +421,22 @@ void DrawImGui()
 			// see the "Text Input > Resize Callback" section of this demo, and the misc/cpp/imgui_stdlib.h file.
 			// (Reference: https://github.com/ocornut/imgui/blob/master/imgui_demo.cpp)
 			static char textureTag[64];
-			strncpy_s(textureTag, mesh.textureTag.c_str(), sizeof(textureTag) - 1);
+			strncpy_s(textureTag, GetInternedString(store.GetTextureTag(curMeshIndex)).c_str(), sizeof(textureTag) - 1);
 			textureTag[sizeof(textureTag) - 1] = '\0';
 
 			if (ImGui::InputText("Texture##", textureTag, sizeof(textureTag)))
 			{
-				mesh.textureTag = std::string(textureTag);
+				StringID textureID = InternString(textureTag);
+				store.SetTexture(curMeshIndex, textureID, g_SceneManager->FindTextureSlot(textureID));
 			}*/
 
 			// UV Scale Controls
 			ImGui::Text("UV Scale");
-			ImGui::DragFloat2("UV Scale##", &mesh.uvScale.x, 0.1f, 0.1f, 10.0f);
+			ImGui::DragFloat2("UV Scale##", &store.UVScale(curMeshIndex).x, 0.1f, 0.1f, 10.0f);
 
 			// Shader Color Controls
 			ImGui::Text("Shader Color");
-			ImGui::ColorEdit4("Shader Color##", &mesh.shaderColor.r);
+			ImGui::ColorEdit4("Shader Color##", &store.Color(curMeshIndex).r);
 			
 		}
 
@@ -399,8 +446,8 @@ void DrawImGui()
 		// Delete Mesh
 		if (ImGui::Button("Delete Mesh"))
 		{
-			g_SceneManager->RemoveMesh(curMeshIndex);
-			curMeshIndex = std::max(0, curMeshIndex - 1);
+			g_SceneManager->RemoveMesh(curMeshHandle);
+			curMeshHandle = SceneStore::INVALID_HANDLE;
 		}
 	}
 
@@ -417,11 +464,176 @@ void DrawImGui()
 		}
 	}
 
+	if (ImGui::CollapsingHeader("Renderer Stats"))
+	{
+		// GL state changes of the last frame, sent to GL and skipped
+		const char* callNames[STATE_CALL_COUNT] = { "Program", "Vertex Array", "Texture", "Uniform" };
+		const GL_STATE_COUNTERS& counters = g_ShaderManager->GetStateCache()->GetLastFrameCounters();
+		for (int i = 0; i < STATE_CALL_COUNT; i++)
+		{
+			ImGui::Text("%s: %u issued, %u elided", callNames[i], counters.issued[i], counters.elided[i]);
+		}
+		ImGui::Text("Shader Variants: %d", (int)g_ShaderManager->GetVariantCount());
+
+		// state changes between consecutive draws of the render queue
+		const char* changeNames[RenderQueue::STATE_CHANGE_COUNT] = { "Variant", "Material", "Texture", "Mesh" };
+		const RenderQueue::RENDER_QUEUE_STATS& queueStats = g_SceneManager->GetRenderQueueStats();
+		ImGui::Text("Queued Draws: %u", queueStats.draws);
+		ImGui::Text("Draw Calls: %u (%u commands)", g_SceneManager->GetDrawCallCount(),
+			g_SceneManager->GetDrawCommandCount());
+		ImGui::Text("Transforms Recomposed: %u", g_SceneManager->GetTransformUpdateCount());
+		ImGui::Text("Culling: %u tested, %u culled", g_SceneManager->GetCullTestedCount(),
+			g_SceneManager->GetCulledCount());
+		bool bOcclusionCulling = g_SceneManager->GetOcclusionCulling();
+		if (ImGui::Checkbox("Occlusion Culling", &bOcclusionCulling))
+		{
+			g_SceneManager->SetOcclusionCulling(bOcclusionCulling);
+		}
+		ImGui::Text("Occlusion: %u occluded, %u occluder triangles, %.1f us", g_SceneManager->GetOccludedCount(),
+			g_SceneManager->GetOccluderTriangleCount(), g_SceneManager->GetOcclusionMicroseconds());
+		bool bLodSelection = g_SceneManager->GetLodSelection();
+		if (ImGui::Checkbox("Levels of Detail", &bLodSelection))
+		{
+			g_SceneManager->SetLodSelection(bLodSelection);
+		}
+		ImGui::Text("Triangles: %u before LOD, %u after LOD", g_SceneManager->GetFullTriangleCount(),
+			g_SceneManager->GetLodTriangleCount());
+		ImGui::Text("Baked: %u static objects into %u batches%s", g_SceneManager->GetBakedObjectCount(),
+			g_SceneManager->GetBakedBatchCount(), g_SceneManager->WasBakeCached() ? " (cached)" : "");
+		if (g_SceneManager->IsGpuCullingSupported())
+		{
+			bool bGpuCulling = g_SceneManager->GetGpuCulling();
+			if (ImGui::Checkbox("GPU Culling", &bGpuCulling))
+			{
+				g_SceneManager->SetGpuCulling(bGpuCulling);
+			}
+			if (bGpuCulling)
+			{
+				ImGui::Text("    GPU counts %u frames behind", g_SceneManager->GetGpuCullStatsLatency());
+			}
+			// compare the culling of the last frame with the CPU
+			static SceneManager::GPU_CULL_CHECK gpuCullCheck = {};
+			static bool bGpuCullChecked = false;
+			if (bGpuCulling && ImGui::Button("Check GPU Culling"))
+			{
+				bGpuCullChecked = g_SceneManager->CheckGpuCulling(gpuCullCheck);
+			}
+			if (bGpuCullChecked)
+			{
+				ImGui::Text("GPU Check: %u objects, %u / %u visible, %u + %u + %u mismatches", gpuCullCheck.itemCount,
+					gpuCullCheck.gpuVisibleCount, gpuCullCheck.cpuVisibleCount, gpuCullCheck.visibilityMismatches,
+					gpuCullCheck.occlusionMismatches, gpuCullCheck.lodMismatches);
+			}
+		}
+		else
+		{
+			ImGui::Text("GPU Culling: not supported");
+		}
+		bool bDeferredShading = g_SceneManager->GetDeferredShading();
+		if (ImGui::Checkbox("Deferred Shading", &bDeferredShading))
+		{
+			g_SceneManager->SetDeferredShading(bDeferredShading);
+		}
+		ImGui::Text("Scene GPU Time: %.2f ms (%s)", g_SceneManager->GetSceneGpuMilliseconds(),
+			bDeferredShading ? "deferred" : "forward");
+		ImGui::Text("Last Pick: %.1f us", g_SceneManager->GetLastPickMicroseconds());
+		const SpatialHash& spatialHash = g_SceneManager->GetSpatialHash();
+		ImGui::Text("Spatial Hash: %u objects in %u cells, %u oversized", (unsigned int)spatialHash.Size(),
+			(unsigned int)spatialHash.GetCellCount(), (unsigned int)spatialHash.GetOversizedCount());
+		ImGui::Text("    %u moved, %u changed cells at the last query", g_SceneManager->GetSpatialUpdateCount(),
+			g_SceneManager->GetSpatialCellChangeCount());
+		int testLightCount = g_SceneManager->GetTestPointLightCount();
+		if (ImGui::SliderInt("Test Point Lights", &testLightCount, 0, 1024))
+		{
+			g_SceneManager->SetTestPointLightCount(testLightCount);
+		}
+		ImGui::Text("Point Lights: %u, %u cluster references, at most %u per cluster, %.1f us",
+			(unsigned int)g_SceneManager->GetPointLightCount(), (unsigned int)g_SceneManager->GetClusterLightIndexCount(),
+			(unsigned int)g_SceneManager->GetMaxClusterLightCount(), g_SceneManager->GetLightClusterMicroseconds());
+		for (int i = 0; i < RenderQueue::STATE_CHANGE_COUNT; i++)
+		{
+			ImGui::Text("%s changes: %u unsorted, %u sorted", changeNames[i], queueStats.unsorted[i], queueStats.sorted[i]);
+		}
+
+		// per-frame traversal cost of the scene layouts
+		static std::vector<SCENE_STORE_BENCHMARK_RESULT> benchmarkResults;
+		if (ImGui::Button("Run Scene Store Benchmark"))
+		{
+			benchmarkResults = RunSceneStoreBenchmark();
+		}
+		for (size_t i = 0; i < benchmarkResults.size(); i++)
+		{
+			ImGui::Text("%u objects: %.1f us structs, %.1f us store", (unsigned int)benchmarkResults[i].objectCount,
+				benchmarkResults[i].legacyMicroseconds, benchmarkResults[i].storeMicroseconds);
+			ImGui::Text("    remove + add: %.3f us structs, %.3f us store",
+				benchmarkResults[i].legacyChurnMicroseconds, benchmarkResults[i].storeChurnMicroseconds);
+			ImGui::Text("    remove + add group of 4: %.3f us store", benchmarkResults[i].hierarchyChurnMicroseconds);
+		}
+
+		// per-frame cost of the world matrices
+		static std::vector<TRANSFORM_BENCHMARK_RESULT> transformResults;
+		if (ImGui::Button("Run Transform Benchmark"))
+		{
+			transformResults = RunTransformBenchmark();
+		}
+		for (size_t i = 0; i < transformResults.size(); i++)
+		{
+			ImGui::Text("%u objects: %.1f us per draw, %.1f us batched, %.1f us cached", (unsigned int)transformResults[i].objectCount,
+				transformResults[i].perDrawMicroseconds, transformResults[i].batchedMicroseconds, transformResults[i].cachedMicroseconds);
+		}
+
+		// per-frame cost of moving every object in the spatial hash
+		static std::vector<SPATIAL_HASH_BENCHMARK_RESULT> spatialResults;
+		if (ImGui::Button("Run Spatial Hash Benchmark"))
+		{
+			spatialResults = RunSpatialHashBenchmark();
+		}
+		for (size_t i = 0; i < spatialResults.size(); i++)
+		{
+			ImGui::Text("%u objects: %.1f us moving all, %.0f cell changes", (unsigned int)spatialResults[i].objectCount,
+				spatialResults[i].updateMicroseconds, spatialResults[i].cellChanges);
+			ImGui::Text("    box query: %.1f us grid, %.1f us all; frustum: %.1f us grid, %.1f us all; ray: %.1f us",
+				spatialResults[i].boxQueryMicroseconds, spatialResults[i].linearQueryMicroseconds,
+				spatialResults[i].frustumQueryMicroseconds, spatialResults[i].linearFrustumMicroseconds,
+				spatialResults[i].rayMicroseconds);
+			ImGui::Text("    %u box, %u frustum and %u ray queries differ", (unsigned int)spatialResults[i].boxMismatches,
+				(unsigned int)spatialResults[i].frustumMismatches, (unsigned int)spatialResults[i].rayMismatches);
+		}
+
+		// cost of one pick through the tree against every triangle
+		static std::vector<PICK_BENCHMARK_RESULT> pickResults;
+		if (ImGui::Button("Run Pick Benchmark"))
+		{
+			pickResults = RunPickBenchmark();
+		}
+		for (size_t i = 0; i < pickResults.size(); i++)
+		{
+			ImGui::Text("%u triangles: %.1f us tree, %.0f us every triangle, %u differ", (unsigned int)pickResults[i].triangleCount,
+				pickResults[i].treeMicroseconds, pickResults[i].linearMicroseconds, (unsigned int)pickResults[i].mismatchCount);
+		}
+
+		// occluder rasterization per thread count, checked against
+		// the scalar kernel
+		static std::vector<OCCLUSION_BENCHMARK_RESULT> occlusionResults;
+		if (ImGui::Button("Run Occlusion Benchmark"))
+		{
+			occlusionResults = RunOcclusionBenchmark();
+		}
+		for (size_t i = 0; i < occlusionResults.size(); i++)
+		{
+			ImGui::Text("%u triangles, %d threads: %.1f us (%.1f us scalar), %u texels differ",
+				(unsigned int)occlusionResults[i].triangleCount, occlusionResults[i].threadCount,
+				occlusionResults[i].renderMicroseconds, occlusionResults[i].scalarMicroseconds,
+				(unsigned int)occlusionResults[i].mismatchCount);
+		}
+	}
+
 	// Camera Control Instructions
 	ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "Camera Controls");
 	ImGui::Text("W/A/S/D - Move");
 	ImGui::Text("Q/E - Down/Up");
 	ImGui::Text("RMB - Look Around");
+	ImGui::Text("LMB - Select Mesh");
 	ImGui::Text("Scroll Wheel - Increase/Decrease Flight Speed");
 	ImGui::Text("O - Orthographic");
 	ImGui::Text("P - Perspective");
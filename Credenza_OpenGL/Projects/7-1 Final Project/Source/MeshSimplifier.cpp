@@ -0,0 +1,467 @@
+///////////////////////////////////////////////////////////////////////////////
+// MeshSimplifier.cpp
+// ============
+// reduce the triangle count of an indexed mesh with quadric error metric
+// edge collapses, giving coarser levels of detail over the same vertices
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+
+namespace
+{
+	// candidate collapse of one welded vertex onto another
+	struct COLLAPSE
+	{
+		float cost;
+		uint32_t from;
+		uint32_t to;
+	};
+
+	// triangles whose normal turns further than this cosine
+	// count as flipped over
+	const float g_MinNormalCosine = 0.25f;
+
+	/***********************************************************
+	 *  AddPlane()
+	 *
+	 *  This function is used for adding a weighted plane to a
+	 *  quadric.
+	 ***********************************************************/
+	void AddPlane(double* q, const glm::dvec4& plane, double weight)
+	{
+		q[0] += weight * plane.x * plane.x;
+		q[1] += weight * plane.x * plane.y;
+		q[2] += weight * plane.x * plane.z;
+		q[3] += weight * plane.x * plane.w;
+		q[4] += weight * plane.y * plane.y;
+		q[5] += weight * plane.y * plane.z;
+		q[6] += weight * plane.y * plane.w;
+		q[7] += weight * plane.z * plane.z;
+		q[8] += weight * plane.z * plane.w;
+		q[9] += weight * plane.w * plane.w;
+	}
+
+	/***********************************************************
+	 *  EvaluateQuadrics()
+	 *
+	 *  This function is used for measuring the sum of two
+	 *  quadrics at a position.
+	 ***********************************************************/
+	double EvaluateQuadrics(const double* a, const double* b, const glm::vec3& position)
+	{
+		double q[10];
+		for (int i = 0; i < 10; i++)
+		{
+			q[i] = a[i] + b[i];
+		}
+
+		double x = position.x;
+		double y = position.y;
+		double z = position.z;
+		return(q[0] * x * x + 2.0 * q[1] * x * y + 2.0 * q[2] * x * z + 2.0 * q[3] * x
+			+ q[4] * y * y + 2.0 * q[5] * y * z + 2.0 * q[6] * y
+			+ q[7] * z * z + 2.0 * q[8] * z
+			+ q[9]);
+	}
+
+	/***********************************************************
+	 *  LessPosition()
+	 *
+	 *  This function is used for ordering positions one axis
+	 *  after another, so equal positions end up next to each
+	 *  other when sorted.
+	 ***********************************************************/
+	bool LessPosition(const glm::vec3& a, const glm::vec3& b)
+	{
+		if (a.x != b.x)
+		{
+			return(a.x < b.x);
+		}
+		if (a.y != b.y)
+		{
+			return(a.y < b.y);
+		}
+		return(a.z < b.z);
+	}
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method is used for loading a mesh to simplify.  It
+ *  welds the vertices by position, drops triangles that
+ *  are already degenerate, sums the quadric of every
+ *  welded vertex from the planes of its triangles weighted
+ *  by their area, and locks the vertices on edges that are
+ *  not shared by exactly two triangles.
+ ***********************************************************/
+void MeshSimplifier::Load(const float* vertices, size_t vertexCount, size_t floatsPerVertex,
+	const uint32_t* indices, size_t indexCount)
+{
+	m_positions.resize(vertexCount);
+	m_normals.resize(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		const float* vertex = vertices + i * floatsPerVertex;
+		m_positions[i] = glm::vec3(vertex[0], vertex[1], vertex[2]);
+		m_normals[i] = glm::vec3(vertex[3], vertex[4], vertex[5]);
+	}
+	m_sourceIndices.assign(indices, indices + (indexCount / 3) * 3);
+
+	// weld the vertices by sorting them by position
+	std::vector<uint32_t> order(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		order[i] = (uint32_t)i;
+	}
+	std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b)
+		{
+			if (LessPosition(m_positions[a], m_positions[b]))
+			{
+				return(true);
+			}
+			if (LessPosition(m_positions[b], m_positions[a]))
+			{
+				return(false);
+			}
+			return(a < b);
+		});
+
+	m_welded.resize(vertexCount);
+	m_weldedPositions.clear();
+	m_memberStarts.clear();
+	m_members = order;
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		if (i == 0 || m_positions[order[i]] != m_positions[order[i - 1]])
+		{
+			m_memberStarts.push_back((uint32_t)i);
+			m_weldedPositions.push_back(m_positions[order[i]]);
+		}
+		m_welded[order[i]] = (uint32_t)(m_weldedPositions.size() - 1);
+	}
+	m_memberStarts.push_back((uint32_t)vertexCount);
+
+	size_t weldedCount = m_weldedPositions.size();
+	m_collapsedTo.resize(weldedCount);
+	for (size_t i = 0; i < weldedCount; i++)
+	{
+		m_collapsedTo[i] = (uint32_t)i;
+	}
+
+	// build the triangles and the quadrics of their corners
+	QUADRIC zero;
+	memset(&zero, 0, sizeof(zero));
+	m_quadrics.assign(weldedCount, zero);
+	m_triangles.clear();
+	m_triangles.reserve(m_sourceIndices.size() / 3);
+	for (size_t i = 0; i + 2 < m_sourceIndices.size(); i += 3)
+	{
+		TRIANGLE triangle;
+		for (int c = 0; c < 3; c++)
+		{
+			triangle.corners[c] = m_welded[m_sourceIndices[i + c]];
+		}
+		triangle.source = (uint32_t)(i / 3);
+		if (triangle.corners[0] == triangle.corners[1] ||
+			triangle.corners[1] == triangle.corners[2] ||
+			triangle.corners[2] == triangle.corners[0])
+		{
+			continue;
+		}
+		m_triangles.push_back(triangle);
+
+		glm::dvec3 p0(m_weldedPositions[triangle.corners[0]]);
+		glm::dvec3 p1(m_weldedPositions[triangle.corners[1]]);
+		glm::dvec3 p2(m_weldedPositions[triangle.corners[2]]);
+		glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+		double length = glm::length(normal);
+		if (length <= 0.0)
+		{
+			continue;
+		}
+		normal /= length;
+		glm::dvec4 plane(normal, -glm::dot(normal, p0));
+		for (int c = 0; c < 3; c++)
+		{
+			AddPlane(m_quadrics[triangle.corners[c]].a, plane, length * 0.5);
+		}
+	}
+
+	// lock the ends of every edge that is open or shared by
+	// more than two triangles
+	std::vector<uint64_t> edges;
+	edges.reserve(m_triangles.size() * 3);
+	for (size_t i = 0; i < m_triangles.size(); i++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			uint32_t a = m_triangles[i].corners[c];
+			uint32_t b = m_triangles[i].corners[(c + 1) % 3];
+			edges.push_back(((uint64_t)std::min(a, b) << 32) | std::max(a, b));
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+
+	m_locked.assign(weldedCount, 0);
+	for (size_t i = 0; i < edges.size();)
+	{
+		size_t end = i + 1;
+		while (end < edges.size() && edges[end] == edges[i])
+		{
+			end++;
+		}
+		if (end - i != 2)
+		{
+			m_locked[(uint32_t)(edges[i] >> 32)] = 1;
+			m_locked[(uint32_t)edges[i]] = 1;
+		}
+		i = end;
+	}
+}
+
+/***********************************************************
+ *  FindRoot()
+ *
+ *  This method is used for following the collapses of a
+ *  welded vertex to the vertex it ended on, shortening the
+ *  path on the way.
+ ***********************************************************/
+uint32_t MeshSimplifier::FindRoot(uint32_t vertex)
+{
+	uint32_t root = vertex;
+	while (m_collapsedTo[root] != root)
+	{
+		root = m_collapsedTo[root];
+	}
+	while (m_collapsedTo[vertex] != root)
+	{
+		uint32_t next = m_collapsedTo[vertex];
+		m_collapsedTo[vertex] = root;
+		vertex = next;
+	}
+	return(root);
+}
+
+/***********************************************************
+ *  FlipsTriangles()
+ *
+ *  This method is used for checking whether moving a
+ *  vertex onto another turns the normal of one of the
+ *  triangles around it too far or makes it degenerate.
+ *  Triangles that share the collapsed edge disappear and
+ *  are skipped.
+ ***********************************************************/
+bool MeshSimplifier::FlipsTriangles(uint32_t from, uint32_t to) const
+{
+	for (uint32_t i = m_adjacencyStarts[from]; i < m_adjacencyStarts[from + 1]; i++)
+	{
+		const TRIANGLE& triangle = m_triangles[m_adjacency[i]];
+		if (triangle.corners[0] == to || triangle.corners[1] == to || triangle.corners[2] == to)
+		{
+			continue;
+		}
+
+		glm::vec3 before[3];
+		glm::vec3 after[3];
+		for (int c = 0; c < 3; c++)
+		{
+			before[c] = m_weldedPositions[triangle.corners[c]];
+			after[c] = (triangle.corners[c] == from) ? m_weldedPositions[to] : before[c];
+		}
+
+		glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+		glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+		float lengths = glm::length(normalBefore) * glm::length(normalAfter);
+		if (lengths <= 0.0f || glm::dot(normalBefore, normalAfter) < g_MinNormalCosine * lengths)
+		{
+			return(true);
+		}
+	}
+	return(false);
+}
+
+/***********************************************************
+ *  Simplify()
+ *
+ *  This method is used for collapsing edges until no more
+ *  than the target number of triangles remain.  Every pass
+ *  rebuilds the triangles around each vertex, costs every
+ *  edge in its cheaper direction, and collapses the edges
+ *  from the cheapest up.  An edge is skipped when one of
+ *  its ends was touched earlier in the pass, so the costs
+ *  and flip checks of a pass always see current triangles.
+ *  A pass stops once enough triangles would be gone, as
+ *  every collapse removes about two of them.
+ ***********************************************************/
+bool MeshSimplifier::Simplify(size_t targetTriangleCount)
+{
+	size_t weldedCount = m_weldedPositions.size();
+	std::vector<COLLAPSE> collapses;
+	std::vector<uint8_t> touched;
+
+	while (m_triangles.size() > targetTriangleCount)
+	{
+		// triangles around every vertex
+		m_adjacencyStarts.assign(weldedCount + 1, 0);
+		for (size_t i = 0; i < m_triangles.size(); i++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				m_adjacencyStarts[m_triangles[i].corners[c] + 1]++;
+			}
+		}
+		for (size_t i = 0; i < weldedCount; i++)
+		{
+			m_adjacencyStarts[i + 1] += m_adjacencyStarts[i];
+		}
+		m_adjacency.resize(m_triangles.size() * 3);
+		std::vector<uint32_t> fill(m_adjacencyStarts.begin(), m_adjacencyStarts.end() - 1);
+		for (size_t i = 0; i < m_triangles.size(); i++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				m_adjacency[fill[m_triangles[i].corners[c]]++] = (uint32_t)i;
+			}
+		}
+
+		// cost every edge once, an edge shared by two triangles
+		// runs from the lower vertex in one of them
+		collapses.clear();
+		for (size_t i = 0; i < m_triangles.size(); i++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				uint32_t a = m_triangles[i].corners[c];
+				uint32_t b = m_triangles[i].corners[(c + 1) % 3];
+				if (a > b || (m_locked[a] && m_locked[b]))
+				{
+					continue;
+				}
+
+				COLLAPSE collapse;
+				double costToB = m_locked[a] ? DBL_MAX : EvaluateQuadrics(m_quadrics[a].a, m_quadrics[b].a, m_weldedPositions[b]);
+				double costToA = m_locked[b] ? DBL_MAX : EvaluateQuadrics(m_quadrics[a].a, m_quadrics[b].a, m_weldedPositions[a]);
+				if (costToB <= costToA)
+				{
+					collapse.cost = (float)costToB;
+					collapse.from = a;
+					collapse.to = b;
+				}
+				else
+				{
+					collapse.cost = (float)costToA;
+					collapse.from = b;
+					collapse.to = a;
+				}
+				collapses.push_back(collapse);
+			}
+		}
+		if (collapses.empty())
+		{
+			return(false);
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const COLLAPSE& a, const COLLAPSE& b)
+			{
+				return(a.cost < b.cost);
+			});
+
+		// collapse from the cheapest edge up
+		touched.assign(weldedCount, 0);
+		size_t excess = m_triangles.size() - targetTriangleCount;
+		size_t removed = 0;
+		for (size_t i = 0; i < collapses.size() && removed < excess; i++)
+		{
+			uint32_t from = collapses[i].from;
+			uint32_t to = collapses[i].to;
+			if (touched[from] || touched[to] || FlipsTriangles(from, to))
+			{
+				continue;
+			}
+
+			m_collapsedTo[from] = to;
+			for (int q = 0; q < 10; q++)
+			{
+				m_quadrics[to].a[q] += m_quadrics[from].a[q];
+			}
+			for (uint32_t t = m_adjacencyStarts[from]; t < m_adjacencyStarts[from + 1]; t++)
+			{
+				const TRIANGLE& triangle = m_triangles[m_adjacency[t]];
+				touched[triangle.corners[0]] = 1;
+				touched[triangle.corners[1]] = 1;
+				touched[triangle.corners[2]] = 1;
+			}
+			removed += 2;
+		}
+		if (removed == 0)
+		{
+			return(false);
+		}
+
+		// move the corners onto the vertices they collapsed
+		// to and drop the triangles that became degenerate
+		size_t kept = 0;
+		for (size_t i = 0; i < m_triangles.size(); i++)
+		{
+			TRIANGLE triangle = m_triangles[i];
+			for (int c = 0; c < 3; c++)
+			{
+				triangle.corners[c] = FindRoot(triangle.corners[c]);
+			}
+			if (triangle.corners[0] == triangle.corners[1] ||
+				triangle.corners[1] == triangle.corners[2] ||
+				triangle.corners[2] == triangle.corners[0])
+			{
+				continue;
+			}
+			m_triangles[kept++] = triangle;
+		}
+		m_triangles.resize(kept);
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  GetIndices()
+ *
+ *  This method is used for writing the remaining triangles
+ *  as indices into the loaded vertices.  A corner whose
+ *  welded vertex is unchanged keeps its own vertex, so UVs
+ *  and hard normals stay as they were.  A corner that was
+ *  collapsed takes the vertex welded at its new position
+ *  whose normal is closest to the one it had.
+ ***********************************************************/
+void MeshSimplifier::GetIndices(std::vector<uint32_t>& indices) const
+{
+	indices.resize(m_triangles.size() * 3);
+	for (size_t i = 0; i < m_triangles.size(); i++)
+	{
+		const TRIANGLE& triangle = m_triangles[i];
+		for (int c = 0; c < 3; c++)
+		{
+			uint32_t original = m_sourceIndices[triangle.source * 3 + c];
+			uint32_t welded = triangle.corners[c];
+			if (m_welded[original] != welded)
+			{
+				float best = -FLT_MAX;
+				uint32_t chosen = m_members[m_memberStarts[welded]];
+				for (uint32_t m = m_memberStarts[welded]; m < m_memberStarts[welded + 1]; m++)
+				{
+					float cosine = glm::dot(m_normals[m_members[m]], m_normals[original]);
+					if (cosine > best)
+					{
+						best = cosine;
+						chosen = m_members[m];
+					}
+				}
+				original = chosen;
+			}
+			indices[i * 3 + c] = original;
+		}
+	}
+}
@@ -0,0 +1,103 @@
+///////////////////////////////////////////////////////////////////////////////
+// MeshSimplifier.h
+// ============
+// reduce the triangle count of an indexed mesh with quadric error metric
+// edge collapses, giving coarser levels of detail over the same vertices
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  MeshSimplifier
+ *
+ *  This class contains a mesh being simplified.  Vertices
+ *  at the same position are welded first, so the seams of
+ *  the vertex layout do not stop edges from collapsing.
+ *  Every welded vertex keeps the quadric of the planes of
+ *  the triangles around it, and collapsing an edge moves
+ *  one end onto the other, the cost being the summed
+ *  quadric measured at the kept position.
+ *
+ *  Collapses run in passes: the cheapest edges are taken
+ *  first, each only when the vertices around it were not
+ *  touched earlier in the pass and no triangle flips over.
+ *  Vertices on open borders never move, so holes keep
+ *  their outline.  No vertex is ever created or moved, so
+ *  every level can be drawn from the vertices of the full
+ *  mesh with its own index list.
+ *
+ *  Simplify() continues from the current state, so calling
+ *  it with falling targets gives a chain of levels.
+ ***********************************************************/
+class MeshSimplifier
+{
+public:
+	// load a mesh, the position is the first three floats and
+	// the normal the next three of every vertex
+	void Load(const float* vertices, size_t vertexCount, size_t floatsPerVertex,
+		const uint32_t* indices, size_t indexCount);
+
+	// collapse edges until at most the target number of triangles
+	// remain, returns false when no more edges can collapse
+	bool Simplify(size_t targetTriangleCount);
+
+	// remaining triangles
+	inline size_t GetTriangleCount() const { return m_triangles.size(); }
+	// indices of the remaining triangles into the vertices of the
+	// loaded mesh
+	void GetIndices(std::vector<uint32_t>& indices) const;
+
+private:
+	// sum of squared plane distances, as the upper half of the
+	// symmetric 4x4 matrix
+	struct QUADRIC
+	{
+		double a[10];
+	};
+
+	// remaining triangle, with the welded vertices of its corners
+	// and the triangle of the loaded mesh it came from
+	struct TRIANGLE
+	{
+		uint32_t corners[3];
+		uint32_t source;
+	};
+
+	// follow the collapses of a welded vertex to the one it
+	// ended on
+	uint32_t FindRoot(uint32_t vertex);
+	// check whether moving a vertex onto another flips one of
+	// the triangles around it over
+	bool FlipsTriangles(uint32_t from, uint32_t to) const;
+
+	// positions and normals of the loaded vertices
+	std::vector<glm::vec3> m_positions;
+	std::vector<glm::vec3> m_normals;
+	// original indices, three per source triangle
+	std::vector<uint32_t> m_sourceIndices;
+
+	// welded vertex of every loaded vertex, the position of
+	// every welded vertex and the loaded vertices welded into it
+	std::vector<uint32_t> m_welded;
+	std::vector<glm::vec3> m_weldedPositions;
+	std::vector<uint32_t> m_memberStarts;
+	std::vector<uint32_t> m_members;
+	// welded vertex each one collapsed onto, itself while it remains
+	std::vector<uint32_t> m_collapsedTo;
+	// quadric of every welded vertex
+	std::vector<QUADRIC> m_quadrics;
+	// set for welded vertices on an open border
+	std::vector<uint8_t> m_locked;
+
+	std::vector<TRIANGLE> m_triangles;
+	// triangles around every welded vertex, rebuilt every pass
+	std::vector<uint32_t> m_adjacencyStarts;
+	std::vector<uint32_t> m_adjacency;
+};
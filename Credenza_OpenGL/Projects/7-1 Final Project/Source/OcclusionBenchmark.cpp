@@ -0,0 +1,151 @@
+///////////////////////////////////////////////////////////////////////////////
+// OcclusionBenchmark.cpp
+// ============
+// time the occluder rasterization for several thread counts and check that
+// every thread count and the SSE2 kernel give the depths of the scalar one
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "OcclusionBenchmark.h"
+#include "OcclusionCulling.h"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+// declaration of global variables
+namespace
+{
+	const size_t g_TriangleCounts[] = { 64, 1024, 16384 };
+	// number of timed renders, about the same total work per count
+	const int g_RenderCounts[] = { 2000, 500, 50 };
+	const int g_ThreadCounts[] = { 1, 2, 4, 8 };
+	// view depths the occluders are spread over
+	const float g_NearestOccluder = 3.0f;
+	const float g_FarthestOccluder = 60.0f;
+
+	/***********************************************************
+	 *  CountMismatches()
+	 *
+	 *  This function is used for counting the texels of the
+	 *  culler's depth buffer that differ from a reference.
+	 ***********************************************************/
+	size_t CountMismatches(const OcclusionCuller& culler, const std::vector<float>& reference)
+	{
+		size_t mismatchCount = 0;
+		for (int y = 0; y < OcclusionCuller::BUFFER_HEIGHT; y++)
+		{
+			for (int x = 0; x < OcclusionCuller::BUFFER_WIDTH; x++)
+			{
+				if (culler.GetDepth(0, x, y) != reference[y * OcclusionCuller::BUFFER_WIDTH + x])
+				{
+					mismatchCount++;
+				}
+			}
+		}
+		return(mismatchCount);
+	}
+}
+
+/***********************************************************
+ *  RunOcclusionBenchmark()
+ *
+ *  This function is used for timing OcclusionCuller::Render()
+ *  over random occluder triangles spread through the view,
+ *  with each thread count in turn.  The screen triangles of
+ *  the render are also rasterized on the calling thread by
+ *  the scalar kernel, and every depth buffer texel of every
+ *  thread count is compared with that reference, which
+ *  checks the bands and the SSE2 kernel together.
+ ***********************************************************/
+std::vector<OCCLUSION_BENCHMARK_RESULT> RunOcclusionBenchmark()
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	std::vector<OCCLUSION_BENCHMARK_RESULT> results;
+	std::mt19937 random(23);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> depth(g_NearestOccluder, g_FarthestOccluder);
+
+	float aspect = (float)OcclusionCuller::BUFFER_WIDTH / OcclusionCuller::BUFFER_HEIGHT;
+	float halfHeight = std::tan(glm::radians(30.0f));
+	glm::mat4 viewProjection = glm::perspective(glm::radians(60.0f), aspect, 0.1f, 100.0f);
+	float checksum = 0.0f;
+
+	for (int run = 0; run < 3; run++)
+	{
+		size_t count = g_TriangleCounts[run];
+		int renders = g_RenderCounts[run];
+
+		// triangles about a tenth of the view across, at any depth
+		std::vector<glm::vec3> positions(count * 3);
+		std::vector<uint32_t> indices(count * 3);
+		for (size_t i = 0; i < count; i++)
+		{
+			float distance = depth(random);
+			glm::vec3 center(unit(random) * halfHeight * aspect * distance,
+				unit(random) * halfHeight * distance, -distance);
+			float size = distance * 0.1f;
+			for (int corner = 0; corner < 3; corner++)
+			{
+				positions[i * 3 + corner] = center +
+					glm::vec3(unit(random) * size, unit(random) * size, unit(random) * size * 0.1f);
+				indices[i * 3 + corner] = (uint32_t)(i * 3 + corner);
+			}
+		}
+
+		OcclusionCuller culler;
+		culler.AddOccluder(positions.data(), indices.data(), indices.size(), glm::mat4(1.0f));
+
+		// scalar kernel on one thread over the triangles of a render
+		culler.SetThreadCount(1);
+		culler.Render(viewProjection);
+		const std::vector<SCREEN_TRIANGLE>& triangles = culler.GetScreenTriangles();
+		std::vector<float> reference((size_t)OcclusionCuller::BUFFER_WIDTH * OcclusionCuller::BUFFER_HEIGHT);
+		Clock::time_point scalarStart = Clock::now();
+		for (int render = 0; render < renders; render++)
+		{
+			std::fill(reference.begin(), reference.end(), 1.0f);
+			RasterizeDepthBandScalar(triangles.data(), triangles.size(), reference.data(),
+				OcclusionCuller::BUFFER_WIDTH, 0, OcclusionCuller::BUFFER_HEIGHT);
+		}
+		Clock::time_point scalarEnd = Clock::now();
+		checksum += reference[reference.size() / 2];
+
+		for (size_t t = 0; t < sizeof(g_ThreadCounts) / sizeof(g_ThreadCounts[0]); t++)
+		{
+			culler.SetThreadCount(g_ThreadCounts[t]);
+			// one untimed render to start the workers
+			culler.Render(viewProjection);
+
+			Clock::time_point start = Clock::now();
+			for (int render = 0; render < renders; render++)
+			{
+				culler.Render(viewProjection);
+			}
+			Clock::time_point end = Clock::now();
+			checksum += culler.GetDepth(0, OcclusionCuller::BUFFER_WIDTH / 2, OcclusionCuller::BUFFER_HEIGHT / 2);
+
+			OCCLUSION_BENCHMARK_RESULT result;
+			result.triangleCount = count;
+			result.threadCount = g_ThreadCounts[t];
+			result.renderMicroseconds = std::chrono::duration<double, std::micro>(end - start).count() / renders;
+			result.scalarMicroseconds = std::chrono::duration<double, std::micro>(scalarEnd - scalarStart).count() / renders;
+			result.mismatchCount = CountMismatches(culler, reference);
+			results.push_back(result);
+
+			std::cout << "Occluders, " << count << " triangles, " << result.threadCount << " threads: "
+				<< result.renderMicroseconds << " us/render ("
+				<< result.scalarMicroseconds << " us scalar raster), "
+				<< result.mismatchCount << " texels differ" << std::endl;
+		}
+	}
+
+	std::cout << "(checksum " << checksum << ")" << std::endl;
+
+	return(results);
+}
@@ -0,0 +1,28 @@
+///////////////////////////////////////////////////////////////////////////////
+// OcclusionBenchmark.h
+// ============
+// time the occluder rasterization for several thread counts and check that
+// every thread count and the SSE2 kernel give the depths of the scalar one
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+// average time of one occluder render for a given triangle and thread
+// count, and the number of depth buffer texels that differ from the
+// scalar kernel run on one thread
+struct OCCLUSION_BENCHMARK_RESULT
+{
+	size_t triangleCount;
+	int threadCount;
+	double renderMicroseconds;
+	double scalarMicroseconds;
+	size_t mismatchCount;
+};
+
+// run the renders for 64, 1k and 16k occluder triangles on 1, 2, 4
+// and 8 threads, print the results to the console and return them
+std::vector<OCCLUSION_BENCHMARK_RESULT> RunOcclusionBenchmark();
@@ -0,0 +1,573 @@
+///////////////////////////////////////////////////////////////////////////////
+// OcclusionCulling.cpp
+// ============
+// rasterize a few large occluders into a small depth buffer on the CPU and
+// test bounding boxes against its hierarchical depth, so objects hidden
+// behind the occluders are never queued
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "OcclusionCulling.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)) || defined(__SSE2__)
+#define OCCLUSION_CULLING_SSE2
+#include <emmintrin.h>
+#endif
+
+// declaration of global variables
+namespace
+{
+	// most threads used to rasterize
+	const int g_MaxThreads = 8;
+	// fewer triangles than this per thread are not worth
+	// starting another thread for
+	const size_t g_TrianglesPerThread = 16;
+	// clip space w below which a point counts as behind the eye
+	const float g_MinClipW = 1e-5f;
+
+	// edge functions of a triangle, the edge opposite to each
+	// corner as a * x + b * y + c, and the depth weights of
+	// the edge values
+	struct TRIANGLE_EDGES
+	{
+		float a[3];
+		float b[3];
+		float c[3];
+		float zWeights[3];
+	};
+
+	/***********************************************************
+	 *  SetupEdges()
+	 *
+	 *  This function is used for computing the edge functions
+	 *  of a triangle, shared by both rasterizer kernels so
+	 *  they evaluate the same values.
+	 ***********************************************************/
+	inline void SetupEdges(const SCREEN_TRIANGLE& triangle, TRIANGLE_EDGES& edges)
+	{
+		const float* x = triangle.x;
+		const float* y = triangle.y;
+		float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+		float inverseArea = 1.0f / area;
+
+		for (int edge = 0; edge < 3; edge++)
+		{
+			int from = (edge + 1) % 3;
+			int to = (edge + 2) % 3;
+			edges.a[edge] = y[from] - y[to];
+			edges.b[edge] = x[to] - x[from];
+			edges.c[edge] = x[from] * y[to] - x[to] * y[from];
+			edges.zWeights[edge] = triangle.z[edge] * inverseArea;
+		}
+	}
+}
+
+/***********************************************************
+ *  OcclusionCuller()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+OcclusionCuller::OcclusionCuller()
+{
+	m_viewProjection = glm::mat4(1.0f);
+	m_threadCount = 1;
+	m_workFrame = 0;
+	m_workBandCount = 0;
+	m_workPending = 0;
+	m_bStopWorkers = false;
+	SetThreadCount((int)std::thread::hardware_concurrency());
+
+	// every level halves the size of the one below, rounding
+	// up, down to a single texel
+	int width = BUFFER_WIDTH;
+	int height = BUFFER_HEIGHT;
+	while (true)
+	{
+		m_levels.push_back(std::vector<float>((size_t)width * height, 1.0f));
+		m_levelWidths.push_back(width);
+		m_levelHeights.push_back(height);
+		if ((width == 1) && (height == 1))
+		{
+			break;
+		}
+		width = std::max(1, (width + 1) / 2);
+		height = std::max(1, (height + 1) / 2);
+	}
+}
+
+/***********************************************************
+ *  ~OcclusionCuller()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+OcclusionCuller::~OcclusionCuller()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_workMutex);
+		m_bStopWorkers = true;
+	}
+	m_workReady.notify_all();
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		m_workers[i].join();
+	}
+}
+
+/***********************************************************
+ *  ClearOccluders()
+ *
+ *  This method is used for removing all occluders.
+ ***********************************************************/
+void OcclusionCuller::ClearOccluders()
+{
+	m_occluderPositions.clear();
+}
+
+/***********************************************************
+ *  AddOccluder()
+ *
+ *  This method is used for adding the triangles of an
+ *  occluder.  Occluders do not move, so their triangles
+ *  are kept in world space.
+ ***********************************************************/
+void OcclusionCuller::AddOccluder(const glm::vec3* positions, const uint32_t* indices, size_t indexCount,
+	const glm::mat4& world)
+{
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		for (int corner = 0; corner < 3; corner++)
+		{
+			m_occluderPositions.push_back(glm::vec3(world * glm::vec4(positions[indices[i + corner]], 1.0f)));
+		}
+	}
+}
+
+/***********************************************************
+ *  SetThreadCount()
+ *
+ *  This method is used for setting how many threads
+ *  rasterize the occluders.
+ ***********************************************************/
+void OcclusionCuller::SetThreadCount(int threadCount)
+{
+	m_threadCount = std::max(1, std::min(threadCount, g_MaxThreads));
+}
+
+/***********************************************************
+ *  Render()
+ *
+ *  This method is used for drawing the occluders into the
+ *  depth buffer.  The triangles are projected first, and
+ *  those that reach behind the near plane or off the
+ *  buffer are dropped - leaving out part of an occluder
+ *  can only keep more objects visible.  The rows of the
+ *  buffer are then split into one band per thread; the
+ *  waiting workers are woken for the bands after the
+ *  first, which the calling thread rasterizes itself.
+ ***********************************************************/
+size_t OcclusionCuller::Render(const glm::mat4& viewProjection)
+{
+	m_viewProjection = viewProjection;
+	m_triangles.clear();
+
+	for (size_t i = 0; i + 2 < m_occluderPositions.size(); i += 3)
+	{
+		SCREEN_TRIANGLE triangle;
+		bool bClipped = false;
+		for (int corner = 0; corner < 3; corner++)
+		{
+			glm::vec4 clip = viewProjection * glm::vec4(m_occluderPositions[i + corner], 1.0f);
+			if ((clip.w < g_MinClipW) || (clip.z < -clip.w))
+			{
+				bClipped = true;
+				break;
+			}
+			triangle.x[corner] = ((clip.x / clip.w) * 0.5f + 0.5f) * BUFFER_WIDTH;
+			triangle.y[corner] = ((clip.y / clip.w) * 0.5f + 0.5f) * BUFFER_HEIGHT;
+			triangle.z[corner] = (clip.z / clip.w) * 0.5f + 0.5f;
+		}
+		if (bClipped)
+		{
+			continue;
+		}
+
+		// occluders are drawn from both sides, so clockwise
+		// triangles are turned around
+		float area = (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0]) -
+			(triangle.x[2] - triangle.x[0]) * (triangle.y[1] - triangle.y[0]);
+		if (area == 0.0f)
+		{
+			continue;
+		}
+		if (area < 0.0f)
+		{
+			std::swap(triangle.x[1], triangle.x[2]);
+			std::swap(triangle.y[1], triangle.y[2]);
+			std::swap(triangle.z[1], triangle.z[2]);
+		}
+
+		float minX = std::min(triangle.x[0], std::min(triangle.x[1], triangle.x[2]));
+		float maxX = std::max(triangle.x[0], std::max(triangle.x[1], triangle.x[2]));
+		float minY = std::min(triangle.y[0], std::min(triangle.y[1], triangle.y[2]));
+		float maxY = std::max(triangle.y[0], std::max(triangle.y[1], triangle.y[2]));
+		if ((maxX < 0.0f) || (maxY < 0.0f) || (minX >= BUFFER_WIDTH) || (minY >= BUFFER_HEIGHT))
+		{
+			continue;
+		}
+		triangle.minX = std::max(0, (int)std::floor(minX));
+		triangle.maxX = std::min(BUFFER_WIDTH - 1, (int)std::floor(maxX));
+		triangle.minY = std::max(0, (int)std::floor(minY));
+		triangle.maxY = std::min(BUFFER_HEIGHT - 1, (int)std::floor(maxY));
+		m_triangles.push_back(triangle);
+	}
+
+	std::vector<float>& depth = m_levels[0];
+	std::fill(depth.begin(), depth.end(), 1.0f);
+
+	int threadCount = (int)std::min((size_t)m_threadCount, (m_triangles.size() / g_TrianglesPerThread) + 1);
+	const SCREEN_TRIANGLE* triangles = m_triangles.data();
+	size_t count = m_triangles.size();
+	if (threadCount <= 1)
+	{
+		RasterizeDepthBand(triangles, count, depth.data(), BUFFER_WIDTH, 0, BUFFER_HEIGHT);
+	}
+	else
+	{
+		StartWorkers(threadCount);
+		{
+			std::lock_guard<std::mutex> lock(m_workMutex);
+			m_workBandCount = threadCount;
+			m_workPending = (int)m_workers.size();
+			m_workFrame++;
+		}
+		m_workReady.notify_all();
+
+		int rowBegin = 0;
+		int rowEnd = 0;
+		GetBandRows(0, rowBegin, rowEnd);
+		RasterizeDepthBand(triangles, count, depth.data(), BUFFER_WIDTH, rowBegin, rowEnd);
+
+		std::unique_lock<std::mutex> lock(m_workMutex);
+		m_workDone.wait(lock, [this]() { return m_workPending == 0; });
+	}
+
+	BuildPyramid();
+
+	return(count);
+}
+
+/***********************************************************
+ *  StartWorkers()
+ *
+ *  This method is used for starting the worker threads the
+ *  passed in number of bands needs.  Workers are only ever
+ *  added, a frame with fewer bands leaves the extra ones
+ *  without work.
+ ***********************************************************/
+void OcclusionCuller::StartWorkers(int bandCount)
+{
+	while ((int)m_workers.size() < bandCount - 1)
+	{
+		int band = (int)m_workers.size() + 1;
+		m_workers.push_back(std::thread(&OcclusionCuller::RunWorker, this, band, m_workFrame));
+	}
+}
+
+/***********************************************************
+ *  RunWorker()
+ *
+ *  This method is used for the loop of a worker thread.  It
+ *  sleeps until a new frame is posted, rasterizes its band
+ *  when the frame has one, and reports back until the
+ *  culler is destroyed.
+ ***********************************************************/
+void OcclusionCuller::RunWorker(int band, uint32_t frame)
+{
+	std::unique_lock<std::mutex> lock(m_workMutex);
+	while (true)
+	{
+		m_workReady.wait(lock, [this, frame]() { return m_bStopWorkers || (m_workFrame != frame); });
+		if (m_bStopWorkers)
+		{
+			return;
+		}
+		frame = m_workFrame;
+		int bandCount = m_workBandCount;
+		lock.unlock();
+
+		if (band < bandCount)
+		{
+			int rowBegin = 0;
+			int rowEnd = 0;
+			GetBandRows(band, rowBegin, rowEnd);
+			RasterizeDepthBand(m_triangles.data(), m_triangles.size(), m_levels[0].data(),
+				BUFFER_WIDTH, rowBegin, rowEnd);
+		}
+
+		lock.lock();
+		if (--m_workPending == 0)
+		{
+			m_workDone.notify_one();
+		}
+	}
+}
+
+/***********************************************************
+ *  GetBandRows()
+ *
+ *  This method is used for getting the rows of a band of
+ *  the current frame, the buffer split evenly into as many
+ *  bands as the frame uses.
+ ***********************************************************/
+void OcclusionCuller::GetBandRows(int band, int& rowBegin, int& rowEnd) const
+{
+	int rowsPerBand = (BUFFER_HEIGHT + m_workBandCount - 1) / m_workBandCount;
+	rowBegin = std::min((int)BUFFER_HEIGHT, band * rowsPerBand);
+	rowEnd = std::min((int)BUFFER_HEIGHT, rowBegin + rowsPerBand);
+}
+
+/***********************************************************
+ *  BuildPyramid()
+ *
+ *  This method is used for building every level of the
+ *  depth pyramid from the one below, keeping the farthest
+ *  depth of each block of four texels.  Texels past the
+ *  edge of an odd sized level repeat the last row or
+ *  column.
+ ***********************************************************/
+void OcclusionCuller::BuildPyramid()
+{
+	for (size_t level = 1; level < m_levels.size(); level++)
+	{
+		const std::vector<float>& source = m_levels[level - 1];
+		int sourceWidth = m_levelWidths[level - 1];
+		int sourceHeight = m_levelHeights[level - 1];
+		std::vector<float>& target = m_levels[level];
+		int width = m_levelWidths[level];
+		int height = m_levelHeights[level];
+
+		for (int y = 0; y < height; y++)
+		{
+			int y0 = std::min(y * 2, sourceHeight - 1);
+			int y1 = std::min(y * 2 + 1, sourceHeight - 1);
+			for (int x = 0; x < width; x++)
+			{
+				int x0 = std::min(x * 2, sourceWidth - 1);
+				int x1 = std::min(x * 2 + 1, sourceWidth - 1);
+				target[y * width + x] = std::max(
+					std::max(source[y0 * sourceWidth + x0], source[y0 * sourceWidth + x1]),
+					std::max(source[y1 * sourceWidth + x0], source[y1 * sourceWidth + x1]));
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  IsVisible()
+ *
+ *  This method is used for testing a box against the
+ *  depth pyramid.  The corners of the box give its screen
+ *  rectangle and nearest depth, and the level where the
+ *  grown rectangle covers at most two texels each way is
+ *  read.  Boxes that reach behind the near plane are kept.
+ ***********************************************************/
+bool OcclusionCuller::IsVisible(const glm::vec3& boxMin, const glm::vec3& boxMax) const
+{
+	float minX = (float)BUFFER_WIDTH;
+	float maxX = 0.0f;
+	float minY = (float)BUFFER_HEIGHT;
+	float maxY = 0.0f;
+	float nearest = 1.0f;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		glm::vec3 position((corner & 1) ? boxMax.x : boxMin.x,
+			(corner & 2) ? boxMax.y : boxMin.y,
+			(corner & 4) ? boxMax.z : boxMin.z);
+		glm::vec4 clip = m_viewProjection * glm::vec4(position, 1.0f);
+		if ((clip.w < g_MinClipW) || (clip.z < -clip.w))
+		{
+			return(true);
+		}
+
+		float x = ((clip.x / clip.w) * 0.5f + 0.5f) * BUFFER_WIDTH;
+		float y = ((clip.y / clip.w) * 0.5f + 0.5f) * BUFFER_HEIGHT;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		nearest = std::min(nearest, (clip.z / clip.w) * 0.5f + 0.5f);
+	}
+
+	// boxes off the buffer are left to the frustum test
+	if ((maxX < 0.0f) || (maxY < 0.0f) || (minX >= BUFFER_WIDTH) || (minY >= BUFFER_HEIGHT))
+	{
+		return(true);
+	}
+
+	int x0 = std::max(0, (int)std::floor(minX) - 1);
+	int x1 = std::min(BUFFER_WIDTH - 1, (int)std::floor(maxX) + 1);
+	int y0 = std::max(0, (int)std::floor(minY) - 1);
+	int y1 = std::min(BUFFER_HEIGHT - 1, (int)std::floor(maxY) + 1);
+
+	int level = 0;
+	while ((level + 1 < (int)m_levels.size()) &&
+		(((x1 >> level) - (x0 >> level) > 1) || ((y1 >> level) - (y0 >> level) > 1)))
+	{
+		level++;
+	}
+
+	float farthest = 0.0f;
+	for (int y = (y0 >> level); y <= (y1 >> level); y++)
+	{
+		for (int x = (x0 >> level); x <= (x1 >> level); x++)
+		{
+			farthest = std::max(farthest, GetDepth(level, x, y));
+		}
+	}
+
+	return(nearest <= farthest);
+}
+
+/***********************************************************
+ *  RasterizeDepthBand()
+ *
+ *  This function is used for rasterizing triangles into a
+ *  band of rows.  With SSE2 four pixels of a row are tested
+ *  and written per iteration, starting at a multiple of
+ *  four; the pixels are the ones the scalar kernel visits
+ *  and get the same depths.
+ ***********************************************************/
+void RasterizeDepthBand(
+	const SCREEN_TRIANGLE* triangles,
+	size_t count,
+	float* depth,
+	int width,
+	int rowBegin,
+	int rowEnd)
+{
+#ifdef OCCLUSION_CULLING_SSE2
+	const __m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+	const __m128 zero = _mm_setzero_ps();
+
+	for (size_t t = 0; t < count; t++)
+	{
+		const SCREEN_TRIANGLE& triangle = triangles[t];
+		int minY = std::max(triangle.minY, rowBegin);
+		int maxY = std::min(triangle.maxY, rowEnd - 1);
+		if (minY > maxY)
+		{
+			continue;
+		}
+
+		TRIANGLE_EDGES edges;
+		SetupEdges(triangle, edges);
+		int minX = triangle.minX & ~3;
+		int maxX = triangle.maxX;
+
+		__m128 edgeA[3];
+		__m128 weight[3];
+		for (int edge = 0; edge < 3; edge++)
+		{
+			edgeA[edge] = _mm_set1_ps(edges.a[edge]);
+			weight[edge] = _mm_set1_ps(edges.zWeights[edge]);
+		}
+
+		for (int row = minY; row <= maxY; row++)
+		{
+			float centerY = row + 0.5f;
+			__m128 rowValue[3];
+			for (int edge = 0; edge < 3; edge++)
+			{
+				rowValue[edge] = _mm_set1_ps(edges.b[edge] * centerY + edges.c[edge]);
+			}
+
+			float* rowDepth = depth + (size_t)row * width;
+			for (int column = minX; column <= maxX; column += 4)
+			{
+				__m128 centerX = _mm_add_ps(_mm_set1_ps((float)column), laneOffsets);
+				__m128 e0 = _mm_add_ps(_mm_mul_ps(edgeA[0], centerX), rowValue[0]);
+				__m128 e1 = _mm_add_ps(_mm_mul_ps(edgeA[1], centerX), rowValue[1]);
+				__m128 e2 = _mm_add_ps(_mm_mul_ps(edgeA[2], centerX), rowValue[2]);
+				__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)),
+					_mm_cmpge_ps(e2, zero));
+				if (_mm_movemask_ps(inside) == 0)
+				{
+					continue;
+				}
+
+				__m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e0, weight[0]), _mm_mul_ps(e1, weight[1])),
+					_mm_mul_ps(e2, weight[2]));
+				__m128 current = _mm_loadu_ps(rowDepth + column);
+				__m128 nearer = _mm_min_ps(current, z);
+				_mm_storeu_ps(rowDepth + column,
+					_mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, current)));
+			}
+		}
+	}
+#else
+	RasterizeDepthBandScalar(triangles, count, depth, width, rowBegin, rowEnd);
+#endif
+}
+
+/***********************************************************
+ *  RasterizeDepthBandScalar()
+ *
+ *  This function is used for rasterizing triangles into a
+ *  band of rows one pixel at a time.  Each edge is an edge
+ *  function that is positive inside the counter-clockwise
+ *  triangle, and the three edge values of a pixel center,
+ *  divided by the area, are its barycentric weights for
+ *  the depth.  Rows start at the same multiple of four as
+ *  the SSE2 kernel.
+ ***********************************************************/
+void RasterizeDepthBandScalar(
+	const SCREEN_TRIANGLE* triangles,
+	size_t count,
+	float* depth,
+	int width,
+	int rowBegin,
+	int rowEnd)
+{
+	for (size_t t = 0; t < count; t++)
+	{
+		const SCREEN_TRIANGLE& triangle = triangles[t];
+		int minY = std::max(triangle.minY, rowBegin);
+		int maxY = std::min(triangle.maxY, rowEnd - 1);
+		if (minY > maxY)
+		{
+			continue;
+		}
+
+		TRIANGLE_EDGES edges;
+		SetupEdges(triangle, edges);
+		int minX = triangle.minX & ~3;
+		int maxX = triangle.maxX;
+
+		for (int row = minY; row <= maxY; row++)
+		{
+			float centerY = row + 0.5f;
+			float rowValue[3];
+			for (int edge = 0; edge < 3; edge++)
+			{
+				rowValue[edge] = edges.b[edge] * centerY + edges.c[edge];
+			}
+
+			float* rowDepth = depth + (size_t)row * width;
+			for (int column = minX; column <= maxX; column++)
+			{
+				float centerX = column + 0.5f;
+				float e0 = edges.a[0] * centerX + rowValue[0];
+				float e1 = edges.a[1] * centerX + rowValue[1];
+				float e2 = edges.a[2] * centerX + rowValue[2];
+				if ((e0 >= 0.0f) && (e1 >= 0.0f) && (e2 >= 0.0f))
+				{
+					float z = (e0 * edges.zWeights[0] + e1 * edges.zWeights[1]) + e2 * edges.zWeights[2];
+					rowDepth[column] = std::min(rowDepth[column], z);
+				}
+			}
+		}
+	}
+}
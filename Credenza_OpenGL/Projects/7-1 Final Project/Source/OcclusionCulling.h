@@ -0,0 +1,163 @@
+///////////////////////////////////////////////////////////////////////////////
+// OcclusionCulling.h
+// ============
+// rasterize a few large occluders into a small depth buffer on the CPU and
+// test bounding boxes against its hierarchical depth, so objects hidden
+// behind the occluders are never queued
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// occluder triangle in the pixel space of the depth buffer,
+// with its corners counter-clockwise and the pixel rectangle
+// it covers
+struct SCREEN_TRIANGLE
+{
+	float x[3];
+	float y[3];
+	float z[3];
+	int minX;
+	int maxX;
+	int minY;
+	int maxY;
+};
+
+/***********************************************************
+ *  OcclusionCuller
+ *
+ *  This class contains the world space triangles of the
+ *  designated occluders and a low resolution depth buffer
+ *  they are rasterized into every frame, together with the
+ *  hierarchical depth pyramid built from it.  Every level
+ *  of the pyramid holds the farthest depth of four texels
+ *  of the level below.
+ *
+ *  Depth is the normalized device depth moved to 0 at the
+ *  near plane and 1 at the far plane.  A box is occluded
+ *  when its nearest depth is beyond the farthest depth of
+ *  the texels its screen rectangle covers.  The rectangle
+ *  is grown by a texel on every side, so occluder edges
+ *  that only cover part of a texel never hide a box.
+ *
+ *  The rasterizer evaluates four pixels at a time with
+ *  SSE2 and splits the rows of the buffer into bands that
+ *  are rasterized on separate threads.  The worker threads
+ *  are started by the first render that needs them and
+ *  then wait for the next frame, so a frame only costs a
+ *  wake up and a wait.  Every band keeps the nearest depth
+ *  of each of its pixels, which does not depend on the
+ *  order the triangles are drawn in, so the result is the
+ *  same for any number of threads and needs no GPU.
+ ***********************************************************/
+class OcclusionCuller
+{
+public:
+	// size of the depth buffer, the width is a multiple of four
+	static const int BUFFER_WIDTH = 256;
+	static const int BUFFER_HEIGHT = 144;
+
+	OcclusionCuller();
+	~OcclusionCuller();
+
+	// remove all occluders
+	void ClearOccluders();
+	// add the indexed triangles of an occluder, moved to world
+	// space by the matrix
+	void AddOccluder(const glm::vec3* positions, const uint32_t* indices, size_t indexCount,
+		const glm::mat4& world);
+	// number of occluder triangles
+	inline size_t GetOccluderTriangleCount() const { return m_occluderPositions.size() / 3; }
+	// occluder triangles of the last render in screen space
+	inline const std::vector<SCREEN_TRIANGLE>& GetScreenTriangles() const { return m_triangles; }
+
+	// threads used to rasterize, 1 rasterizes on the calling thread;
+	// frames with few triangles use fewer threads
+	void SetThreadCount(int threadCount);
+	inline int GetThreadCount() const { return m_threadCount; }
+
+	// rasterize the occluders seen through a projection * view
+	// matrix and build the depth pyramid, returns the number of
+	// triangles rasterized
+	size_t Render(const glm::mat4& viewProjection);
+
+	// test a world space box against the depth pyramid, false
+	// when it is hidden behind the occluders
+	bool IsVisible(const glm::vec3& boxMin, const glm::vec3& boxMax) const;
+
+	// depth pyramid as of the last render, level 0 is the buffer
+	inline int GetLevelCount() const { return (int)m_levels.size(); }
+	inline int GetLevelWidth(int level) const { return m_levelWidths[level]; }
+	inline int GetLevelHeight(int level) const { return m_levelHeights[level]; }
+	inline float GetDepth(int level, int x, int y) const { return m_levels[level][y * m_levelWidths[level] + x]; }
+	inline const float* GetLevelData(int level) const { return m_levels[level].data(); }
+
+private:
+	// build the farthest depth levels from the depth buffer
+	void BuildPyramid();
+	// start worker threads until there is one for every band
+	// after the first
+	void StartWorkers(int bandCount);
+	// loop of the worker rasterizing the passed in band, from
+	// the frame after the passed in one
+	void RunWorker(int band, uint32_t frame);
+	// rows of a band of the current frame
+	void GetBandRows(int band, int& rowBegin, int& rowEnd) const;
+
+	// world space occluder triangles, three positions each
+	std::vector<glm::vec3> m_occluderPositions;
+	// occluder triangles of the current frame in screen space
+	std::vector<SCREEN_TRIANGLE> m_triangles;
+	// depth pyramid, the first level is the depth buffer
+	std::vector<std::vector<float> > m_levels;
+	std::vector<int> m_levelWidths;
+	std::vector<int> m_levelHeights;
+	// projection * view of the last render
+	glm::mat4 m_viewProjection;
+	int m_threadCount;
+
+	// worker threads, the one at index i rasterizes band i + 1
+	std::vector<std::thread> m_workers;
+	std::mutex m_workMutex;
+	std::condition_variable m_workReady;
+	std::condition_variable m_workDone;
+	// frame the workers were last woken for, the number of bands
+	// of that frame and the workers that have not finished it
+	uint32_t m_workFrame;
+	int m_workBandCount;
+	int m_workPending;
+	bool m_bStopWorkers;
+};
+
+// rasterize screen space triangles into the rows of a depth
+// buffer from rowBegin up to rowEnd, keeping the nearest depth
+// of every pixel - the kernel behind OcclusionCuller::Render(),
+// four pixels per iteration with SSE2 where available; the
+// width must be a multiple of four
+void RasterizeDepthBand(
+	const SCREEN_TRIANGLE* triangles,
+	size_t count,
+	float* depth,
+	int width,
+	int rowBegin,
+	int rowEnd);
+
+// one pixel per iteration version of the same kernel, giving
+// the same depths - used where SSE2 is missing and to check
+// the SSE2 path
+void RasterizeDepthBandScalar(
+	const SCREEN_TRIANGLE* triangles,
+	size_t count,
+	float* depth,
+	int width,
+	int rowBegin,
+	int rowEnd);
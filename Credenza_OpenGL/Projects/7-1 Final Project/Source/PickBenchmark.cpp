@@ -0,0 +1,194 @@
+///////////////////////////////////////////////////////////////////////////////
+// PickBenchmark.cpp
+// ============
+// time ray picks through the bounding volume hierarchy against testing every
+// triangle, over random triangle soups
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "PickBenchmark.h"
+#include "BoundingVolumeHierarchy.h"
+
+#include <cfloat>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+#include <glm/glm.hpp>
+
+// declaration of global variables
+namespace
+{
+	const size_t g_TriangleCounts[] = { 10000, 100000, 1000000 };
+	// number of rays tested against every triangle, fewer for the
+	// larger soups
+	const size_t g_LinearRayCounts[] = { 1000, 100, 20 };
+	// number of timed picks through the tree
+	const size_t g_TreeRayCount = 10000;
+	// half the side of the cube holding the soup, and the largest
+	// distance of a corner from its triangle center
+	const float g_SoupExtent = 50.0f;
+	const float g_TriangleSize = 1.0f;
+
+	// corners of the triangles of a soup, three per triangle
+	struct TRIANGLE_SOUP
+	{
+		std::vector<glm::vec3> corners;
+	};
+
+	/***********************************************************
+	 *  TestSoupTriangle()
+	 *
+	 *  This function is used for testing one triangle of a
+	 *  soup, the way the scene picks test mesh triangles.
+	 ***********************************************************/
+	float TestSoupTriangle(void* pContext, uint32_t primitive,
+		const glm::vec3& origin, const glm::vec3& direction, float maxDistance)
+	{
+		const TRIANGLE_SOUP* pSoup = (const TRIANGLE_SOUP*)pContext;
+		const glm::vec3* corners = &pSoup->corners[primitive * 3];
+		float distance = IntersectTriangle(origin, direction, corners[0], corners[1], corners[2]);
+		return((distance <= maxDistance) ? distance : -1.0f);
+	}
+
+	/***********************************************************
+	 *  IntersectAll()
+	 *
+	 *  This function is used for finding the nearest triangle
+	 *  of a soup hit by a ray by testing every triangle.
+	 ***********************************************************/
+	uint32_t IntersectAll(const TRIANGLE_SOUP& soup, const glm::vec3& origin, const glm::vec3& direction,
+		float* pDistance)
+	{
+		uint32_t hitTriangle = BoundingVolumeHierarchy::NO_PRIMITIVE;
+		float nearest = FLT_MAX;
+
+		size_t count = soup.corners.size() / 3;
+		for (size_t i = 0; i < count; i++)
+		{
+			const glm::vec3* corners = &soup.corners[i * 3];
+			float distance = IntersectTriangle(origin, direction, corners[0], corners[1], corners[2]);
+			if ((distance >= 0.0f) && (distance <= nearest))
+			{
+				nearest = distance;
+				hitTriangle = (uint32_t)i;
+			}
+		}
+
+		*pDistance = nearest;
+		return(hitTriangle);
+	}
+}
+
+/***********************************************************
+ *  RunPickBenchmark()
+ *
+ *  This function is used for timing picks through a tree
+ *  built over random triangles spread through a cube, the
+ *  way PickMesh() tests the triangles of a mesh.  The rays
+ *  start around the cube and aim at random points in it.
+ *  A smaller set of the rays is also tested against every
+ *  triangle, and a ray counts as a mismatch when the two
+ *  nearest hits are not the same distance.
+ ***********************************************************/
+std::vector<PICK_BENCHMARK_RESULT> RunPickBenchmark()
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	std::vector<PICK_BENCHMARK_RESULT> results;
+	std::mt19937 random(17);
+	std::uniform_real_distribution<float> inCube(-g_SoupExtent, g_SoupExtent);
+	std::uniform_real_distribution<float> inTriangle(-g_TriangleSize, g_TriangleSize);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	float checksum = 0.0f;
+
+	for (int run = 0; run < 3; run++)
+	{
+		size_t count = g_TriangleCounts[run];
+		size_t linearRayCount = g_LinearRayCounts[run];
+
+		TRIANGLE_SOUP soup;
+		soup.corners.resize(count * 3);
+		std::vector<glm::vec3> boxMins(count);
+		std::vector<glm::vec3> boxMaxs(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			glm::vec3 center(inCube(random), inCube(random), inCube(random));
+			glm::vec3* corners = &soup.corners[i * 3];
+			for (int corner = 0; corner < 3; corner++)
+			{
+				corners[corner] = center + glm::vec3(inTriangle(random), inTriangle(random), inTriangle(random));
+			}
+			boxMins[i] = glm::min(corners[0], glm::min(corners[1], corners[2]));
+			boxMaxs[i] = glm::max(corners[0], glm::max(corners[1], corners[2]));
+		}
+
+		// rays from a sphere around the cube to a point inside
+		std::vector<glm::vec3> origins(g_TreeRayCount);
+		std::vector<glm::vec3> directions(g_TreeRayCount);
+		for (size_t i = 0; i < g_TreeRayCount; i++)
+		{
+			glm::vec3 outside(unit(random), unit(random), unit(random));
+			if (glm::dot(outside, outside) < 1e-6f)
+			{
+				outside = glm::vec3(1.0f, 0.0f, 0.0f);
+			}
+			origins[i] = glm::normalize(outside) * (g_SoupExtent * 3.0f);
+			directions[i] = glm::vec3(inCube(random), inCube(random), inCube(random)) - origins[i];
+		}
+
+		Clock::time_point buildStart = Clock::now();
+		BoundingVolumeHierarchy tree;
+		tree.Build(boxMins.data(), boxMaxs.data(), count);
+		Clock::time_point buildEnd = Clock::now();
+
+		std::vector<float> treeDistances(g_TreeRayCount);
+		for (size_t i = 0; i < g_TreeRayCount; i++)
+		{
+			float distance = -1.0f;
+			tree.Intersect(origins[i], directions[i], FLT_MAX, &TestSoupTriangle, &soup, &distance);
+			treeDistances[i] = distance;
+		}
+		Clock::time_point treeEnd = Clock::now();
+
+		size_t mismatchCount = 0;
+		Clock::time_point linearStart = Clock::now();
+		for (size_t i = 0; i < linearRayCount; i++)
+		{
+			float distance = -1.0f;
+			uint32_t hit = IntersectAll(soup, origins[i], directions[i], &distance);
+			if (hit == BoundingVolumeHierarchy::NO_PRIMITIVE)
+			{
+				distance = -1.0f;
+			}
+			if (distance != treeDistances[i])
+			{
+				mismatchCount++;
+			}
+			checksum += distance;
+		}
+		Clock::time_point linearEnd = Clock::now();
+		for (size_t i = 0; i < g_TreeRayCount; i++)
+		{
+			checksum += treeDistances[i];
+		}
+
+		PICK_BENCHMARK_RESULT result;
+		result.triangleCount = count;
+		result.buildMilliseconds = std::chrono::duration<double, std::milli>(buildEnd - buildStart).count();
+		result.treeMicroseconds = std::chrono::duration<double, std::micro>(treeEnd - buildEnd).count() / g_TreeRayCount;
+		result.linearMicroseconds = std::chrono::duration<double, std::micro>(linearEnd - linearStart).count() / linearRayCount;
+		result.mismatchCount = mismatchCount;
+		results.push_back(result);
+
+		std::cout << "Pick, " << count << " triangles: "
+			<< result.treeMicroseconds << " us tree ("
+			<< result.buildMilliseconds << " ms build), "
+			<< result.linearMicroseconds << " us every triangle, "
+			<< mismatchCount << " of " << linearRayCount << " rays differ" << std::endl;
+	}
+
+	std::cout << "(checksum " << checksum << ")" << std::endl;
+
+	return(results);
+}
@@ -0,0 +1,28 @@
+///////////////////////////////////////////////////////////////////////////////
+// PickBenchmark.h
+// ============
+// time ray picks through the bounding volume hierarchy against testing every
+// triangle, over random triangle soups
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+// build time of the tree and average time of one pick for a given
+// triangle count, with the number of rays whose nearest hit differed
+// from the one found by testing every triangle
+struct PICK_BENCHMARK_RESULT
+{
+	size_t triangleCount;
+	double buildMilliseconds;
+	double treeMicroseconds;
+	double linearMicroseconds;
+	size_t mismatchCount;
+};
+
+// run the picks for 10k, 100k and 1M triangles, print the results to
+// the console and return them
+std::vector<PICK_BENCHMARK_RESULT> RunPickBenchmark();
@@ -0,0 +1,214 @@
+///////////////////////////////////////////////////////////////////////////////
+// RenderQueue.cpp
+// ============
+// collect the draws of a frame under 64-bit sort keys and order them so
+// that state changes between consecutive draws are minimized
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RenderQueue.h"
+
+#include <string.h>
+
+// declaration of global variables
+namespace
+{
+	const int g_RadixBits = 8;
+	const int g_RadixBuckets = RenderQueue::RADIX_BUCKETS;
+	const int g_RadixPasses = RenderQueue::RADIX_PASSES;
+
+	const uint64_t g_DepthMask = 0xFFFFFF;
+}
+
+/***********************************************************
+ *  RenderQueue()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+RenderQueue::RenderQueue()
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+/***********************************************************
+ *  MakeKey()
+ *
+ *  This method is used for packing the state of a draw into
+ *  a sort key.  Opaque draws are grouped by state and drawn
+ *  front to back inside a group, translucent draws are
+ *  ordered back to front first so that blending is correct.
+ ***********************************************************/
+uint64_t RenderQueue::MakeKey(
+	RenderPass pass,
+	unsigned int variant,
+	unsigned int material,
+	unsigned int texture,
+	unsigned int mesh,
+	float depth)
+{
+	if (depth < 0.0f)
+	{
+		depth = 0.0f;
+	}
+	if (depth > 1.0f)
+	{
+		depth = 1.0f;
+	}
+	uint64_t quantizedDepth = (uint64_t)(depth * (float)g_DepthMask);
+
+	uint64_t key = 0;
+	if (pass == PASS_OPAQUE)
+	{
+		key |= (uint64_t)(variant & 0xFF) << 55;
+		key |= (uint64_t)(texture & 0x1F) << 50;
+		key |= (uint64_t)(material & 0x3F) << 44;
+		key |= (uint64_t)(mesh & 0xFFFFF) << 24;
+		key |= quantizedDepth;
+	}
+	else
+	{
+		key |= (uint64_t)1 << 63;
+		key |= (g_DepthMask - quantizedDepth) << 39;
+		key |= (uint64_t)(variant & 0xFF) << 31;
+		key |= (uint64_t)(texture & 0x1F) << 26;
+		key |= (uint64_t)(material & 0x3F) << 20;
+		key |= (uint64_t)(mesh & 0xFFFFF);
+	}
+
+	return(key);
+}
+
+/***********************************************************
+ *  DecodeKey()
+ *
+ *  This method is used for reading the state fields back
+ *  out of a sort key.
+ ***********************************************************/
+void RenderQueue::DecodeKey(uint64_t key, unsigned int fields[STATE_CHANGE_COUNT])
+{
+	if ((key >> 63) == PASS_OPAQUE)
+	{
+		fields[STATE_CHANGE_VARIANT] = (unsigned int)((key >> 55) & 0xFF);
+		fields[STATE_CHANGE_TEXTURE] = (unsigned int)((key >> 50) & 0x1F);
+		fields[STATE_CHANGE_MATERIAL] = (unsigned int)((key >> 44) & 0x3F);
+		fields[STATE_CHANGE_MESH] = (unsigned int)((key >> 24) & 0xFFFFF);
+	}
+	else
+	{
+		fields[STATE_CHANGE_VARIANT] = (unsigned int)((key >> 31) & 0xFF);
+		fields[STATE_CHANGE_TEXTURE] = (unsigned int)((key >> 26) & 0x1F);
+		fields[STATE_CHANGE_MATERIAL] = (unsigned int)((key >> 20) & 0x3F);
+		fields[STATE_CHANGE_MESH] = (unsigned int)(key & 0xFFFFF);
+	}
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for removing all queued draws while
+ *  keeping the allocated memory for the next frame.
+ ***********************************************************/
+void RenderQueue::Clear()
+{
+	m_items.clear();
+}
+
+/***********************************************************
+ *  Sort()
+ *
+ *  This method is used for sorting the queued draws with a
+ *  least significant digit radix sort over 8-bit digits.
+ *  Digits that are the same for every key are skipped.  The
+ *  sort is stable, so draws with equal keys keep the order
+ *  they were submitted in.
+ ***********************************************************/
+void RenderQueue::Sort()
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_stats.draws = (unsigned int)m_items.size();
+	CountStateChanges(m_stats.unsorted);
+
+	size_t count = m_items.size();
+	if (count > 1)
+	{
+		m_scratch.resize(count);
+
+		// build the digit histograms of every pass at once
+		memset(m_histograms, 0, sizeof(m_histograms));
+		for (size_t i = 0; i < count; i++)
+		{
+			uint64_t key = m_items[i].key;
+			for (int pass = 0; pass < g_RadixPasses; pass++)
+			{
+				m_histograms[pass][(key >> (pass * g_RadixBits)) & (g_RadixBuckets - 1)]++;
+			}
+		}
+
+		RENDER_ITEM* source = &m_items[0];
+		RENDER_ITEM* destination = &m_scratch[0];
+		for (int pass = 0; pass < g_RadixPasses; pass++)
+		{
+			unsigned int* histogram = m_histograms[pass];
+			int shift = pass * g_RadixBits;
+
+			// every key has the same digit - nothing to reorder
+			if (histogram[(source[0].key >> shift) & (g_RadixBuckets - 1)] == count)
+			{
+				continue;
+			}
+
+			// turn the histogram into bucket start offsets
+			unsigned int offset = 0;
+			for (int bucket = 0; bucket < g_RadixBuckets; bucket++)
+			{
+				unsigned int bucketCount = histogram[bucket];
+				histogram[bucket] = offset;
+				offset += bucketCount;
+			}
+
+			for (size_t i = 0; i < count; i++)
+			{
+				unsigned int digit = (unsigned int)((source[i].key >> shift) & (g_RadixBuckets - 1));
+				destination[histogram[digit]++] = source[i];
+			}
+
+			RENDER_ITEM* swap = source;
+			source = destination;
+			destination = swap;
+		}
+
+		// an odd number of executed passes leaves the result in the scratch buffer
+		if (source != &m_items[0])
+		{
+			m_items.swap(m_scratch);
+		}
+	}
+
+	CountStateChanges(m_stats.sorted);
+}
+
+/***********************************************************
+ *  CountStateChanges()
+ *
+ *  This method is used for counting how often each kind of
+ *  state differs between consecutive queued draws.  The
+ *  first draw counts as a change of every kind.
+ ***********************************************************/
+void RenderQueue::CountStateChanges(unsigned int changes[STATE_CHANGE_COUNT]) const
+{
+	unsigned int previous[STATE_CHANGE_COUNT];
+	unsigned int current[STATE_CHANGE_COUNT];
+
+	for (size_t i = 0; i < m_items.size(); i++)
+	{
+		DecodeKey(m_items[i].key, current);
+		for (int field = 0; field < STATE_CHANGE_COUNT; field++)
+		{
+			if ((i == 0) || (current[field] != previous[field]))
+			{
+				changes[field]++;
+			}
+			previous[field] = current[field];
+		}
+	}
+}
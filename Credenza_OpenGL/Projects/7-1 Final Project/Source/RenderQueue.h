@@ -0,0 +1,121 @@
+///////////////////////////////////////////////////////////////////////////////
+// RenderQueue.h
+// ============
+// collect the draws of a frame under 64-bit sort keys and order them so
+// that state changes between consecutive draws are minimized
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/***********************************************************
+ *  RenderQueue
+ *
+ *  This class contains the draws submitted for one frame.
+ *  Every draw is a sort key and the index of its payload,
+ *  which is owned by the caller.  The queue is radix sorted
+ *  once per frame before the draws are submitted to GL.
+ *  The texture is ordered above the material because the
+ *  material is per-instance data that does not split a
+ *  multi-draw submission.
+ *
+ *  Key layout, from the most significant bit:
+ *    opaque pass      [63]    0
+ *                     [55-62] shader variant
+ *                     [50-54] texture
+ *                     [44-49] material
+ *                     [24-43] mesh / VAO
+ *                     [0-23]  depth, front to back
+ *    translucent pass [63]    1
+ *                     [39-62] depth, back to front
+ *                     [31-38] shader variant
+ *                     [26-30] texture
+ *                     [20-25] material
+ *                     [0-19]  mesh / VAO
+ ***********************************************************/
+class RenderQueue
+{
+public:
+	// render passes, drawn in this order
+	enum RenderPass
+	{
+		PASS_OPAQUE = 0,
+		PASS_TRANSLUCENT = 1
+	};
+
+	// kinds of state changes counted between consecutive draws
+	enum StateChange
+	{
+		STATE_CHANGE_VARIANT = 0,
+		STATE_CHANGE_MATERIAL,
+		STATE_CHANGE_TEXTURE,
+		STATE_CHANGE_MESH,
+		STATE_CHANGE_COUNT
+	};
+
+	// a single queued draw
+	struct RENDER_ITEM
+	{
+		uint64_t key;
+		uint32_t payload;
+	};
+
+	// state changes of the frame in submission and in sorted order
+	struct RENDER_QUEUE_STATS
+	{
+		unsigned int draws;
+		unsigned int unsorted[STATE_CHANGE_COUNT];
+		unsigned int sorted[STATE_CHANGE_COUNT];
+	};
+
+	// radix sort digits - 8 passes of 8 bits
+	static const int RADIX_BUCKETS = 256;
+	static const int RADIX_PASSES = 8;
+
+	// constructor
+	RenderQueue();
+
+	// build a sort key - depth is the normalized view distance
+	static uint64_t MakeKey(
+		RenderPass pass,
+		unsigned int variant,
+		unsigned int material,
+		unsigned int texture,
+		unsigned int mesh,
+		float depth);
+
+	// remove all queued draws
+	void Clear();
+	// queue a draw
+	inline void Push(uint64_t key, uint32_t payload)
+	{
+		RENDER_ITEM item = { key, payload };
+		m_items.push_back(item);
+	}
+	// order the queued draws by key, keeping submission order for equal keys
+	void Sort();
+
+	// access the queued draws
+	inline size_t Size() const { return m_items.size(); }
+	inline const RENDER_ITEM& operator[](size_t index) const { return m_items[index]; }
+
+	// state change counts of the last sorted frame
+	inline const RENDER_QUEUE_STATS& GetStats() const { return m_stats; }
+
+private:
+	std::vector<RENDER_ITEM> m_items;
+	// scratch buffer used by the radix sort passes
+	std::vector<RENDER_ITEM> m_scratch;
+	// digit histograms of the radix sort passes
+	unsigned int m_histograms[RADIX_PASSES][RADIX_BUCKETS];
+	RENDER_QUEUE_STATS m_stats;
+
+	// split a key into the fields that cause state changes
+	static void DecodeKey(uint64_t key, unsigned int fields[STATE_CHANGE_COUNT]);
+	// count the state changes between consecutive queued draws
+	void CountStateChanges(unsigned int changes[STATE_CHANGE_COUNT]) const;
+};
@@ -0,0 +1,300 @@
+///////////////////////////////////////////////////////////////////////////////
+// SceneBaker.cpp
+// ============
+// merge the static objects of a scene into pre-transformed world space
+// geometry, one batch per material, and cache the result on disk
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneBaker.h"
+
+#include <cstring>
+#include <fstream>
+
+// declaration of global variables
+namespace
+{
+	// identifies a bake cache file
+	const char g_BakeMagic[4] = { 'B', 'A', 'K', 'E' };
+	// change whenever the bake output or the basic shapes change,
+	// so caches made by an older build are baked again
+	const uint32_t g_BakeVersion = 1;
+
+	const size_t g_FloatsPerVertex = 8;
+
+	/***********************************************************
+	 *  FindBatch()
+	 *
+	 *  This function is used for finding the batch an object
+	 *  belongs to, adding a new batch when there is none.
+	 ***********************************************************/
+	BAKED_BATCH& FindBatch(std::vector<BAKED_BATCH>& batches, StringID materialTag,
+		StringID textureTag, const glm::vec4& color, bool bTextured)
+	{
+		for (size_t i = 0; i < batches.size(); i++)
+		{
+			BAKED_BATCH& batch = batches[i];
+			if ((batch.materialTag == materialTag) && (batch.bTextured == bTextured) &&
+				(bTextured ? (batch.textureTag == textureTag) : (batch.color == color)))
+			{
+				return(batch);
+			}
+		}
+
+		BAKED_BATCH batch;
+		batch.materialTag = materialTag;
+		batch.textureTag = bTextured ? textureTag : EMPTY_STRING_ID;
+		batch.color = color;
+		batch.bTextured = bTextured;
+		batches.push_back(batch);
+
+		return(batches.back());
+	}
+
+	/***********************************************************
+	 *  WriteString()
+	 *  ReadString()
+	 *
+	 *  These functions are used for writing and reading a
+	 *  length prefixed tag of a cache file.  The file holds
+	 *  the text, identifiers are only valid while running.
+	 ***********************************************************/
+	void WriteString(std::ofstream& file, StringID tag)
+	{
+		const std::string& text = GetInternedString(tag);
+		uint32_t length = (uint32_t)text.size();
+		file.write((const char*)&length, sizeof(length));
+		file.write(text.data(), length);
+	}
+
+	bool ReadString(std::ifstream& file, StringID& tag)
+	{
+		uint32_t length = 0;
+		if (!file.read((char*)&length, sizeof(length)) || (length > 4096))
+		{
+			return(false);
+		}
+		std::string text(length, '\0');
+		if ((length > 0) && !file.read(&text[0], length))
+		{
+			return(false);
+		}
+		tag = InternString(text);
+		return(true);
+	}
+}
+
+/***********************************************************
+ *  IsBakeable()
+ *
+ *  This function is used for checking whether an object is
+ *  merged into the baked batches.
+ ***********************************************************/
+bool IsBakeable(const SceneStore& store, size_t index)
+{
+	SceneStore::RENDER_VIEW view = store.GetRenderView();
+	uint8_t flags = view.flags[index];
+
+	if ((flags & SceneStore::OBJECT_FLAG_STATIC) == 0)
+	{
+		return(false);
+	}
+	if (((flags & SceneStore::OBJECT_FLAG_TEXTURED) == 0) && (view.colors[index].a < 1.0f))
+	{
+		return(false);
+	}
+	return(view.drawRecords[index].geometry != ShapeMeshes::INVALID_GEOMETRY);
+}
+
+/***********************************************************
+ *  BakeStaticObjects()
+ *
+ *  This function is used for reading the geometry of every
+ *  bakeable object back from the shared buffers and adding
+ *  it to its batch in world space.  Positions go through
+ *  the world matrix and normals through its inverse
+ *  transpose, so they stay perpendicular under non-uniform
+ *  scale.  Mirroring transforms flip the triangle winding
+ *  back to counter-clockwise.
+ ***********************************************************/
+void BakeStaticObjects(const SceneStore& store, ShapeMeshes* pMeshes,
+	std::vector<BAKED_BATCH>& batches)
+{
+	SceneStore::RENDER_VIEW view = store.GetRenderView();
+	std::vector<GLfloat> vertices;
+	std::vector<GLuint> indices;
+
+	for (size_t i = 0; i < view.count; i++)
+	{
+		if (!IsBakeable(store, i))
+		{
+			continue;
+		}
+
+		vertices.clear();
+		indices.clear();
+		const ShapeMeshes::DRAW_RECORD& record = view.drawRecords[i];
+		if (!pMeshes->GetGeometryData(record.geometry, record.parts, vertices, indices))
+		{
+			continue;
+		}
+
+		bool bTextured = (view.flags[i] & SceneStore::OBJECT_FLAG_TEXTURED) != 0;
+		BAKED_BATCH& batch = FindBatch(batches, store.GetMaterialTag(i),
+			store.GetTextureTag(i), view.colors[i], bTextured);
+
+		const glm::mat4& world = view.worldMatrices[i];
+		glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(world)));
+		bool bMirrored = glm::determinant(glm::mat3(world)) < 0.0f;
+		const glm::vec2& uvScale = view.uvScales[i];
+
+		GLuint firstVertex = (GLuint)(batch.vertices.size() / g_FloatsPerVertex);
+		for (size_t v = 0; v < vertices.size(); v += g_FloatsPerVertex)
+		{
+			const GLfloat* source = &vertices[v];
+			glm::vec3 position = glm::vec3(world * glm::vec4(source[0], source[1], source[2], 1.0f));
+			glm::vec3 normal = normalMatrix * glm::vec3(source[3], source[4], source[5]);
+			float length = glm::length(normal);
+			if (length > 0.0f)
+			{
+				normal /= length;
+			}
+
+			GLfloat baked[g_FloatsPerVertex] = {
+				position.x, position.y, position.z,
+				normal.x, normal.y, normal.z,
+				source[6] * uvScale.x, source[7] * uvScale.y };
+			batch.vertices.insert(batch.vertices.end(), baked, baked + g_FloatsPerVertex);
+		}
+
+		for (size_t t = 0; t + 2 < indices.size(); t += 3)
+		{
+			batch.indices.push_back(firstVertex + indices[t]);
+			batch.indices.push_back(firstVertex + indices[t + (bMirrored ? 2 : 1)]);
+			batch.indices.push_back(firstVertex + indices[t + (bMirrored ? 1 : 2)]);
+		}
+	}
+}
+
+/***********************************************************
+ *  HashBakeSource()
+ *
+ *  This function is used for hashing the source data of a
+ *  bake with 64-bit FNV-1a, seeded with the bake version.
+ ***********************************************************/
+uint64_t HashBakeSource(const std::string& source)
+{
+	uint64_t hash = 14695981039346656037ULL ^ g_BakeVersion;
+	for (size_t i = 0; i < source.size(); i++)
+	{
+		hash ^= (uint8_t)source[i];
+		hash *= 1099511628211ULL;
+	}
+	return(hash);
+}
+
+/***********************************************************
+ *  LoadBakedBatches()
+ *
+ *  This function is used for reading a bake cache.  The
+ *  header holds the magic, the bake version and the hash of
+ *  the source, followed by the batches.
+ ***********************************************************/
+bool LoadBakedBatches(const std::string& filename, uint64_t sourceHash,
+	std::vector<BAKED_BATCH>& batches)
+{
+	std::ifstream file(filename, std::ios::binary);
+	if (!file.is_open())
+	{
+		return(false);
+	}
+
+	char magic[4];
+	uint32_t version = 0;
+	uint64_t hash = 0;
+	uint32_t batchCount = 0;
+	file.read(magic, sizeof(magic));
+	file.read((char*)&version, sizeof(version));
+	file.read((char*)&hash, sizeof(hash));
+	file.read((char*)&batchCount, sizeof(batchCount));
+	if (!file || (0 != memcmp(magic, g_BakeMagic, sizeof(magic))) ||
+		(version != g_BakeVersion) || (hash != sourceHash))
+	{
+		return(false);
+	}
+
+	std::vector<BAKED_BATCH> loaded(batchCount);
+	for (uint32_t i = 0; i < batchCount; i++)
+	{
+		BAKED_BATCH& batch = loaded[i];
+		uint32_t textured = 0;
+		uint32_t floatCount = 0;
+		uint32_t indexCount = 0;
+		if (!ReadString(file, batch.materialTag) || !ReadString(file, batch.textureTag) ||
+			!file.read((char*)&batch.color, sizeof(batch.color)) ||
+			!file.read((char*)&textured, sizeof(textured)) ||
+			!file.read((char*)&floatCount, sizeof(floatCount)) ||
+			!file.read((char*)&indexCount, sizeof(indexCount)))
+		{
+			return(false);
+		}
+		batch.bTextured = (textured != 0);
+		batch.vertices.resize(floatCount);
+		batch.indices.resize(indexCount);
+		if (((floatCount > 0) && !file.read((char*)&batch.vertices[0], floatCount * sizeof(GLfloat))) ||
+			((indexCount > 0) && !file.read((char*)&batch.indices[0], indexCount * sizeof(GLuint))))
+		{
+			return(false);
+		}
+	}
+
+	batches.swap(loaded);
+	return(true);
+}
+
+/***********************************************************
+ *  SaveBakedBatches()
+ *
+ *  This function is used for writing a bake cache in the
+ *  layout read by LoadBakedBatches().
+ ***********************************************************/
+bool SaveBakedBatches(const std::string& filename, uint64_t sourceHash,
+	const std::vector<BAKED_BATCH>& batches)
+{
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		return(false);
+	}
+
+	uint32_t batchCount = (uint32_t)batches.size();
+	file.write(g_BakeMagic, sizeof(g_BakeMagic));
+	file.write((const char*)&g_BakeVersion, sizeof(g_BakeVersion));
+	file.write((const char*)&sourceHash, sizeof(sourceHash));
+	file.write((const char*)&batchCount, sizeof(batchCount));
+
+	for (size_t i = 0; i < batches.size(); i++)
+	{
+		const BAKED_BATCH& batch = batches[i];
+		uint32_t textured = batch.bTextured ? 1 : 0;
+		uint32_t floatCount = (uint32_t)batch.vertices.size();
+		uint32_t indexCount = (uint32_t)batch.indices.size();
+
+		WriteString(file, batch.materialTag);
+		WriteString(file, batch.textureTag);
+		file.write((const char*)&batch.color, sizeof(batch.color));
+		file.write((const char*)&textured, sizeof(textured));
+		file.write((const char*)&floatCount, sizeof(floatCount));
+		file.write((const char*)&indexCount, sizeof(indexCount));
+		if (floatCount > 0)
+		{
+			file.write((const char*)&batch.vertices[0], floatCount * sizeof(GLfloat));
+		}
+		if (indexCount > 0)
+		{
+			file.write((const char*)&batch.indices[0], indexCount * sizeof(GLuint));
+		}
+	}
+
+	return((bool)file);
+}
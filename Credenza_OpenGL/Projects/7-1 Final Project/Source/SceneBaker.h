@@ -0,0 +1,54 @@
+///////////////////////////////////////////////////////////////////////////////
+// SceneBaker.h
+// ============
+// merge the static objects of a scene into pre-transformed world space
+// geometry, one batch per material, and cache the result on disk
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "ShapeMeshes.h"
+#include "SceneStore.h"
+#include "StringInterner.h"
+
+// merged geometry of the static objects that share a material,
+// a texture and, for untextured objects, a color
+struct BAKED_BATCH
+{
+	StringID materialTag;
+	StringID textureTag;
+	glm::vec4 color;
+	bool bTextured;
+	// shape layout vertices in world space, texture coordinates
+	// already multiplied by the UV scale of their object
+	std::vector<GLfloat> vertices;
+	std::vector<GLuint> indices;
+};
+
+// check whether an object of a store is merged by the bake -
+// static objects are, unless they are translucent and need
+// the back to front order of the render queue
+bool IsBakeable(const SceneStore& store, size_t index);
+
+// merge the bakeable objects of a store into batches, the
+// world matrices of the store must be up to date
+void BakeStaticObjects(const SceneStore& store, ShapeMeshes* pMeshes,
+	std::vector<BAKED_BATCH>& batches);
+
+// hash of the source data a bake is made from
+uint64_t HashBakeSource(const std::string& source);
+
+// read the baked batches of a cache file, false when the file
+// is missing, damaged or was baked from another source
+bool LoadBakedBatches(const std::string& filename, uint64_t sourceHash,
+	std::vector<BAKED_BATCH>& batches);
+// write the baked batches to a cache file
+bool SaveBakedBatches(const std::string& filename, uint64_t sourceHash,
+	const std::vector<BAKED_BATCH>& batches);
@@ -12,6 +12,8 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "SceneManager.h"
+#include "SceneBaker.h"
+#include "MeshSimplifier.h"
 
 #ifndef STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
@@ -20,14 +22,162 @@
 
 #include <glm/gtx/transform.hpp>
 
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <random>
+#include <sstream>
+
+static_assert(sizeof(SceneManager::GPU_MATERIAL) == 48,
+	"GPU_MATERIAL must match the std140 layout of Material");
+static_assert(sizeof(SceneManager::LIGHT_SOURCE) == 80,
+	"LIGHT_SOURCE must match the std140 layout of LightSource");
+
 // declaration of global variables
 namespace
 {
-	const char* g_ModelName = "model";
-	const char* g_ColorValueName = "objectColor";
 	const char* g_TextureValueName = "objectTexture";
-	const char* g_UseTextureName = "bUseTexture";
-	const char* g_UseLightingName = "bUseLighting";
+	// samplers of the G-buffer in the lighting pass
+	const char* g_GBufferAlbedoName = "gbufferAlbedo";
+	const char* g_GBufferNormalName = "gbufferNormal";
+	const char* g_GBufferDepthName = "gbufferDepth";
+
+	// view distance mapped onto the depth bits of the sort keys
+	const float g_MaxSortDistance = 100.0f;
+
+	// description of the static scene and the cache of its bake
+	const char* g_StaticSceneFile = "../../Utilities/scenes/credenza.json";
+	const char* g_StaticBakeFile = "../../Utilities/scenes/credenza.bake";
+	// compute shader of the GPU culling
+	const char* g_CullingShaderFile = "../../Utilities/shaders/cullingComputeShader.glsl";
+
+	// size on screen below which each coarser level of detail is
+	// drawn, as a fraction of half the viewport height, and the
+	// margin a size must pass a threshold by to switch levels
+	const float g_LodThresholds[3] = { 0.5f, 0.25f, 0.125f };
+	const float g_LodHysteresis = 0.15f;
+
+	// edge length of the cells of the spatial hash, about twice
+	// the size of the objects added from the editor
+	const float g_SpatialCellSize = 4.0f;
+
+	// room the test point lights are scattered over, their radius
+	// range and the seed that places them the same every time
+	const glm::vec3 g_TestLightMin(-20.0f, 0.5f, -5.0f);
+	const glm::vec3 g_TestLightMax(20.0f, 12.0f, 15.0f);
+	const float g_TestLightMinRadius = 1.5f;
+	const float g_TestLightMaxRadius = 4.0f;
+	const unsigned int g_TestLightSeed = 2024;
+
+	// names of the basic shapes in scene descriptions
+	struct MESH_NAME
+	{
+		const char* name;
+		ShapeMeshes::MeshID mesh;
+	};
+	const MESH_NAME g_MeshNames[] =
+	{
+		{ "box", ShapeMeshes::MESH_BOX },
+		{ "cone", ShapeMeshes::MESH_CONE },
+		{ "cylinder", ShapeMeshes::MESH_CYLINDER },
+		{ "plane", ShapeMeshes::MESH_PLANE },
+		{ "prism", ShapeMeshes::MESH_PRISM },
+		{ "pyramid3", ShapeMeshes::MESH_PYRAMID3 },
+		{ "pyramid4", ShapeMeshes::MESH_PYRAMID4 },
+		{ "sphere", ShapeMeshes::MESH_SPHERE },
+		{ "half sphere", ShapeMeshes::MESH_HALF_SPHERE },
+		{ "tapered cylinder", ShapeMeshes::MESH_TAPERED_CYLINDER },
+		{ "torus", ShapeMeshes::MESH_TORUS },
+		{ "half torus", ShapeMeshes::MESH_HALF_TORUS }
+	};
+
+	/***********************************************************
+	 *  FindMeshID()
+	 *
+	 *  This function is used for finding a basic shape by its
+	 *  name in a scene description, -1 if there is none.
+	 ***********************************************************/
+	int FindMeshID(const std::string& name)
+	{
+		for (size_t i = 0; i < sizeof(g_MeshNames) / sizeof(g_MeshNames[0]); i++)
+		{
+			if (name == g_MeshNames[i].name)
+			{
+				return((int)g_MeshNames[i].mesh);
+			}
+		}
+		return(-1);
+	}
+
+	/***********************************************************
+	 *  FindMeshPart()
+	 *
+	 *  This function is used for finding a mesh part mask by
+	 *  its name in a scene description, 0 if there is none.
+	 ***********************************************************/
+	unsigned int FindMeshPart(const std::string& name)
+	{
+		if (name == "top") return(ShapeMeshes::MESH_PART_TOP);
+		if (name == "bottom") return(ShapeMeshes::MESH_PART_BOTTOM);
+		if (name == "sides") return(ShapeMeshes::MESH_PART_SIDES);
+		return(0);
+	}
+
+	/***********************************************************
+	 *  DecomposeNodeTransform()
+	 *
+	 *  This function is used for splitting the transformation
+	 *  of a model node into the position, Euler rotation in
+	 *  degrees and scale of a scene object, inverting the
+	 *  translate * rotateX * rotateY * rotateZ * scale order
+	 *  of the transform cache.  Shear cannot be represented
+	 *  and is dropped.
+	 ***********************************************************/
+	void DecomposeNodeTransform(const aiMatrix4x4& matrix,
+		glm::vec3& position, glm::vec3& rotation, glm::vec3& scale)
+	{
+		// Assimp matrices are row major
+		glm::vec3 axisX(matrix.a1, matrix.b1, matrix.c1);
+		glm::vec3 axisY(matrix.a2, matrix.b2, matrix.c2);
+		glm::vec3 axisZ(matrix.a3, matrix.b3, matrix.c3);
+
+		position = glm::vec3(matrix.a4, matrix.b4, matrix.c4);
+		scale = glm::vec3(glm::length(axisX), glm::length(axisY), glm::length(axisZ));
+		if (glm::dot(glm::cross(axisX, axisY), axisZ) < 0.0f)
+		{
+			scale.x = -scale.x;
+		}
+		for (int i = 0; i < 3; i++)
+		{
+			if (scale[i] == 0.0f)
+			{
+				scale[i] = 1.0e-6f;
+			}
+		}
+		axisX /= scale.x;
+		axisY /= scale.y;
+		axisZ /= scale.z;
+
+		// the third column of rotateX * rotateY * rotateZ is
+		// (sy, -sx * cy, cx * cy), the first row (cy * cz,
+		// -cy * sz, sy)
+		float sy = glm::clamp(axisZ.x, -1.0f, 1.0f);
+		rotation.y = std::asin(sy);
+		if (std::fabs(sy) < 0.9999f)
+		{
+			rotation.x = std::atan2(-axisZ.y, axisZ.z);
+			rotation.z = std::atan2(-axisY.x, axisX.x);
+		}
+		else
+		{
+			// X and Z turn around the same axis, keep it in X
+			rotation.x = std::atan2(axisY.z, axisY.y);
+			rotation.z = 0.0f;
+		}
+		rotation = glm::degrees(rotation);
+	}
 }
 
 /***********************************************************
@@ -39,6 +189,68 @@ SceneManager::SceneManager(ShaderManager *pShaderManager)
 {
 	m_pShaderManager = pShaderManager;
 	m_basicMeshes = new ShapeMeshes();
+	if (NULL != m_pShaderManager)
+	{
+		m_basicMeshes->SetStateCache(m_pShaderManager->GetStateCache());
+	}
+	m_lightBlockUBO = 0;
+	m_materialBlockUBO = 0;
+	m_bLightsDirty = true;
+	memset(m_lights, 0, sizeof(m_lights));
+	m_bUseTexture = false;
+	m_bUseLighting = false;
+	m_bTranslucentColor = false;
+	m_activeLightCount = TOTAL_LIGHTS;
+	m_scenePointLightCount = 0;
+	m_testPointLightCount = 0;
+	m_lightClusterMicroseconds = 0.0;
+	m_bDeferredShading = false;
+	m_deferredFramebuffer = 0;
+	m_gpuTimerQueries[0] = 0;
+	m_gpuTimerQueries[1] = 0;
+	m_gpuTimerFrame = 0;
+	m_sceneGpuMilliseconds = 0.0;
+
+	m_transformUpdateCount = 0;
+	m_cullTestedCount = 0;
+	m_culledCount = 0;
+	m_bOcclusionCulling = true;
+	m_view = glm::mat4(1.0f);
+	m_projection = glm::mat4(1.0f);
+	m_viewProjection = glm::mat4(1.0f);
+	m_occludedCount = 0;
+	m_occluderTriangleCount = 0;
+	m_occlusionMicroseconds = 0.0;
+	m_bakedObjectCount = 0;
+	m_bBakeCached = false;
+	m_bLodSelection = true;
+	m_lodProjectionScale = 1.0f;
+	m_fullTriangleCount = 0;
+	m_lodTriangleCount = 0;
+	m_bGpuCulling = false;
+	m_gpuCullStatsLatency = 0;
+	m_lodSlotCount = 0;
+	m_pickLayoutVersion = 0;
+	m_pickWorldVersion = 0;
+	m_bPickTreeValid = false;
+	m_lastPickMicroseconds = 0.0;
+	m_spatialHash.SetCellSize(g_SpatialCellSize);
+	m_bSpatialHashValid = false;
+	m_spatialUpdateCount = 0;
+	m_spatialCellChangeCount = 0;
+	m_drawState.pTransforms = NULL;
+	m_drawState.transform = 0;
+	m_drawState.color = glm::vec4(1.0f);
+	m_drawState.uvScale = glm::vec2(1.0f);
+	m_drawState.textureSlot = -1;
+	m_drawState.materialIndex = 0;
+	m_drawState.variantKey = 0;
+	m_drawState.draw = ShapeMeshes::MakeDrawRecord(ShapeMeshes::MESH_BOX);
+	m_drawState.bGpuCulled = false;
+	m_drawState.lodSlot = 0;
+	m_viewPosition = glm::vec3(0.0f);
+	m_drawCallCount = 0;
+	m_drawCommandCount = 0;
 }
 
 /***********************************************************
@@ -51,6 +263,40 @@ SceneManager::~SceneManager()
 	m_pShaderManager = NULL;
 	delete m_basicMeshes;
 	m_basicMeshes = NULL;
+	if (0 != m_lightBlockUBO)
+	{
+		glDeleteBuffers(1, &m_lightBlockUBO);
+		m_lightBlockUBO = 0;
+	}
+	if (0 != m_materialBlockUBO)
+	{
+		glDeleteBuffers(1, &m_materialBlockUBO);
+		m_materialBlockUBO = 0;
+	}
+	if (0 != m_gpuTimerQueries[0])
+	{
+		glDeleteQueries(2, m_gpuTimerQueries);
+	}
+}
+
+/***********************************************************
+ *  ResolveUniformHandles()
+ *
+ *  This method is used for resolving the names of the
+ *  uniforms that are set on every draw into handles, so
+ *  the render methods never look them up by string.
+ ***********************************************************/
+void SceneManager::ResolveUniformHandles()
+{
+	if (NULL == m_pShaderManager)
+	{
+		return;
+	}
+
+	m_uniforms.objectTexture = m_pShaderManager->GetUniformHandle(g_TextureValueName);
+	m_uniforms.gbufferAlbedo = m_pShaderManager->GetUniformHandle(g_GBufferAlbedoName);
+	m_uniforms.gbufferNormal = m_pShaderManager->GetUniformHandle(g_GBufferNormalName);
+	m_uniforms.gbufferDepth = m_pShaderManager->GetUniformHandle(g_GBufferDepthName);
 }
 
 /***********************************************************
@@ -115,7 +361,8 @@ bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
 
 		// register the loaded texture and associate it with the special tag string
 		m_textureIDs[m_loadedTextures].ID = textureID;
-		m_textureIDs[m_loadedTextures].tag = tag;
+		m_textureIDs[m_loadedTextures].tag = InternString(tag);
+		m_textureSlots[m_textureIDs[m_loadedTextures].tag] = m_loadedTextures;
 		m_loadedTextures++;
 
 		return true;
@@ -135,11 +382,12 @@ bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
  ***********************************************************/
 void SceneManager::BindGLTextures()
 {
+	GLStateCache* pStateCache = m_pShaderManager->GetStateCache();
+
 	for (int i = 0; i < m_loadedTextures; i++)
 	{
 		// bind textures on corresponding texture units
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, m_textureIDs[i].ID);
+		pStateCache->BindTexture(i, GL_TEXTURE_2D, m_textureIDs[i].ID);
 	}
 }
 
@@ -163,24 +411,15 @@ void SceneManager::DestroyGLTextures()
  *  This method is used for getting an ID for the previously
  *  loaded texture bitmap associated with the passed in tag.
  ***********************************************************/
-int SceneManager::FindTextureID(std::string tag)
+int SceneManager::FindTextureID(StringID tag)
 {
-	int textureID = -1;
-	int index = 0;
-	bool bFound = false;
-
-	while ((index < m_loadedTextures) && (bFound == false))
+	int textureSlot = FindTextureSlot(tag);
+	if (textureSlot < 0)
 	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
-		{
-			textureID = m_textureIDs[index].ID;
-			bFound = true;
-		}
-		else
-			index++;
+		return(-1);
 	}
 
-	return(textureID);
+	return((int)m_textureIDs[textureSlot].ID);
 }
 
 /***********************************************************
@@ -189,97 +428,70 @@ int SceneManager::FindTextureID(std::string tag)
  *  This method is used for getting a slot index for the previously
  *  loaded texture bitmap associated with the passed in tag.
  ***********************************************************/
-int SceneManager::FindTextureSlot(std::string tag)
+int SceneManager::FindTextureSlot(StringID tag)
 {
-	int textureSlot = -1;
-	int index = 0;
-	bool bFound = false;
-
-	while ((index < m_loadedTextures) && (bFound == false))
+	std::unordered_map<StringID, int>::const_iterator found = m_textureSlots.find(tag);
+	if (found == m_textureSlots.end())
 	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
-		{
-			textureSlot = index;
-			bFound = true;
-		}
-		else
-			index++;
+		return(-1);
 	}
 
-	return(textureSlot);
+	return(found->second);
 }
 
 /***********************************************************
- *  FindMaterial()
+ *  FindMaterialIndex()
  *
- *  This method is used for getting a material from the previously
- *  defined materials list that is associated with the passed in tag.
+ *  This method is used for getting the index of a material
+ *  in the previously defined materials list that is
+ *  associated with the passed in tag.  The index selects
+ *  the material from the shader material table.
  ***********************************************************/
-bool SceneManager::FindMaterial(std::string tag, OBJECT_MATERIAL& material)
+int SceneManager::FindMaterialIndex(StringID tag) const
 {
-	if (m_objectMaterials.size() == 0)
-	{
-		return(false);
-	}
-
-	int index = 0;
-	bool bFound = false;
-	while ((index < m_objectMaterials.size()) && (bFound == false))
+	std::unordered_map<StringID, int>::const_iterator found = m_materialIndices.find(tag);
+	if (found == m_materialIndices.end())
 	{
-		if (m_objectMaterials[index].tag.compare(tag) == 0)
-		{
-			bFound = true;
-			material.ambientColor = m_objectMaterials[index].ambientColor;
-			material.ambientStrength = m_objectMaterials[index].ambientStrength;
-			material.diffuseColor = m_objectMaterials[index].diffuseColor;
-			material.specularColor = m_objectMaterials[index].specularColor;
-			material.shininess = m_objectMaterials[index].shininess;
-		}
-		else
-		{
-			index++;
-		}
+		return(-1);
 	}
 
-	return(true);
+	return(found->second);
 }
 
 /***********************************************************
- *  SetTransformations()
+ *  UploadMaterials()
  *
- *  This method is used for setting the transform buffer
- *  using the passed in transformation values.
+ *  This method is used for packing all of the defined
+ *  materials into the material uniform buffer, so a draw
+ *  only has to select a material by its index.
  ***********************************************************/
-void SceneManager::SetTransformations(
-	glm::vec3 scaleXYZ,
-	float XrotationDegrees,
-	float YrotationDegrees,
-	float ZrotationDegrees,
-	glm::vec3 positionXYZ)
+void SceneManager::UploadMaterials()
 {
-	// variables for this method
-	glm::mat4 modelView;
-	glm::mat4 scale;
-	glm::mat4 rotationX;
-	glm::mat4 rotationY;
-	glm::mat4 rotationZ;
-	glm::mat4 translation;
-
-	// set the scale value in the transform buffer
-	scale = glm::scale(scaleXYZ);
-	// set the rotation values in the transform buffer
-	rotationX = glm::rotate(glm::radians(XrotationDegrees), glm::vec3(1.0f, 0.0f, 0.0f));
-	rotationY = glm::rotate(glm::radians(YrotationDegrees), glm::vec3(0.0f, 1.0f, 0.0f));
-	rotationZ = glm::rotate(glm::radians(ZrotationDegrees), glm::vec3(0.0f, 0.0f, 1.0f));
-	// set the translation value in the transform buffer
-	translation = glm::translate(positionXYZ);
-
-	modelView = translation * rotationX * rotationY * rotationZ * scale;
+	GPU_MATERIAL gpuMaterials[MAX_MATERIALS];
+	memset(gpuMaterials, 0, sizeof(gpuMaterials));
 
-	if (NULL != m_pShaderManager)
+	int count = (int)m_objectMaterials.size();
+	if (count > MAX_MATERIALS)
+	{
+		std::cout << "Only the first " << MAX_MATERIALS << " materials are available to the shader" << std::endl;
+		count = MAX_MATERIALS;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		gpuMaterials[i].ambientColor = m_objectMaterials[i].ambientColor;
+		gpuMaterials[i].ambientStrength = m_objectMaterials[i].ambientStrength;
+		gpuMaterials[i].diffuseColor = m_objectMaterials[i].diffuseColor;
+		gpuMaterials[i].specularColor = m_objectMaterials[i].specularColor;
+		gpuMaterials[i].shininess = m_objectMaterials[i].shininess;
+	}
+
+	if (0 == m_materialBlockUBO)
 	{
-		m_pShaderManager->setMat4Value(g_ModelName, modelView);
+		m_materialBlockUBO = m_pShaderManager->CreateUniformBuffer(
+			MATERIAL_BLOCK_BINDING, sizeof(gpuMaterials));
 	}
+	m_pShaderManager->UpdateUniformBuffer(m_materialBlockUBO, gpuMaterials, sizeof(gpuMaterials));
 }
 
 /***********************************************************
@@ -302,11 +514,9 @@ void SceneManager::SetShaderColor(
 	currentColor.b = blueColorValue;
 	currentColor.a = alphaValue;
 
-	if (NULL != m_pShaderManager)
-	{
-		m_pShaderManager->setIntValue(g_UseTextureName, false);
-		m_pShaderManager->setVec4Value(g_ColorValueName, currentColor);
-	}
+	m_bUseTexture = false;
+	m_bTranslucentColor = (alphaValue < 1.0f);
+	m_drawState.color = currentColor;
 }
 
 /***********************************************************
@@ -316,16 +526,508 @@ void SceneManager::SetShaderColor(
  *  associated with the passed in ID into the shader.
  ***********************************************************/
 void SceneManager::SetShaderTexture(
-	std::string textureTag)
+	int textureSlot)
 {
-	if (NULL != m_pShaderManager)
+	m_bUseTexture = true;
+	m_drawState.textureSlot = textureSlot;
+}
+
+/***********************************************************
+ *  GetShaderVariantKey()
+ *
+ *  This method is used for getting the key of the shader
+ *  variant that matches the current texture, lighting and
+ *  color state, so the fragment shader never branches on
+ *  these at runtime.  Untextured draws keep the color alpha
+ *  and unlit textured draws keep the texture alpha,
+ *  matching the output of the previous single shader.
+ ***********************************************************/
+unsigned int SceneManager::GetShaderVariantKey() const
+{
+	unsigned int features = 0;
+	unsigned int lightCount = 0;
+
+	if (m_bUseTexture)
+	{
+		features |= SHADER_FEATURE_TEXTURE;
+	}
+	if (m_bUseLighting)
+	{
+		features |= SHADER_FEATURE_LIGHTING;
+		lightCount = (unsigned int)m_activeLightCount;
+	}
+	if (m_bUseTexture ? (m_bUseLighting == false) : m_bTranslucentColor)
+	{
+		features |= SHADER_FEATURE_ALPHA;
+	}
+
+	return(MakeShaderVariantKey(features, lightCount));
+}
+
+/***********************************************************
+ *  SetActiveLightCount()
+ *
+ *  This method is used for setting how many of the light
+ *  slots are evaluated by the lit shader variants.
+ ***********************************************************/
+void SceneManager::SetActiveLightCount(int lightCount)
+{
+	m_activeLightCount = std::max(0, std::min(lightCount, (int)TOTAL_LIGHTS));
+}
+
+/***********************************************************
+ *  SubmitDraw()
+ *
+ *  This method is used for queueing the current draw state.
+ *  The sort key groups draws by shader variant, texture,
+ *  material and mesh, and orders them by view distance.
+ ***********************************************************/
+void SceneManager::SubmitDraw(unsigned int meshKey)
+{
+	DRAW_PACKET packet = m_drawState;
+	packet.variantKey = GetShaderVariantKey();
+
+	RenderQueue::RenderPass pass = (packet.variantKey & SHADER_FEATURE_ALPHA) ?
+		RenderQueue::PASS_TRANSLUCENT : RenderQueue::PASS_OPAQUE;
+	// feature bits and light count packed into the variant field
+	unsigned int variant = (packet.variantKey & 0x7) |
+		((packet.variantKey >> SHADER_LIGHT_COUNT_SHIFT) << 3);
+	unsigned int texture = (packet.variantKey & SHADER_FEATURE_TEXTURE) ?
+		(unsigned int)(packet.textureSlot + 1) : 0;
+	// the translation of the world matrix is the position
+	glm::vec3 position = glm::vec3(packet.pTransforms->GetWorld(packet.transform)[3]);
+	float depth = glm::length(position - m_viewPosition) / g_MaxSortDistance;
+
+	uint64_t key = RenderQueue::MakeKey(pass, variant,
+		(unsigned int)packet.materialIndex, texture, meshKey, depth);
+	m_renderQueue.Push(key, (uint32_t)m_drawPackets.size());
+	m_drawPackets.push_back(packet);
+}
+
+/***********************************************************
+ *  FlushRenderQueue()
+ *
+ *  This method is used for sorting the draws queued this
+ *  frame and issuing them.  The model matrix, color, UV
+ *  scale and material of every draw are read from the
+ *  instance buffer, so consecutive sorted draws of the
+ *  same mesh become one instanced draw command.  All the
+ *  commands that share the shader variant and texture are
+ *  issued with a single multi-draw call.  The draws culled
+ *  on the GPU are dispatched to the compute shader first,
+ *  and each of their calls draws the commands it wrote.
+ *  With deferred shading the opaque draws write the
+ *  G-buffer, which is lit before the translucent draws.
+ *  The GPU time of the dispatch and the draws is measured.
+ ***********************************************************/
+void SceneManager::FlushRenderQueue()
+{
+	m_renderQueue.Sort();
+	m_drawCallCount = 0;
+	m_drawCommandCount = 0;
+
+	// the instance data is written in sorted order so that
+	// every batch is a contiguous range of the buffer
+	size_t count = m_renderQueue.Size();
+	m_instances.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		const DRAW_PACKET& packet = m_drawPackets[m_renderQueue[i].payload];
+		ShapeMeshes::INSTANCE_DATA& instance = m_instances[i];
+		instance.model = packet.pTransforms->GetWorld(packet.transform);
+		instance.color = packet.color;
+		instance.uvScale = packet.uvScale;
+		instance.materialIndex = packet.materialIndex;
+		instance.padding = 0;
+	}
+	if (count > 0)
+	{
+		m_basicMeshes->UploadInstances(&m_instances[0], count);
+	}
+
+	// split the sorted draws into submissions, the ones culled
+	// on the GPU each become a pass of the GPU culler
+	m_submissions.clear();
+	m_gpuCuller.Clear();
+	size_t first = 0;
+	while (first < count)
+	{
+		const DRAW_PACKET& packet = m_drawPackets[m_renderQueue[first].payload];
+
+		SUBMISSION submission;
+		submission.first = first;
+		submission.last = first;
+		while ((submission.last < count) &&
+			CanShareSubmission(packet, m_drawPackets[m_renderQueue[submission.last].payload]))
+		{
+			submission.last++;
+		}
+		submission.gpuPass = packet.bGpuCulled ? AddGpuCullPass(submission.first, submission.last) : NO_GPU_PASS;
+		m_submissions.push_back(submission);
+
+		first = submission.last;
+	}
+
+	glBeginQuery(GL_TIME_ELAPSED, m_gpuTimerQueries[m_gpuTimerFrame & 1]);
+
+	if (m_gpuCuller.GetItemCount() > 0)
+	{
+		GpuCuller::GPU_CULL_PARAMS params;
+		params.viewProjection = m_viewProjection;
+		for (int i = 0; i < 6; i++)
+		{
+			params.planes[i] = m_frustumCuller.GetPlane(i);
+		}
+		params.lodProjectionScale = m_lodProjectionScale;
+		memcpy(params.lodThresholds, g_LodThresholds, sizeof(params.lodThresholds));
+		params.lodHysteresis = g_LodHysteresis;
+		params.bLodSelection = m_bLodSelection;
+		params.lodSlotCount = m_lodSlotCount;
+		params.pOcclusionCuller = (m_bOcclusionCulling && (m_occlusionCuller.GetOccluderTriangleCount() > 0)) ?
+			&m_occlusionCuller : NULL;
+		m_gpuCuller.Dispatch(params);
+
+		// the counts of the GPU culled objects arrive a few frames
+		// late, they are added to the counts of the CPU culled ones
+		GpuCuller::GPU_CULL_STATS stats;
+		if (m_gpuCuller.GetStats(stats))
+		{
+			m_cullTestedCount += stats.testedCount;
+			m_culledCount += stats.culledCount;
+			m_occludedCount += stats.occludedCount;
+			m_fullTriangleCount += stats.fullTriangleCount;
+			m_lodTriangleCount += stats.lodTriangleCount;
+			m_gpuCullStatsLatency = m_gpuCuller.GetStatsLatency();
+		}
+	}
+
+	// the culling dispatch uses the same storage bindings
+	m_lightClusterer.Bind();
+
+	// with deferred shading the opaque draws, sorted first, only
+	// write the G-buffer, which is lit before the translucent draws
+	bool bGeometryPass = m_bDeferredShading && BeginGeometryPass();
+	for (size_t i = 0; i < m_submissions.size(); i++)
+	{
+		const SUBMISSION& submission = m_submissions[i];
+		unsigned int variantKey = m_drawPackets[m_renderQueue[submission.first].payload].variantKey;
+		if (bGeometryPass)
+		{
+			if (variantKey & SHADER_FEATURE_ALPHA)
+			{
+				LightGBuffer();
+				bGeometryPass = false;
+			}
+			else
+			{
+				variantKey = (variantKey & (SHADER_FEATURE_TEXTURE | SHADER_FEATURE_LIGHTING)) |
+					SHADER_FEATURE_GBUFFER;
+			}
+		}
+		DrawSubmission(submission, variantKey);
+	}
+	if (bGeometryPass)
+	{
+		LightGBuffer();
+	}
+	m_basicMeshes->SetInstanceRange(0, 1);
+
+	// read the time of the frame before, once the GPU is done
+	// with it, so the CPU never waits for the result
+	glEndQuery(GL_TIME_ELAPSED);
+	m_gpuTimerFrame++;
+	GLuint previousQuery = m_gpuTimerQueries[m_gpuTimerFrame & 1];
+	GLint bAvailable = GL_FALSE;
+	if (m_gpuTimerFrame > 1)
+	{
+		glGetQueryObjectiv(previousQuery, GL_QUERY_RESULT_AVAILABLE, &bAvailable);
+	}
+	if (bAvailable)
+	{
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(previousQuery, GL_QUERY_RESULT, &nanoseconds);
+		m_sceneGpuMilliseconds = nanoseconds / 1000000.0;
+	}
+
+	m_renderQueue.Clear();
+	m_drawPackets.clear();
+}
+
+/***********************************************************
+ *  DrawSubmission()
+ *
+ *  This method is used for issuing the draws of one
+ *  submission with the passed in shader variant.  The draws
+ *  culled on the GPU are drawn with the commands the
+ *  compute shader wrote, the others are batched into
+ *  instanced commands of one multi-draw call.
+ ***********************************************************/
+void SceneManager::DrawSubmission(const SUBMISSION& submission, unsigned int variantKey)
+{
+	const DRAW_PACKET& packet = m_drawPackets[m_renderQueue[submission.first].payload];
+
+	m_pShaderManager->UseVariant(variantKey);
+	if (variantKey & SHADER_FEATURE_TEXTURE)
+	{
+		m_pShaderManager->setSampler2DValue(m_uniforms.objectTexture, packet.textureSlot);
+	}
+
+	if (submission.gpuPass != NO_GPU_PASS)
+	{
+		// the commands and the number of them are on the GPU
+		GLintptr indirectOffset;
+		GLintptr drawCountOffset;
+		GLsizei maxDrawCount;
+		m_gpuCuller.GetPassDraw(submission.gpuPass, indirectOffset, drawCountOffset, maxDrawCount);
+		m_basicMeshes->SubmitIndirectCount(m_gpuCuller.GetCommandBuffer(), indirectOffset,
+			m_gpuCuller.GetDrawCountBuffer(), drawCountOffset, maxDrawCount,
+			m_gpuCuller.GetInstanceBuffer());
+		m_drawCallCount++;
+		return;
+	}
+
+	m_basicMeshes->BeginCommands();
+	size_t last = submission.first;
+	while (last < submission.last)
+	{
+		const DRAW_PACKET& batch = m_drawPackets[m_renderQueue[last].payload];
+
+		size_t batchEnd = last + 1;
+		while ((batchEnd < submission.last) &&
+			CanInstanceTogether(batch, m_drawPackets[m_renderQueue[batchEnd].payload]))
+		{
+			batchEnd++;
+		}
+
+		m_basicMeshes->SetInstanceRange((GLuint)last, (GLsizei)(batchEnd - last));
+		m_basicMeshes->DrawRecord(batch.draw);
+
+		last = batchEnd;
+	}
+	m_drawCommandCount += (unsigned int)m_basicMeshes->SubmitCommands();
+	m_drawCallCount++;
+}
+
+/***********************************************************
+ *  BeginGeometryPass()
+ *
+ *  This method is used for sizing the G-buffer to the
+ *  viewport and binding it in place of the framebuffer
+ *  being drawn, which is kept for the lighting pass.
+ *  Returns false when the G-buffer cannot be created, the
+ *  frame is then shaded forward.
+ ***********************************************************/
+bool SceneManager::BeginGeometryPass()
+{
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	if (!m_gBuffer.Resize(viewport[2], viewport[3]))
+	{
+		return(false);
+	}
+
+	GLint framebuffer = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+	m_deferredFramebuffer = (GLuint)framebuffer;
+
+	m_gBuffer.BeginGeometryPass();
+	return(true);
+}
+
+/***********************************************************
+ *  LightGBuffer()
+ *
+ *  This method is used for the lighting pass of deferred
+ *  shading.  One triangle over the screen shades every
+ *  pixel of the G-buffer once, with the point lights of
+ *  its cluster, into the framebuffer the geometry pass
+ *  replaced.  The depth of the G-buffer is written along
+ *  so the translucent draws that follow are hidden by it.
+ ***********************************************************/
+void SceneManager::LightGBuffer()
+{
+	GLStateCache* pStateCache = m_pShaderManager->GetStateCache();
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_deferredFramebuffer);
+
+	m_pShaderManager->UseVariant(MakeShaderVariantKey(SHADER_FEATURE_LIGHTING | SHADER_FEATURE_DEFERRED,
+		(unsigned int)m_activeLightCount));
+	m_pShaderManager->setSampler2DValue(m_uniforms.gbufferAlbedo, GBuffer::ALBEDO_UNIT);
+	m_pShaderManager->setSampler2DValue(m_uniforms.gbufferNormal, GBuffer::NORMAL_UNIT);
+	m_pShaderManager->setSampler2DValue(m_uniforms.gbufferDepth, GBuffer::DEPTH_UNIT);
+	m_gBuffer.BindTextures(pStateCache);
+
+	glDepthFunc(GL_ALWAYS);
+	m_gBuffer.DrawFullScreen(pStateCache);
+	glDepthFunc(GL_LESS);
+	m_drawCallCount++;
+}
+
+/***********************************************************
+ *  AddGpuCullPass()
+ *
+ *  This method is used for giving the draws of a submission
+ *  to the GPU culler as one pass.  Every draw becomes an
+ *  object with its world box and bounding sphere and the
+ *  draw command of each of its levels of detail.  Shapes
+ *  whose parts are not next to each other in the index
+ *  buffer add an object for every part, without levels.
+ ***********************************************************/
+GLuint SceneManager::AddGpuCullPass(size_t first, size_t last)
+{
+	GLuint pass = m_gpuCuller.BeginPass();
+	for (size_t i = first; i < last; i++)
+	{
+		const DRAW_PACKET& packet = m_drawPackets[m_renderQueue[i].payload];
+		const ShapeMeshes::GEOMETRY_BOUNDS& bounds = m_basicMeshes->GetGeometryBounds(packet.draw.geometry);
+
+		GpuCuller::GPU_CULL_ITEM item;
+		item.model = packet.pTransforms->GetWorld(packet.transform);
+		item.color = packet.color;
+		item.boxMin = glm::vec4(bounds.boxMin, packet.uvScale.x);
+		item.boxMax = glm::vec4(bounds.boxMax, packet.uvScale.y);
+		item.sphere = glm::vec4(bounds.sphereCenter, bounds.sphereRadius);
+		item.materialIndex = packet.materialIndex;
+		item.lodSlot = packet.lodSlot;
+
+		ShapeMeshes::DRAW_ELEMENTS_COMMAND commands[3];
+		if ((packet.draw.geometry < m_lodChains.size()) && (m_lodChains[packet.draw.geometry].levelCount > 1))
+		{
+			const LOD_CHAIN& chain = m_lodChains[packet.draw.geometry];
+			ShapeMeshes::DRAW_ELEMENTS_COMMAND levels[MAX_LOD_LEVELS];
+			for (int level = 0; level < chain.levelCount; level++)
+			{
+				m_basicMeshes->GetDrawCommands(chain.geometries[level], packet.draw.parts, commands);
+				levels[level] = commands[0];
+			}
+			m_gpuCuller.AddItem(item, levels, chain.levelCount);
+			continue;
+		}
+
+		int commandCount = m_basicMeshes->GetDrawCommands(packet.draw.geometry, packet.draw.parts, commands);
+		for (int c = 0; c < commandCount; c++)
+		{
+			m_gpuCuller.AddItem(item, &commands[c], 1);
+		}
+	}
+	return(pass);
+}
+
+/***********************************************************
+ *  CheckGpuCulling()
+ *
+ *  This method is used for checking the GPU culling of the
+ *  last frame against the CPU.  The results of the compute
+ *  shader are read back, and every object is tested again
+ *  with the frustum culler, then with the occlusion culler
+ *  when the shader tested against it, and when visible is
+ *  given its level of detail starting from the level the
+ *  shader saw as drawn before.
+ ***********************************************************/
+bool SceneManager::CheckGpuCulling(GPU_CULL_CHECK& check)
+{
+	memset(&check, 0, sizeof(check));
+
+	std::vector<uint32_t> results;
+	if (!m_gpuCuller.ReadResults(results))
+	{
+		return(false);
+	}
+
+	m_frustumCuller.Clear();
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const GpuCuller::GPU_CULL_ITEM& item = m_gpuCuller.GetItem(i);
+		m_frustumCuller.AddBox(glm::vec3(item.boxMin), glm::vec3(item.boxMax), item.model);
+	}
+	m_frustumCuller.Cull();
+
+	check.itemCount = (unsigned int)results.size();
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const GpuCuller::GPU_CULL_ITEM& item = m_gpuCuller.GetItem(i);
+		bool bGpuInside = (results[i] != 0);
+		bool bCpuInside = m_frustumCuller.IsVisible(i);
+		if (bGpuInside != bCpuInside)
+		{
+			check.visibilityMismatches++;
+			continue;
+		}
+
+		bool bGpuVisible = (results[i] & 1) != 0;
+		bool bCpuVisible = bCpuInside;
+		if (bCpuInside && m_gpuCuller.WasOcclusionTested())
+		{
+			glm::vec3 boxMin;
+			glm::vec3 boxMax;
+			m_frustumCuller.GetBox(i, boxMin, boxMax);
+			bCpuVisible = m_occlusionCuller.IsVisible(boxMin, boxMax);
+		}
+		check.gpuVisibleCount += bGpuVisible ? 1 : 0;
+		check.cpuVisibleCount += bCpuVisible ? 1 : 0;
+		if (bGpuVisible != bCpuVisible)
+		{
+			check.occlusionMismatches++;
+			continue;
+		}
+
+		if (bCpuVisible && (item.levelCount > 1))
+		{
+			int previousLevel = (int)((results[i] >> 8) & 0xFF);
+			int gpuLevel = (int)((results[i] >> 16) & 0xFF);
+			int cpuLevel = m_bLodSelection ?
+				SelectLodLevel(item.sphere, item.model, (int)item.levelCount, previousLevel) : 0;
+			if (gpuLevel != cpuLevel)
+			{
+				check.lodMismatches++;
+			}
+		}
+	}
+
+	std::cout << "GPU culling check: " << check.itemCount << " objects, "
+		<< check.gpuVisibleCount << " visible on the GPU, " << check.cpuVisibleCount << " on the CPU, "
+		<< check.visibilityMismatches << " frustum, " << check.occlusionMismatches << " occlusion and "
+		<< check.lodMismatches << " level of detail mismatches" << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *  CanShareSubmission()
+ *
+ *  This method is used for checking whether two queued
+ *  draws use the same shader variant and texture and are
+ *  both culled on the same side, so
+ *  they can be issued with the same multi-draw call.
+ ***********************************************************/
+bool SceneManager::CanShareSubmission(const DRAW_PACKET& first, const DRAW_PACKET& second) const
+{
+	if ((first.variantKey != second.variantKey) ||
+		(first.bGpuCulled != second.bGpuCulled))
+	{
+		return(false);
+	}
+	if ((first.variantKey & SHADER_FEATURE_TEXTURE) &&
+		(first.textureSlot != second.textureSlot))
 	{
-		m_pShaderManager->setIntValue(g_UseTextureName, true);
+		return(false);
+	}
+	return(true);
+}
 
-		int textureID = -1;
-		textureID = FindTextureSlot(textureTag);
-		m_pShaderManager->setSampler2DValue(g_TextureValueName, textureID);
+/***********************************************************
+ *  CanInstanceTogether()
+ *
+ *  This method is used for checking whether two queued
+ *  draws only differ in their per-instance data.
+ ***********************************************************/
+bool SceneManager::CanInstanceTogether(const DRAW_PACKET& first, const DRAW_PACKET& second) const
+{
+	if (!CanShareSubmission(first, second) ||
+		(first.draw.geometry != second.draw.geometry) ||
+		(first.draw.parts != second.draw.parts))
+	{
+		return(false);
 	}
+	return(true);
 }
 
 /***********************************************************
@@ -336,36 +1038,24 @@ void SceneManager::SetShaderTexture(
  ***********************************************************/
 void SceneManager::SetTextureUVScale(float u, float v)
 {
-	if (NULL != m_pShaderManager)
-	{
-		m_pShaderManager->setVec2Value("UVscale", glm::vec2(u, v));
-	}
+	m_drawState.uvScale = glm::vec2(u, v);
 }
 
 /***********************************************************
  *  SetShaderMaterial()
  *
- *  This method is used for passing the material values
- *  into the shader.
+ *  This method is used for selecting the material values
+ *  in the shader.  Materials that are not defined fall
+ *  back to the default material.
  ***********************************************************/
 void SceneManager::SetShaderMaterial(
-	std::string materialTag)
+	int materialIndex)
 {
-	if (m_objectMaterials.size() > 0)
+	if (materialIndex < 0)
 	{
-		OBJECT_MATERIAL material;
-		bool bReturn = false;
-
-		bReturn = FindMaterial(materialTag, material);
-		if (bReturn == true)
-		{
-			m_pShaderManager->setVec3Value("material.ambientColor", material.ambientColor);
-			m_pShaderManager->setFloatValue("material.ambientStrength", material.ambientStrength);
-			m_pShaderManager->setVec3Value("material.diffuseColor", material.diffuseColor);
-			m_pShaderManager->setVec3Value("material.specularColor", material.specularColor);
-			m_pShaderManager->setFloatValue("material.shininess", material.shininess);
-		}
+		materialIndex = 0;
 	}
+	m_drawState.materialIndex = materialIndex;
 }
 
 /***********************************************************
@@ -439,7 +1129,7 @@ void SceneManager::DefineObjectMaterials()
 	defaultMaterial.diffuseColor = glm::vec3(0.5f, 0.5f, 0.5f);
 	defaultMaterial.specularColor = glm::vec3(0.2f, 0.2f, 0.2f);
 	defaultMaterial.shininess = 16.0;
-	defaultMaterial.tag = "default";
+	defaultMaterial.tag = InternString("default");
 
 	m_objectMaterials.push_back(defaultMaterial);
 
@@ -449,7 +1139,7 @@ void SceneManager::DefineObjectMaterials()
 	metalMaterial.diffuseColor = glm::vec3(0.2f, 0.2f, 0.2f);
 	metalMaterial.specularColor = glm::vec3(0.5f, 0.5f, 0.5f);
 	metalMaterial.shininess = 22.0;
-	metalMaterial.tag = "metal";
+	metalMaterial.tag = InternString("metal");
 
 	m_objectMaterials.push_back(metalMaterial);
 
@@ -459,7 +1149,7 @@ void SceneManager::DefineObjectMaterials()
 	woodMaterial.diffuseColor = glm::vec3(0.3f, 0.3f, 0.3f);
 	woodMaterial.specularColor = glm::vec3(0.3f, 0.3f, 0.3);
 	woodMaterial.shininess = 22.0;
-	woodMaterial.tag = "wood";
+	woodMaterial.tag = InternString("wood");
 
 	m_objectMaterials.push_back(woodMaterial);
 
@@ -469,7 +1159,7 @@ void SceneManager::DefineObjectMaterials()
 	frameMaterial.diffuseColor = glm::vec3(0.3f, 0.3f, 0.3f);
 	frameMaterial.specularColor = glm::vec3(0.1f, 0.1f, 0.01);
 	frameMaterial.shininess = 80.0;
-	frameMaterial.tag = "picture frame";
+	frameMaterial.tag = InternString("picture frame");
 
 	m_objectMaterials.push_back(frameMaterial);
 
@@ -479,7 +1169,7 @@ void SceneManager::DefineObjectMaterials()
 	woodNoShineMaterial.diffuseColor = glm::vec3(0.3f, 0.3f, 0.3f);
 	woodNoShineMaterial.specularColor = glm::vec3(0.3f, 0.3f, 0.3);
 	woodNoShineMaterial.shininess = 0.3;
-	woodNoShineMaterial.tag = "woodNoShine";
+	woodNoShineMaterial.tag = InternString("woodNoShine");
 
 	m_objectMaterials.push_back(woodNoShineMaterial);
 
@@ -489,7 +1179,7 @@ void SceneManager::DefineObjectMaterials()
 	wallMaterial.diffuseColor = glm::vec3(0.5f, 0.5f, 0.5f);
 	wallMaterial.specularColor = glm::vec3(0.01f, 0.01f, 0.01f);
 	wallMaterial.shininess = 3.0;
-	wallMaterial.tag = "wall";
+	wallMaterial.tag = InternString("wall");
 
 	m_objectMaterials.push_back(wallMaterial);
 
@@ -499,9 +1189,16 @@ void SceneManager::DefineObjectMaterials()
 	glassMaterial.diffuseColor = glm::vec3(0.3f, 0.3f, 0.3f);
 	glassMaterial.specularColor = glm::vec3(0.1f, 0.1f, 0.01f);
 	glassMaterial.shininess = 12.0;
-	glassMaterial.tag = "glass";
+	glassMaterial.tag = InternString("glass");
 
 	m_objectMaterials.push_back(glassMaterial);
+
+	// index the materials by tag for FindMaterialIndex()
+	m_materialIndices.clear();
+	for (size_t i = 0; i < m_objectMaterials.size(); i++)
+	{
+		m_materialIndices[m_objectMaterials[i].tag] = (int)i;
+	}
 }
 
 /***********************************************************
@@ -509,49 +1206,157 @@ void SceneManager::DefineObjectMaterials()
  *
  *  This method is called to add and configure the light
  *  sources for the 3D scene.  There are up to 4 light sources.
+ *  The lights are written into a uniform buffer that is
+ *  uploaded with a single call instead of one per field.
  ***********************************************************/
 void SceneManager::SetupSceneLights()
 {
-	m_pShaderManager->setBoolValue(g_UseLightingName, true);
+	m_bUseLighting = true;
+
+	if (0 == m_lightBlockUBO)
+	{
+		m_lightBlockUBO = m_pShaderManager->CreateUniformBuffer(
+			LIGHT_BLOCK_BINDING, sizeof(m_lights));
+	}
+
+	LIGHT_SOURCE light;
 
 	// Light 0
-	m_pShaderManager->setVec3Value("lightSources[0].position", -50.0f, 30.0f, 0.0f);
+	memset(&light, 0, sizeof(light));
+	light.position = glm::vec3(-50.0f, 30.0f, 0.0f);
 	// Warm lighting
-	m_pShaderManager->setVec3Value("lightSources[0].ambientColor", 0.1f, 0.1f, 0.01f);
-	m_pShaderManager->setFloatValue("lightSources[0].focalStrength", 10.0f);
-	m_pShaderManager->setFloatValue("lightSources[0].specularIntensity", 0.1f);
+	light.ambientColor = glm::vec3(0.1f, 0.1f, 0.01f);
+	light.focalStrength = 10.0f;
+	light.specularIntensity = 0.1f;
+	SetLight(0, light);
 
 	// Light 1
-	m_pShaderManager->setVec3Value("lightSources[1].position", 0.0f, 8.0f, 15.0f);
+	memset(&light, 0, sizeof(light));
+	light.position = glm::vec3(0.0f, 8.0f, 15.0f);
 	// Warm lighting
-	m_pShaderManager->setVec3Value("lightSources[1].ambientColor", 0.1f, 0.1f, 0.01f);
-	m_pShaderManager->setVec3Value("lightSources[1].diffuseColor", 0.5f, 0.5f, 0.5f);
-	m_pShaderManager->setVec3Value("lightSources[1].specularColor", 0.2f, 0.2f, 0.2f);
-	m_pShaderManager->setFloatValue("lightSources[1].focalStrength", 5.0f);
-	m_pShaderManager->setFloatValue("lightSources[1].specularIntensity", 0.1f);
+	light.ambientColor = glm::vec3(0.1f, 0.1f, 0.01f);
+	light.diffuseColor = glm::vec3(0.5f, 0.5f, 0.5f);
+	light.specularColor = glm::vec3(0.2f, 0.2f, 0.2f);
+	light.focalStrength = 5.0f;
+	light.specularIntensity = 0.1f;
+	SetLight(1, light);
 
 	// Light 2
-	m_pShaderManager->setVec3Value("lightSources[2].position", 50.0f, 30.0f, 0.0f);
-	m_pShaderManager->setVec3Value("lightSources[2].diffuseColor", 0.5f, 0.5f, 0.5f);
-	m_pShaderManager->setFloatValue("lightSources[2].focalStrength", 10.0f);
-	m_pShaderManager->setFloatValue("lightSources[2].specularIntensity", 0.1f);
-	
+	memset(&light, 0, sizeof(light));
+	light.position = glm::vec3(50.0f, 30.0f, 0.0f);
+	light.diffuseColor = glm::vec3(0.5f, 0.5f, 0.5f);
+	light.focalStrength = 10.0f;
+	light.specularIntensity = 0.1f;
+	SetLight(2, light);
+
+	UpdateLightBlock();
 }
 
 /***********************************************************
- *  PrepareScene()
+ *  SetLight()
  *
- *  This method is used for preparing the 3D scene by loading
- *  the shapes, textures in memory to support the 3D scene 
+ *  This method is used for replacing a scene light at
+ *  runtime.  The change is uploaded before the next frame.
+ ***********************************************************/
+void SceneManager::SetLight(int index, const LIGHT_SOURCE& light)
+{
+	if (index < 0 || index >= TOTAL_LIGHTS)
+	{
+		return;
+	}
+
+	if (memcmp(&m_lights[index], &light, sizeof(LIGHT_SOURCE)) != 0)
+	{
+		m_lights[index] = light;
+		m_bLightsDirty = true;
+	}
+}
+
+/***********************************************************
+ *  SetTestPointLightCount()
+ *
+ *  This method is used for replacing the test point lights
+ *  with the passed in number of lights of random colors and
+ *  sizes scattered around the room.  The same count always
+ *  places the same lights.
+ ***********************************************************/
+void SceneManager::SetTestPointLightCount(int count)
+{
+	m_testPointLightCount = std::max(count, 0);
+	m_lightClusterer.Truncate(m_scenePointLightCount);
+
+	std::mt19937 generator(g_TestLightSeed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	for (int i = 0; i < m_testPointLightCount; i++)
+	{
+		LightClusterer::POINT_LIGHT light;
+		light.position = g_TestLightMin + (g_TestLightMax - g_TestLightMin) *
+			glm::vec3(unit(generator), unit(generator), unit(generator));
+		light.radius = g_TestLightMinRadius + (g_TestLightMaxRadius - g_TestLightMinRadius) * unit(generator);
+		light.color = glm::vec3(unit(generator), unit(generator), unit(generator));
+		light.intensity = 1.0f;
+		m_lightClusterer.AddLight(light);
+	}
+}
+
+/***********************************************************
+ *  UpdateLightBlock()
+ *
+ *  This method is used for uploading all of the scene lights
+ *  with one buffer write, only when a light has changed.
+ ***********************************************************/
+void SceneManager::UpdateLightBlock()
+{
+	if ((m_bLightsDirty == false) || (0 == m_lightBlockUBO))
+	{
+		return;
+	}
+
+	m_pShaderManager->UpdateUniformBuffer(m_lightBlockUBO, m_lights, sizeof(m_lights));
+	m_bLightsDirty = false;
+}
+
+/***********************************************************
+ *  UpdateLightClusters()
+ *
+ *  This method is used for building the point light lists
+ *  of the clusters for the view of the frame and uploading
+ *  them with the lights, timing the build.
+ ***********************************************************/
+void SceneManager::UpdateLightClusters()
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	Clock::time_point start = Clock::now();
+	m_lightClusterer.Build(m_view, m_projection);
+	m_lightClusterMicroseconds = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+	m_lightClusterer.Upload();
+}
+
+/***********************************************************
+ *  PrepareScene()
+ *
+ *  This method is used for preparing the 3D scene by loading
+ *  the shapes, textures in memory to support the 3D scene 
  *  rendering
  ***********************************************************/
 void SceneManager::PrepareScene()
 {
+	ResolveUniformHandles();
 
 	LoadSceneTextures();
 	DefineObjectMaterials();
+	UploadMaterials();
 	SetupSceneLights();
 
+	glGenQueries(2, m_gpuTimerQueries);
+
+	// culling stays on the CPU when the compute shader is not available
+	if (!m_gpuCuller.Initialize(m_pShaderManager, g_CullingShaderFile))
+	{
+		std::cout << "GPU culling is not supported, culling on the CPU" << std::endl;
+	}
+
 	// only one instance of a particular mesh needs to be
 	// loaded in memory no matter how many times it is drawn
 	// in the rendered 3D scene
@@ -567,26 +1372,34 @@ void SceneManager::PrepareScene()
 	m_basicMeshes->LoadSphereMesh();
 	m_basicMeshes->LoadTaperedCylinderMesh(); // Vase
 	m_basicMeshes->LoadTorusMesh();
+
+	// the static scene is data, loaded once into its own store
+	LoadStaticScene(g_StaticSceneFile);
 }
 
-void SceneManager::AddMeshToScene(std::string tag, glm::vec3 position, 
+SceneStore::Handle SceneManager::AddMeshToScene(StringID tag, glm::vec3 position, 
 	glm::vec3 rotation, glm::vec3 scale, 
-	std::string materialTag, std::string textureTag, glm::vec2 uvScale,
-	glm::vec4 shaderColor, std::function<void()> drawFunction)
+	StringID materialTag, StringID textureTag, glm::vec2 uvScale,
+	glm::vec4 shaderColor, ShapeMeshes::DRAW_RECORD drawRecord,
+	SceneStore::Handle parent)
 {
 
-	MESH_OBJECT newMesh;
+	SceneStore::OBJECT_DESC newMesh;
 	newMesh.tag = tag;
 	newMesh.position = position;
 	newMesh.rotation = rotation;
 	newMesh.scale = scale;
 	newMesh.materialTag = materialTag;
+	newMesh.materialIndex = std::max(0, FindMaterialIndex(materialTag));
 	newMesh.textureTag = textureTag;
+	newMesh.textureSlot = FindTextureSlot(textureTag);
 	newMesh.uvScale = uvScale;
-	newMesh.shaderColor = shaderColor;
-	newMesh.drawFunction = drawFunction;
+	newMesh.color = shaderColor;
+	newMesh.drawRecord = drawRecord;
+	newMesh.flags = 0;
+	newMesh.parent = parent;
 
-	m_meshes.push_back(newMesh);
+	return(m_sceneStore.Add(newMesh));
 
 }
 
@@ -597,9 +1410,9 @@ void SceneManager::AddMeshToScene(std::string tag, glm::vec3 position,
  ***********************************************************/
 void SceneManager::AddBox()
 {
-	AddMeshToScene("box", glm::vec3(0.0f, 0.0f, 0.0f), 
+	AddMeshToScene(InternString("box"), glm::vec3(0.0f, 0.0f, 0.0f), 
 		glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), 
-		"", "", { 1.0f, 1.0f }, { 1.0, 1.0, 1.0, 1.0 }, [this]() { m_basicMeshes->DrawBoxMesh(); });
+		EMPTY_STRING_ID, EMPTY_STRING_ID, { 1.0f, 1.0f }, { 1.0, 1.0, 1.0, 1.0 }, ShapeMeshes::MakeDrawRecord(ShapeMeshes::MESH_BOX));
 }
 
 /***********************************************************
@@ -609,9 +1422,9 @@ void SceneManager::AddBox()
  ***********************************************************/
 void SceneManager::AddCone()
 {
-	AddMeshToScene("cone", glm::vec3(0.0f, 0.0f, 0.0f),
+	AddMeshToScene(InternString("cone"), glm::vec3(0.0f, 0.0f, 0.0f),
 		glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f),
-		"", "", { 1.0f, 1.0f }, { 1.0, 1.0, 1.0, 1.0 }, [this]() { m_basicMeshes->DrawConeMesh(); });
+		EMPTY_STRING_ID, EMPTY_STRING_ID, { 1.0f, 1.0f }, { 1.0, 1.0, 1.0, 1.0 }, ShapeMeshes::MakeDrawRecord(ShapeMeshes::MESH_CONE));
 }
 
 /***********************************************************
@@ -621,9 +1434,9 @@ void SceneManager::AddCone()
  ***********************************************************/
 void SceneManager::AddCylinder()
 {
-	AddMeshToScene("cylinder", glm::vec3(0.0f, 0.0f, 0.0f),
+	AddMeshToScene(InternString("cylinder"), glm::vec3(0.0f, 0.0f, 0.0f),
 		glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f),
-		"", "", { 1.0f, 1.0f }, { 1.0, 1.0, 1.0, 1.0 }, [this]() { m_basicMeshes->DrawCylinderMesh(); });
+		EMPTY_STRING_ID, EMPTY_STRING_ID, { 1.0f, 1.0f }, { 1.0, 1.0, 1.0, 1.0 }, ShapeMeshes::MakeDrawRecord(ShapeMeshes::MESH_CYLINDER));
 }
 
 /***********************************************************
@@ -633,9 +1446,9 @@ void SceneManager::AddCylinder()
  ***********************************************************/
 void SceneManager::AddPlane()
 {
-	AddMeshToScene("plane", glm::vec3(0.0f, 0.0f, 0.0f),
+	AddMeshToScene(InternString("plane"), glm::vec3(0.0f, 0.0f, 0.0f),
 		glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f),
-		"", "", { 1.0f, 1.0f }, { 1.0, 1.0, 1.0, 1.0 }, [this]() { m_basicMeshes->DrawPlaneMesh(); });
+		EMPTY_STRING_ID, EMPTY_STRING_ID, { 1.0f, 1.0f }, { 1.0, 1.0, 1.0, 1.0 }, ShapeMeshes::MakeDrawRecord(ShapeMeshes::MESH_PLANE));
 }
 
 /***********************************************************
@@ -645,9 +1458,9 @@ void SceneManager::AddPlane()
  ***********************************************************/
 void SceneManager::AddPrism()
 {
-	AddMeshToScene("prism", glm::vec3(0.0f, 0.0f, 0.0f),
+	AddMeshToScene(InternString("prism"), glm::vec3(0.0f, 0.0f, 0.0f),
 		glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f),
-		"", "", { 1.0f, 1.0f }, { 1.0, 1.0, 1.0, 1.0 }, [this]() { m_basicMeshes->DrawPrismMesh(); });
+		EMPTY_STRING_ID, EMPTY_STRING_ID, { 1.0f, 1.0f }, { 1.0, 1.0, 1.0, 1.0 }, ShapeMeshes::MakeDrawRecord(ShapeMeshes::MESH_PRISM));
 }
 
 /***********************************************************
@@ -657,9 +1470,9 @@ void SceneManager::AddPrism()
  ***********************************************************/
 void SceneManager::AddPyramid3()
 {
-	AddMeshToScene("pyramid3", glm::vec3(0.0f, 0.0f, 0.0f),
+	AddMeshToScene(InternString("pyramid3"), glm::vec3(0.0f, 0.0f, 0.0f),
 		glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f),
-		"", "", { 1.0f, 1.0f }, { 1.0, 1.0, 1.0, 1.0 }, [this]() { m_basicMeshes->DrawPyramid3Mesh(); });
+		EMPTY_STRING_ID, EMPTY_STRING_ID, { 1.0f, 1.0f }, { 1.0, 1.0, 1.0, 1.0 }, ShapeMeshes::MakeDrawRecord(ShapeMeshes::MESH_PYRAMID3));
 }
 
 /***********************************************************
@@ -669,9 +1482,9 @@ void SceneManager::AddPyramid3()
  ***********************************************************/
 void SceneManager::AddPyramid4()
 {
-	AddMeshToScene("pyramid4", glm::vec3(0.0f, 0.0f, 0.0f),
+	AddMeshToScene(InternString("pyramid4"), glm::vec3(0.0f, 0.0f, 0.0f),
 		glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f),
-		"", "", { 1.0f, 1.0f }, { 1.0, 1.0, 1.0, 1.0 }, [this]() { m_basicMeshes->DrawPyramid4Mesh(); });
+		EMPTY_STRING_ID, EMPTY_STRING_ID, { 1.0f, 1.0f }, { 1.0, 1.0, 1.0, 1.0 }, ShapeMeshes::MakeDrawRecord(ShapeMeshes::MESH_PYRAMID4));
 }
 
 /***********************************************************
@@ -681,9 +1494,9 @@ void SceneManager::AddPyramid4()
  ***********************************************************/
 void SceneManager::AddSphere()
 {
-	AddMeshToScene("sphere", glm::vec3(0.0f, 0.0f, 0.0f),
+	AddMeshToScene(InternString("sphere"), glm::vec3(0.0f, 0.0f, 0.0f),
 		glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f),
-		"", "", { 1.0f, 1.0f }, { 1.0, 1.0, 1.0, 1.0 }, [this]() { m_basicMeshes->DrawSphereMesh(); });
+		EMPTY_STRING_ID, EMPTY_STRING_ID, { 1.0f, 1.0f }, { 1.0, 1.0, 1.0, 1.0 }, ShapeMeshes::MakeDrawRecord(ShapeMeshes::MESH_SPHERE));
 }
 
 /***********************************************************
@@ -693,9 +1506,9 @@ void SceneManager::AddSphere()
  ***********************************************************/
 void SceneManager::AddTaperedCylinder()
 {
-	AddMeshToScene("tapered cylinder", glm::vec3(0.0f, 0.0f, 0.0f),
+	AddMeshToScene(InternString("tapered cylinder"), glm::vec3(0.0f, 0.0f, 0.0f),
 		glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f),
-		"", "", { 1.0f, 1.0f }, { 1.0, 1.0, 1.0, 1.0 }, [this]() { m_basicMeshes->DrawTaperedCylinderMesh(); });
+		EMPTY_STRING_ID, EMPTY_STRING_ID, { 1.0f, 1.0f }, { 1.0, 1.0, 1.0, 1.0 }, ShapeMeshes::MakeDrawRecord(ShapeMeshes::MESH_TAPERED_CYLINDER));
 }
 
 /***********************************************************
@@ -705,9 +1518,9 @@ void SceneManager::AddTaperedCylinder()
  ***********************************************************/
 void SceneManager::AddTorus()
 {
-	AddMeshToScene("torus", glm::vec3(0.0f, 0.0f, 0.0f),
+	AddMeshToScene(InternString("torus"), glm::vec3(0.0f, 0.0f, 0.0f),
 		glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f),
-		"", "", { 1.0f, 1.0f }, { 1.0, 1.0, 1.0, 1.0 }, [this]() { m_basicMeshes->DrawTorusMesh(); });
+		EMPTY_STRING_ID, EMPTY_STRING_ID, { 1.0f, 1.0f }, { 1.0, 1.0, 1.0, 1.0 }, ShapeMeshes::MakeDrawRecord(ShapeMeshes::MESH_TORUS));
 }
 
 /***********************************************************
@@ -717,40 +1530,444 @@ void SceneManager::AddTorus()
  ***********************************************************/
 void SceneManager::RenderMeshes()
 {
-	// Loop through all the meshes in the scene and render them
-	for (auto& mesh : m_meshes)
+	// Infinite rotation toggle
+	if (isRotating)
 	{
-		// Infinite rotation toggle
-		if (isRotating)
+		m_sceneStore.RotateAll(0.2f);
+	}
+
+	QueueSceneObjects(m_sceneStore, LOD_SLOT_SCENE_STORE);
+}
+
+/***********************************************************
+ *  QueueSceneObjects()
+ *
+ *  This method is used for queueing a draw for every object
+ *  of a scene store.  The world matrices changed this frame
+ *  are recomposed first, then the local bounding box of
+ *  the geometry of every object is moved to world space and
+ *  tested against the view frustum, and only the objects
+ *  inside it are queued.  Geometries with coarser levels
+ *  are drawn at the level matching their size on screen.
+ *  With GPU culling the opaque objects are all queued and
+ *  culled by the compute shader when the queue is issued,
+ *  each with a level slot taken from its handle, which the
+ *  object keeps while others are added and removed.
+ *  Textured objects set their texture after the color, so
+ *  they use the textured variants.
+ ***********************************************************/
+void SceneManager::QueueSceneObjects(SceneStore& store, uint32_t lodSlotStore)
+{
+	m_transformUpdateCount += (unsigned int)store.UpdateTransforms();
+
+	SceneStore::RENDER_VIEW view = store.GetRenderView();
+	m_frustumCuller.Clear();
+	m_cullObjects.clear();
+	for (size_t i = 0; i < view.count; i++)
+	{
+		unsigned int geometry = view.drawRecords[i].geometry;
+		if (geometry != ShapeMeshes::INVALID_GEOMETRY)
 		{
-		mesh.rotation.y += 0.2f;
-		if (mesh.rotation.y > 360.0f) mesh.rotation.y -= 360.0f;
+			const ShapeMeshes::GEOMETRY_BOUNDS& bounds = m_basicMeshes->GetGeometryBounds(geometry);
+			m_frustumCuller.AddBox(bounds.boxMin, bounds.boxMax, view.worldMatrices[i]);
+			m_cullObjects.push_back((uint32_t)i);
 		}
+	}
+	m_frustumCuller.Cull();
+
+	// opaque objects are culled on the GPU when it is enabled,
+	// translucent objects stay on the CPU as they are drawn in
+	// back to front order
+	bool bGpuCulling = m_bGpuCulling && m_gpuCuller.IsSupported();
+	bool bOcclusion = m_bOcclusionCulling && (m_occlusionCuller.GetOccluderTriangleCount() > 0);
+	for (size_t box = 0; box < m_cullObjects.size(); box++)
+	{
+		size_t i = m_cullObjects[box];
+		const glm::vec4& color = view.colors[i];
+
+		// the store keeps the world matrix of every object
+		m_drawState.pTransforms = &store.GetTransforms();
+		m_drawState.transform = (uint32_t)i;
+		SetShaderMaterial(view.materialIndices[i]);
+		SetShaderTexture(view.textureSlots[i]);
+		SetTextureUVScale(view.uvScales[i].x, view.uvScales[i].y);
+		SetShaderColor(color.r, color.g, color.b, color.a);
+		if (view.flags[i] & SceneStore::OBJECT_FLAG_TEXTURED)
+		{
+			SetShaderTexture(view.textureSlots[i]);
+		}
+		m_drawState.bGpuCulled = bGpuCulling && !(GetShaderVariantKey() & SHADER_FEATURE_ALPHA);
+		m_drawState.lodSlot = (store.GetHandle(i) & SceneStore::HANDLE_SLOT_MASK) * LOD_SLOT_STORE_COUNT + lodSlotStore;
 
-		SetTransformations(mesh.scale, mesh.rotation.x, mesh.rotation.y, mesh.rotation.z, mesh.position);
-		SetShaderMaterial(mesh.materialTag);
-		SetShaderTexture(mesh.textureTag);
-		SetTextureUVScale(mesh.uvScale.x, mesh.uvScale.y);
-		SetShaderColor(mesh.shaderColor.r, mesh.shaderColor.g, mesh.shaderColor.b, mesh.shaderColor.a);
-		
-		if (mesh.drawFunction)
+		// the geometry identifier is the mesh key, so objects of
+		// the same shape are sorted next to each other
+		ShapeMeshes::DRAW_RECORD record = view.drawRecords[i];
+		if (m_drawState.bGpuCulled)
+		{
+			m_drawState.draw = record;
+			SubmitDraw(record.geometry);
+			continue;
+		}
+
+		m_cullTestedCount++;
+		if (!m_frustumCuller.IsVisible(box))
 		{
-			mesh.drawFunction();
+			m_culledCount++;
+			continue;
+		}
+		if (bOcclusion)
+		{
+			glm::vec3 boxMin;
+			glm::vec3 boxMax;
+			m_frustumCuller.GetBox(box, boxMin, boxMax);
+			if (!m_occlusionCuller.IsVisible(boxMin, boxMax))
+			{
+				m_occludedCount++;
+				continue;
+			}
 		}
+
+		GLuint fullIndexCount = m_basicMeshes->GetIndexCount(record.geometry, record.parts);
+		m_fullTriangleCount += fullIndexCount / 3;
+		if ((record.geometry < m_lodChains.size()) && (m_lodChains[record.geometry].levelCount > 1))
+		{
+			const LOD_CHAIN& chain = m_lodChains[record.geometry];
+			int level = 0;
+			if (m_bLodSelection)
+			{
+				const ShapeMeshes::GEOMETRY_BOUNDS& bounds = m_basicMeshes->GetGeometryBounds(record.geometry);
+				level = SelectLodLevel(glm::vec4(bounds.sphereCenter, bounds.sphereRadius),
+					view.worldMatrices[i], chain.levelCount, store.LodLevel(i));
+			}
+			store.LodLevel(i) = (uint8_t)level;
+			record.geometry = chain.geometries[level];
+			m_lodTriangleCount += m_basicMeshes->GetIndexCount(record.geometry, record.parts) / 3;
+		}
+		else
+		{
+			m_lodTriangleCount += fullIndexCount / 3;
+		}
+		m_drawState.draw = record;
+		SubmitDraw(record.geometry);
 	}
+	m_lodSlotCount = std::max(m_lodSlotCount, (uint32_t)store.GetSlotCount() * LOD_SLOT_STORE_COUNT);
 }
 
 /***********************************************************
  *  RemoveMesh()
  *
- *  This method is used for removing a mesh from the scene
+ *  This method is used for removing a mesh from the scene.
+ *  The removed objects leave the spatial hash right away,
+ *  so it never holds a slot a later object takes over.
+ ***********************************************************/
+void SceneManager::RemoveMesh(SceneStore::Handle handle)
+{
+	m_sceneStore.Remove(handle);
+
+	const std::vector<SceneStore::Handle>& removed = m_sceneStore.GetRemovedHandles();
+	for (size_t i = 0; i < removed.size(); i++)
+	{
+		uint32_t slot = removed[i] & SceneStore::HANDLE_SLOT_MASK;
+		if ((slot < m_spatialHandles.size()) && (m_spatialHandles[slot] == removed[i]))
+		{
+			m_spatialHash.Remove(slot);
+			m_spatialHandles[slot] = SceneStore::INVALID_HANDLE;
+		}
+	}
+}
+
+/***********************************************************
+ *  PickMesh()
+ *
+ *  This method is used for finding the mesh object hit
+ *  first by a ray.  The pick tree finds the objects whose
+ *  world boxes the ray passes through, nearest first, and
+ *  each of them is tested exactly against the triangles
+ *  of its geometry.
  ***********************************************************/
-void SceneManager::RemoveMesh(int index)
+SceneStore::Handle SceneManager::PickMesh(const glm::vec3& origin, const glm::vec3& direction)
 {
-	if (index >= 0 && index < m_meshes.size())
+	typedef std::chrono::high_resolution_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	UpdatePickTree();
+
+	SceneStore::Handle handle = SceneStore::INVALID_HANDLE;
+	uint32_t hit = m_pickTree.Intersect(origin, direction, FLT_MAX, &SceneManager::PickObjectTest, this, NULL);
+	if (hit != BoundingVolumeHierarchy::NO_PRIMITIVE)
 	{
-		m_meshes.erase(m_meshes.begin() + index);
+		handle = m_sceneStore.GetHandle(m_pickObjects[hit]);
 	}
+
+	m_lastPickMicroseconds = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+	return(handle);
+}
+
+/***********************************************************
+ *  UpdatePickTree()
+ *
+ *  This method is used for bringing the pick tree up to
+ *  date with the mesh objects.  Adding or removing objects
+ *  changes the primitives, so the tree is built again;
+ *  when objects only moved, the boxes are recomputed and
+ *  the tree is refit.
+ ***********************************************************/
+void SceneManager::UpdatePickTree()
+{
+	// edits made since the last frame are not composed yet
+	m_sceneStore.UpdateTransforms();
+
+	bool bLayoutChanged = !m_bPickTreeValid ||
+		(m_pickLayoutVersion != m_sceneStore.GetLayoutVersion());
+	bool bMoved = (m_pickWorldVersion != m_sceneStore.GetTransforms().GetWorldVersion());
+	if (!bLayoutChanged && !bMoved)
+	{
+		return;
+	}
+
+	SceneStore::RENDER_VIEW view = m_sceneStore.GetRenderView();
+	if (bLayoutChanged)
+	{
+		m_pickObjects.clear();
+		for (size_t i = 0; i < view.count; i++)
+		{
+			if (view.drawRecords[i].geometry != ShapeMeshes::INVALID_GEOMETRY)
+			{
+				m_pickObjects.push_back((uint32_t)i);
+			}
+		}
+	}
+
+	m_pickBoxMins.resize(m_pickObjects.size());
+	m_pickBoxMaxs.resize(m_pickObjects.size());
+	for (size_t i = 0; i < m_pickObjects.size(); i++)
+	{
+		uint32_t index = m_pickObjects[i];
+		const ShapeMeshes::GEOMETRY_BOUNDS& bounds =
+			m_basicMeshes->GetGeometryBounds(view.drawRecords[index].geometry);
+		TransformBounds(bounds.boxMin, bounds.boxMax, view.worldMatrices[index],
+			m_pickBoxMins[i], m_pickBoxMaxs[i]);
+	}
+
+	if (bLayoutChanged)
+	{
+		m_pickTree.Build(m_pickBoxMins.data(), m_pickBoxMaxs.data(), m_pickObjects.size());
+	}
+	else
+	{
+		m_pickTree.Refit(m_pickBoxMins.data(), m_pickBoxMaxs.data());
+	}
+
+	m_pickLayoutVersion = m_sceneStore.GetLayoutVersion();
+	m_pickWorldVersion = m_sceneStore.GetTransforms().GetWorldVersion();
+	m_bPickTreeValid = true;
+}
+
+/***********************************************************
+ *  UpdateSpatialHash()
+ *
+ *  This method is used for bringing the spatial hash up to
+ *  date with the mesh objects before a query.  Nothing is
+ *  done while rendering: the store keeps a mark on every
+ *  object whose world matrix was recomposed, and only
+ *  those objects are moved here.  Added objects are
+ *  recomposed like moved ones, and RemoveMesh() takes the
+ *  removed ones out, so every object is only registered
+ *  from scratch the first time and after the store is
+ *  cleared.
+ ***********************************************************/
+void SceneManager::UpdateSpatialHash()
+{
+	// edits made since the last frame are not composed yet
+	m_sceneStore.UpdateTransforms();
+	m_sceneStore.TakeMovedObjects(m_movedObjects);
+	m_spatialUpdateCount = 0;
+	m_spatialCellChangeCount = 0;
+
+	if (m_bSpatialHashValid)
+	{
+		for (size_t i = 0; i < m_movedObjects.size(); i++)
+		{
+			UpdateSpatialEntry(m_movedObjects[i]);
+		}
+		return;
+	}
+
+	m_spatialHash.Clear();
+	m_spatialHandles.clear();
+	for (size_t i = 0; i < m_sceneStore.Size(); i++)
+	{
+		UpdateSpatialEntry(i);
+	}
+	m_bSpatialHashValid = true;
+}
+
+/***********************************************************
+ *  UpdateSpatialEntry()
+ *
+ *  This method is used for moving the world box of one
+ *  mesh object in the spatial hash.
+ ***********************************************************/
+void SceneManager::UpdateSpatialEntry(size_t index)
+{
+	SceneStore::Handle handle = m_sceneStore.GetHandle(index);
+	uint32_t slot = handle & SceneStore::HANDLE_SLOT_MASK;
+	if (slot >= m_spatialHandles.size())
+	{
+		m_spatialHandles.resize(slot + 1, (SceneStore::Handle)SceneStore::INVALID_HANDLE);
+	}
+	m_spatialHandles[slot] = handle;
+
+	const ShapeMeshes::DRAW_RECORD& record = m_sceneStore.GetDrawRecord(index);
+	if (record.geometry == ShapeMeshes::INVALID_GEOMETRY)
+	{
+		m_spatialHash.Remove(slot);
+		return;
+	}
+
+	const ShapeMeshes::GEOMETRY_BOUNDS& bounds = m_basicMeshes->GetGeometryBounds(record.geometry);
+	glm::vec3 boxMin;
+	glm::vec3 boxMax;
+	TransformBounds(bounds.boxMin, bounds.boxMax, m_sceneStore.GetTransforms().GetWorld(index), boxMin, boxMax);
+	if (m_spatialHash.Update(slot, boxMin, boxMax))
+	{
+		m_spatialCellChangeCount++;
+	}
+	m_spatialUpdateCount++;
+}
+
+/***********************************************************
+ *  FindMeshesInBox()
+ *
+ *  This method is used for finding the mesh objects whose
+ *  world boxes overlap a world space box.
+ ***********************************************************/
+void SceneManager::FindMeshesInBox(const glm::vec3& boxMin, const glm::vec3& boxMax,
+	std::vector<SceneStore::Handle>& handles)
+{
+	UpdateSpatialHash();
+
+	m_spatialHash.QueryBox(boxMin, boxMax, m_spatialIds);
+	handles.clear();
+	for (size_t i = 0; i < m_spatialIds.size(); i++)
+	{
+		handles.push_back(m_spatialHandles[m_spatialIds[i]]);
+	}
+}
+
+/***********************************************************
+ *  FindMeshesInView()
+ *
+ *  This method is used for finding the mesh objects whose
+ *  world boxes are inside the view frustum of the frame.
+ ***********************************************************/
+void SceneManager::FindMeshesInView(std::vector<SceneStore::Handle>& handles)
+{
+	UpdateSpatialHash();
+
+	glm::vec4 planes[6];
+	for (int i = 0; i < 6; i++)
+	{
+		planes[i] = m_frustumCuller.GetPlane(i);
+	}
+	m_spatialHash.QueryFrustum(planes, m_spatialIds);
+	handles.clear();
+	for (size_t i = 0; i < m_spatialIds.size(); i++)
+	{
+		handles.push_back(m_spatialHandles[m_spatialIds[i]]);
+	}
+}
+
+/***********************************************************
+ *  GetMeshTriangles()
+ *
+ *  This method is used for getting the triangles of the
+ *  drawn parts of a geometry.  They are read back from the
+ *  shared buffers and the tree over them is built the
+ *  first time they are needed, later picks reuse them.
+ ***********************************************************/
+SceneManager::MESH_TRIANGLES& SceneManager::GetMeshTriangles(const ShapeMeshes::DRAW_RECORD& record)
+{
+	uint64_t key = ((uint64_t)record.geometry << 32) | record.parts;
+	std::unordered_map<uint64_t, MESH_TRIANGLES>::iterator found = m_meshTriangles.find(key);
+	if (found != m_meshTriangles.end())
+	{
+		return(found->second);
+	}
+
+	MESH_TRIANGLES& mesh = m_meshTriangles[key];
+	std::vector<GLfloat> vertices;
+	m_basicMeshes->GetGeometryData(record.geometry, record.parts, vertices, mesh.indices);
+
+	const size_t floatsPerVertex = 8;
+	mesh.positions.resize(vertices.size() / floatsPerVertex);
+	for (size_t i = 0; i < mesh.positions.size(); i++)
+	{
+		mesh.positions[i] = glm::vec3(vertices[i * floatsPerVertex],
+			vertices[i * floatsPerVertex + 1], vertices[i * floatsPerVertex + 2]);
+	}
+
+	size_t triangleCount = mesh.indices.size() / 3;
+	std::vector<glm::vec3> boxMins(triangleCount);
+	std::vector<glm::vec3> boxMaxs(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		const glm::vec3& v0 = mesh.positions[mesh.indices[t * 3]];
+		const glm::vec3& v1 = mesh.positions[mesh.indices[t * 3 + 1]];
+		const glm::vec3& v2 = mesh.positions[mesh.indices[t * 3 + 2]];
+		boxMins[t] = glm::min(v0, glm::min(v1, v2));
+		boxMaxs[t] = glm::max(v0, glm::max(v1, v2));
+	}
+	mesh.tree.Build(boxMins.data(), boxMaxs.data(), triangleCount);
+
+	return(mesh);
+}
+
+/***********************************************************
+ *  PickObjectTest()
+ *
+ *  This method is used for testing one object of the pick
+ *  tree.  The ray is moved into the local space of the
+ *  object without normalizing its direction, so distances
+ *  along it are the same as in world space.
+ ***********************************************************/
+float SceneManager::PickObjectTest(void* pContext, uint32_t primitive,
+	const glm::vec3& origin, const glm::vec3& direction, float maxDistance)
+{
+	SceneManager* pManager = (SceneManager*)pContext;
+	uint32_t index = pManager->m_pickObjects[primitive];
+
+	const glm::mat4& world = pManager->m_sceneStore.GetTransforms().GetWorld(index);
+	if (glm::determinant(glm::mat3(world)) == 0.0f)
+	{
+		return(-1.0f);
+	}
+	glm::mat4 toLocal = glm::inverse(world);
+	glm::vec3 localOrigin = glm::vec3(toLocal * glm::vec4(origin, 1.0f));
+	glm::vec3 localDirection = glm::mat3(toLocal) * direction;
+
+	MESH_TRIANGLES& mesh = pManager->GetMeshTriangles(pManager->m_sceneStore.GetDrawRecord(index));
+	float distance = -1.0f;
+	mesh.tree.Intersect(localOrigin, localDirection, maxDistance,
+		&SceneManager::PickTriangleTest, &mesh, &distance);
+	return(distance);
+}
+
+/***********************************************************
+ *  PickTriangleTest()
+ *
+ *  This method is used for testing one triangle of a pick
+ *  mesh.  Hits beyond the nearest one found so far are
+ *  reported as misses.
+ ***********************************************************/
+float SceneManager::PickTriangleTest(void* pContext, uint32_t primitive,
+	const glm::vec3& origin, const glm::vec3& direction, float maxDistance)
+{
+	const MESH_TRIANGLES* pMesh = (const MESH_TRIANGLES*)pContext;
+	const GLuint* triangle = &pMesh->indices[primitive * 3];
+	float distance = IntersectTriangle(origin, direction, pMesh->positions[triangle[0]],
+		pMesh->positions[triangle[1]], pMesh->positions[triangle[2]]);
+	return((distance <= maxDistance) ? distance : -1.0f);
 }
 
 /***********************************************************
@@ -760,10 +1977,10 @@ void SceneManager::RemoveMesh(int index)
  *  Adapted from https://learnopengl.com/Model-Loading/Model
  *  and https://assimp-docs.readthedocs.io/en/latest/
  ***********************************************************/
-void SceneManager::LoadModel(std::string filename, std::string tag,
+void SceneManager::LoadModel(const std::string& filename, StringID tag,
 	glm::vec3 position, glm::vec3 rotation,
-	glm::vec3 scale, std::string materialTag,
-	std::string textureTag, glm::vec2 uvScale,
+	glm::vec3 scale, StringID materialTag,
+	StringID textureTag, glm::vec2 uvScale,
 	glm::vec4 shaderColor, bool isRotating)
 {
 	Assimp::Importer importer;
@@ -776,48 +1993,64 @@ void SceneManager::LoadModel(std::string filename, std::string tag,
 		return;
 	}
 
+	// the model root carries the placement in the scene, the
+	// node hierarchy of the file hangs below it
+	SceneStore::Handle root = AddMeshToScene(tag, position,
+		rotation, scale,
+		materialTag, textureTag,
+		uvScale, shaderColor,
+		ShapeMeshes::MakeDrawRecord(ShapeMeshes::INVALID_GEOMETRY));
+	if (isRotating)
+	{
+		m_sceneStore.Flags(m_sceneStore.GetIndex(root)) |= SceneStore::OBJECT_FLAG_ROTATING;
+	}
+
 	ProcessNode(scene->mRootNode, scene, 
-		tag, position, 
-		rotation, scale, 
+		root, tag, 
 		materialTag, textureTag, 
-		uvScale, shaderColor, 
-		isRotating);
+		uvScale, shaderColor);
 }
 
 /***********************************************************
  *  ProcessNode()
  *
  *  This method is used for processing a node in the 3D model.
+ *  The node becomes a scene object with the node transform
+ *  relative to its parent, and its meshes and child nodes
+ *  are added below it.
  *  Adapted from https://learnopengl.com/Model-Loading/Model
  *  and https://assimp-docs.readthedocs.io/en/latest/
  ***********************************************************/
 void SceneManager::ProcessNode(aiNode* node, const aiScene* scene, 
-	std::string tag, glm::vec3 position, 
-	glm::vec3 rotation, glm::vec3 scale, 
-	std::string materialTag, std::string textureTag, 
-	glm::vec2 uvScale, glm::vec4 shaderColor, 
-	bool isRotating)
+	SceneStore::Handle parent, StringID tag, 
+	StringID materialTag, StringID textureTag, 
+	glm::vec2 uvScale, glm::vec4 shaderColor)
 {
+	glm::vec3 position, rotation, scale;
+	DecomposeNodeTransform(node->mTransformation, position, rotation, scale);
+
+	SceneStore::Handle nodeHandle = AddMeshToScene(
+		InternString(GetInternedString(tag) + "/" + node->mName.C_Str()), position,
+		rotation, scale,
+		materialTag, textureTag,
+		uvScale, shaderColor,
+		ShapeMeshes::MakeDrawRecord(ShapeMeshes::INVALID_GEOMETRY), parent);
+
 	for (unsigned int i = 0; i < node->mNumMeshes; i++)
 	{
 		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		std::string meshTag = tag + std::to_string(i);
 		ProcessMesh(mesh, scene, 
-			tag + std::to_string(i), position, 
-			rotation, scale, 
+			nodeHandle, InternString(GetInternedString(tag) + std::to_string(i)), 
 			materialTag, textureTag,
-			uvScale, shaderColor,
-			isRotating);
+			uvScale, shaderColor);
 	}
 
 	for (unsigned int i = 0; i < node->mNumChildren; i++)
 	{
 		ProcessNode(node->mChildren[i], scene, 
-			tag, position, 
-			rotation, scale,
+			nodeHandle, tag, 
 			materialTag, textureTag,
-			uvScale, shaderColor,
-			isRotating);
+			uvScale, shaderColor);
 	}
 }
 
@@ -830,10 +2063,9 @@ void SceneManager::ProcessNode(aiNode* node, const aiScene* scene,
  *  and https://assimp-docs.readthedocs.io/en/latest/
  ***********************************************************/
 void SceneManager::ProcessMesh(aiMesh* mesh, const aiScene* scene, 
-	std::string tag, glm::vec3 position, 
-	glm::vec3 rotation, glm::vec3 scale,
-	std::string materialTag, std::string textureTag, 
-	glm::vec2 uvScale, glm::vec4 shaderColor, bool isRotating)
+	SceneStore::Handle parent, StringID tag, 
+	StringID materialTag, StringID textureTag, 
+	glm::vec2 uvScale, glm::vec4 shaderColor)
 {
 	std::vector<float> vertices;
 	std::vector<unsigned int> indices;
@@ -856,6 +2088,10 @@ void SceneManager::ProcessMesh(aiMesh* mesh, const aiScene* scene,
 			vertices.push_back(0.0f);
 			vertices.push_back(0.0f);
 		}
+
+		// no texture coordinates for the imported models
+		vertices.push_back(0.0f);
+		vertices.push_back(0.0f);
 	}
 
 	for (unsigned int i = 0; i < mesh->mNumFaces; i++)
@@ -865,45 +2101,126 @@ void SceneManager::ProcessMesh(aiMesh* mesh, const aiScene* scene,
 			indices.push_back(face.mIndices[j]);
 	}
 
-	// Initialize buffers
-	GLuint VAO, VBO, EBO;
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-	glGenBuffers(1, &EBO);
+	// Add the geometry to the shared buffers, the scene object
+	// only keeps the identifier of the geometry
+	GLuint vertexCount = static_cast<GLuint>(vertices.size() / 8);
+	GLuint indexCount = static_cast<GLuint>(indices.size());
+	unsigned int geometry = m_basicMeshes->AddGeometry(
+		vertices.data(), vertexCount, indices.data(), indexCount);
+	BuildLodChain(geometry, vertices, indices);
+
+	// Add the mesh to the scene, placed by its node
+	AddMeshToScene(tag, glm::vec3(0.0f, 0.0f, 0.0f), 
+		glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), 
+		materialTag, textureTag, 
+		uvScale, shaderColor, 
+		ShapeMeshes::MakeDrawRecord(geometry), parent);
+}
+
+/***********************************************************
+ *  BuildLodChain()
+ *
+ *  This method is used for simplifying an imported mesh
+ *  into coarser levels of detail, each with about half the
+ *  triangles of the one before.  Every level is an index
+ *  list over the vertices of the full mesh, added as a
+ *  geometry of its own.  Small meshes are left alone, and
+ *  the chain ends early when the simplifier cannot remove
+ *  enough triangles for another level.
+ ***********************************************************/
+void SceneManager::BuildLodChain(unsigned int geometry, const std::vector<float>& vertices,
+	const std::vector<unsigned int>& indices)
+{
+	const size_t minTriangles = 512;
 
-	glBindVertexArray(VAO);
+	size_t triangleCount = indices.size() / 3;
+	if ((geometry == ShapeMeshes::INVALID_GEOMETRY) || (triangleCount < minTriangles))
+	{
+		return;
+	}
 
-	// Bind vertex buffer
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+	LOD_CHAIN chain;
+	chain.geometries[0] = geometry;
+	chain.levelCount = 1;
 
-	// Bind element buffer
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+	MeshSimplifier simplifier;
+	simplifier.Load(vertices.data(), vertices.size() / 8, 8, indices.data(), indices.size());
 
-	// Position (stride of 6 without texture coordinates)
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	// Normal (stride of 6 without texture coordinates)
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
+	std::vector<uint32_t> levelIndices;
+	size_t previousCount = triangleCount;
+	while ((chain.levelCount < MAX_LOD_LEVELS) && (previousCount / 2 >= minTriangles / 4))
+	{
+		simplifier.Simplify(previousCount / 2);
+		size_t levelCount = simplifier.GetTriangleCount();
+		// a level that keeps most of the triangles saves nothing
+		if ((levelCount == 0) || (levelCount * 4 > previousCount * 3))
+		{
+			break;
+		}
 
-	glBindVertexArray(0);
+		simplifier.GetIndices(levelIndices);
+		unsigned int levelGeometry = m_basicMeshes->AddGeometryLevel(geometry,
+			levelIndices.data(), (GLuint)levelIndices.size());
+		if (levelGeometry == ShapeMeshes::INVALID_GEOMETRY)
+		{
+			break;
+		}
+		chain.geometries[chain.levelCount] = levelGeometry;
+		chain.levelCount++;
+		previousCount = levelCount;
+	}
 
-	// Create a draw function for the mesh
-	std::function<void()> drawFunction = [VAO, indices]() {
-		glBindVertexArray(VAO);
-		glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0);
-		glBindVertexArray(0);
-		};
+	if (chain.levelCount > 1)
+	{
+		if (m_lodChains.size() <= geometry)
+		{
+			LOD_CHAIN empty;
+			memset(&empty, 0, sizeof(empty));
+			m_lodChains.resize(geometry + 1, empty);
+		}
+		m_lodChains[geometry] = chain;
+	}
+}
 
-	// Add the mesh to the scene
-	AddMeshToScene(tag, position, 
-		rotation, scale, 
-		materialTag, textureTag, 
-		uvScale, shaderColor, 
-		drawFunction);
-	m_meshes.back().isRotating = isRotating;
+/***********************************************************
+ *  SelectLodLevel()
+ *
+ *  This method is used for choosing the level of detail of
+ *  an object.  The size on screen is the radius of the
+ *  world bounding sphere over its clip space distance,
+ *  scaled by the projection, as a fraction of half the
+ *  viewport height.  Each level below the full mesh starts
+ *  when the size drops under its threshold.  Moving to
+ *  another level needs the size to pass the threshold by
+ *  a margin, so objects near a threshold do not switch
+ *  levels every frame.  The compute shader of the GPU
+ *  culling repeats this selection.
+ ***********************************************************/
+int SceneManager::SelectLodLevel(const glm::vec4& sphere, const glm::mat4& world, int levelCount, int currentLevel) const
+{
+	glm::vec4 center = world * glm::vec4(glm::vec3(sphere), 1.0f);
+	float scale = std::max(glm::length(glm::vec3(world[0])),
+		std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+	float radius = sphere.w * scale;
+
+	// the camera is inside the sphere
+	float distance = (m_viewProjection * center).w;
+	if (distance <= radius)
+	{
+		return(0);
+	}
+	float size = radius * m_lodProjectionScale / distance;
+
+	int level = std::min(currentLevel, levelCount - 1);
+	while ((level + 1 < levelCount) && (size < g_LodThresholds[level] * (1.0f - g_LodHysteresis)))
+	{
+		level++;
+	}
+	while ((level > 0) && (size > g_LodThresholds[level - 1] * (1.0f + g_LodHysteresis)))
+	{
+		level--;
+	}
+	return(level);
 }
 
 /***********************************************************
@@ -916,18 +2233,31 @@ void SceneManager::SerializeSceneData(std::string filename)
 {
 	json jScene;
 
-	for (auto& mesh : m_meshes)
+	for (size_t i = 0; i < m_sceneStore.Size(); i++)
 	{
+		// children are parts of a model and come back when
+		// its root is loaded
+		if (m_sceneStore.GetParent(i) != SceneStore::INVALID_HANDLE)
+		{
+			continue;
+		}
+
+		const glm::vec3& position = m_sceneStore.GetPosition(i);
+		const glm::vec3& rotation = m_sceneStore.GetRotation(i);
+		const glm::vec3& scale = m_sceneStore.GetScale(i);
+		const glm::vec2& uvScale = m_sceneStore.UVScale(i);
+		const glm::vec4& shaderColor = m_sceneStore.Color(i);
+
 		json jMesh;
-		jMesh["tag"] = mesh.tag;
-		jMesh["position"] = { mesh.position.x, mesh.position.y, mesh.position.z };
-		jMesh["rotation"] = { mesh.rotation.x, mesh.rotation.y, mesh.rotation.z };
-		jMesh["scale"] = { mesh.scale.x, mesh.scale.y, mesh.scale.z };
-		jMesh["materialTag"] = mesh.materialTag;
-		jMesh["textureTag"] = mesh.textureTag;
-		jMesh["uvScale"] = { mesh.uvScale.x, mesh.uvScale.y };
-		jMesh["shaderColor"] = { mesh.shaderColor.r, mesh.shaderColor.g, mesh.shaderColor.b, mesh.shaderColor.a };
-		jMesh["isRotating"] = mesh.isRotating;
+		jMesh["tag"] = GetInternedString(m_sceneStore.GetTag(i));
+		jMesh["position"] = { position.x, position.y, position.z };
+		jMesh["rotation"] = { rotation.x, rotation.y, rotation.z };
+		jMesh["scale"] = { scale.x, scale.y, scale.z };
+		jMesh["materialTag"] = GetInternedString(m_sceneStore.GetMaterialTag(i));
+		jMesh["textureTag"] = GetInternedString(m_sceneStore.GetTextureTag(i));
+		jMesh["uvScale"] = { uvScale.x, uvScale.y };
+		jMesh["shaderColor"] = { shaderColor.r, shaderColor.g, shaderColor.b, shaderColor.a };
+		jMesh["isRotating"] = ((m_sceneStore.Flags(i) & SceneStore::OBJECT_FLAG_ROTATING) != 0);
 
 		jScene.push_back(jMesh);
 
@@ -959,7 +2289,8 @@ void SceneManager::DeserializeSceneData(std::string filename)
 	file >> jScene;
 	file.close();
 
-	m_meshes.clear();
+	m_sceneStore.Clear();
+	m_bSpatialHashValid = false;
 
 	for (auto& jMesh : jScene)
 	{
@@ -968,8 +2299,9 @@ void SceneManager::DeserializeSceneData(std::string filename)
 		glm::vec3 position(jMesh["position"][0], jMesh["position"][1], jMesh["position"][2]);
 		glm::vec3 rotation(jMesh["rotation"][0], jMesh["rotation"][1], jMesh["rotation"][2]);
 		glm::vec3 scale(jMesh["scale"][0], jMesh["scale"][1], jMesh["scale"][2]);
-		std::string materialTag = jMesh["materialTag"];
-		std::string textureTag = jMesh["textureTag"];
+		StringID tagID = InternString(tag);
+		StringID materialTag = InternString(jMesh["materialTag"].get<std::string>());
+		StringID textureTag = InternString(jMesh["textureTag"].get<std::string>());
 		glm::vec2 uvScale(jMesh["uvScale"][0], jMesh["uvScale"][1]);
 		glm::vec4 shaderColor(jMesh["shaderColor"][0], jMesh["shaderColor"][1], jMesh["shaderColor"][2], jMesh["shaderColor"][3]);
 		bool isRotating = jMesh["isRotating"];
@@ -977,7 +2309,7 @@ void SceneManager::DeserializeSceneData(std::string filename)
 		// Handle re-drawing models
 		if (tag.find("Stanford Bunny") != std::string::npos)
 		{
-			LoadModel("../../Models/bunny.obj", tag, 
+			LoadModel("../../Models/bunny.obj", tagID, 
 				position, rotation, 
 				scale, materialTag, 
 				textureTag, uvScale,
@@ -986,7 +2318,7 @@ void SceneManager::DeserializeSceneData(std::string filename)
 		}
 		else if (tag.find("Lucy") != std::string::npos)
 		{
-			LoadModel("../../Models/lucy.obj", tag,
+			LoadModel("../../Models/lucy.obj", tagID,
 				position, rotation,
 				scale, materialTag,
 				textureTag, uvScale,
@@ -995,7 +2327,7 @@ void SceneManager::DeserializeSceneData(std::string filename)
 		}
 		else if (tag.find("Suzanne") != std::string::npos)
 		{
-			LoadModel("../../Models/suzanne.obj", tag,
+			LoadModel("../../Models/suzanne.obj", tagID,
 				position, rotation,
 				scale, materialTag,
 				textureTag, uvScale,
@@ -1004,7 +2336,7 @@ void SceneManager::DeserializeSceneData(std::string filename)
 		}  
 		else if (tag.find("Teapot") != std::string::npos)
 		{
-			LoadModel("../../Models/teapot.obj", tag,
+			LoadModel("../../Models/teapot.obj", tagID,
 				position, rotation,
 				scale, materialTag,
 				textureTag, uvScale,
@@ -1012,1450 +2344,380 @@ void SceneManager::DeserializeSceneData(std::string filename)
 			continue;
 		}
 		
-		// Retrive mesh data
-		MESH_OBJECT mesh;
-		mesh.tag = tag;
-		mesh.position = position;
-		mesh.rotation = rotation;
-		mesh.scale = scale;
-		mesh.materialTag = materialTag;
-		mesh.textureTag = textureTag;
-		mesh.uvScale = uvScale;
-		mesh.shaderColor = shaderColor;
-		mesh.isRotating = isRotating;
-
 		// Handle re-drawing basic meshes
 		if (tag.find("box") != std::string::npos)
 		{
-			AddMeshToScene(tag, position, 
+			AddMeshToScene(tagID, position, 
 				rotation, scale, 
 				materialTag, textureTag, 
 				uvScale, shaderColor, 
-				[this]() { m_basicMeshes->DrawBoxMesh(); });
+				ShapeMeshes::MakeDrawRecord(ShapeMeshes::MESH_BOX));
 			continue;
 		}
 		else if (tag.find("cone") != std::string::npos)
 		{
-			AddMeshToScene(tag, position,
+			AddMeshToScene(tagID, position,
 				rotation, scale,
 				materialTag, textureTag,
 				uvScale, shaderColor,
-				[this]() { m_basicMeshes->DrawConeMesh(); });
+				ShapeMeshes::MakeDrawRecord(ShapeMeshes::MESH_CONE));
 			continue;
 		}
 		else if (tag.find("tapered cylinder") != std::string::npos)
 		{
-			AddMeshToScene(tag, position,
+			AddMeshToScene(tagID, position,
 				rotation, scale,
 				materialTag, textureTag,
 				uvScale, shaderColor,
-				[this]() { m_basicMeshes->DrawTaperedCylinderMesh(); });
+				ShapeMeshes::MakeDrawRecord(ShapeMeshes::MESH_TAPERED_CYLINDER));
 			continue;
 		}
 		else if (tag.find("cylinder") != std::string::npos)
 		{
-			AddMeshToScene(tag, position,
+			AddMeshToScene(tagID, position,
 				rotation, scale,
 				materialTag, textureTag,
 				uvScale, shaderColor,
-				[this]() { m_basicMeshes->DrawCylinderMesh(); });
+				ShapeMeshes::MakeDrawRecord(ShapeMeshes::MESH_CYLINDER));
 			continue;
 		}
 		else if (tag.find("plane") != std::string::npos)
 		{
-			AddMeshToScene(tag, position,
+			AddMeshToScene(tagID, position,
 				rotation, scale,
 				materialTag, textureTag,
 				uvScale, shaderColor,
-				[this]() { m_basicMeshes->DrawPlaneMesh(); });
+				ShapeMeshes::MakeDrawRecord(ShapeMeshes::MESH_PLANE));
 			continue;
 		}
 		else if (tag.find("prism") != std::string::npos)
 		{
-			AddMeshToScene(tag, position,
+			AddMeshToScene(tagID, position,
 				rotation, scale,
 				materialTag, textureTag,
 				uvScale, shaderColor,
-				[this]() { m_basicMeshes->DrawPrismMesh(); });
+				ShapeMeshes::MakeDrawRecord(ShapeMeshes::MESH_PRISM));
 			continue;
 		}
 		else if (tag.find("pyramid3") != std::string::npos)
 		{
-			AddMeshToScene(tag, position,
+			AddMeshToScene(tagID, position,
 				rotation, scale,
 				materialTag, textureTag,
 				uvScale, shaderColor,
-				[this]() { m_basicMeshes->DrawPyramid3Mesh(); });
+				ShapeMeshes::MakeDrawRecord(ShapeMeshes::MESH_PYRAMID3));
 			continue;
 		}
 		else if (tag.find("pyramid4") != std::string::npos)
 		{
-			AddMeshToScene(tag, position,
+			AddMeshToScene(tagID, position,
 				rotation, scale,
 				materialTag, textureTag,
 				uvScale, shaderColor,
-				[this]() { m_basicMeshes->DrawPyramid4Mesh(); });
+				ShapeMeshes::MakeDrawRecord(ShapeMeshes::MESH_PYRAMID4));
 			continue;
 		}
 		else if (tag.find("sphere") != std::string::npos)
 		{
-			AddMeshToScene(tag, position,
+			AddMeshToScene(tagID, position,
 				rotation, scale,
 				materialTag, textureTag,
 				uvScale, shaderColor,
-				[this]() { m_basicMeshes->DrawSphereMesh(); });
+				ShapeMeshes::MakeDrawRecord(ShapeMeshes::MESH_SPHERE));
 			continue;
 		}
 		else if (tag.find("torus") != std::string::npos)
 		{
-			AddMeshToScene(tag, position,
+			AddMeshToScene(tagID, position,
 				rotation, scale,
 				materialTag, textureTag,
 				uvScale, shaderColor,
-				[this]() { m_basicMeshes->DrawTorusMesh(); });
+				ShapeMeshes::MakeDrawRecord(ShapeMeshes::MESH_TORUS));
 			continue;
 		}
 
-		m_meshes.push_back(mesh);
+		// Retrive mesh data without a known shape
+		SceneStore::Handle handle = AddMeshToScene(tagID, position,
+			rotation, scale,
+			materialTag, textureTag,
+			uvScale, shaderColor,
+			ShapeMeshes::MakeDrawRecord(ShapeMeshes::INVALID_GEOMETRY));
+		if (isRotating)
+		{
+			m_sceneStore.Flags(m_sceneStore.GetIndex(handle)) |= SceneStore::OBJECT_FLAG_ROTATING;
+		}
 
 	}
 }
 
 /***********************************************************
- *  RenderScene()
+ *  LoadStaticScene()
  *
- *  This method is used for rendering the 3D scene by 
- *  transforming and drawing the basic 3D shapes
+ *  This method is used for loading the description of the
+ *  static scene into its scene store.  Every object names
+ *  a basic shape and optionally the parts of it to draw;
+ *  objects with a texture tag are drawn textured.  Point
+ *  lights are described by entries of their own.  Objects
+ *  marked static are then baked, keyed by a hash of the
+ *  file contents.
  ***********************************************************/
-void SceneManager::RenderScene()
+void SceneManager::LoadStaticScene(std::string filename)
 {
+	std::ifstream file(filename);
+	if (!file.is_open())
+	{
+		std::cerr << "Could not open file: " << filename << std::endl;
+		return;
+	}
 
-	RenderBackdrop();
-	RenderFloor();
-	RenderPictureFrame();
-	RenderVase();
-	RenderVaseBase();
-	RenderCandleHolders();
-	RenderCandles();
-	RenderCandleWicks();
-	RenderCredenza();
-	RenderNegativeSpace();
-	RenderDrawers();
-	RenderDoors();
-	RenderKnobs();
-
-	// Allow rendering of all basic meshes
-	RenderMeshes();
-}
-
-
-/***********************************************************
- *  RenderBackrop()
- *
- *  This method is called to render the shapes for the scene
- *  backdrop object.
- ***********************************************************/
-void SceneManager::RenderBackdrop()
-{
-	SetShaderMaterial("wall");
-
-	SetTextureUVScale(6, 5);
-
-	// declare the variables for the transformations
-	glm::vec3 scaleXYZ;
-	float XrotationDegrees = 0.0f;
-	float YrotationDegrees = 0.0f;
-	float ZrotationDegrees = 0.0f;
-	glm::vec3 positionXYZ;
-
-	/******************************************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(20.0f, 1.0f, 7.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(0.0f, 5.0f, 3.3f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	// Gray
-	SetShaderColor(0.6, 0.6, 0.6, 1);
-	SetShaderTexture("backdrop");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawPlaneMesh();
-	/****************************************************************/
-}
+	std::stringstream source;
+	source << file.rdbuf();
+	file.close();
 
+	json jScene = json::parse(source.str());
 
-/***********************************************************
- *  RenderFloor()
- *
- *  This method is called to render the shapes for the scene
- *  floor object.
- ***********************************************************/
-void SceneManager::RenderFloor()
-{
-	SetShaderMaterial("wood");
+	m_staticScene.Clear();
+	m_bakedScene.Clear();
+	m_bakedObjectCount = 0;
+	m_bBakeCached = false;
+	m_lightClusterer.Clear();
 
-	// Set texture scale for floor
-	SetTextureUVScale(5, 10);
+	for (auto& jObject : jScene)
+	{
+		// point lights are entries of their own, without a mesh
+		if (jObject.contains("pointLight"))
+		{
+			const json& jLight = jObject["pointLight"];
+			LightClusterer::POINT_LIGHT light;
+			light.position = glm::vec3(jLight["position"][0], jLight["position"][1], jLight["position"][2]);
+			light.radius = jLight["radius"];
+			light.color = glm::vec3(jLight["color"][0], jLight["color"][1], jLight["color"][2]);
+			light.intensity = jLight.value("intensity", 1.0f);
+			m_lightClusterer.AddLight(light);
+			continue;
+		}
 
-	// declare the variables for the transformations
-	glm::vec3 scaleXYZ;
-	float XrotationDegrees = 0.0f;
-	float YrotationDegrees = 0.0f;
-	float ZrotationDegrees = 0.0f;
-	glm::vec3 positionXYZ;
+		std::string meshName = jObject["mesh"];
+		int mesh = FindMeshID(meshName);
+		if (mesh < 0)
+		{
+			std::cerr << "Unknown mesh \"" << meshName << "\" in " << filename << std::endl;
+			continue;
+		}
 
-	/******************************************************************/
-	/*** Set needed transformations before drawing the basic mesh.  ***/
-	/*** This same ordering of code should be used for transforming ***/
-	/*** and drawing all the basic 3D shapes.						***/
-	/******************************************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(10.0f, 1.0f, 20.0f);
+		unsigned int parts = ShapeMeshes::MESH_PART_ALL;
+		if (jObject.contains("parts"))
+		{
+			parts = 0;
+			for (auto& jPart : jObject["parts"])
+			{
+				parts |= FindMeshPart(jPart);
+			}
+		}
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 90.0f;
-	ZrotationDegrees = 0.0f;
+		SceneStore::OBJECT_DESC desc;
+		desc.tag = InternString(jObject["tag"].get<std::string>());
+		desc.position = glm::vec3(jObject["position"][0], jObject["position"][1], jObject["position"][2]);
+		desc.rotation = glm::vec3(jObject["rotation"][0], jObject["rotation"][1], jObject["rotation"][2]);
+		desc.scale = glm::vec3(jObject["scale"][0], jObject["scale"][1], jObject["scale"][2]);
+		desc.materialTag = InternString(jObject["materialTag"].get<std::string>());
+		desc.materialIndex = std::max(0, FindMaterialIndex(desc.materialTag));
+		desc.textureTag = InternString(jObject["textureTag"].get<std::string>());
+		desc.textureSlot = FindTextureSlot(desc.textureTag);
+		desc.uvScale = glm::vec2(jObject["uvScale"][0], jObject["uvScale"][1]);
+		desc.color = glm::vec4(jObject["shaderColor"][0], jObject["shaderColor"][1],
+			jObject["shaderColor"][2], jObject["shaderColor"][3]);
+		desc.drawRecord = ShapeMeshes::MakeDrawRecord((GLuint)mesh, parts);
+		desc.flags = (desc.textureTag == EMPTY_STRING_ID) ? 0 : SceneStore::OBJECT_FLAG_TEXTURED;
+		if (jObject.value("isStatic", false))
+		{
+			desc.flags |= SceneStore::OBJECT_FLAG_STATIC;
+		}
+		if (jObject.value("isOccluder", false))
+		{
+			desc.flags |= SceneStore::OBJECT_FLAG_OCCLUDER;
+		}
+		desc.parent = SceneStore::INVALID_HANDLE;
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm:: vec3(0.0f, 0.0f, 10.0f);
+		m_staticScene.Add(desc);
+	}
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	m_scenePointLightCount = m_lightClusterer.Size();
+	SetTestPointLightCount(m_testPointLightCount);
 
-	// Brown
-	//SetShaderColor(0.803, 0.521, 0.247, 1);
-	SetShaderTexture("floor");
-	
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawPlaneMesh();
-	/****************************************************************/
+	CollectOccluders();
+	BakeStaticScene(g_StaticBakeFile, HashBakeSource(source.str()));
 }
 
 /***********************************************************
- *  RenderPictureFrame()
+ *  CollectOccluders()
  *
- *  This method is called to render the shapes for the scene
- *  picture frame object.
+ *  This method is used for handing the triangles of every
+ *  occluder of the static scene to the occlusion culler.
+ *  Occluders never move, so this is only done when the
+ *  static scene is loaded.
  ***********************************************************/
-void SceneManager::RenderPictureFrame()
+void SceneManager::CollectOccluders()
 {
-	SetShaderMaterial("picture frame");
-
-	// Set texture scale for picture frame
-	SetTextureUVScale(1, 1);
-
-	// declare the variables for the transformations
-	glm::vec3 scaleXYZ;
-	float XrotationDegrees = 0.0f;
-	float YrotationDegrees = 0.0f;
-	float ZrotationDegrees = 0.0f;
-	glm::vec3 positionXYZ;
-
-	/******************************************************************/
-	/*** Set needed transformations before drawing the basic mesh.  ***/
-	/*** This same ordering of code should be used for transforming ***/
-	/*** and drawing all the basic 3D shapes.						***/
-	/******************************************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(3.0f, 1.0f, 5.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 90.0f;
-	ZrotationDegrees = 90.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(0.0f, 7.5f, 3.35f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	// Brown
-	//SetShaderColor(0.803, 0.521, 0.247, 1);
-	SetShaderTexture("picture frame");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawPlaneMesh();
-	/****************************************************************/
-}
-
-/***********************************************************
- *  RenderVase()
- *
- *  This method is called to render the shapes for the scene
- *  vase object.
- ***********************************************************/
-void SceneManager::RenderVase()
-{
-	SetShaderMaterial("glass");
-
-	// Set texture scale
-	SetTextureUVScale(2, 2);
-
-	// declare the variables for the transformations
-	glm::vec3 scaleXYZ;
-	float XrotationDegrees = 0.0f;
-	float YrotationDegrees = 0.0f;
-	float ZrotationDegrees = 0.0f;
-	glm::vec3 positionXYZ;
-
-	/******************************************************************/
-	/*** Set needed transformations before drawing the basic mesh.  ***/
-	/*** This same ordering of code should be used for transforming ***/
-	/*** and drawing all the basic 3D shapes.						***/
-	/******************************************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(0.6f, 1.0f, 0.6f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 180.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(0.0f, 5.301f, 5.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	m_occlusionCuller.ClearOccluders();
+	m_staticScene.UpdateTransforms();
 
-	//SetShaderColor(1, 1, 1, 0.4);
-	SetShaderTexture("vase");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawTaperedCylinderMesh(true, false, true);
-	/****************************************************************/
-}
-
-/***********************************************************
- *  RenderVaseBase()
- *
- *  This method is called to render the shapes for the scene
- *  vase base objects.
- ***********************************************************/
-void SceneManager::RenderVaseBase()
-{
-	SetShaderMaterial("metal");
-
-	// Set texture scale
-	SetTextureUVScale(1, 1);
-
-	// declare the variables for the transformations
-	glm::vec3 scaleXYZ;
-	float XrotationDegrees = 0.0f;
-	float YrotationDegrees = 0.0f;
-	float ZrotationDegrees = 0.0f;
-	glm::vec3 positionXYZ;
-
-	/******************************************************************/
-	/*** Set needed transformations before drawing the basic mesh.  ***/
-	/*** This same ordering of code should be used for transforming ***/
-	/*** and drawing all the basic 3D shapes.						***/
-	/******************************************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(0.5f, 0.1f, 0.5f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(0.0f, 4.0f, 5.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	//SetShaderColor(1, 1, 1, 0.4);
-	SetShaderTexture("stainless");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh(true, true, true);
-	/****************************************************************/
-
-	/******************************************************************/
-	/*** Set needed transformations before drawing the basic mesh.  ***/
-	/*** This same ordering of code should be used for transforming ***/
-	/*** and drawing all the basic 3D shapes.						***/
-	/******************************************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(0.4f, 0.1f, 0.4f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(0.0f, 4.1f, 5.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	//SetShaderColor(1, 1, 1, 0.4);
-	SetShaderTexture("stainless");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh(true, true, true);
-	/****************************************************************/
-
-	/******************************************************************/
-	/*** Set needed transformations before drawing the basic mesh.  ***/
-	/*** This same ordering of code should be used for transforming ***/
-	/*** and drawing all the basic 3D shapes.						***/
-	/******************************************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(0.3f, 0.1f, 0.3f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(0.0f, 4.2f, 5.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	//SetShaderColor(1, 1, 1, 0.4);
-	SetShaderTexture("stainless");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh(true, true, true);
-	/****************************************************************/
-}
-
-/***********************************************************
- *  RenderCandleHolders()
- *
- *  This method is called to render the shapes for the scene
- *  candle holder objects.
- ***********************************************************/
-void SceneManager::RenderCandleHolders()
-{
-	// Set texture scale
-	SetTextureUVScale(2.5, 2);
-	
-
-	// declare the variables for the transformations
-	glm::vec3 scaleXYZ;
-	float XrotationDegrees = 0.0f;
-	float YrotationDegrees = 0.0f;
-	float ZrotationDegrees = 0.0f;
-	glm::vec3 positionXYZ;
-
-	/******************************************************************/
-	/*** Set needed transformations before drawing the basic mesh.  ***/
-	/*** This same ordering of code should be used for transforming ***/
-	/*** and drawing all the basic 3D shapes.						***/
-	/******************************************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(0.4f, 0.8f, 0.4f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(1.5f, 4.01f, 5.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderMaterial("glass");
-	SetShaderTexture("candle holders");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh(false, true, true);
-	/****************************************************************/
-
-	/******************************************************************/
-	/*** Set needed transformations before drawing the basic mesh.  ***/
-	/*** This same ordering of code should be used for transforming ***/
-	/*** and drawing all the basic 3D shapes.						***/
-	/******************************************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(0.4f, 0.8f, 0.4f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-1.5f, 4.01f, 5.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderColor(1, 1, 1, 0.5);
-	SetShaderMaterial("glass");
-	SetShaderTexture("candle holders");
+	SceneStore::RENDER_VIEW view = m_staticScene.GetRenderView();
+	for (size_t i = 0; i < view.count; i++)
+	{
+		if (((view.flags[i] & SceneStore::OBJECT_FLAG_OCCLUDER) == 0) ||
+			(view.drawRecords[i].geometry == ShapeMeshes::INVALID_GEOMETRY))
+		{
+			continue;
+		}
 
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh(false, true, true);
-	/****************************************************************/
+		const MESH_TRIANGLES& mesh = GetMeshTriangles(view.drawRecords[i]);
+		if (!mesh.indices.empty())
+		{
+			m_occlusionCuller.AddOccluder(mesh.positions.data(), mesh.indices.data(),
+				mesh.indices.size(), view.worldMatrices[i]);
+		}
+	}
 }
 
 /***********************************************************
- *  RenderCandles()
+ *  SetViewProjection()
  *
- *  This method is called to render the shapes for the scene
- *  candle objects.
+ *  This method is used for setting the view and projection
+ *  of the frame, used by the frustum and occlusion culling
+ *  and to cluster the point lights.
  ***********************************************************/
-void SceneManager::RenderCandles()
+void SceneManager::SetViewProjection(const glm::mat4& view, const glm::mat4& projection)
 {
-	// Set texture scale
-	SetTextureUVScale(2.5, 2);
-
-
-	// declare the variables for the transformations
-	glm::vec3 scaleXYZ;
-	float XrotationDegrees = 0.0f;
-	float YrotationDegrees = 0.0f;
-	float ZrotationDegrees = 0.0f;
-	glm::vec3 positionXYZ;
-
-	/******************************************************************/
-	/*** Set needed transformations before drawing the basic mesh.  ***/
-	/*** This same ordering of code should be used for transforming ***/
-	/*** and drawing all the basic 3D shapes.						***/
-	/******************************************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(0.2f, 0.6f, 0.2f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(1.5f, 4.0f, 5.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderColor(0.952, 0.890, 0.760, 1.0);
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh(true, true, true);
-	/****************************************************************/
-
-	/******************************************************************/
-	/*** Set needed transformations before drawing the basic mesh.  ***/
-	/*** This same ordering of code should be used for transforming ***/
-	/*** and drawing all the basic 3D shapes.						***/
-	/******************************************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(0.2f, 0.6f, 0.2f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-1.5f, 4.0f, 5.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderColor(0.952, 0.890, 0.760, 1.0);
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh(true, false, true);
-	/****************************************************************/
+	glm::mat4 viewProjection = projection * view;
+	m_view = view;
+	m_projection = projection;
+	m_viewProjection = viewProjection;
+	m_frustumCuller.SetViewProjection(viewProjection);
+
+	// the view rows are unit length, so the length of the
+	// second row is the vertical scale of the projection
+	m_lodProjectionScale = glm::length(glm::vec3(viewProjection[0][1],
+		viewProjection[1][1], viewProjection[2][1]));
 }
 
 /***********************************************************
- *  RenderCandles()
+ *  BakeStaticScene()
  *
- *  This method is called to render the shapes for the scene
- *  candle wick objects.
+ *  This method is used for replacing the static objects of
+ *  the static scene with baked batches.  The batches come
+ *  from the cache file when it was baked from the same
+ *  source, otherwise they are baked and the cache is
+ *  written.  Every batch becomes one object of the baked
+ *  scene store, drawn with an identity transform.
  ***********************************************************/
-void SceneManager::RenderCandleWicks()
+void SceneManager::BakeStaticScene(const std::string& cacheFilename, uint64_t sourceHash)
 {
-	// Set texture scale
-	SetTextureUVScale(2.5, 2);
-
-
-	// declare the variables for the transformations
-	glm::vec3 scaleXYZ;
-	float XrotationDegrees = 0.0f;
-	float YrotationDegrees = 0.0f;
-	float ZrotationDegrees = 0.0f;
-	glm::vec3 positionXYZ;
-
-	/******************************************************************/
-	/*** Set needed transformations before drawing the basic mesh.  ***/
-	/*** This same ordering of code should be used for transforming ***/
-	/*** and drawing all the basic 3D shapes.						***/
-	/******************************************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(0.005f, 0.1f, 0.005f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(1.5f, 4.55f, 5.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	SetShaderMaterial("metal");
-	SetShaderColor(0, 0, 0, 1.0);
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh(true, true, true);
-	/****************************************************************/
-
-	/******************************************************************/
-	/*** Set needed transformations before drawing the basic mesh.  ***/
-	/*** This same ordering of code should be used for transforming ***/
-	/*** and drawing all the basic 3D shapes.						***/
-	/******************************************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(0.005f, 0.1f, 0.005f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+	std::vector<BAKED_BATCH> batches;
+	bool bCached = LoadBakedBatches(cacheFilename, sourceHash, batches);
+	if (!bCached)
+	{
+		m_staticScene.UpdateTransforms();
+		BakeStaticObjects(m_staticScene, m_basicMeshes, batches);
+		if (!SaveBakedBatches(cacheFilename, sourceHash, batches))
+		{
+			std::cerr << "Could not write bake cache: " << cacheFilename << std::endl;
+		}
+	}
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-1.5f, 4.55f, 5.0f);
+	for (size_t i = 0; i < batches.size(); i++)
+	{
+		const BAKED_BATCH& batch = batches[i];
+		if (batch.indices.empty())
+		{
+			continue;
+		}
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+		unsigned int geometry = m_basicMeshes->AddGeometry(
+			batch.vertices.data(), (GLuint)(batch.vertices.size() / 8),
+			batch.indices.data(), (GLuint)batch.indices.size());
+
+		SceneStore::OBJECT_DESC desc;
+		desc.tag = InternString("baked " + GetInternedString(batch.materialTag));
+		desc.position = glm::vec3(0.0f);
+		desc.rotation = glm::vec3(0.0f);
+		desc.scale = glm::vec3(1.0f);
+		desc.materialTag = batch.materialTag;
+		desc.materialIndex = std::max(0, FindMaterialIndex(batch.materialTag));
+		desc.textureTag = batch.textureTag;
+		desc.textureSlot = FindTextureSlot(batch.textureTag);
+		desc.uvScale = glm::vec2(1.0f);
+		desc.color = batch.color;
+		desc.drawRecord = ShapeMeshes::MakeDrawRecord(geometry);
+		desc.flags = SceneStore::OBJECT_FLAG_STATIC |
+			(batch.bTextured ? SceneStore::OBJECT_FLAG_TEXTURED : 0);
+		desc.parent = SceneStore::INVALID_HANDLE;
+		m_bakedScene.Add(desc);
+	}
 
-	SetShaderMaterial("metal");
-	SetShaderColor(0, 0, 0, 1.0);
+	// the baked objects are dropped, walking from the end keeps
+	// the objects moved by a removal already visited
+	size_t bakedCount = 0;
+	for (size_t i = m_staticScene.Size(); i-- > 0;)
+	{
+		if (IsBakeable(m_staticScene, i))
+		{
+			m_staticScene.Remove(m_staticScene.GetHandle(i));
+			bakedCount++;
+		}
+	}
 
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh(true, true, true);
-	/****************************************************************/
+	m_bakedObjectCount = (unsigned int)bakedCount;
+	m_bBakeCached = bCached;
 }
 
 /***********************************************************
- *  RenderCredenza()
+ *  RenderScene()
  *
- *  This method is called to render the shapes for the 
- *  credenza object.
+ *  This method is used for rendering the 3D scene.  The
+ *  static scene and the objects added at runtime are both
+ *  scene stores, queued and issued the same way.
  ***********************************************************/
-void SceneManager::RenderCredenza()
-{
-	SetShaderMaterial("woodNoShine");
-
-	SetTextureUVScale(1, 1);
-
-	// declare the variables for the transformations
-	glm::vec3 scaleXYZ;
-	float XrotationDegrees = 0.0f;
-	float YrotationDegrees = 0.0f;
-	float ZrotationDegrees = 0.0f;
-	glm::vec3 positionXYZ;
-
-	// Center of credenza
-
-	/*****************************Middle Piece*************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(4.0f, 4.0f, 3.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(0.0f, 2.0f, 5.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	// Offwhite
-	SetShaderColor(0.960, 0.960, 0.862, 1);
-	SetShaderTexture("credenza");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-	/****************************************************************/
-
-	// Left side of credenza
-
-	/***********************Left Piece*******************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(1.0f, 4.0f, 2.6f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-2.5f, 2.0f, 4.8f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	// Offwhite
-	SetShaderColor(0.960, 0.960, 0.862, 1);
-	SetShaderTexture("credenza");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-	/****************************************************************/
-
-	// Right side of credenza
-
-	/***********************Right Piece*******************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(1.0f, 4.0f, 2.6f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(2.5f, 2.0f, 4.8f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	// Offwhite
-	SetShaderColor(0.960, 0.960, 0.862, 1);
-	SetShaderTexture("credenza");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-	/****************************************************************/
-}
-
-/***********************************************************
- *  RenderNegativeSpace()
- *
- *  This method is called to render the shapes for the 
- *  negative space object.
- ***********************************************************/
-void SceneManager::RenderNegativeSpace()
-{
-	// declare the variables for the transformations
-	glm::vec3 scaleXYZ;
-	float XrotationDegrees = 0.0f;
-	float YrotationDegrees = 0.0f;
-	float ZrotationDegrees = 0.0f;
-	glm::vec3 positionXYZ;
-
-	/******************************Top Drawer Negative Space************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(3.6f, 0.6f, 3.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(0.0f, 3.5f, 5.05f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	// Black
-	SetShaderColor(0, 0, 0, 1);
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-	/****************************************************************/
-
-	/*******************************Large Doors Negative Space***********************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(3.6f, 2.8f, 3.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(0.0f, 1.65f, 5.05f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	// Black
-	SetShaderColor(0, 0, 0, 1);
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-	/****************************************************************/
-
-	/***********************Left Piece Top Drawer Negative Space*******************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(0.7f, 0.6f, 2.6f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-2.5f, 3.5f, 4.85f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	// Black
-	SetShaderColor(0, 0, 0, 1);
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-	/****************************************************************/
-
-	/***********************Left Piece Bottom Door Negative Space*******************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(0.7f, 2.9f, 2.6f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-2.5f, 1.6f, 4.85f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	// Black
-	SetShaderColor(0, 0, 0, 1);
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-	/****************************************************************/
-
-	/***********************Right Piece Top Drawer Negative Space*******************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(0.7f, 0.6f, 2.6f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(2.5f, 3.5f, 4.85f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	// Black
-	SetShaderColor(0, 0, 0, 1);
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-	/****************************************************************/
-
-	/***********************Right Piece Bottom Door Negative Space*******************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(0.7f, 2.9f, 2.6f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(2.5f, 1.6f, 4.85f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	// Black
-	SetShaderColor(0, 0, 0, 1);
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-	/****************************************************************/
-}
-
-/***********************************************************
- *  RenderDrawers()
- *
- *  This method is called to render the shapes for the drawer 
- *  objects.
- ***********************************************************/
-void SceneManager::RenderDrawers()
+void SceneManager::RenderScene()
 {
-	SetShaderMaterial("wood");
-
-	SetTextureUVScale(4, 1);
-
-	// declare the variables for the transformations
-	glm::vec3 scaleXYZ;
-	float XrotationDegrees = 0.0f;
-	float YrotationDegrees = 0.0f;
-	float ZrotationDegrees = 0.0f;
-	glm::vec3 positionXYZ;
-
-	/****************************Top Drawer**************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(3.52f, 0.52f, 3.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(0.0f, 3.51f, 5.06f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	// Offwhite
-	SetShaderColor(0.960, 0.960, 0.862, 1);
-	SetShaderTexture("doors");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-	/****************************************************************/
-
-	/***********************Left Piece Top Drawer*******************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(0.62f, 0.55f, 2.6f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-2.47f, 3.5f, 4.9f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	// Offwhite
-	SetShaderColor(0.960, 0.960, 0.862, 1);
-	SetShaderTexture("doors");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-	/****************************************************************/
-
-	/***********************Right Piece Top Drawer*******************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(0.62f, 0.55f, 2.6f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(2.47f, 3.5f, 4.9f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	// Offwhite
-	SetShaderColor(0.960, 0.960, 0.862, 1);
-	SetShaderTexture("doors");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-	/****************************************************************/
-}
-
-/***********************************************************
- *  RenderDoors()
- *
- *  This method is called to render the shapes for the door 
- *  objects.
- ***********************************************************/
-void SceneManager::RenderDoors()
-{
-	SetShaderMaterial("wood");
-
-	SetTextureUVScale(1, 1);
-
-	// declare the variables for the transformations
-	glm::vec3 scaleXYZ;
-	float XrotationDegrees = 0.0f;
-	float YrotationDegrees = 0.0f;
-	float ZrotationDegrees = 0.0f;
-	glm::vec3 positionXYZ;
-
-	/********************************Large Door Left**********************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(1.75f, 2.74f, 3.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-0.89f, 1.66f, 5.06f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	// Offwhite
-	//SetShaderColor(0.960, 0.960, 0.862, 1);
-	SetShaderTexture("doors");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-	/****************************************************************/
-
-
-
-	/*******************************Large Door Right***********************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(1.75f, 2.74f, 3.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(0.89f, 1.66f, 5.06f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	// Offwhite
-	//SetShaderColor(0.960, 0.960, 0.862, 1);
-	SetShaderTexture("doors");
-	
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-	/****************************************************************/
-
-	/***********************Left Piece Bottom Door*******************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(0.65f, 2.8f, 2.6f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-2.48f, 1.62f, 4.86f);
+	// start the state counters of this frame - the UI renders
+	// between frames and leaves the cached GL state unknown
+	m_pShaderManager->GetStateCache()->BeginFrame();
+
+	// upload any light changes made since the last frame
+	UpdateLightBlock();
+
+	// list the point lights reaching every cluster of the view
+	UpdateLightClusters();
+
+	// counters of this frame, summed over the queued stores
+	m_transformUpdateCount = 0;
+	m_cullTestedCount = 0;
+	m_culledCount = 0;
+	m_occludedCount = 0;
+	m_fullTriangleCount = 0;
+	m_lodTriangleCount = 0;
+	m_lodSlotCount = 0;
+
+	// draw the occluders into the occlusion depth buffer
+	m_occluderTriangleCount = 0;
+	m_occlusionMicroseconds = 0.0;
+	if (m_bOcclusionCulling && (m_occlusionCuller.GetOccluderTriangleCount() > 0))
+	{
+		typedef std::chrono::high_resolution_clock Clock;
+		Clock::time_point start = Clock::now();
+		m_occluderTriangleCount = (unsigned int)m_occlusionCuller.Render(m_viewProjection);
+		m_occlusionMicroseconds = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+	}
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	// queue the static scene loaded by PrepareScene(), the
+	// baked batches and the objects that were not baked
+	QueueSceneObjects(m_bakedScene, LOD_SLOT_BAKED_SCENE);
+	QueueSceneObjects(m_staticScene, LOD_SLOT_STATIC_SCENE);
 
-	// Offwhite
-	//SetShaderColor(0.960, 0.960, 0.862, 1);
-	SetShaderTexture("doors");
+	// Allow rendering of all basic meshes
+	RenderMeshes();
 
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-	/****************************************************************/
-
-	/***********************Right Piece Bottom Door*******************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(0.65f, 2.8f, 2.6f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(2.48f, 1.62f, 4.86f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	// Offwhite
-	//SetShaderColor(0.960, 0.960, 0.862, 1);
-	SetShaderTexture("doors");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-	/****************************************************************/
-}
-
-/***********************************************************
- *  RenderKnobs()
- *
- *  This method is called to render the shapes for the knob 
- *  objects.
- ***********************************************************/
-void SceneManager::RenderKnobs()
-{
-	SetShaderMaterial("metal");
-
-	SetTextureUVScale(1, 1);
-
-	// declare the variables for the transformations
-	glm::vec3 scaleXYZ;
-	float XrotationDegrees = 0.0f;
-	float YrotationDegrees = 0.0f;
-	float ZrotationDegrees = 0.0f;
-	glm::vec3 positionXYZ;
-
-	/***********************Right Piece Bottom Door Knob*******************************************/
-	// Set texture scale for all knobs
-	SetTextureUVScale(1, 1);
-
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(0.08f, 0.08f, 0.08f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(2.25f, 1.62f, 6.15f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	// Gold
-	//SetShaderColor(0.854, 0.647, 0.125, 1);
-	SetShaderTexture("knobs");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
-	/****************************************************************/
-
-	/***********************Right Piece Top Drawer Knob*******************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(0.08f, 0.08f, 0.08f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(2.47f, 3.5f, 6.15f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	// Gold
-	//SetShaderColor(0.854, 0.647, 0.125, 1);
-	SetShaderTexture("knobs");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
-	/****************************************************************/
-
-	/***********************Left Piece Bottom Door Knob*******************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(0.08f, 0.08f, 0.08f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-2.25f, 1.62f, 6.15f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	// Gold
-	//SetShaderColor(0.854, 0.647, 0.125, 1);
-	SetShaderTexture("knobs");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
-	/****************************************************************/
-
-	/***********************Left Piece Top Drawer Knob*******************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(0.08f, 0.08f, 0.08f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-2.47f, 3.5f, 6.15f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	// Gold
-	//SetShaderColor(0.854, 0.647, 0.125, 1);
-	SetShaderTexture("knobs");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
-	/****************************************************************/
-
-	/****************************Large Door Right Knob**************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(0.08f, 0.08f, 0.08f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(0.2f, 1.65f, 6.5f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	// Gold
-	//SetShaderColor(0.854, 0.647, 0.125, 1);
-	SetShaderTexture("knobs");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
-	/****************************************************************/
-
-	/****************************Large Door Left Knob**************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(0.08f, 0.08f, 0.08f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-0.2f, 1.65f, 6.5f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	// Gold
-	//SetShaderColor(0.854, 0.647, 0.125, 1);
-	SetShaderTexture("knobs");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
-	/****************************************************************/
-
-	/****************************Top Drawer Knob**************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(0.08f, 0.08f, 0.08f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(0.0f, 3.5f, 6.5f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
-
-	// Gold
-	//SetShaderColor(0.854, 0.647, 0.125, 1);
-	SetShaderTexture("knobs");
-
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
-	/****************************************************************/
+	// issue the queued draws in state sorted order
+	FlushRenderQueue();
 }
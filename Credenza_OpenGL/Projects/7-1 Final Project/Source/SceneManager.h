@@ -15,10 +15,21 @@
 
 #include "ShaderManager.h"
 #include "ShapeMeshes.h"
+#include "RenderQueue.h"
+#include "FrustumCulling.h"
+#include "GBuffer.h"
+#include "GpuCulling.h"
+#include "BoundingVolumeHierarchy.h"
+#include "ClusteredLighting.h"
+#include "OcclusionCulling.h"
+#include "SceneStore.h"
+#include "SpatialHash.h"
+#include "StringInterner.h"
+#include "TransformCache.h"
 
 #include <string>
+#include <unordered_map>
 #include <vector>
-#include <functional>
 
 // Assimp library for loading 3D models
 #include <assimp/Importer.hpp>
@@ -56,24 +67,12 @@ public:
 
 	void LoadSceneTextures();
 
-	// Seperate scene components into different methods with unique values
-	void RenderKnobs();
-	void RenderFloor();
-	void RenderPictureFrame();
-	void RenderVase();
-	void RenderVaseBase();
-	void RenderCandleHolders();
-	void RenderCandles();
-	void RenderCandleWicks();
-	void RenderDoors();
-	void RenderDrawers();
-	void RenderNegativeSpace();
-	void RenderBackdrop();
-	void RenderCredenza();
+	// Load the static scene description into its scene store
+	void LoadStaticScene(std::string filename);
 
 	struct TEXTURE_INFO
 	{
-		std::string tag;
+		StringID tag;
 		uint32_t ID;
 	};
 
@@ -84,29 +83,78 @@ public:
 		glm::vec3 diffuseColor;
 		glm::vec3 specularColor;
 		float shininess;
-		std::string tag;
+		StringID tag;
 	};
 
-	// Mesh object structure to hold properties for each mesh
-	struct MESH_OBJECT
+	// std140 mirror of the Material struct in fragmentShader.glsl
+	struct GPU_MATERIAL
+	{
+		glm::vec3 ambientColor;
+		float ambientStrength;
+		glm::vec3 diffuseColor;
+		float padding0;
+		glm::vec3 specularColor;
+		float shininess;
+	};
+
+	// number of material slots in the shader MaterialBlock
+	static const int MAX_MATERIALS = 32;
+
+	// find the index of a defined material by tag, -1 if not defined
+	int FindMaterialIndex(StringID tag) const;
+
+	// std140 mirror of the LightSource struct in fragmentShader.glsl,
+	// the padding keeps every vec3 on a 16 byte boundary
+	struct LIGHT_SOURCE
 	{
-		std::string tag;
-		glm::vec3 rotation;
 		glm::vec3 position;
-		glm::vec3 scale;
-		std::string materialTag;
-		std::string textureTag;
-		glm::vec2 uvScale;
-		glm::vec4 shaderColor;
-		std::function<void()> drawFunction;
-		bool isRotating = false;
+		float padding0;
+		glm::vec3 ambientColor;
+		float padding1;
+		glm::vec3 diffuseColor;
+		float padding2;
+		glm::vec3 specularColor;
+		float focalStrength;
+		float specularIntensity;
+		float padding3[3];
 	};
 
+	// number of light slots in the shader LightBlock
+	static const int TOTAL_LIGHTS = 4;
+
+	// replace a scene light - the light block is uploaded
+	// once before the next rendered frame
+	void SetLight(int index, const LIGHT_SOURCE& light);
+	const LIGHT_SOURCE& GetLight(int index) const { return m_lights[index]; }
+
+	// set how many light slots the lit shader variants evaluate -
+	// every slot contributes the material ambient and diffuse
+	// terms, so the default keeps all TOTAL_LIGHTS slots
+	void SetActiveLightCount(int lightCount);
+	int GetActiveLightCount() const { return m_activeLightCount; }
+
+	// add or replace a point light, shaded only by the fragments of
+	// the clusters it reaches - any number of them may be added
+	size_t AddPointLight(const LightClusterer::POINT_LIGHT& light) { return m_lightClusterer.AddLight(light); }
+	void SetPointLight(size_t index, const LightClusterer::POINT_LIGHT& light) { m_lightClusterer.SetLight(index, light); }
+	size_t GetPointLightCount() const { return m_lightClusterer.Size(); }
+	// add the passed in number of randomly placed test lights after
+	// the point lights of the static scene, replacing the last ones
+	void SetTestPointLightCount(int count);
+	int GetTestPointLightCount() const { return m_testPointLightCount; }
+	// references to point lights over all clusters, the most point
+	// lights of one cluster and the time taken to build the cluster
+	// lists for the last frame
+	size_t GetClusterLightIndexCount() const { return m_lightClusterer.GetLightIndexCount(); }
+	size_t GetMaxClusterLightCount() const { return m_lightClusterer.GetMaxClusterLightCount(); }
+	double GetLightClusterMicroseconds() const { return m_lightClusterMicroseconds; }
+
 	// Add meshes to scene with various properties
-	void AddMeshToScene(std::string tag, glm::vec3 position, glm::vec3 rotation, 
-		glm::vec3 scale, std::string materialTag, 
-		std::string textureTag, glm::vec2 uvScale,
-		glm::vec4 shaderColor, std::function<void()> drawFunction);
+	SceneStore::Handle AddMeshToScene(StringID tag, glm::vec3 position, glm::vec3 rotation, 
+		glm::vec3 scale, StringID materialTag, 
+		StringID textureTag, glm::vec2 uvScale,
+		glm::vec4 shaderColor, ShapeMeshes::DRAW_RECORD drawRecord,
+		SceneStore::Handle parent = SceneStore::INVALID_HANDLE);
 
 	// Add basic shapes to the scene with unique properties
 	void AddBox();
@@ -124,34 +172,119 @@ public:
 	void RenderMeshes();
 
 	// Getters for the meshes
-	int GetNumMeshes() { return m_meshes.size(); }
-
-	// Get a specific mesh object by index
-	MESH_OBJECT& GetMesh(int index) { return m_meshes[index]; }
-
-	// Remove a mesh object from the scene by index
-	void RemoveMesh(int index);
-
-	// List of mesh objects to be rendered in the scene
-	std::vector<MESH_OBJECT> m_meshes;
+	int GetNumMeshes() { return (int)m_sceneStore.Size(); }
+
+	// Get the store of the mesh objects, indexed by dense index
+	SceneStore& GetSceneStore() { return m_sceneStore; }
+
+	// Remove a mesh object, and the objects below it, from the
+	// scene by handle - stale handles are ignored
+	void RemoveMesh(SceneStore::Handle handle);
+
+	// find the mesh object nearest along a world space ray,
+	// INVALID_HANDLE when the ray hits none
+	SceneStore::Handle PickMesh(const glm::vec3& origin, const glm::vec3& direction);
+	// time taken by the last pick, including any tree updates
+	double GetLastPickMicroseconds() const { return m_lastPickMicroseconds; }
+
+	// find the mesh objects whose world boxes overlap a box, or
+	// that are inside the view frustum, through the spatial hash,
+	// which is brought up to date first
+	void FindMeshesInBox(const glm::vec3& boxMin, const glm::vec3& boxMax,
+		std::vector<SceneStore::Handle>& handles);
+	void FindMeshesInView(std::vector<SceneStore::Handle>& handles);
+	// grid of the world boxes of the mesh objects
+	const SpatialHash& GetSpatialHash() const { return m_spatialHash; }
+	// boxes updated in the grid, and how many changed cells, by the last query
+	unsigned int GetSpatialUpdateCount() const { return m_spatialUpdateCount; }
+	unsigned int GetSpatialCellChangeCount() const { return m_spatialCellChangeCount; }
 
 	// Load a 3D model from a file and process its meshes
-	void LoadModel(std::string filename, std::string tag, 
+	void LoadModel(const std::string& filename, StringID tag, 
 		glm::vec3 position, glm::vec3 rotation,
-		glm::vec3 scale, std::string materialTag,
-		std::string textureTag, glm::vec2 uvScale,
+		glm::vec3 scale, StringID materialTag,
+		StringID textureTag, glm::vec2 uvScale,
 		glm::vec4 shaderColor, bool isRotating);
 	void ProcessNode(aiNode* node, const aiScene* scene, 
-		std::string tag, glm::vec3 position, 
-		glm::vec3 rotation, glm::vec3 scale,
-		std::string materialTag,
-		std::string textureTag, glm::vec2 uvScale,
-		glm::vec4 shaderColor, bool isRotating);
+		SceneStore::Handle parent, StringID tag, 
+		StringID materialTag,
+		StringID textureTag, glm::vec2 uvScale,
+		glm::vec4 shaderColor);
 	void ProcessMesh(aiMesh* mesh, const aiScene* scene, 
-		std::string tag, glm::vec3 position, glm::vec3 rotation, 
-		glm::vec3 scale, std::string materialTag,
-		std::string textureTag, glm::vec2 uvScale,
-		glm::vec4 shaderColor, bool isRotating);
+		SceneStore::Handle parent, StringID tag, 
+		StringID materialTag,
+		StringID textureTag, glm::vec2 uvScale,
+		glm::vec4 shaderColor);
+
+	// camera position used to order the queued draws by depth
+	void SetViewPosition(const glm::vec3& viewPosition) { m_viewPosition = viewPosition; }
+	// view and projection the queued objects are culled against
+	// and the point lights are clustered for
+	void SetViewProjection(const glm::mat4& view, const glm::mat4& projection);
+	// test the objects inside the frustum against the occluders
+	// of the static scene before queueing them
+	void SetOcclusionCulling(bool bEnabled) { m_bOcclusionCulling = bEnabled; }
+	bool GetOcclusionCulling() const { return m_bOcclusionCulling; }
+	// draw imported meshes at the level of detail that matches
+	// their size on screen
+	void SetLodSelection(bool bEnabled) { m_bLodSelection = bEnabled; }
+	bool GetLodSelection() const { return m_bLodSelection; }
+	// cull the opaque objects and select their level of detail in
+	// a compute shader instead of on the CPU, when supported
+	void SetGpuCulling(bool bEnabled) { m_bGpuCulling = bEnabled; }
+	bool GetGpuCulling() const { return m_bGpuCulling; }
+	bool IsGpuCullingSupported() const { return m_gpuCuller.IsSupported(); }
+	// frames the counts of the GPU culled objects lag behind, as
+	// they are read back without waiting on the GPU
+	unsigned int GetGpuCullStatsLatency() const { return m_gpuCullStatsLatency; }
+	// write the opaque draws to a G-buffer and light every pixel
+	// once, instead of lighting every drawn fragment
+	void SetDeferredShading(bool bEnabled) { m_bDeferredShading = bEnabled; }
+	bool GetDeferredShading() const { return m_bDeferredShading; }
+	// GPU time of the culling dispatch and the draws of the scene,
+	// measured a frame or two behind
+	double GetSceneGpuMilliseconds() const { return m_sceneGpuMilliseconds; }
+
+	// results of the GPU culling of the last frame compared with
+	// the CPU culling of the same objects
+	struct GPU_CULL_CHECK
+	{
+		unsigned int itemCount;
+		unsigned int gpuVisibleCount;
+		unsigned int cpuVisibleCount;
+		unsigned int visibilityMismatches;
+		unsigned int occlusionMismatches;
+		unsigned int lodMismatches;
+	};
+	// read back the GPU culling results of the last frame and
+	// repeat the culling on the CPU, false without GPU culling
+	bool CheckGpuCulling(GPU_CULL_CHECK& check);
+
+	// state change counts of the last rendered frame
+	const RenderQueue::RENDER_QUEUE_STATS& GetRenderQueueStats() const { return m_renderQueue.GetStats(); }
+	// multi-draw calls issued for the queued draws of the last frame
+	unsigned int GetDrawCallCount() const { return m_drawCallCount; }
+	// indirect draw commands issued by those calls
+	unsigned int GetDrawCommandCount() const { return m_drawCommandCount; }
+	// world matrices recomposed for the last frame
+	unsigned int GetTransformUpdateCount() const { return m_transformUpdateCount; }
+	// objects tested against the frustum and objects culled for the last frame
+	unsigned int GetCullTestedCount() const { return m_cullTestedCount; }
+	unsigned int GetCulledCount() const { return m_culledCount; }
+	// objects found hidden behind the occluders for the last frame
+	unsigned int GetOccludedCount() const { return m_occludedCount; }
+	// occluder triangles rasterized and the time taken for the last frame
+	unsigned int GetOccluderTriangleCount() const { return m_occluderTriangleCount; }
+	double GetOcclusionMicroseconds() const { return m_occlusionMicroseconds; }
+	// triangles of the objects queued for the last frame, at full
+	// detail and at the levels of detail drawn
+	unsigned int GetFullTriangleCount() const { return m_fullTriangleCount; }
+	unsigned int GetLodTriangleCount() const { return m_lodTriangleCount; }
+	// static objects merged by the bake of the loaded scene, the
+	// batches they became, and whether the bake came from the cache
+	unsigned int GetBakedObjectCount() const { return m_bakedObjectCount; }
+	unsigned int GetBakedBatchCount() const { return (unsigned int)m_bakedScene.Size(); }
+	bool WasBakeCached() const { return m_bBakeCached; }
 
 	// Infinite rotation boolean
 	bool isRotating = false;
@@ -170,6 +303,260 @@ private:
 	TEXTURE_INFO m_textureIDs[16];
 	// defined object materials
 	std::vector<OBJECT_MATERIAL> m_objectMaterials;
+	// material index and texture slot of every interned tag
+	std::unordered_map<StringID, int> m_materialIndices;
+	std::unordered_map<StringID, int> m_textureSlots;
+	// mesh objects added to the scene at runtime
+	SceneStore m_sceneStore;
+	// objects of the static scene description that are not baked
+	SceneStore m_staticScene;
+	// one object per baked batch of the static scene
+	SceneStore m_bakedScene;
+	unsigned int m_bakedObjectCount;
+	bool m_bBakeCached;
+
+	// merge the static objects of the static scene into baked
+	// batches, read from the cache file when it matches the source
+	void BakeStaticScene(const std::string& cacheFilename, uint64_t sourceHash);
+	// give the occluder objects of the static scene to the
+	// occlusion culler, before the bake drops them
+	void CollectOccluders();
+
+	// full geometry followed by the coarser levels simplified
+	// from it at import
+	static const int MAX_LOD_LEVELS = 4;
+	struct LOD_CHAIN
+	{
+		unsigned int geometries[MAX_LOD_LEVELS];
+		int levelCount;
+	};
+	// level of detail chain of every geometry, by geometry identifier,
+	// geometries without coarser levels have no levels
+	std::vector<LOD_CHAIN> m_lodChains;
+	bool m_bLodSelection;
+	// vertical projection scale of the current view
+	float m_lodProjectionScale;
+	unsigned int m_fullTriangleCount;
+	unsigned int m_lodTriangleCount;
+
+	// simplify an imported mesh into coarser levels over the same
+	// vertices and keep them as the chain of its geometry
+	void BuildLodChain(unsigned int geometry, const std::vector<float>& vertices,
+		const std::vector<unsigned int>& indices);
+	// get the level of detail to draw an object at, from the size
+	// of its bounding sphere on screen and the level drawn before
+	int SelectLodLevel(const glm::vec4& sphere, const glm::mat4& world, int levelCount, int currentLevel) const;
+
+	// compute shader culling of the opaque draws
+	GpuCuller m_gpuCuller;
+	bool m_bGpuCulling;
+	unsigned int m_gpuCullStatsLatency;
+	// scene stores giving level slots to their objects, the slot of
+	// an object is its handle slot times the store count plus its
+	// store, so it stays the same while other objects come and go
+	enum LodSlotStore
+	{
+		LOD_SLOT_BAKED_SCENE = 0,
+		LOD_SLOT_STATIC_SCENE,
+		LOD_SLOT_SCENE_STORE,
+		LOD_SLOT_STORE_COUNT
+	};
+	// level slots needed by the stores queued this frame
+	uint32_t m_lodSlotCount;
+	// draws of the queue issued by one multi-draw call, culled
+	// on the GPU when it has a pass of the GPU culler
+	struct SUBMISSION
+	{
+		size_t first;
+		size_t last;
+		GLuint gpuPass;
+	};
+	static const GLuint NO_GPU_PASS = 0xFFFFFFFF;
+	std::vector<SUBMISSION> m_submissions;
+	// add the draws of a submission to a new pass of the GPU culler
+	GLuint AddGpuCullPass(size_t first, size_t last);
+	// issue the draws of a submission with a shader variant
+	void DrawSubmission(const SUBMISSION& submission, unsigned int variantKey);
+
+	// surface attributes written by the opaque draws with
+	// deferred shading, and the framebuffer they are lit into
+	GBuffer m_gBuffer;
+	bool m_bDeferredShading;
+	GLuint m_deferredFramebuffer;
+	// timer queries of the draws of the last two frames, used in turn
+	GLuint m_gpuTimerQueries[2];
+	unsigned int m_gpuTimerFrame;
+	double m_sceneGpuMilliseconds;
+	// bind the G-buffer for the opaque draws, false when it is
+	// not available and the frame is shaded forward
+	bool BeginGeometryPass();
+	// shade the G-buffer into the framebuffer being drawn
+	void LightGBuffer();
+
+	// triangles of the drawn parts of a geometry and the tree
+	// over them, read back the first time the geometry is picked
+	// or used as an occluder
+	struct MESH_TRIANGLES
+	{
+		std::vector<glm::vec3> positions;
+		std::vector<GLuint> indices;
+		BoundingVolumeHierarchy tree;
+	};
+	// mesh triangles by geometry and drawn parts
+	std::unordered_map<uint64_t, MESH_TRIANGLES> m_meshTriangles;
+	// tree over the world boxes of the mesh objects that have
+	// geometry, and the dense index of every box
+	BoundingVolumeHierarchy m_pickTree;
+	std::vector<uint32_t> m_pickObjects;
+	std::vector<glm::vec3> m_pickBoxMins;
+	std::vector<glm::vec3> m_pickBoxMaxs;
+	// store versions the pick tree was last built or refit at
+	uint32_t m_pickLayoutVersion;
+	uint32_t m_pickWorldVersion;
+	bool m_bPickTreeValid;
+	double m_lastPickMicroseconds;
+
+	// world boxes of the mesh objects that have geometry, each
+	// registered under the slot of its handle, which stays the
+	// same while other objects are added and removed; moves are
+	// applied when the grid is queried, removals right away
+	SpatialHash m_spatialHash;
+	// handle registered under every slot
+	std::vector<SceneStore::Handle> m_spatialHandles;
+	// false until every object is registered, and after the
+	// store is cleared
+	bool m_bSpatialHashValid;
+	// objects moved since the last update, and query results
+	std::vector<uint32_t> m_movedObjects;
+	std::vector<uint32_t> m_spatialIds;
+	unsigned int m_spatialUpdateCount;
+	unsigned int m_spatialCellChangeCount;
+
+	// bring the grid up to date with the mesh objects
+	void UpdateSpatialHash();
+	// register the world box of one object, or remove it when it
+	// has no geometry
+	void UpdateSpatialEntry(size_t index);
+
+	// rebuild the pick tree after objects were added or removed,
+	// or refit it after objects moved
+	void UpdatePickTree();
+	// get the triangles of a draw record, reading them back on first use
+	MESH_TRIANGLES& GetMeshTriangles(const ShapeMeshes::DRAW_RECORD& record);
+	// primitive tests of the pick trees, the context is the scene
+	// manager for objects and the mesh triangles for triangles
+	static float PickObjectTest(void* pContext, uint32_t primitive,
+		const glm::vec3& origin, const glm::vec3& direction, float maxDistance);
+	static float PickTriangleTest(void* pContext, uint32_t primitive,
+		const glm::vec3& origin, const glm::vec3& direction, float maxDistance);
+
+	// pre-resolved handles for the uniforms set on every draw
+	struct SHADER_UNIFORMS
+	{
+		UniformHandle objectTexture;
+		UniformHandle gbufferAlbedo;
+		UniformHandle gbufferNormal;
+		UniformHandle gbufferDepth;
+	};
+	SHADER_UNIFORMS m_uniforms;
+
+	// resolve the per-draw uniform names into handles
+	void ResolveUniformHandles();
+
+	// CPU copy of the LightBlock uniform buffer contents
+	LIGHT_SOURCE m_lights[TOTAL_LIGHTS];
+	// uniform buffer object backing the LightBlock
+	GLuint m_lightBlockUBO;
+	// set when a light changed since the last upload
+	bool m_bLightsDirty;
+
+	// upload the light block if any light has changed
+	void UpdateLightBlock();
+
+	// point lights and their lists for the clusters of the view
+	LightClusterer m_lightClusterer;
+	// point lights loaded with the static scene, the test lights follow
+	size_t m_scenePointLightCount;
+	int m_testPointLightCount;
+	double m_lightClusterMicroseconds;
+
+	// build and upload the point light lists of the clusters
+	void UpdateLightClusters();
+
+	// render state that selects the shader variant
+	bool m_bUseTexture;
+	bool m_bUseLighting;
+	bool m_bTranslucentColor;
+	int m_activeLightCount;
+
+	// get the shader variant key matching the render state
+	unsigned int GetShaderVariantKey() const;
+
+	// everything needed to issue one queued draw
+	struct DRAW_PACKET
+	{
+		// cache holding the world matrix and its index there
+		const TransformCache* pTransforms;
+		uint32_t transform;
+		glm::vec4 color;
+		glm::vec2 uvScale;
+		int textureSlot;
+		int materialIndex;
+		unsigned int variantKey;
+		// shape or imported geometry and the drawn parts of it
+		ShapeMeshes::DRAW_RECORD draw;
+		// culled and given its level of detail on the GPU, using
+		// the level slot for the hysteresis
+		bool bGpuCulled;
+		uint32_t lodSlot;
+	};
+
+	// world matrices recomposed for the last frame
+	unsigned int m_transformUpdateCount;
+	// objects tested against the frustum and objects culled for the last frame
+	unsigned int m_cullTestedCount;
+	unsigned int m_culledCount;
+	// world space boxes of the objects of the store being queued,
+	// and the object index of every box
+	FrustumCuller m_frustumCuller;
+	std::vector<uint32_t> m_cullObjects;
+	// depth buffer of the occluders of the static scene
+	OcclusionCuller m_occlusionCuller;
+	bool m_bOcclusionCulling;
+	glm::mat4 m_view;
+	glm::mat4 m_projection;
+	glm::mat4 m_viewProjection;
+	unsigned int m_occludedCount;
+	unsigned int m_occluderTriangleCount;
+	double m_occlusionMicroseconds;
+
+	// draw state set by the Set* methods for the next submitted draw
+	DRAW_PACKET m_drawState;
+	// payloads of the draws queued this frame
+	std::vector<DRAW_PACKET> m_drawPackets;
+	// sort keys of the draws queued this frame
+	RenderQueue m_renderQueue;
+	// camera position of the frame
+	glm::vec3 m_viewPosition;
+
+	// update the world matrices of a scene store and queue every
+	// object of it that is inside the view frustum, the store is
+	// one of LodSlotStore
+	void QueueSceneObjects(SceneStore& store, uint32_t lodSlotStore);
+	// queue the current draw state under the passed in mesh key
+	void SubmitDraw(unsigned int meshKey);
+	// per-instance data of the queued draws in sorted order
+	std::vector<ShapeMeshes::INSTANCE_DATA> m_instances;
+	// multi-draw calls and the draw commands they contained for the last frame
+	unsigned int m_drawCallCount;
+	unsigned int m_drawCommandCount;
+
+	// sort the queued draws and issue them as multi-draw submissions
+	void FlushRenderQueue();
+	// check whether two queued draws can share a multi-draw call
+	bool CanShareSubmission(const DRAW_PACKET& first, const DRAW_PACKET& second) const;
+	// check whether two queued draws can share an instanced draw call
+	bool CanInstanceTogether(const DRAW_PACKET& first, const DRAW_PACKET& second) const;
 
 	// load texture images and convert to OpenGL texture data
 	bool CreateGLTexture(const char* filename, std::string tag);
@@ -178,19 +565,12 @@ private:
 	// free the loaded OpenGL textures
 	void DestroyGLTextures();
 	// find a loaded texture by tag
-	int FindTextureID(std::string tag);
-	int FindTextureSlot(std::string tag);
-	// find a defined material by tag
-	bool FindMaterial(std::string tag, OBJECT_MATERIAL& material);
-
-	// set the transformation values 
-	// into the transform buffer
-	void SetTransformations(
-		glm::vec3 scaleXYZ,
-		float XrotationDegrees,
-		float YrotationDegrees,
-		float ZrotationDegrees,
-		glm::vec3 positionXYZ);
+	int FindTextureID(StringID tag);
+	int FindTextureSlot(StringID tag);
+	// pack the defined materials into the material uniform buffer
+	void UploadMaterials();
+	// uniform buffer object backing the MaterialBlock
+	GLuint m_materialBlockUBO;
 
 	// set the color values into the shader
 	void SetShaderColor(
@@ -201,7 +581,7 @@ private:
 
 	// set the texture data into the shader
 	void SetShaderTexture(
-		std::string textureTag);
+		int textureSlot);
 
 	// set the UV scale for the texture mapping
 	void SetTextureUVScale(
@@ -209,6 +589,6 @@ private:
 
 	// set the object material into the shader
 	void SetShaderMaterial(
-		std::string materialTag);
+		int materialIndex);
 
 };
\ No newline at end of file
@@ -0,0 +1,313 @@
+///////////////////////////////////////////////////////////////////////////////
+// SceneStore.cpp
+// ============
+// store the objects of the editable scene as dense parallel arrays, so the
+// per-frame passes only touch the data they read
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneStore.h"
+
+/***********************************************************
+ *  Add()
+ *
+ *  This method is used for appending an object to the
+ *  dense arrays and giving it a handle.  Slots of removed
+ *  objects are reused, with their new generation, before
+ *  new ones are made.  The parent must already be in the
+ *  store.
+ ***********************************************************/
+SceneStore::Handle SceneStore::Add(const OBJECT_DESC& desc)
+{
+	uint32_t index = (uint32_t)Size();
+
+	uint32_t slot = m_freeSlot;
+	if (slot != INVALID_HANDLE)
+	{
+		m_freeSlot = m_handleIndices[slot];
+		m_handleIndices[slot] = index;
+	}
+	else
+	{
+		if (m_handleIndices.size() >= MAX_OBJECTS)
+		{
+			return(INVALID_HANDLE);
+		}
+		slot = (uint32_t)m_handleIndices.size();
+		m_handleIndices.push_back(index);
+		m_generations.push_back(0);
+	}
+	Handle handle = ((Handle)m_generations[slot] << HANDLE_SLOT_BITS) | slot;
+
+	size_t parentIndex = GetIndex(desc.parent);
+	m_transforms.Add(desc.position, desc.rotation, desc.scale,
+		(parentIndex < index) ? (uint32_t)parentIndex : TransformCache::NO_PARENT);
+	m_materialIndices.push_back(desc.materialIndex);
+	m_textureSlots.push_back(desc.textureSlot);
+	m_uvScales.push_back(desc.uvScale);
+	m_colors.push_back(desc.color);
+	m_drawRecords.push_back(desc.drawRecord);
+	m_flags.push_back(desc.flags);
+	m_lodLevels.push_back(0);
+
+	OBJECT_NAMES names;
+	names.tag = desc.tag;
+	names.materialTag = desc.materialTag;
+	names.textureTag = desc.textureTag;
+	m_names.push_back(names);
+
+	m_handles.push_back(handle);
+	m_layoutVersion++;
+
+	return(handle);
+}
+
+/***********************************************************
+ *  Remove()
+ *
+ *  This method is used for removing an object and every
+ *  object below it.  The subtree is collected breadth
+ *  first along the child lists of the transforms, by
+ *  handle since dense indices move while objects are
+ *  removed, then removed deepest first so every object is
+ *  childless when it goes.  The cost is the size of the
+ *  subtree, whatever the size of the store.
+ ***********************************************************/
+void SceneStore::Remove(Handle handle)
+{
+	// a stale or invalid handle removes nothing
+	m_subtree.clear();
+	size_t index = GetIndex(handle);
+	if (index >= Size())
+	{
+		return;
+	}
+
+	m_subtree.push_back((uint32_t)index);
+	for (size_t i = 0; i < m_subtree.size(); i++)
+	{
+		for (uint32_t child = m_transforms.GetFirstChild(m_subtree[i]);
+			child != TransformCache::NO_PARENT; child = m_transforms.GetNextSibling(child))
+		{
+			m_subtree.push_back(child);
+		}
+	}
+	for (size_t i = 0; i < m_subtree.size(); i++)
+	{
+		m_subtree[i] = m_handles[m_subtree[i]];
+	}
+
+	for (size_t i = m_subtree.size(); i > 0; i--)
+	{
+		RemoveObject(m_subtree[i - 1]);
+	}
+}
+
+/***********************************************************
+ *  RemoveObject()
+ *
+ *  This method is used for removing a single object.  The
+ *  last object is moved into the freed dense index and its
+ *  slot is pointed at the new index.  The freed slot moves
+ *  on to its next generation.
+ ***********************************************************/
+void SceneStore::RemoveObject(Handle handle)
+{
+	size_t index = GetIndex(handle);
+	if (index >= Size())
+	{
+		return;
+	}
+
+	size_t last = Size() - 1;
+	if (index != last)
+	{
+		m_materialIndices[index] = m_materialIndices[last];
+		m_textureSlots[index] = m_textureSlots[last];
+		m_uvScales[index] = m_uvScales[last];
+		m_colors[index] = m_colors[last];
+		m_drawRecords[index] = m_drawRecords[last];
+		m_flags[index] = m_flags[last];
+		m_lodLevels[index] = m_lodLevels[last];
+		m_names[index] = m_names[last];
+		m_handles[index] = m_handles[last];
+
+		m_handleIndices[m_handles[index] & HANDLE_SLOT_MASK] = (uint32_t)index;
+	}
+
+	m_transforms.Remove(index);
+	m_materialIndices.pop_back();
+	m_textureSlots.pop_back();
+	m_uvScales.pop_back();
+	m_colors.pop_back();
+	m_drawRecords.pop_back();
+	m_flags.pop_back();
+	m_lodLevels.pop_back();
+	m_names.pop_back();
+	m_handles.pop_back();
+
+	// the slot joins the free list, copies of the handle
+	// no longer match its generation
+	uint32_t slot = handle & HANDLE_SLOT_MASK;
+	m_generations[slot] = (uint16_t)((m_generations[slot] + 1) & HANDLE_GENERATION_MASK);
+	m_handleIndices[slot] = m_freeSlot;
+	m_freeSlot = slot;
+	m_layoutVersion++;
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for removing every object and
+ *  releasing all handles.  The slots are kept and move on
+ *  to their next generation, so handles taken before the
+ *  store was cleared stay stale.
+ ***********************************************************/
+void SceneStore::Clear()
+{
+	m_transforms.Clear();
+	m_materialIndices.clear();
+	m_textureSlots.clear();
+	m_uvScales.clear();
+	m_colors.clear();
+	m_drawRecords.clear();
+	m_flags.clear();
+	m_lodLevels.clear();
+	m_names.clear();
+	m_handles.clear();
+	m_subtree.clear();
+	m_layoutVersion++;
+
+	m_freeSlot = INVALID_HANDLE;
+	for (size_t slot = m_handleIndices.size(); slot-- > 0;)
+	{
+		m_generations[slot] = (uint16_t)((m_generations[slot] + 1) & HANDLE_GENERATION_MASK);
+		m_handleIndices[slot] = m_freeSlot;
+		m_freeSlot = (uint32_t)slot;
+	}
+}
+
+/***********************************************************
+ *  GetIndex()
+ *
+ *  This method is used for getting the dense index of the
+ *  object with the passed in handle.  Handles whose
+ *  generation is not the current one of their slot, and
+ *  handles of slots never used, return an index past the
+ *  end of the arrays.
+ ***********************************************************/
+size_t SceneStore::GetIndex(Handle handle) const
+{
+	uint32_t slot = handle & HANDLE_SLOT_MASK;
+	if ((handle == INVALID_HANDLE) || (slot >= m_handleIndices.size()) ||
+		(m_generations[slot] != (handle >> HANDLE_SLOT_BITS)))
+	{
+		return(Size());
+	}
+
+	return(m_handleIndices[slot]);
+}
+
+/***********************************************************
+ *  SetParent()
+ *
+ *  This method is used for attaching an object to another
+ *  one, or detaching it with INVALID_HANDLE.
+ ***********************************************************/
+bool SceneStore::SetParent(Handle handle, Handle parent)
+{
+	size_t index = GetIndex(handle);
+	if (index >= Size())
+	{
+		return(false);
+	}
+
+	uint32_t parentIndex = TransformCache::NO_PARENT;
+	if (parent != INVALID_HANDLE)
+	{
+		size_t found = GetIndex(parent);
+		if (found >= Size())
+		{
+			return(false);
+		}
+		parentIndex = (uint32_t)found;
+	}
+
+	return(m_transforms.SetParent(index, parentIndex));
+}
+
+/***********************************************************
+ *  GetParent()
+ *
+ *  This method is used for getting the handle of the
+ *  parent of an object.
+ ***********************************************************/
+SceneStore::Handle SceneStore::GetParent(size_t index) const
+{
+	uint32_t parent = m_transforms.GetParent(index);
+	if (parent == TransformCache::NO_PARENT)
+	{
+		return(INVALID_HANDLE);
+	}
+	return(m_handles[parent]);
+}
+
+/***********************************************************
+ *  GetRenderView()
+ *
+ *  This method is used for getting the dense arrays that
+ *  the render pass walks from the first to the last object.
+ ***********************************************************/
+SceneStore::RENDER_VIEW SceneStore::GetRenderView() const
+{
+	RENDER_VIEW view;
+	view.count = Size();
+	view.positions = m_transforms.GetPositions();
+	view.rotations = m_transforms.GetRotations();
+	view.scales = m_transforms.GetScales();
+	view.worldMatrices = m_transforms.GetWorldMatrices();
+	view.materialIndices = m_materialIndices.data();
+	view.textureSlots = m_textureSlots.data();
+	view.uvScales = m_uvScales.data();
+	view.colors = m_colors.data();
+	view.drawRecords = m_drawRecords.data();
+	view.flags = m_flags.data();
+
+	return(view);
+}
+
+/***********************************************************
+ *  RotateAll()
+ *
+ *  This method is used for turning every root object around
+ *  its Y axis, keeping the angle within one full turn.
+ *  Only the transforms are touched.
+ ***********************************************************/
+void SceneStore::RotateAll(float degrees)
+{
+	m_transforms.RotateAllY(degrees);
+}
+
+/***********************************************************
+ *  SetMaterial()
+ *
+ *  This method is used for changing the material of an
+ *  object by tag and resolved material index.
+ ***********************************************************/
+void SceneStore::SetMaterial(size_t index, StringID materialTag, int materialIndex)
+{
+	m_names[index].materialTag = materialTag;
+	m_materialIndices[index] = materialIndex;
+}
+
+/***********************************************************
+ *  SetTexture()
+ *
+ *  This method is used for changing the texture of an
+ *  object by tag and resolved texture slot.
+ ***********************************************************/
+void SceneStore::SetTexture(size_t index, StringID textureTag, int textureSlot)
+{
+	m_names[index].textureTag = textureTag;
+	m_textureSlots[index] = textureSlot;
+}
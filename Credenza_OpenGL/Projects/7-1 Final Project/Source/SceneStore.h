@@ -0,0 +1,221 @@
+///////////////////////////////////////////////////////////////////////////////
+// SceneStore.h
+// ============
+// store the objects of the editable scene as dense parallel arrays, so the
+// per-frame passes only touch the data they read
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "ShapeMeshes.h"
+#include "StringInterner.h"
+#include "TransformCache.h"
+
+/***********************************************************
+ *  SceneStore
+ *
+ *  This class contains the objects added to the scene at
+ *  runtime in a structure-of-arrays layout.  Each kind of
+ *  per-object data lives in its own dense array, all of
+ *  them indexed by the same dense index.  Removing an
+ *  object moves the last object into its slot, so the
+ *  arrays never have holes.
+ *
+ *  Objects are referred to from outside by handles, which
+ *  stay valid while other objects are added and removed.
+ *  A handle names a slot of the handle table, which maps
+ *  it to the current dense index of its object, and the
+ *  generation of that slot.  Removing an object advances
+ *  the generation, so its handle is detected as stale
+ *  even after the slot is reused.  Adding is constant
+ *  time, removing costs the size of the removed subtree.
+ *
+ *  The transforms are kept in a transform cache that holds
+ *  the world matrix of every object, so unchanged objects
+ *  are not recomposed every frame.  An object may have a
+ *  parent object, its transform is then relative to the
+ *  parent and it moves with it.
+ ***********************************************************/
+class SceneStore
+{
+public:
+	// stable reference to an object of the store, the slot in
+	// the low bits and its generation in the high bits
+	typedef uint32_t Handle;
+	static const Handle INVALID_HANDLE = 0xFFFFFFFF;
+	static const uint32_t HANDLE_SLOT_BITS = 20;
+	static const uint32_t HANDLE_SLOT_MASK = (1u << HANDLE_SLOT_BITS) - 1;
+	static const uint32_t HANDLE_GENERATION_MASK = 0xFFFFFFFF >> HANDLE_SLOT_BITS;
+	// the last slot is never used, so no handle equals INVALID_HANDLE
+	static const uint32_t MAX_OBJECTS = HANDLE_SLOT_MASK;
+
+	// per-object flags
+	enum ObjectFlag
+	{
+		OBJECT_FLAG_ROTATING = 1 << 0,
+		// drawn with its texture instead of its color
+		OBJECT_FLAG_TEXTURED = 1 << 1,
+		// never moves, merged by the static geometry bake
+		OBJECT_FLAG_STATIC = 1 << 2,
+		// large static object that hides the objects behind it,
+		// rasterized by the occlusion culling
+		OBJECT_FLAG_OCCLUDER = 1 << 3
+	};
+
+	// everything needed to add an object
+	struct OBJECT_DESC
+	{
+		StringID tag;
+		glm::vec3 position;
+		glm::vec3 rotation;
+		glm::vec3 scale;
+		StringID materialTag;
+		int materialIndex;
+		StringID textureTag;
+		int textureSlot;
+		glm::vec2 uvScale;
+		glm::vec4 color;
+		ShapeMeshes::DRAW_RECORD drawRecord;
+		uint8_t flags;
+		// object the transform is relative to, or INVALID_HANDLE
+		Handle parent;
+	};
+
+	// read-only view of the dense arrays used by the render pass
+	struct RENDER_VIEW
+	{
+		size_t count;
+		const glm::vec3* positions;
+		const glm::vec3* rotations;
+		const glm::vec3* scales;
+		const glm::mat4* worldMatrices;
+		const int* materialIndices;
+		const int* textureSlots;
+		const glm::vec2* uvScales;
+		const glm::vec4* colors;
+		const ShapeMeshes::DRAW_RECORD* drawRecords;
+		const uint8_t* flags;
+	};
+
+	// add an object and get its handle, INVALID_HANDLE once
+	// the store holds MAX_OBJECTS
+	Handle Add(const OBJECT_DESC& desc);
+	// remove an object together with its descendants, the
+	// last objects take their dense indices; costs the size
+	// of the subtree
+	void Remove(Handle handle);
+	// handles of the objects taken out by the last Remove()
+	inline const std::vector<Handle>& GetRemovedHandles() const { return m_subtree; }
+	// remove all objects
+	void Clear();
+
+	// number of objects
+	inline size_t Size() const { return m_handles.size(); }
+	// changes whenever objects are added or removed
+	inline uint32_t GetLayoutVersion() const { return m_layoutVersion; }
+
+	// translate between handles and dense indices, stale and
+	// invalid handles give an index past the end
+	size_t GetIndex(Handle handle) const;
+	inline bool IsValid(Handle handle) const { return GetIndex(handle) < Size(); }
+	inline Handle GetHandle(size_t index) const { return m_handles[index]; }
+	// number of handle slots, every slot of a handle is below it
+	inline size_t GetSlotCount() const { return m_handleIndices.size(); }
+
+	// change the parent of an object, INVALID_HANDLE makes it
+	// a root; fails when that would make a cycle
+	bool SetParent(Handle handle, Handle parent);
+	// parent of an object, INVALID_HANDLE for roots
+	Handle GetParent(size_t index) const;
+
+	// dense arrays for the render pass
+	RENDER_VIEW GetRenderView() const;
+
+	// rotate every root object around its Y axis - the update
+	// pass of the rotation toggle
+	void RotateAll(float degrees);
+	// recompose the world matrices of the changed objects,
+	// returns how many were recomposed
+	inline size_t UpdateTransforms() { return m_transforms.Update(); }
+	// hand over the dense indices of the objects whose world
+	// matrices were recomposed since the last call
+	inline void TakeMovedObjects(std::vector<uint32_t>& indices) { m_transforms.TakeMoved(indices); }
+	// transforms indexed by dense index
+	inline const TransformCache& GetTransforms() const { return m_transforms; }
+
+	// per-object access by dense index for editing, writable
+	// transform access marks the world matrix dirty; the
+	// transform is relative to the parent
+	inline glm::vec3& Position(size_t index) { return m_transforms.Position(index); }
+	inline glm::vec3& Rotation(size_t index) { return m_transforms.Rotation(index); }
+	inline glm::vec3& Scale(size_t index) { return m_transforms.Scale(index); }
+	inline const glm::vec3& GetPosition(size_t index) const { return m_transforms.GetPosition(index); }
+	inline const glm::vec3& GetRotation(size_t index) const { return m_transforms.GetRotation(index); }
+	inline const glm::vec3& GetScale(size_t index) const { return m_transforms.GetScale(index); }
+	inline glm::vec2& UVScale(size_t index) { return m_uvScales[index]; }
+	inline glm::vec4& Color(size_t index) { return m_colors[index]; }
+	inline uint8_t& Flags(size_t index) { return m_flags[index]; }
+	// level of detail drawn last frame, kept for the hysteresis
+	// of the selection
+	inline uint8_t& LodLevel(size_t index) { return m_lodLevels[index]; }
+	inline int GetMaterialIndex(size_t index) const { return m_materialIndices[index]; }
+	inline int GetTextureSlot(size_t index) const { return m_textureSlots[index]; }
+	inline const ShapeMeshes::DRAW_RECORD& GetDrawRecord(size_t index) const { return m_drawRecords[index]; }
+
+	// interned names of an object, only read by the editor,
+	// serialization and the bake
+	inline StringID GetTag(size_t index) const { return m_names[index].tag; }
+	inline StringID GetMaterialTag(size_t index) const { return m_names[index].materialTag; }
+	inline StringID GetTextureTag(size_t index) const { return m_names[index].textureTag; }
+
+	// change the material or texture, together with its resolved index
+	void SetMaterial(size_t index, StringID materialTag, int materialIndex);
+	void SetTexture(size_t index, StringID textureTag, int textureSlot);
+
+private:
+	// remove one object, its children become roots
+	void RemoveObject(Handle handle);
+
+	// names are not read while rendering, so they are kept
+	// apart from the arrays the render pass walks
+	struct OBJECT_NAMES
+	{
+		StringID tag;
+		StringID materialTag;
+		StringID textureTag;
+	};
+
+	// hot arrays, read every frame
+	TransformCache m_transforms;
+	std::vector<int> m_materialIndices;
+	std::vector<int> m_textureSlots;
+	std::vector<glm::vec2> m_uvScales;
+	std::vector<glm::vec4> m_colors;
+	std::vector<ShapeMeshes::DRAW_RECORD> m_drawRecords;
+	std::vector<uint8_t> m_flags;
+	std::vector<uint8_t> m_lodLevels;
+
+	// cold array, read by the editor and serialization
+	std::vector<OBJECT_NAMES> m_names;
+
+	// handle of every dense index
+	std::vector<Handle> m_handles;
+	// dense index of the object of every slot, or the next
+	// free slot for slots that are not in use
+	std::vector<uint32_t> m_handleIndices;
+	// current generation of every slot
+	std::vector<uint16_t> m_generations;
+	// first slot that is not in use
+	uint32_t m_freeSlot = INVALID_HANDLE;
+	// dense indices, then handles, of the subtree being removed
+	std::vector<uint32_t> m_subtree;
+	// number of times objects were added or removed
+	uint32_t m_layoutVersion = 0;
+};
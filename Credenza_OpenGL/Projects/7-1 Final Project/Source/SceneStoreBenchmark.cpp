@@ -0,0 +1,310 @@
+///////////////////////////////////////////////////////////////////////////////
+// SceneStoreBenchmark.cpp
+// ============
+// time the per-frame traversal of the scene store, and removing and adding
+// objects, against the array of mesh object structs it replaced
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneStoreBenchmark.h"
+#include "SceneStore.h"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <functional>
+
+#include <glm/glm.hpp>
+
+// declaration of global variables
+namespace
+{
+	// the mesh object struct the scene kept before the scene store
+	struct LEGACY_MESH_OBJECT
+	{
+		std::string tag;
+		glm::vec3 rotation;
+		glm::vec3 position;
+		glm::vec3 scale;
+		std::string materialTag;
+		int materialIndex = 0;
+		std::string textureTag;
+		glm::vec2 uvScale;
+		glm::vec4 shaderColor;
+		std::function<void()> drawFunction;
+		bool isRotating = false;
+	};
+
+	// the draw state the render pass collects for every object
+	struct PACKED_DRAW
+	{
+		glm::vec3 position;
+		glm::vec3 rotation;
+		glm::vec3 scale;
+		int materialIndex;
+		int textureSlot;
+		glm::vec2 uvScale;
+		glm::vec4 color;
+	};
+
+	const size_t g_ObjectCounts[] = { 1000, 10000, 100000 };
+	// number of timed frames, about the same total work per count
+	const int g_FrameCounts[] = { 2000, 200, 20 };
+	// number of timed removals, each followed by an addition
+	const size_t g_ChurnCount = 1000;
+	// objects of a group in the hierarchy churn, a root and its children
+	const size_t g_GroupSize = 4;
+
+	/***********************************************************
+	 *  MakeDesc()
+	 *
+	 *  This function is used for making the same object for
+	 *  both layouts from its index.
+	 ***********************************************************/
+	SceneStore::OBJECT_DESC MakeDesc(size_t index)
+	{
+		float offset = (float)(index % 1000);
+
+		SceneStore::OBJECT_DESC desc;
+		desc.tag = InternString("tapered cylinder");
+		desc.position = glm::vec3(offset, 1.0f, -offset);
+		desc.rotation = glm::vec3(0.0f, offset, 0.0f);
+		desc.scale = glm::vec3(1.0f);
+		desc.materialTag = InternString("default");
+		desc.materialIndex = (int)(index % 8);
+		desc.textureTag = EMPTY_STRING_ID;
+		desc.textureSlot = -1;
+		desc.uvScale = glm::vec2(1.0f);
+		desc.color = glm::vec4(1.0f);
+		desc.drawRecord = ShapeMeshes::MakeDrawRecord(ShapeMeshes::MESH_TAPERED_CYLINDER);
+		desc.flags = 0;
+		desc.parent = SceneStore::INVALID_HANDLE;
+
+		return(desc);
+	}
+
+	/***********************************************************
+	 *  AddGroup()
+	 *
+	 *  This function is used for adding a root object and the
+	 *  children attached to it, as the hierarchy churn does.
+	 ***********************************************************/
+	void AddGroup(SceneStore& store, size_t index)
+	{
+		SceneStore::OBJECT_DESC desc = MakeDesc(index);
+		SceneStore::Handle root = store.Add(desc);
+
+		desc.parent = root;
+		desc.position = glm::vec3(0.0f, 1.0f, 0.0f);
+		for (size_t i = 1; i < g_GroupSize; i++)
+		{
+			store.Add(desc);
+		}
+	}
+
+	/***********************************************************
+	 *  TraverseLegacy()
+	 *
+	 *  This function is used for running the update and render
+	 *  traversal of one frame over the array of structs.
+	 ***********************************************************/
+	void TraverseLegacy(std::vector<LEGACY_MESH_OBJECT>& meshes, std::vector<PACKED_DRAW>& draws)
+	{
+		for (size_t i = 0; i < meshes.size(); i++)
+		{
+			LEGACY_MESH_OBJECT& mesh = meshes[i];
+
+			mesh.rotation.y += 0.2f;
+			if (mesh.rotation.y > 360.0f) mesh.rotation.y -= 360.0f;
+
+			if (mesh.drawFunction)
+			{
+				PACKED_DRAW& draw = draws[i];
+				draw.position = mesh.position;
+				draw.rotation = mesh.rotation;
+				draw.scale = mesh.scale;
+				draw.materialIndex = mesh.materialIndex;
+				draw.textureSlot = mesh.textureTag.empty() ? -1 : 0;
+				draw.uvScale = mesh.uvScale;
+				draw.color = mesh.shaderColor;
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  TraverseStore()
+	 *
+	 *  This function is used for running the update and render
+	 *  traversal of one frame over the scene store.
+	 ***********************************************************/
+	void TraverseStore(SceneStore& store, std::vector<PACKED_DRAW>& draws)
+	{
+		store.RotateAll(0.2f);
+
+		SceneStore::RENDER_VIEW view = store.GetRenderView();
+		for (size_t i = 0; i < view.count; i++)
+		{
+			if (view.drawRecords[i].geometry != ShapeMeshes::INVALID_GEOMETRY)
+			{
+				PACKED_DRAW& draw = draws[i];
+				draw.position = view.positions[i];
+				draw.rotation = view.rotations[i];
+				draw.scale = view.scales[i];
+				draw.materialIndex = view.materialIndices[i];
+				draw.textureSlot = view.textureSlots[i];
+				draw.uvScale = view.uvScales[i];
+				draw.color = view.colors[i];
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  Checksum()
+	 *
+	 *  This function is used for reading the collected draws
+	 *  so the timed traversals cannot be optimized away.
+	 ***********************************************************/
+	float Checksum(const std::vector<PACKED_DRAW>& draws)
+	{
+		float sum = 0.0f;
+		for (size_t i = 0; i < draws.size(); i++)
+		{
+			sum += draws[i].rotation.y + (float)draws[i].materialIndex;
+		}
+		return(sum);
+	}
+}
+
+/***********************************************************
+ *  RunSceneStoreBenchmark()
+ *
+ *  This function is used for timing the traversal done by
+ *  RenderMeshes() every frame - the rotation update and the
+ *  collection of the draw state - with the old array of
+ *  mesh object structs and with the scene store.  Both
+ *  layouts hold the same objects.
+ *
+ *  Then objects spread over the whole scene are removed,
+ *  each followed by an addition so the count stays the
+ *  same.  The array erases and shifts the later objects,
+ *  the store swaps the last object into the hole.
+ *
+ *  Last, every object of a store is put in a group of a
+ *  root and its children, and whole groups are removed
+ *  through their root and added again, so the removals go
+ *  through the child lists and move objects that have
+ *  parents and children.
+ ***********************************************************/
+std::vector<SCENE_STORE_BENCHMARK_RESULT> RunSceneStoreBenchmark()
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	std::vector<SCENE_STORE_BENCHMARK_RESULT> results;
+	float checksum = 0.0f;
+
+	for (int run = 0; run < 3; run++)
+	{
+		size_t count = g_ObjectCounts[run];
+		int frames = g_FrameCounts[run];
+
+		std::vector<LEGACY_MESH_OBJECT> meshes(count);
+		SceneStore store;
+		for (size_t i = 0; i < count; i++)
+		{
+			SceneStore::OBJECT_DESC desc = MakeDesc(i);
+
+			LEGACY_MESH_OBJECT& mesh = meshes[i];
+			mesh.tag = GetInternedString(desc.tag);
+			mesh.position = desc.position;
+			mesh.rotation = desc.rotation;
+			mesh.scale = desc.scale;
+			mesh.materialTag = GetInternedString(desc.materialTag);
+			mesh.materialIndex = desc.materialIndex;
+			mesh.textureTag = GetInternedString(desc.textureTag);
+			mesh.uvScale = desc.uvScale;
+			mesh.shaderColor = desc.color;
+			mesh.drawFunction = [offset = (float)(i % 1000)]() { (void)offset; };
+
+			store.Add(desc);
+		}
+		std::vector<PACKED_DRAW> draws(count);
+
+		// one untimed frame each to warm the caches
+		TraverseLegacy(meshes, draws);
+		TraverseStore(store, draws);
+
+		Clock::time_point start = Clock::now();
+		for (int frame = 0; frame < frames; frame++)
+		{
+			TraverseLegacy(meshes, draws);
+		}
+		Clock::time_point middle = Clock::now();
+		checksum += Checksum(draws);
+
+		for (int frame = 0; frame < frames; frame++)
+		{
+			TraverseStore(store, draws);
+		}
+		Clock::time_point end = Clock::now();
+		checksum += Checksum(draws);
+
+		// remove and add again, the same positions for both
+		LEGACY_MESH_OBJECT added = meshes[0];
+		Clock::time_point churnStart = Clock::now();
+		for (size_t i = 0; i < g_ChurnCount; i++)
+		{
+			size_t index = (i * 7919) % meshes.size();
+			meshes.erase(meshes.begin() + index);
+			meshes.push_back(added);
+		}
+		Clock::time_point churnMiddle = Clock::now();
+		for (size_t i = 0; i < g_ChurnCount; i++)
+		{
+			size_t index = (i * 7919) % store.Size();
+			store.Remove(store.GetHandle(index));
+			store.Add(MakeDesc(i));
+		}
+		Clock::time_point churnEnd = Clock::now();
+		checksum += (float)(meshes.size() + store.Size());
+
+		// remove a group through its root and add a new one
+		SceneStore groups;
+		for (size_t i = 0; i < count; i += g_GroupSize)
+		{
+			AddGroup(groups, i);
+		}
+		Clock::time_point groupStart = Clock::now();
+		for (size_t i = 0; i < g_ChurnCount; i++)
+		{
+			size_t index = (i * 7919) % groups.Size();
+			SceneStore::Handle handle = groups.GetHandle(index);
+			SceneStore::Handle parent = groups.GetParent(index);
+			groups.Remove((parent != SceneStore::INVALID_HANDLE) ? parent : handle);
+			AddGroup(groups, i);
+		}
+		Clock::time_point groupEnd = Clock::now();
+		checksum += (float)(groups.Size() + groups.UpdateTransforms());
+
+		SCENE_STORE_BENCHMARK_RESULT result;
+		result.objectCount = count;
+		result.legacyMicroseconds = std::chrono::duration<double, std::micro>(middle - start).count() / frames;
+		result.storeMicroseconds = std::chrono::duration<double, std::micro>(end - middle).count() / frames;
+		result.legacyChurnMicroseconds = std::chrono::duration<double, std::micro>(churnMiddle - churnStart).count() / g_ChurnCount;
+		result.storeChurnMicroseconds = std::chrono::duration<double, std::micro>(churnEnd - churnMiddle).count() / g_ChurnCount;
+		result.hierarchyChurnMicroseconds = std::chrono::duration<double, std::micro>(groupEnd - groupStart).count() / g_ChurnCount;
+		results.push_back(result);
+
+		std::cout << "Scene traversal, " << count << " objects: "
+			<< result.legacyMicroseconds << " us/frame array of structs, "
+			<< result.storeMicroseconds << " us/frame scene store" << std::endl;
+		std::cout << "Remove and add, " << count << " objects: "
+			<< result.legacyChurnMicroseconds << " us array of structs, "
+			<< result.storeChurnMicroseconds << " us scene store" << std::endl;
+		std::cout << "Remove and add a group of " << g_GroupSize << ", " << count << " objects: "
+			<< result.hierarchyChurnMicroseconds << " us scene store" << std::endl;
+	}
+
+	std::cout << "(checksum " << checksum << ")" << std::endl;
+
+	return(results);
+}
@@ -0,0 +1,29 @@
+///////////////////////////////////////////////////////////////////////////////
+// SceneStoreBenchmark.h
+// ============
+// time the per-frame traversal of the scene store, and removing and adding
+// objects, against the array of mesh object structs it replaced
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+// average traversal time of one frame, of one removal followed by an
+// addition, and of one group removed and added again in a store where
+// every object has a parent or children, for a given object count
+struct SCENE_STORE_BENCHMARK_RESULT
+{
+	size_t objectCount;
+	double legacyMicroseconds;
+	double storeMicroseconds;
+	double legacyChurnMicroseconds;
+	double storeChurnMicroseconds;
+	double hierarchyChurnMicroseconds;
+};
+
+// run the traversal and the removals for 1k, 10k and 100k objects with
+// both layouts, print the results to the console and return them
+std::vector<SCENE_STORE_BENCHMARK_RESULT> RunSceneStoreBenchmark();
@@ -0,0 +1,827 @@
+///////////////////////////////////////////////////////////////////////////////
+// SpatialHash.cpp
+// ============
+// register the world boxes of moving objects in a loose uniform grid, so
+// range, frustum and ray queries only visit the occupied cells they reach
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SpatialHash.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// declaration of global variables
+namespace
+{
+	// the hash key holds 21 bits of each grid coordinate, cells
+	// are kept one short of the ends so their neighbors fit too
+	const int g_CoordBits = 21;
+	const int g_CoordOffset = 1 << (g_CoordBits - 1);
+	const float g_MinCoord = -(float)(g_CoordOffset - 1);
+	const float g_MaxCoord = (float)(g_CoordOffset - 2);
+
+	/***********************************************************
+	 *  BoxesOverlap()
+	 *
+	 *  This function is used for checking whether two boxes
+	 *  share any point.
+	 ***********************************************************/
+	inline bool BoxesOverlap(const glm::vec3& firstMin, const glm::vec3& firstMax,
+		const glm::vec3& secondMin, const glm::vec3& secondMax)
+	{
+		return (firstMin.x <= secondMax.x) && (firstMax.x >= secondMin.x) &&
+			(firstMin.y <= secondMax.y) && (firstMax.y >= secondMin.y) &&
+			(firstMin.z <= secondMax.z) && (firstMax.z >= secondMin.z);
+	}
+
+	/***********************************************************
+	 *  ClassifyBox()
+	 *
+	 *  This function is used for testing a box against six
+	 *  inward pointing planes, the same test as CullBoxes().
+	 *  Returns -1 when the box is outside one plane, 1 when
+	 *  it is inside all of them and 0 when it straddles.
+	 ***********************************************************/
+	int ClassifyBox(const glm::vec4* planes, const glm::vec3& boxMin, const glm::vec3& boxMax)
+	{
+		glm::vec3 center = (boxMin + boxMax) * 0.5f;
+		glm::vec3 extent = (boxMax - boxMin) * 0.5f;
+
+		int result = 1;
+		for (int p = 0; p < 6; p++)
+		{
+			const glm::vec4& plane = planes[p];
+			float centerDistance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+			float radius = std::fabs(plane.x) * extent.x + std::fabs(plane.y) * extent.y +
+				std::fabs(plane.z) * extent.z;
+			if ((centerDistance + radius) < 0.0f)
+			{
+				return(-1);
+			}
+			if ((centerDistance - radius) < 0.0f)
+			{
+				result = 0;
+			}
+		}
+		return(result);
+	}
+
+	/***********************************************************
+	 *  IntersectPlanes()
+	 *
+	 *  This function is used for finding the point shared by
+	 *  three planes, false when two of them are parallel.
+	 ***********************************************************/
+	bool IntersectPlanes(const glm::vec4& first, const glm::vec4& second, const glm::vec4& third,
+		glm::vec3& point)
+	{
+		glm::vec3 secondThird = glm::cross(glm::vec3(second), glm::vec3(third));
+		float determinant = glm::dot(glm::vec3(first), secondThird);
+		if (std::fabs(determinant) < 1e-12f)
+		{
+			return(false);
+		}
+
+		point = -(first.w * secondThird +
+			second.w * glm::cross(glm::vec3(third), glm::vec3(first)) +
+			third.w * glm::cross(glm::vec3(first), glm::vec3(second))) / determinant;
+		return(std::isfinite(point.x) && std::isfinite(point.y) && std::isfinite(point.z));
+	}
+
+	/***********************************************************
+	 *  IntersectBox()
+	 *
+	 *  This function is used for the slab test of a ray and a
+	 *  box.  The entry distance is clamped to the ray origin.
+	 ***********************************************************/
+	inline bool IntersectBox(const glm::vec3& origin, const glm::vec3& inverseDirection,
+		const glm::vec3& boxMin, const glm::vec3& boxMax, float maxDistance, float& entry)
+	{
+		glm::vec3 nearPlanes = (boxMin - origin) * inverseDirection;
+		glm::vec3 farPlanes = (boxMax - origin) * inverseDirection;
+		glm::vec3 nearest = glm::min(nearPlanes, farPlanes);
+		glm::vec3 farthest = glm::max(nearPlanes, farPlanes);
+
+		entry = std::max(std::max(nearest.x, nearest.y), std::max(nearest.z, 0.0f));
+		float exit = std::min(std::min(farthest.x, farthest.y), std::min(farthest.z, maxDistance));
+		return(entry <= exit);
+	}
+}
+
+/***********************************************************
+ *  SpatialHash()
+ *
+ *  This method is used for creating an empty grid.
+ ***********************************************************/
+SpatialHash::SpatialHash(float cellSize)
+{
+	m_cellCount = 0;
+	m_entryCount = 0;
+	m_queryMark = 0;
+	m_lookupShift = 64;
+	SetCellSize(cellSize);
+}
+
+/***********************************************************
+ *  SetCellSize()
+ *
+ *  This method is used for changing the edge length of the
+ *  cells.  Every entry would change cells, so the grid is
+ *  emptied and the caller registers them again.
+ ***********************************************************/
+void SpatialHash::SetCellSize(float cellSize)
+{
+	m_cellSize = std::max(cellSize, 1e-3f);
+	m_inverseCellSize = 1.0f / m_cellSize;
+	Clear();
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for registering the box of an entry.
+ *  An entry still in the cell that holds the center of its
+ *  box only has its box replaced.  Otherwise it leaves its
+ *  cell, which is released when it becomes empty, and
+ *  joins the new one, which is created when needed.
+ ***********************************************************/
+bool SpatialHash::Update(uint32_t id, const glm::vec3& boxMin, const glm::vec3& boxMax)
+{
+	if (id >= m_entryCells.size())
+	{
+		m_boxMins.resize(id + 1, glm::vec3(0.0f));
+		m_boxMaxs.resize(id + 1, glm::vec3(0.0f));
+		m_entryCoords.resize(id + 1, glm::ivec3(0));
+		m_entryCells.resize(id + 1, (uint32_t)NO_CELL);
+		m_entrySlots.resize(id + 1, 0);
+	}
+	m_boxMins[id] = boxMin;
+	m_boxMaxs[id] = boxMax;
+
+	uint32_t current = m_entryCells[id];
+	glm::vec3 size = boxMax - boxMin;
+	if ((size.x > m_cellSize) || (size.y > m_cellSize) || (size.z > m_cellSize))
+	{
+		if (current == OVERSIZED_CELL)
+		{
+			return(false);
+		}
+		if (current != NO_CELL)
+		{
+			Detach(id);
+		}
+		else
+		{
+			m_entryCount++;
+		}
+		Attach(id, OVERSIZED_CELL, glm::ivec3(0));
+		return(true);
+	}
+
+	glm::ivec3 coords = GetCellCoords((boxMin + boxMax) * 0.5f);
+	if ((current != NO_CELL) && (current != OVERSIZED_CELL) && (m_entryCoords[id] == coords))
+	{
+		return(false);
+	}
+	if (current != NO_CELL)
+	{
+		Detach(id);
+	}
+	else
+	{
+		m_entryCount++;
+	}
+	// the lookup follows the detach, which may move cells
+	Attach(id, FindCell(coords), coords);
+	return(true);
+}
+
+/***********************************************************
+ *  Remove()
+ *
+ *  This method is used for removing an entry from its cell.
+ ***********************************************************/
+void SpatialHash::Remove(uint32_t id)
+{
+	if (!Contains(id))
+	{
+		return;
+	}
+	Detach(id);
+	m_entryCount--;
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for removing every entry.  The cell
+ *  lists are kept to be reused by the next entries.
+ ***********************************************************/
+void SpatialHash::Clear()
+{
+	m_cellCount = 0;
+	std::fill(m_lookupKeys.begin(), m_lookupKeys.end(), (uint64_t)EMPTY_KEY);
+	m_coordsMin = glm::ivec3(INT32_MAX);
+	m_coordsMax = glm::ivec3(INT32_MIN);
+	m_boxMins.clear();
+	m_boxMaxs.clear();
+	m_entryCoords.clear();
+	m_entryCells.clear();
+	m_entrySlots.clear();
+	m_entryCount = 0;
+	m_oversized.clear();
+}
+
+/***********************************************************
+ *  GetCellCoords()
+ *
+ *  This method is used for finding the grid coordinates of
+ *  the cell that holds a point.
+ ***********************************************************/
+glm::ivec3 SpatialHash::GetCellCoords(const glm::vec3& point) const
+{
+	glm::vec3 scaled = glm::floor(point * m_inverseCellSize);
+	scaled = glm::clamp(scaled, glm::vec3(g_MinCoord), glm::vec3(g_MaxCoord));
+	return(glm::ivec3(scaled));
+}
+
+/***********************************************************
+ *  GetCellKey()
+ *
+ *  This method is used for packing the grid coordinates of
+ *  a cell into one hash key.
+ ***********************************************************/
+uint64_t SpatialHash::GetCellKey(const glm::ivec3& coords)
+{
+	return(((uint64_t)(uint32_t)(coords.x + g_CoordOffset) << (2 * g_CoordBits)) |
+		((uint64_t)(uint32_t)(coords.y + g_CoordOffset) << g_CoordBits) |
+		(uint64_t)(uint32_t)(coords.z + g_CoordOffset));
+}
+
+/***********************************************************
+ *  FindCell()
+ *
+ *  This method is used for looking up the occupied cell at
+ *  a grid coordinate.
+ ***********************************************************/
+uint32_t SpatialHash::FindCell(const glm::ivec3& coords) const
+{
+	if (m_lookupKeys.empty())
+	{
+		return(NO_CELL);
+	}
+
+	uint64_t key = GetCellKey(coords);
+	size_t mask = m_lookupKeys.size() - 1;
+	for (size_t slot = GetHomeSlot(key); m_lookupKeys[slot] != EMPTY_KEY; slot = (slot + 1) & mask)
+	{
+		if (m_lookupKeys[slot] == key)
+		{
+			return(m_lookupCells[slot]);
+		}
+	}
+	return(NO_CELL);
+}
+
+/***********************************************************
+ *  SetLookup()
+ *
+ *  This method is used for storing the dense index of a
+ *  cell under its key, replacing the index of a cell with
+ *  the same key.  The table doubles before it becomes more
+ *  than half full, which keeps the probe runs short.
+ ***********************************************************/
+void SpatialHash::SetLookup(uint64_t key, uint32_t cell)
+{
+	if ((m_cellCount * 2) > m_lookupKeys.size())
+	{
+		ResizeLookup(std::max(m_lookupKeys.size() * 2, (size_t)64));
+	}
+
+	size_t mask = m_lookupKeys.size() - 1;
+	size_t slot = GetHomeSlot(key);
+	while ((m_lookupKeys[slot] != EMPTY_KEY) && (m_lookupKeys[slot] != key))
+	{
+		slot = (slot + 1) & mask;
+	}
+	m_lookupKeys[slot] = key;
+	m_lookupCells[slot] = cell;
+}
+
+/***********************************************************
+ *  EraseLookup()
+ *
+ *  This method is used for removing a key from the lookup
+ *  table.  The keys after it in the same probe run move
+ *  back into the hole when their home slot allows, so no
+ *  tombstones are left behind.
+ ***********************************************************/
+void SpatialHash::EraseLookup(uint64_t key)
+{
+	size_t mask = m_lookupKeys.size() - 1;
+	size_t hole = GetHomeSlot(key);
+	while (m_lookupKeys[hole] != key)
+	{
+		if (m_lookupKeys[hole] == EMPTY_KEY)
+		{
+			return;
+		}
+		hole = (hole + 1) & mask;
+	}
+
+	for (size_t slot = (hole + 1) & mask; m_lookupKeys[slot] != EMPTY_KEY; slot = (slot + 1) & mask)
+	{
+		// a key may move back unless its home lies after the
+		// hole, up to the slot it is in
+		size_t home = GetHomeSlot(m_lookupKeys[slot]);
+		if (((slot - home) & mask) >= ((slot - hole) & mask))
+		{
+			m_lookupKeys[hole] = m_lookupKeys[slot];
+			m_lookupCells[hole] = m_lookupCells[slot];
+			hole = slot;
+		}
+	}
+	m_lookupKeys[hole] = EMPTY_KEY;
+}
+
+/***********************************************************
+ *  ResizeLookup()
+ *
+ *  This method is used for rebuilding the lookup table with
+ *  a new power of two number of slots from the dense array
+ *  of occupied cells.
+ ***********************************************************/
+void SpatialHash::ResizeLookup(size_t slotCount)
+{
+	m_lookupKeys.assign(slotCount, (uint64_t)EMPTY_KEY);
+	m_lookupCells.assign(slotCount, (uint32_t)NO_CELL);
+	m_lookupShift = 64;
+	for (size_t count = slotCount; count > 1; count >>= 1)
+	{
+		m_lookupShift--;
+	}
+
+	size_t mask = slotCount - 1;
+	for (size_t cell = 0; cell < m_cellCount; cell++)
+	{
+		uint64_t key = GetCellKey(m_cells[cell].coords);
+		size_t slot = GetHomeSlot(key);
+		while (m_lookupKeys[slot] != EMPTY_KEY)
+		{
+			slot = (slot + 1) & mask;
+		}
+		m_lookupKeys[slot] = key;
+		m_lookupCells[slot] = (uint32_t)cell;
+	}
+}
+
+/***********************************************************
+ *  GetLooseBounds()
+ *
+ *  This method is used for getting the box every entry of
+ *  a cell lies in - the cell grown by half its size.
+ ***********************************************************/
+void SpatialHash::GetLooseBounds(const glm::ivec3& coords, glm::vec3& boxMin, glm::vec3& boxMax) const
+{
+	float half = 0.5f * m_cellSize;
+	boxMin = glm::vec3(coords) * m_cellSize - half;
+	boxMax = glm::vec3(coords + 1) * m_cellSize + half;
+}
+
+/***********************************************************
+ *  Attach()
+ *
+ *  This method is used for appending an entry to the list
+ *  of a cell.  NO_CELL creates the cell at the coordinates,
+ *  reusing the list of a released cell.
+ ***********************************************************/
+void SpatialHash::Attach(uint32_t id, uint32_t cell, const glm::ivec3& coords)
+{
+	if (cell == OVERSIZED_CELL)
+	{
+		m_entryCells[id] = OVERSIZED_CELL;
+		m_entrySlots[id] = (uint32_t)m_oversized.size();
+		m_oversized.push_back(id);
+		return;
+	}
+
+	if (cell == NO_CELL)
+	{
+		cell = (uint32_t)m_cellCount++;
+		if (cell == m_cells.size())
+		{
+			m_cells.push_back(GRID_CELL());
+			m_cellMarks.push_back(0);
+		}
+		m_cells[cell].coords = coords;
+		m_cells[cell].entries.clear();
+		SetLookup(GetCellKey(coords), cell);
+		m_coordsMin = glm::min(m_coordsMin, coords);
+		m_coordsMax = glm::max(m_coordsMax, coords);
+	}
+
+	std::vector<uint32_t>& entries = m_cells[cell].entries;
+	m_entryCoords[id] = coords;
+	m_entryCells[id] = cell;
+	m_entrySlots[id] = (uint32_t)entries.size();
+	entries.push_back(id);
+}
+
+/***********************************************************
+ *  Detach()
+ *
+ *  This method is used for taking an entry out of its list.
+ *  The last entry of the list takes its place.  A cell left
+ *  empty is released, and the last occupied cell moves into
+ *  its dense index, so the occupied cells stay contiguous.
+ ***********************************************************/
+void SpatialHash::Detach(uint32_t id)
+{
+	uint32_t cell = m_entryCells[id];
+	uint32_t slot = m_entrySlots[id];
+	std::vector<uint32_t>& entries = (cell == OVERSIZED_CELL) ? m_oversized : m_cells[cell].entries;
+
+	uint32_t last = entries.back();
+	entries[slot] = last;
+	m_entrySlots[last] = slot;
+	entries.pop_back();
+	m_entryCells[id] = NO_CELL;
+
+	if ((cell == OVERSIZED_CELL) || !entries.empty())
+	{
+		return;
+	}
+
+	EraseLookup(GetCellKey(m_cells[cell].coords));
+	uint32_t lastCell = (uint32_t)--m_cellCount;
+	if (cell != lastCell)
+	{
+		// the empty list goes past the count with its capacity
+		std::swap(m_cells[cell], m_cells[lastCell]);
+		SetLookup(GetCellKey(m_cells[cell].coords), cell);
+		const std::vector<uint32_t>& moved = m_cells[cell].entries;
+		for (size_t i = 0; i < moved.size(); i++)
+		{
+			m_entryCells[moved[i]] = cell;
+		}
+	}
+}
+
+/***********************************************************
+ *  QueryBox()
+ *
+ *  This method is used for finding the entries that overlap
+ *  a box.  Only cells whose centers lie within half a cell
+ *  of the box can hold such entries.
+ ***********************************************************/
+size_t SpatialHash::QueryBox(const glm::vec3& boxMin, const glm::vec3& boxMax, std::vector<uint32_t>& ids) const
+{
+	ids.clear();
+
+	for (size_t i = 0; i < m_oversized.size(); i++)
+	{
+		uint32_t id = m_oversized[i];
+		if (BoxesOverlap(m_boxMins[id], m_boxMaxs[id], boxMin, boxMax))
+		{
+			ids.push_back(id);
+		}
+	}
+	if (m_cellCount == 0)
+	{
+		return(ids.size());
+	}
+
+	FindRangeCells(boxMin, boxMax);
+	for (size_t i = 0; i < m_rangeCells.size(); i++)
+	{
+		const std::vector<uint32_t>& entries = m_cells[m_rangeCells[i]].entries;
+		for (size_t e = 0; e < entries.size(); e++)
+		{
+			uint32_t id = entries[e];
+			if (BoxesOverlap(m_boxMins[id], m_boxMaxs[id], boxMin, boxMax))
+			{
+				ids.push_back(id);
+			}
+		}
+	}
+
+	return(ids.size());
+}
+
+/***********************************************************
+ *  FindRangeCells()
+ *
+ *  This method is used for listing the occupied cells that
+ *  can hold entries overlapping a box, the ones whose
+ *  centers lie within half a cell of it.  When there are
+ *  fewer occupied cells than cells in that range, the
+ *  occupied cells are walked instead of looking up every
+ *  cell.
+ ***********************************************************/
+void SpatialHash::FindRangeCells(const glm::vec3& boxMin, const glm::vec3& boxMax) const
+{
+	m_rangeCells.clear();
+	if (m_cellCount == 0)
+	{
+		return;
+	}
+
+	float half = 0.5f * m_cellSize;
+	glm::ivec3 first = glm::max(GetCellCoords(boxMin - half), m_coordsMin);
+	glm::ivec3 last = glm::min(GetCellCoords(boxMax + half), m_coordsMax);
+	if ((first.x > last.x) || (first.y > last.y) || (first.z > last.z))
+	{
+		return;
+	}
+
+	double rangeCount = (double)(last.x - first.x + 1) * (double)(last.y - first.y + 1) *
+		(double)(last.z - first.z + 1);
+	bool bWalkRange = rangeCount <= (double)m_cellCount;
+	size_t cellCount = bWalkRange ? (size_t)rangeCount : m_cellCount;
+	for (size_t i = 0; i < cellCount; i++)
+	{
+		uint32_t cell = (uint32_t)i;
+		if (bWalkRange)
+		{
+			int width = last.x - first.x + 1;
+			int height = last.y - first.y + 1;
+			glm::ivec3 coords(first.x + (int)(i % width), first.y + (int)((i / width) % height),
+				first.z + (int)(i / ((size_t)width * height)));
+			cell = FindCell(coords);
+			if (cell == NO_CELL)
+			{
+				continue;
+			}
+		}
+		else
+		{
+			const glm::ivec3& coords = m_cells[cell].coords;
+			if ((coords.x < first.x) || (coords.x > last.x) || (coords.y < first.y) ||
+				(coords.y > last.y) || (coords.z < first.z) || (coords.z > last.z))
+			{
+				continue;
+			}
+		}
+		m_rangeCells.push_back(cell);
+	}
+}
+
+/***********************************************************
+ *  QueryFrustum()
+ *
+ *  This method is used for finding the entries inside a
+ *  view frustum.  The corners of the frustum, where its
+ *  side planes meet the near and far planes, bound the
+ *  cells it reaches, found the way a box query finds them.
+ *  Planes that do not meet in eight corners reach every
+ *  occupied cell.  The
+ *  loose bounds of every cell reached are tested first:
+ *  the entries of a cell outside the frustum are skipped,
+ *  those of a cell inside it are all taken, and only cells
+ *  that straddle a plane test their entries one by one.
+ ***********************************************************/
+size_t SpatialHash::QueryFrustum(const glm::vec4* planes, std::vector<uint32_t>& ids) const
+{
+	ids.clear();
+
+	for (size_t i = 0; i < m_oversized.size(); i++)
+	{
+		uint32_t id = m_oversized[i];
+		if (ClassifyBox(planes, m_boxMins[id], m_boxMaxs[id]) >= 0)
+		{
+			ids.push_back(id);
+		}
+	}
+
+	// planes 0 to 3 are the sides, 4 and 5 the near and far
+	// planes, in the order of FrustumCuller
+	glm::vec3 frustumMin(FLT_MAX);
+	glm::vec3 frustumMax(-FLT_MAX);
+	bool bBounded = true;
+	for (int corner = 0; (corner < 8) && bBounded; corner++)
+	{
+		glm::vec3 point;
+		bBounded = IntersectPlanes(planes[(corner & 1) ? 1 : 0], planes[(corner & 2) ? 3 : 2],
+			planes[(corner & 4) ? 5 : 4], point);
+		frustumMin = glm::min(frustumMin, point);
+		frustumMax = glm::max(frustumMax, point);
+	}
+	if (bBounded)
+	{
+		FindRangeCells(frustumMin, frustumMax);
+	}
+	else
+	{
+		m_rangeCells.resize(m_cellCount);
+		for (size_t cell = 0; cell < m_cellCount; cell++)
+		{
+			m_rangeCells[cell] = (uint32_t)cell;
+		}
+	}
+
+	for (size_t i = 0; i < m_rangeCells.size(); i++)
+	{
+		uint32_t cell = m_rangeCells[i];
+		glm::vec3 looseMin;
+		glm::vec3 looseMax;
+		GetLooseBounds(m_cells[cell].coords, looseMin, looseMax);
+		int side = ClassifyBox(planes, looseMin, looseMax);
+		if (side < 0)
+		{
+			continue;
+		}
+
+		const std::vector<uint32_t>& entries = m_cells[cell].entries;
+		if (side > 0)
+		{
+			ids.insert(ids.end(), entries.begin(), entries.end());
+			continue;
+		}
+		for (size_t e = 0; e < entries.size(); e++)
+		{
+			uint32_t id = entries[e];
+			if (ClassifyBox(planes, m_boxMins[id], m_boxMaxs[id]) >= 0)
+			{
+				ids.push_back(id);
+			}
+		}
+	}
+
+	return(ids.size());
+}
+
+/***********************************************************
+ *  Intersect()
+ *
+ *  This method is used for finding the nearest entry a ray
+ *  hits.  The ray is clipped to the range of the occupied
+ *  cells and walked cell by cell through the grid.  An
+ *  entry may reach into the neighbors of its cell, so the
+ *  cells around each cell the ray passes are tested too,
+ *  every cell only once.  An entry found from a later cell
+ *  can only be hit beyond where the ray enters that cell,
+ *  so the walk stops once that is past the nearest hit.
+ *
+ *  When the walk would look up more cells than are
+ *  occupied, the occupied cells the ray reaches are sorted
+ *  by entry distance and tested in that order instead.
+ ***********************************************************/
+uint32_t SpatialHash::Intersect(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+	ENTRY_TEST test, void* pContext, float* pDistance) const
+{
+	uint32_t hit = NO_ENTRY;
+	float nearest = maxDistance;
+
+	// keep the slab distances defined for axis aligned rays
+	glm::vec3 inverseDirection;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float component = direction[axis];
+		if (std::fabs(component) < 1e-30f)
+		{
+			component = (component < 0.0f) ? -1e-30f : 1e-30f;
+		}
+		inverseDirection[axis] = 1.0f / component;
+	}
+
+	IntersectEntries(m_oversized, origin, direction, inverseDirection, test, pContext, hit, nearest);
+
+	glm::vec3 rangeMin;
+	glm::vec3 rangeMax;
+	glm::vec3 corner;
+	GetLooseBounds(m_coordsMin, rangeMin, corner);
+	GetLooseBounds(m_coordsMax, corner, rangeMax);
+	float start = 0.0f;
+	if ((m_cellCount == 0) || !IntersectBox(origin, inverseDirection, rangeMin, rangeMax, nearest, start))
+	{
+		if (pDistance != NULL)
+		{
+			*pDistance = nearest;
+		}
+		return(hit);
+	}
+
+	if (++m_queryMark == 0)
+	{
+		std::fill(m_cellMarks.begin(), m_cellMarks.end(), 0);
+		m_queryMark = 1;
+	}
+
+	// the ray leaves the occupied range at the nearest far slab
+	glm::vec3 farPlanes = glm::max((rangeMin - origin) * inverseDirection, (rangeMax - origin) * inverseDirection);
+	float end = std::min(std::min(farPlanes.x, farPlanes.y), std::min(farPlanes.z, nearest));
+	glm::ivec3 coords = GetCellCoords(origin + direction * start);
+	glm::ivec3 endCoords = GetCellCoords(origin + direction * end);
+	glm::ivec3 span = glm::abs(endCoords - coords);
+	double walkSteps = (double)span.x + (double)span.y + (double)span.z + 1.0;
+
+	if ((27.0 * walkSteps) > (double)m_cellCount)
+	{
+		m_rayCells.clear();
+		for (size_t cell = 0; cell < m_cellCount; cell++)
+		{
+			glm::vec3 looseMin;
+			glm::vec3 looseMax;
+			GetLooseBounds(m_cells[cell].coords, looseMin, looseMax);
+			float entry;
+			if (IntersectBox(origin, inverseDirection, looseMin, looseMax, nearest, entry))
+			{
+				m_rayCells.push_back(std::make_pair(entry, (uint32_t)cell));
+			}
+		}
+		std::sort(m_rayCells.begin(), m_rayCells.end());
+		for (size_t i = 0; (i < m_rayCells.size()) && (m_rayCells[i].first <= nearest); i++)
+		{
+			IntersectEntries(m_cells[m_rayCells[i].second].entries, origin, direction, inverseDirection,
+				test, pContext, hit, nearest);
+		}
+	}
+	else
+	{
+		// distance to the next cell boundary along each axis, and
+		// between two boundaries
+		glm::ivec3 step;
+		glm::vec3 boundary;
+		glm::vec3 delta;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			step[axis] = (direction[axis] < 0.0f) ? -1 : 1;
+			float next = (float)(coords[axis] + ((step[axis] > 0) ? 1 : 0)) * m_cellSize;
+			boundary[axis] = (next - origin[axis]) * inverseDirection[axis];
+			delta[axis] = m_cellSize * std::fabs(inverseDirection[axis]);
+		}
+
+		// a few steps of slack for rounding at the range ends
+		int steps = (int)walkSteps + 3;
+		float distance = start;
+		while ((steps-- > 0) && (distance <= std::min(nearest, end)))
+		{
+			for (int dz = -1; dz <= 1; dz++)
+			{
+				for (int dy = -1; dy <= 1; dy++)
+				{
+					for (int dx = -1; dx <= 1; dx++)
+					{
+						uint32_t cell = FindCell(coords + glm::ivec3(dx, dy, dz));
+						if ((cell == NO_CELL) || (m_cellMarks[cell] == m_queryMark))
+						{
+							continue;
+						}
+						m_cellMarks[cell] = m_queryMark;
+						IntersectEntries(m_cells[cell].entries, origin, direction, inverseDirection,
+							test, pContext, hit, nearest);
+					}
+				}
+			}
+
+			int axis = (boundary.x < boundary.y) ? ((boundary.x < boundary.z) ? 0 : 2) :
+				((boundary.y < boundary.z) ? 1 : 2);
+			distance = boundary[axis];
+			coords[axis] += step[axis];
+			boundary[axis] += delta[axis];
+		}
+	}
+
+	if (pDistance != NULL)
+	{
+		*pDistance = nearest;
+	}
+	return(hit);
+}
+
+/***********************************************************
+ *  IntersectEntries()
+ *
+ *  This method is used for testing the entries of a list
+ *  against a ray.  Entries whose boxes the ray hits nearer
+ *  than the nearest hit so far go through the entry test.
+ ***********************************************************/
+void SpatialHash::IntersectEntries(const std::vector<uint32_t>& entries, const glm::vec3& origin,
+	const glm::vec3& direction, const glm::vec3& inverseDirection,
+	ENTRY_TEST test, void* pContext, uint32_t& hit, float& distance) const
+{
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		uint32_t id = entries[i];
+		float entry;
+		if (!IntersectBox(origin, inverseDirection, m_boxMins[id], m_boxMaxs[id], distance, entry))
+		{
+			continue;
+		}
+		if (test != NULL)
+		{
+			entry = test(pContext, id, origin, direction, distance);
+			if (entry < 0.0f)
+			{
+				continue;
+			}
+		}
+		if (entry < distance)
+		{
+			distance = entry;
+			hit = id;
+		}
+	}
+}
@@ -0,0 +1,183 @@
+///////////////////////////////////////////////////////////////////////////////
+// SpatialHash.h
+// ============
+// register the world boxes of moving objects in a loose uniform grid, so
+// range, frustum and ray queries only visit the occupied cells they reach
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  SpatialHash
+ *
+ *  This class contains the world boxes of a set of entries,
+ *  each named by an identifier the caller chooses, sorted
+ *  into the cells of an unbounded uniform grid.  Only the
+ *  occupied cells exist; they are found by their integer
+ *  coordinates through an open addressing hash table and
+ *  kept in a dense array, each with the list of its
+ *  entries.
+ *
+ *  The grid is loose: an entry lives in the one cell that
+ *  holds the center of its box, and its box may reach half
+ *  a cell beyond that cell on every side.  Moving an entry
+ *  within its cell only stores the new box, and crossing
+ *  into another cell moves it between two lists, so
+ *  updates cost the same whatever the number of entries.
+ *  Entries larger than a cell would overflow the loose
+ *  bounds, they are kept in a separate list every query
+ *  tests.
+ *
+ *  Queries visit the cells whose loose bounds they reach,
+ *  or walk the dense array of occupied cells when that is
+ *  shorter, and test the box of every entry they find.
+ ***********************************************************/
+class SpatialHash
+{
+public:
+	// the nearest hit of an entry closer than the passed in
+	// distance, or a negative distance when it is missed
+	typedef float (*ENTRY_TEST)(void* pContext, uint32_t id,
+		const glm::vec3& origin, const glm::vec3& direction, float maxDistance);
+
+	// identifier returned when no entry is hit
+	static const uint32_t NO_ENTRY = 0xFFFFFFFF;
+
+	explicit SpatialHash(float cellSize = 4.0f);
+
+	// change the edge length of the cells, removes all entries
+	void SetCellSize(float cellSize);
+	inline float GetCellSize() const { return m_cellSize; }
+
+	// add an entry, or move it when the identifier is already
+	// registered; returns true when it changed cells
+	bool Update(uint32_t id, const glm::vec3& boxMin, const glm::vec3& boxMax);
+	// remove an entry, unknown identifiers are ignored
+	void Remove(uint32_t id);
+	// remove all entries
+	void Clear();
+
+	// whether an identifier is registered
+	inline bool Contains(uint32_t id) const
+	{
+		return (id < m_entryCells.size()) && (m_entryCells[id] != NO_CELL);
+	}
+	// box of a registered entry
+	inline void GetBox(uint32_t id, glm::vec3& boxMin, glm::vec3& boxMax) const
+	{
+		boxMin = m_boxMins[id];
+		boxMax = m_boxMaxs[id];
+	}
+	// one past the largest identifier ever registered
+	inline size_t GetIdRange() const { return m_entryCells.size(); }
+
+	// number of entries, occupied cells and entries too large
+	// for the cells
+	inline size_t Size() const { return m_entryCount; }
+	inline size_t GetCellCount() const { return m_cellCount; }
+	inline size_t GetOversizedCount() const { return m_oversized.size(); }
+
+	// identifiers of the entries whose boxes overlap a box,
+	// returns how many were found
+	size_t QueryBox(const glm::vec3& boxMin, const glm::vec3& boxMax, std::vector<uint32_t>& ids) const;
+	// identifiers of the entries whose boxes are not outside one
+	// of six inward pointing planes, as FrustumCuller extracts them
+	size_t QueryFrustum(const glm::vec4* planes, std::vector<uint32_t>& ids) const;
+	// find the nearest entry the ray hits within the distance,
+	// the test is called for every entry whose box is hit, or the
+	// box distance is used when it is NULL; returns NO_ENTRY when
+	// nothing is hit
+	uint32_t Intersect(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+		ENTRY_TEST test, void* pContext, float* pDistance) const;
+
+private:
+	// occupied cell and the identifiers of its entries
+	struct GRID_CELL
+	{
+		glm::ivec3 coords;
+		std::vector<uint32_t> entries;
+	};
+
+	// cell of identifiers that are not registered, and of the
+	// entries kept in the oversized list
+	static const uint32_t NO_CELL = 0xFFFFFFFF;
+	static const uint32_t OVERSIZED_CELL = 0xFFFFFFFE;
+
+	// grid coordinates of the cell holding a point, clamped to
+	// the range the hash key can hold
+	glm::ivec3 GetCellCoords(const glm::vec3& point) const;
+	// hash key of a cell
+	static uint64_t GetCellKey(const glm::ivec3& coords);
+	// occupied cell at a grid coordinate, or NO_CELL
+	uint32_t FindCell(const glm::ivec3& coords) const;
+	// slot of the lookup table where a key is probed first
+	inline size_t GetHomeSlot(uint64_t key) const
+	{
+		return (size_t)((key * 0x9E3779B97F4A7C15ull) >> m_lookupShift);
+	}
+	// set the dense index of a cell in the lookup table, growing
+	// it to keep it at most half full, and remove a cell from it
+	void SetLookup(uint64_t key, uint32_t cell);
+	void EraseLookup(uint64_t key);
+	// rebuild the lookup table with a new number of slots
+	void ResizeLookup(size_t slotCount);
+	// loose bounds of a cell
+	void GetLooseBounds(const glm::ivec3& coords, glm::vec3& boxMin, glm::vec3& boxMax) const;
+	// list the occupied cells whose entries can overlap a box
+	void FindRangeCells(const glm::vec3& boxMin, const glm::vec3& boxMax) const;
+
+	// put an entry into a cell, or the oversized list, and take it out
+	void Attach(uint32_t id, uint32_t cell, const glm::ivec3& coords);
+	void Detach(uint32_t id);
+
+	// test the entries of one cell against a ray, keeping the nearest hit
+	void IntersectEntries(const std::vector<uint32_t>& entries, const glm::vec3& origin,
+		const glm::vec3& direction, const glm::vec3& inverseDirection,
+		ENTRY_TEST test, void* pContext, uint32_t& hit, float& distance) const;
+
+	float m_cellSize;
+	float m_inverseCellSize;
+
+	// occupied cells come first, the cells past the count keep
+	// the capacity of their lists for reuse
+	std::vector<GRID_CELL> m_cells;
+	size_t m_cellCount;
+	// range of the coordinates occupied since the last clear
+	glm::ivec3 m_coordsMin;
+	glm::ivec3 m_coordsMax;
+	// keys and dense cell indices of the lookup table, probed
+	// linearly, with EMPTY_KEY in unused slots
+	static const uint64_t EMPTY_KEY = 0xFFFFFFFFFFFFFFFFull;
+	std::vector<uint64_t> m_lookupKeys;
+	std::vector<uint32_t> m_lookupCells;
+	int m_lookupShift;
+
+	// box, cell and position within the cell list of every
+	// identifier, and the coordinates of the cell so an entry
+	// that stays in it never reads the cell
+	std::vector<glm::vec3> m_boxMins;
+	std::vector<glm::vec3> m_boxMaxs;
+	std::vector<glm::ivec3> m_entryCoords;
+	std::vector<uint32_t> m_entryCells;
+	std::vector<uint32_t> m_entrySlots;
+	size_t m_entryCount;
+	// entries larger than a cell
+	std::vector<uint32_t> m_oversized;
+
+	// query that last visited each cell, so a ray tests the
+	// entries of a cell once; queries are not reentrant
+	mutable std::vector<uint32_t> m_cellMarks;
+	mutable uint32_t m_queryMark;
+	// occupied cells a ray reaches and their entry distances
+	mutable std::vector<std::pair<float, uint32_t> > m_rayCells;
+	// occupied cells a box or frustum query reaches
+	mutable std::vector<uint32_t> m_rangeCells;
+};
@@ -0,0 +1,328 @@
+///////////////////////////////////////////////////////////////////////////////
+// SpatialHashBenchmark.cpp
+// ============
+// time the spatial hash while every object moves each frame, and its box,
+// frustum and ray queries against testing every object
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SpatialHashBenchmark.h"
+#include "FrustumCulling.h"
+#include "SpatialHash.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+// declaration of global variables
+namespace
+{
+	const size_t g_ObjectCounts[] = { 10000, 100000, 1000000 };
+	// number of timed frames, about the same total work per count
+	const int g_FrameCounts[] = { 100, 10, 2 };
+	// number of timed box, frustum and ray queries
+	const int g_QueryCount = 100;
+	// reach of the query frustums, in cells
+	const float g_FrustumCells = 8.0f;
+
+	// cell edge length and half the size of every object, the
+	// world grows with the count so there is about one object
+	// per cell
+	const float g_CellSize = 4.0f;
+	const float g_HalfSize = 0.5f;
+	// random moves of up to a quarter cell, looked up from a
+	// table so the timing is not spent on the generator
+	const float g_MaxStep = 1.0f;
+	const size_t g_StepCount = 65536;
+
+	/***********************************************************
+	 *  IsInsideFrustum()
+	 *
+	 *  This function is used for testing the box of an object
+	 *  against six inward pointing planes, the test the grid
+	 *  makes, to check the grid against.
+	 ***********************************************************/
+	bool IsInsideFrustum(const glm::vec4* planes, const glm::vec3& position)
+	{
+		glm::vec3 boxMin = position - g_HalfSize;
+		glm::vec3 boxMax = position + g_HalfSize;
+		glm::vec3 center = (boxMin + boxMax) * 0.5f;
+		glm::vec3 extent = (boxMax - boxMin) * 0.5f;
+		for (int p = 0; p < 6; p++)
+		{
+			const glm::vec4& plane = planes[p];
+			float centerDistance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+			float radius = std::fabs(plane.x) * extent.x + std::fabs(plane.y) * extent.y +
+				std::fabs(plane.z) * extent.z;
+			if ((centerDistance + radius) < 0.0f)
+			{
+				return(false);
+			}
+		}
+		return(true);
+	}
+
+	/***********************************************************
+	 *  CountDifferentSets()
+	 *
+	 *  This function is used for counting the queries whose
+	 *  identifiers from the grid are not the same set as the
+	 *  ones found by testing every object.
+	 ***********************************************************/
+	size_t CountDifferentSets(std::vector<std::vector<uint32_t> >& gridIds,
+		std::vector<std::vector<uint32_t> >& linearIds)
+	{
+		size_t mismatches = 0;
+		for (size_t q = 0; q < gridIds.size(); q++)
+		{
+			std::sort(gridIds[q].begin(), gridIds[q].end());
+			std::sort(linearIds[q].begin(), linearIds[q].end());
+			mismatches += (gridIds[q] != linearIds[q]) ? 1 : 0;
+		}
+		return(mismatches);
+	}
+
+	/***********************************************************
+	 *  IntersectBoxes()
+	 *
+	 *  This function is used for finding the nearest box a ray
+	 *  hits by testing every box, to check the grid against.
+	 ***********************************************************/
+	uint32_t IntersectBoxes(const std::vector<glm::vec3>& positions, const glm::vec3& origin,
+		const glm::vec3& direction, float maxDistance, float& distance)
+	{
+		glm::vec3 inverseDirection = 1.0f / direction;
+		uint32_t hit = SpatialHash::NO_ENTRY;
+		distance = maxDistance;
+		for (size_t i = 0; i < positions.size(); i++)
+		{
+			glm::vec3 nearPlanes = (positions[i] - g_HalfSize - origin) * inverseDirection;
+			glm::vec3 farPlanes = (positions[i] + g_HalfSize - origin) * inverseDirection;
+			glm::vec3 nearest = glm::min(nearPlanes, farPlanes);
+			glm::vec3 farthest = glm::max(nearPlanes, farPlanes);
+			float entry = std::max(std::max(nearest.x, nearest.y), std::max(nearest.z, 0.0f));
+			float exit = std::min(std::min(farthest.x, farthest.y), std::min(farthest.z, distance));
+			if ((entry <= exit) && (entry < distance))
+			{
+				distance = entry;
+				hit = (uint32_t)i;
+			}
+		}
+		return(hit);
+	}
+}
+
+/***********************************************************
+ *  RunSpatialHashBenchmark()
+ *
+ *  This function is used for timing the spatial hash with
+ *  every object taking a random step each frame, followed
+ *  by random box and frustum queries through the grid and
+ *  by testing every object, and random rays through the
+ *  grid.  The identifiers each query finds in the grid are
+ *  compared as a set with the ones found by testing every
+ *  object, the nearest hit of every ray with the one found
+ *  the same way, and the number of queries that differ is
+ *  printed with the times.
+ ***********************************************************/
+std::vector<SPATIAL_HASH_BENCHMARK_RESULT> RunSpatialHashBenchmark()
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	std::vector<SPATIAL_HASH_BENCHMARK_RESULT> results;
+	std::mt19937 generator(12345);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	std::vector<glm::vec3> steps(g_StepCount);
+	for (size_t i = 0; i < g_StepCount; i++)
+	{
+		steps[i] = (glm::vec3(unit(generator), unit(generator), unit(generator)) * 2.0f - 1.0f) * g_MaxStep;
+	}
+
+	size_t checksum = 0;
+	for (int run = 0; run < 3; run++)
+	{
+		size_t count = g_ObjectCounts[run];
+		int frames = g_FrameCounts[run];
+		float worldSize = g_CellSize * std::cbrt((float)count);
+
+		SpatialHash grid(g_CellSize);
+		std::vector<glm::vec3> positions(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			positions[i] = glm::vec3(unit(generator), unit(generator), unit(generator)) * worldSize;
+			grid.Update((uint32_t)i, positions[i] - g_HalfSize, positions[i] + g_HalfSize);
+		}
+
+		// objects leaving the world come back on the other side
+		size_t cellChanges = 0;
+		Clock::time_point start = Clock::now();
+		for (int frame = 0; frame < frames; frame++)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				glm::vec3& position = positions[i];
+				position += steps[(i * 7919 + frame * 104729) % g_StepCount];
+				for (int axis = 0; axis < 3; axis++)
+				{
+					if (position[axis] < 0.0f) position[axis] += worldSize;
+					if (position[axis] > worldSize) position[axis] -= worldSize;
+				}
+				if (grid.Update((uint32_t)i, position - g_HalfSize, position + g_HalfSize))
+				{
+					cellChanges++;
+				}
+			}
+		}
+		Clock::time_point updateEnd = Clock::now();
+
+		// boxes of two cells a side anywhere in the world
+		std::vector<glm::vec3> queryMins(g_QueryCount);
+		for (int q = 0; q < g_QueryCount; q++)
+		{
+			queryMins[q] = glm::vec3(unit(generator), unit(generator), unit(generator)) * worldSize;
+		}
+		glm::vec3 querySize(2.0f * g_CellSize);
+
+		std::vector<uint32_t> ids;
+		Clock::time_point boxStart = Clock::now();
+		for (int q = 0; q < g_QueryCount; q++)
+		{
+			checksum += grid.QueryBox(queryMins[q], queryMins[q] + querySize, ids);
+		}
+		Clock::time_point boxEnd = Clock::now();
+
+		std::vector<std::vector<uint32_t> > linearIds(g_QueryCount);
+		for (int q = 0; q < g_QueryCount; q++)
+		{
+			glm::vec3 queryMax = queryMins[q] + querySize;
+			for (size_t i = 0; i < count; i++)
+			{
+				const glm::vec3& position = positions[i];
+				if ((position.x - g_HalfSize <= queryMax.x) && (position.x + g_HalfSize >= queryMins[q].x) &&
+					(position.y - g_HalfSize <= queryMax.y) && (position.y + g_HalfSize >= queryMins[q].y) &&
+					(position.z - g_HalfSize <= queryMax.z) && (position.z + g_HalfSize >= queryMins[q].z))
+				{
+					linearIds[q].push_back((uint32_t)i);
+				}
+			}
+		}
+		Clock::time_point linearEnd = Clock::now();
+
+		std::vector<std::vector<uint32_t> > gridIds(g_QueryCount);
+		for (int q = 0; q < g_QueryCount; q++)
+		{
+			grid.QueryBox(queryMins[q], queryMins[q] + querySize, gridIds[q]);
+		}
+		size_t boxMismatches = CountDifferentSets(gridIds, linearIds);
+
+		// views from anywhere in the world toward any point of it,
+		// reaching a few cells
+		std::vector<glm::vec4> planes(g_QueryCount * 6);
+		glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, g_FrustumCells * g_CellSize);
+		for (int q = 0; q < g_QueryCount; q++)
+		{
+			glm::vec3 eye = glm::vec3(unit(generator), unit(generator), unit(generator)) * worldSize;
+			glm::vec3 target = glm::vec3(unit(generator), unit(generator), unit(generator)) * worldSize;
+			if (glm::length(target - eye) < 1e-3f)
+			{
+				target = eye + glm::vec3(0.0f, 0.0f, -1.0f);
+			}
+			FrustumCuller frustum;
+			frustum.SetViewProjection(projection * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f)));
+			for (int p = 0; p < 6; p++)
+			{
+				planes[q * 6 + p] = frustum.GetPlane(p);
+			}
+		}
+
+		Clock::time_point frustumStart = Clock::now();
+		for (int q = 0; q < g_QueryCount; q++)
+		{
+			checksum += grid.QueryFrustum(&planes[q * 6], ids);
+		}
+		Clock::time_point frustumEnd = Clock::now();
+
+		for (int q = 0; q < g_QueryCount; q++)
+		{
+			linearIds[q].clear();
+			for (size_t i = 0; i < count; i++)
+			{
+				if (IsInsideFrustum(&planes[q * 6], positions[i]))
+				{
+					linearIds[q].push_back((uint32_t)i);
+				}
+			}
+		}
+		Clock::time_point linearFrustumEnd = Clock::now();
+
+		for (int q = 0; q < g_QueryCount; q++)
+		{
+			grid.QueryFrustum(&planes[q * 6], gridIds[q]);
+		}
+		size_t frustumMismatches = CountDifferentSets(gridIds, linearIds);
+
+		// rays from anywhere in the world in any direction
+		std::vector<glm::vec3> origins(g_QueryCount);
+		std::vector<glm::vec3> directions(g_QueryCount);
+		for (int q = 0; q < g_QueryCount; q++)
+		{
+			origins[q] = glm::vec3(unit(generator), unit(generator), unit(generator)) * worldSize;
+			directions[q] = glm::normalize(glm::vec3(unit(generator), unit(generator), unit(generator)) - 0.5f);
+		}
+
+		std::vector<uint32_t> gridHits(g_QueryCount);
+		std::vector<float> gridDistances(g_QueryCount);
+		Clock::time_point rayStart = Clock::now();
+		for (int q = 0; q < g_QueryCount; q++)
+		{
+			gridHits[q] = grid.Intersect(origins[q], directions[q], worldSize, NULL, NULL, &gridDistances[q]);
+		}
+		Clock::time_point rayEnd = Clock::now();
+
+		size_t rayMismatches = 0;
+		for (int q = 0; q < g_QueryCount; q++)
+		{
+			float distance;
+			uint32_t hit = IntersectBoxes(positions, origins[q], directions[q], worldSize, distance);
+			// boxes hit at the same distance may be found in any order
+			rayMismatches += ((hit != gridHits[q]) && (distance != gridDistances[q])) ? 1 : 0;
+			checksum += hit;
+		}
+		checksum += grid.GetCellCount();
+
+		SPATIAL_HASH_BENCHMARK_RESULT result;
+		result.objectCount = count;
+		result.updateMicroseconds = std::chrono::duration<double, std::micro>(updateEnd - start).count() / frames;
+		result.cellChanges = (double)cellChanges / frames;
+		result.boxQueryMicroseconds = std::chrono::duration<double, std::micro>(boxEnd - boxStart).count() / g_QueryCount;
+		result.linearQueryMicroseconds = std::chrono::duration<double, std::micro>(linearEnd - boxEnd).count() / g_QueryCount;
+		result.frustumQueryMicroseconds = std::chrono::duration<double, std::micro>(frustumEnd - frustumStart).count() / g_QueryCount;
+		result.linearFrustumMicroseconds = std::chrono::duration<double, std::micro>(linearFrustumEnd - frustumEnd).count() / g_QueryCount;
+		result.rayMicroseconds = std::chrono::duration<double, std::micro>(rayEnd - rayStart).count() / g_QueryCount;
+		result.boxMismatches = boxMismatches;
+		result.frustumMismatches = frustumMismatches;
+		result.rayMismatches = rayMismatches;
+		results.push_back(result);
+
+		std::cout << "Spatial hash, " << count << " objects: "
+			<< result.updateMicroseconds << " us/frame moving all ("
+			<< result.cellChanges << " cell changes), "
+			<< result.boxQueryMicroseconds << " us box query, "
+			<< result.linearQueryMicroseconds << " us testing all, "
+			<< result.frustumQueryMicroseconds << " us frustum query, "
+			<< result.linearFrustumMicroseconds << " us testing all, "
+			<< result.rayMicroseconds << " us ray"
+			<< " (" << grid.GetCellCount() << " cells; " << boxMismatches << " box, "
+			<< frustumMismatches << " frustum and " << rayMismatches << " ray queries differ)" << std::endl;
+	}
+
+	std::cout << "(checksum " << checksum << ")" << std::endl;
+
+	return(results);
+}
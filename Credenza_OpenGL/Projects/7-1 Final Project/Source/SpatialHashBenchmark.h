@@ -0,0 +1,39 @@
+///////////////////////////////////////////////////////////////////////////////
+// SpatialHashBenchmark.h
+// ============
+// time the spatial hash while every object moves each frame, and its box,
+// frustum and ray queries against testing every object
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+// average time of one frame of moves, and of one query, for a given
+// object count
+struct SPATIAL_HASH_BENCHMARK_RESULT
+{
+	size_t objectCount;
+	// every object moved and updated in the grid
+	double updateMicroseconds;
+	// objects that changed cells per frame
+	double cellChanges;
+	// box query through the grid and by testing every object
+	double boxQueryMicroseconds;
+	double linearQueryMicroseconds;
+	// frustum query through the grid and by testing every object
+	double frustumQueryMicroseconds;
+	double linearFrustumMicroseconds;
+	// nearest box hit by a ray through the grid
+	double rayMicroseconds;
+	// queries whose result differed from testing every object
+	size_t boxMismatches;
+	size_t frustumMismatches;
+	size_t rayMismatches;
+};
+
+// run the moves and queries for 10k, 100k and 1M objects, print the
+// results to the console and return them
+std::vector<SPATIAL_HASH_BENCHMARK_RESULT> RunSpatialHashBenchmark();
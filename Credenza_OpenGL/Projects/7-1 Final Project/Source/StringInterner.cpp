@@ -0,0 +1,68 @@
+///////////////////////////////////////////////////////////////////////////////
+// StringInterner.cpp
+// ============
+// turn the tag strings of meshes, materials and textures into 32-bit
+// identifiers, so they are compared and hashed as integers
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "StringInterner.h"
+
+/***********************************************************
+ *  StringInterner()
+ *
+ *  The constructor for the class, the empty string is
+ *  interned first so it is always EMPTY_STRING_ID.
+ ***********************************************************/
+StringInterner::StringInterner()
+{
+	Intern(std::string());
+}
+
+/***********************************************************
+ *  Intern()
+ *
+ *  This method is used for getting the identifier of a
+ *  string.  A string that was not seen before is copied
+ *  once and numbered after the last one.
+ ***********************************************************/
+StringID StringInterner::Intern(const std::string& text)
+{
+	std::pair<std::unordered_map<std::string, StringID>::iterator, bool> inserted =
+		m_ids.insert(std::make_pair(text, (StringID)m_strings.size()));
+	if (inserted.second)
+	{
+		m_strings.push_back(&inserted.first->first);
+	}
+
+	return(inserted.first->second);
+}
+
+/***********************************************************
+ *  Find()
+ *
+ *  This method is used for looking up a string without
+ *  interning it.
+ ***********************************************************/
+StringID StringInterner::Find(const std::string& text) const
+{
+	std::unordered_map<std::string, StringID>::const_iterator found = m_ids.find(text);
+	if (found == m_ids.end())
+	{
+		return(INVALID_STRING_ID);
+	}
+
+	return(found->second);
+}
+
+/***********************************************************
+ *  GetStringInterner()
+ *
+ *  This function is used for getting the interner shared
+ *  by the whole application, created on first use.
+ ***********************************************************/
+StringInterner& GetStringInterner()
+{
+	static StringInterner interner;
+	return(interner);
+}
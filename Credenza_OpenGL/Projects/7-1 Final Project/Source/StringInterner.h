@@ -0,0 +1,62 @@
+///////////////////////////////////////////////////////////////////////////////
+// StringInterner.h
+// ============
+// turn the tag strings of meshes, materials and textures into 32-bit
+// identifiers, so they are compared and hashed as integers
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// identifier of an interned string
+typedef uint32_t StringID;
+// identifier of the empty string, interned up front
+const StringID EMPTY_STRING_ID = 0;
+// returned for strings that were never interned
+const StringID INVALID_STRING_ID = 0xFFFFFFFF;
+
+/***********************************************************
+ *  StringInterner
+ *
+ *  This class contains one copy of every distinct string
+ *  it was given, numbered in the order they were first
+ *  seen.  Equal strings always get the same identifier,
+ *  so tags are interned once where they enter the scene
+ *  and compared, hashed and stored as integers after.
+ *  Interned strings are never released.
+ ***********************************************************/
+class StringInterner
+{
+public:
+	StringInterner();
+
+	// identifier of a string, interning it when it is new
+	StringID Intern(const std::string& text);
+	// identifier of a string without interning it,
+	// INVALID_STRING_ID when it was never interned
+	StringID Find(const std::string& text) const;
+
+	// text of an identifier
+	inline const std::string& GetString(StringID id) const { return *m_strings[id]; }
+	// number of interned strings
+	inline size_t Size() const { return m_strings.size(); }
+
+private:
+	// the map owns the strings, its nodes never move
+	std::unordered_map<std::string, StringID> m_ids;
+	std::vector<const std::string*> m_strings;
+};
+
+// interner shared by the whole application
+StringInterner& GetStringInterner();
+
+// intern a string with the shared interner
+inline StringID InternString(const std::string& text) { return GetStringInterner().Intern(text); }
+// text of an identifier of the shared interner
+inline const std::string& GetInternedString(StringID id) { return GetStringInterner().GetString(id); }
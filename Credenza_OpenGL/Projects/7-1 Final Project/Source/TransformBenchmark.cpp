@@ -0,0 +1,158 @@
+///////////////////////////////////////////////////////////////////////////////
+// TransformBenchmark.cpp
+// ============
+// time the world matrices of the transform cache against composing them
+// for every draw
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TransformBenchmark.h"
+#include "TransformCache.h"
+
+#include <chrono>
+#include <iostream>
+
+#include <glm/glm.hpp>
+#include <glm/gtx/transform.hpp>
+
+// declaration of global variables
+namespace
+{
+	const size_t g_ObjectCounts[] = { 1000, 10000, 100000 };
+	// number of timed frames, about the same total work per count
+	const int g_FrameCounts[] = { 2000, 200, 20 };
+
+	/***********************************************************
+	 *  ComposePerDraw()
+	 *
+	 *  This function is used for building the world matrix
+	 *  the way SetTransformations() did before the cache.
+	 ***********************************************************/
+	glm::mat4 ComposePerDraw(const glm::vec3& scaleXYZ, const glm::vec3& rotationXYZ, const glm::vec3& positionXYZ)
+	{
+		glm::mat4 scale = glm::scale(scaleXYZ);
+		glm::mat4 rotationX = glm::rotate(glm::radians(rotationXYZ.x), glm::vec3(1.0f, 0.0f, 0.0f));
+		glm::mat4 rotationY = glm::rotate(glm::radians(rotationXYZ.y), glm::vec3(0.0f, 1.0f, 0.0f));
+		glm::mat4 rotationZ = glm::rotate(glm::radians(rotationXYZ.z), glm::vec3(0.0f, 0.0f, 1.0f));
+		glm::mat4 translation = glm::translate(positionXYZ);
+
+		return(translation * rotationX * rotationY * rotationZ * scale);
+	}
+
+	/***********************************************************
+	 *  Checksum()
+	 *
+	 *  This function is used for reading the written matrices
+	 *  so the timed loops cannot be optimized away.
+	 ***********************************************************/
+	float Checksum(const std::vector<glm::mat4>& matrices)
+	{
+		float sum = 0.0f;
+		for (size_t i = 0; i < matrices.size(); i++)
+		{
+			sum += matrices[i][0][0] + matrices[i][3][1];
+		}
+		return(sum);
+	}
+}
+
+/***********************************************************
+ *  RunTransformBenchmark()
+ *
+ *  This function is used for timing the world matrices of
+ *  one frame written into an instance array - composed for
+ *  every draw, recomposed in a batch with every transform
+ *  dirty, and read from the cache with nothing dirty.  The
+ *  largest error of the batched kernel against the per-draw
+ *  matrices is printed with the timings.
+ ***********************************************************/
+std::vector<TRANSFORM_BENCHMARK_RESULT> RunTransformBenchmark()
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	std::vector<TRANSFORM_BENCHMARK_RESULT> results;
+	float checksum = 0.0f;
+
+	for (int run = 0; run < 3; run++)
+	{
+		size_t count = g_ObjectCounts[run];
+		int frames = g_FrameCounts[run];
+
+		TransformCache cache;
+		for (size_t i = 0; i < count; i++)
+		{
+			float offset = (float)(i % 1000);
+			cache.Add(glm::vec3(offset * 0.01f, 1.0f, -offset * 0.01f),
+				glm::vec3(offset * 0.36f, offset * 0.72f, 90.0f),
+				glm::vec3(1.0f + offset * 0.001f));
+		}
+		std::vector<glm::mat4> matrices(count);
+
+		Clock::time_point start = Clock::now();
+		for (int frame = 0; frame < frames; frame++)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				matrices[i] = ComposePerDraw(cache.GetScale(i), cache.GetRotation(i), cache.GetPosition(i));
+			}
+		}
+		Clock::time_point perDrawEnd = Clock::now();
+		checksum += Checksum(matrices);
+
+		// largest difference of the cached matrices
+		cache.Update();
+		float maxError = 0.0f;
+		for (size_t i = 0; i < count; i++)
+		{
+			for (int column = 0; column < 4; column++)
+			{
+				glm::vec4 error = glm::abs(matrices[i][column] - cache.GetWorld(i)[column]);
+				maxError = glm::max(maxError, glm::max(glm::max(error.x, error.y), glm::max(error.z, error.w)));
+			}
+		}
+
+		Clock::time_point batchedStart = Clock::now();
+		for (int frame = 0; frame < frames; frame++)
+		{
+			// a zero turn still marks every transform dirty
+			cache.RotateAllY(0.0f);
+			cache.Update();
+			const glm::mat4* world = cache.GetWorldMatrices();
+			for (size_t i = 0; i < count; i++)
+			{
+				matrices[i] = world[i];
+			}
+		}
+		Clock::time_point batchedEnd = Clock::now();
+		checksum += Checksum(matrices);
+
+		for (int frame = 0; frame < frames; frame++)
+		{
+			cache.Update();
+			const glm::mat4* world = cache.GetWorldMatrices();
+			for (size_t i = 0; i < count; i++)
+			{
+				matrices[i] = world[i];
+			}
+		}
+		Clock::time_point cachedEnd = Clock::now();
+		checksum += Checksum(matrices);
+
+		TRANSFORM_BENCHMARK_RESULT result;
+		result.objectCount = count;
+		result.perDrawMicroseconds = std::chrono::duration<double, std::micro>(perDrawEnd - start).count() / frames;
+		result.batchedMicroseconds = std::chrono::duration<double, std::micro>(batchedEnd - batchedStart).count() / frames;
+		result.cachedMicroseconds = std::chrono::duration<double, std::micro>(cachedEnd - batchedEnd).count() / frames;
+		results.push_back(result);
+
+		std::cout << "World matrices, " << count << " objects: "
+			<< result.perDrawMicroseconds << " us/frame per draw, "
+			<< result.batchedMicroseconds << " us/frame batched, "
+			<< result.cachedMicroseconds << " us/frame cached"
+			<< " (max error " << maxError << ")" << std::endl;
+	}
+
+	std::cout << "(checksum " << checksum << ")" << std::endl;
+
+	return(results);
+}
@@ -0,0 +1,28 @@
+///////////////////////////////////////////////////////////////////////////////
+// TransformBenchmark.h
+// ============
+// time the world matrices of the transform cache against composing them
+// for every draw
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+// average time of one frame of world matrices for a given object count
+struct TRANSFORM_BENCHMARK_RESULT
+{
+	size_t objectCount;
+	// five matrices built and multiplied for every draw
+	double perDrawMicroseconds;
+	// every transform dirty, recomposed by the batched kernel
+	double batchedMicroseconds;
+	// no transform dirty, cached matrices read back
+	double cachedMicroseconds;
+};
+
+// run the three paths for 1k, 10k and 100k objects, print the
+// results to the console and return them
+std::vector<TRANSFORM_BENCHMARK_RESULT> RunTransformBenchmark();
@@ -0,0 +1,664 @@
+///////////////////////////////////////////////////////////////////////////////
+// TransformCache.cpp
+// ============
+// keep the world matrix of every object and recompute it only after its
+// position, rotation or scale, or that of one of its parents, changed
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TransformCache.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)) || defined(__SSE2__)
+#define TRANSFORM_CACHE_SSE2
+#include <emmintrin.h>
+#endif
+
+// declaration of global variables
+namespace
+{
+	const float g_DegreesToRadians = 0.01745329251994329577f;
+
+#ifdef TRANSFORM_CACHE_SSE2
+	/***********************************************************
+	 *  SinCos4()
+	 *
+	 *  This function is used for computing the sine and cosine
+	 *  of four angles in radians.  The angle is reduced to an
+	 *  octant and both minimax polynomials of the Cephes
+	 *  library are evaluated, then each lane picks and signs
+	 *  the pair its octant needs.
+	 ***********************************************************/
+	inline void SinCos4(__m128 x, __m128* pSin, __m128* pCos)
+	{
+		const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32((int)0x80000000));
+
+		// work with the absolute angle, the sine keeps the sign
+		__m128 sinSign = _mm_and_ps(x, signMask);
+		x = _mm_andnot_ps(signMask, x);
+
+		// octant of the angle, rounded up to an even number
+		__m128i octant = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.27323954473516f)));
+		octant = _mm_add_epi32(octant, _mm_set1_epi32(1));
+		octant = _mm_and_si128(octant, _mm_set1_epi32(~1));
+		__m128 y = _mm_cvtepi32_ps(octant);
+
+		// sign flips and polynomial selection of each lane
+		__m128i sinFlip = _mm_slli_epi32(_mm_and_si128(octant, _mm_set1_epi32(4)), 29);
+		sinSign = _mm_xor_ps(sinSign, _mm_castsi128_ps(sinFlip));
+		__m128i cosOctant = _mm_sub_epi32(octant, _mm_set1_epi32(2));
+		__m128 cosSign = _mm_castsi128_ps(
+			_mm_slli_epi32(_mm_andnot_si128(cosOctant, _mm_set1_epi32(4)), 29));
+		__m128 polyMask = _mm_castsi128_ps(_mm_cmpeq_epi32(
+			_mm_and_si128(octant, _mm_set1_epi32(2)), _mm_setzero_si128()));
+
+		// subtract the octant angle in three parts to keep
+		// the precision of the reduced angle
+		x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(0.78515625f)));
+		x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(2.4187564849853515625e-4f)));
+		x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(3.77489497744594108e-8f)));
+		__m128 z = _mm_mul_ps(x, x);
+
+		// cosine polynomial
+		__m128 c = _mm_set1_ps(2.443315711809948e-5f);
+		c = _mm_add_ps(_mm_mul_ps(c, z), _mm_set1_ps(-1.388731625493765e-3f));
+		c = _mm_add_ps(_mm_mul_ps(c, z), _mm_set1_ps(4.166664568298827e-2f));
+		c = _mm_mul_ps(_mm_mul_ps(c, z), z);
+		c = _mm_sub_ps(c, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+		c = _mm_add_ps(c, _mm_set1_ps(1.0f));
+
+		// sine polynomial
+		__m128 s = _mm_set1_ps(-1.9515295891e-4f);
+		s = _mm_add_ps(_mm_mul_ps(s, z), _mm_set1_ps(8.3321608736e-3f));
+		s = _mm_add_ps(_mm_mul_ps(s, z), _mm_set1_ps(-1.6666654611e-1f));
+		s = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(s, z), x), x);
+
+		__m128 sinValue = _mm_or_ps(_mm_and_ps(polyMask, s), _mm_andnot_ps(polyMask, c));
+		__m128 cosValue = _mm_or_ps(_mm_and_ps(polyMask, c), _mm_andnot_ps(polyMask, s));
+		*pSin = _mm_xor_ps(sinValue, sinSign);
+		*pCos = _mm_xor_ps(cosValue, cosSign);
+	}
+
+	/***********************************************************
+	 *  StoreColumns()
+	 *
+	 *  This function is used for turning one matrix column of
+	 *  four transforms, held as x, y, z and w registers, into
+	 *  that column of each of the four local matrices.
+	 ***********************************************************/
+	inline void StoreColumns(__m128 x, __m128 y, __m128 z, __m128 w,
+		glm::mat4* localMatrices, const uint32_t* indices, int column)
+	{
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+		_mm_storeu_ps(&localMatrices[indices[0]][column][0], x);
+		_mm_storeu_ps(&localMatrices[indices[1]][column][0], y);
+		_mm_storeu_ps(&localMatrices[indices[2]][column][0], z);
+		_mm_storeu_ps(&localMatrices[indices[3]][column][0], w);
+	}
+#endif
+}
+
+/***********************************************************
+ *  Add()
+ *
+ *  This method is used for appending a transform.  It
+ *  starts dirty so the next update composes its matrix.
+ *  The parent has to be added before its children.
+ ***********************************************************/
+size_t TransformCache::Add(const glm::vec3& position, const glm::vec3& rotation, const glm::vec3& scale,
+	uint32_t parent)
+{
+	size_t index = m_positions.size();
+	if (parent >= index)
+	{
+		parent = NO_PARENT;
+	}
+
+	m_positions.push_back(position);
+	m_rotations.push_back(rotation);
+	m_scales.push_back(scale);
+	m_localMatrices.push_back(glm::mat4(1.0f));
+	m_worldMatrices.push_back(glm::mat4(1.0f));
+	m_parents.push_back(parent);
+	m_firstChildren.push_back((uint32_t)NO_PARENT);
+	m_previousSiblings.push_back((uint32_t)NO_PARENT);
+	m_nextSiblings.push_back((uint32_t)NO_PARENT);
+	m_updatePasses.push_back(0);
+	m_dirty.push_back(0);
+	m_moved.push_back(0);
+	MarkDirty(index);
+
+	if (parent != NO_PARENT)
+	{
+		LinkChild((uint32_t)index);
+		m_childCount++;
+	}
+	m_bHierarchyChanged = true;
+
+	return(index);
+}
+
+/***********************************************************
+ *  Remove()
+ *
+ *  This method is used for removing a transform.  Its
+ *  children are detached and it leaves the child list of
+ *  its parent.  The last transform is then moved into the
+ *  freed index and marked dirty there: its neighbours in
+ *  the child list of its parent and its own children are
+ *  pointed at the new index.  Nothing else is visited.
+ ***********************************************************/
+void TransformCache::Remove(size_t index)
+{
+	uint32_t removed = (uint32_t)index;
+	uint32_t last = (uint32_t)(Size() - 1);
+
+	uint32_t child = m_firstChildren[removed];
+	while (child != NO_PARENT)
+	{
+		uint32_t next = m_nextSiblings[child];
+		m_parents[child] = NO_PARENT;
+		m_previousSiblings[child] = NO_PARENT;
+		m_nextSiblings[child] = NO_PARENT;
+		m_childCount--;
+		MarkDirty(child);
+		child = next;
+	}
+	m_firstChildren[removed] = NO_PARENT;
+	if (m_parents[removed] != NO_PARENT)
+	{
+		UnlinkChild(removed);
+		m_childCount--;
+	}
+
+	if (removed != last)
+	{
+		m_positions[removed] = m_positions[last];
+		m_rotations[removed] = m_rotations[last];
+		m_scales[removed] = m_scales[last];
+		m_localMatrices[removed] = m_localMatrices[last];
+		m_worldMatrices[removed] = m_worldMatrices[last];
+		m_parents[removed] = m_parents[last];
+		m_firstChildren[removed] = m_firstChildren[last];
+		m_previousSiblings[removed] = m_previousSiblings[last];
+		m_nextSiblings[removed] = m_nextSiblings[last];
+		MarkDirty(removed);
+
+		if (m_previousSiblings[removed] != NO_PARENT)
+		{
+			m_nextSiblings[m_previousSiblings[removed]] = removed;
+		}
+		else if (m_parents[removed] != NO_PARENT)
+		{
+			m_firstChildren[m_parents[removed]] = removed;
+		}
+		if (m_nextSiblings[removed] != NO_PARENT)
+		{
+			m_previousSiblings[m_nextSiblings[removed]] = removed;
+		}
+		for (child = m_firstChildren[removed]; child != NO_PARENT; child = m_nextSiblings[child])
+		{
+			m_parents[child] = removed;
+		}
+	}
+
+	// a dirty index left past the end is skipped by the update
+	m_positions.pop_back();
+	m_rotations.pop_back();
+	m_scales.pop_back();
+	m_localMatrices.pop_back();
+	m_worldMatrices.pop_back();
+	m_parents.pop_back();
+	m_firstChildren.pop_back();
+	m_previousSiblings.pop_back();
+	m_nextSiblings.pop_back();
+	m_updatePasses.pop_back();
+	m_dirty.pop_back();
+	m_moved.pop_back();
+	m_bHierarchyChanged = true;
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for removing every transform.
+ ***********************************************************/
+void TransformCache::Clear()
+{
+	m_positions.clear();
+	m_rotations.clear();
+	m_scales.clear();
+	m_localMatrices.clear();
+	m_worldMatrices.clear();
+	m_parents.clear();
+	m_firstChildren.clear();
+	m_previousSiblings.clear();
+	m_nextSiblings.clear();
+	m_updatePasses.clear();
+	m_dirty.clear();
+	m_dirtyIndices.clear();
+	m_moved.clear();
+	m_movedIndices.clear();
+	m_depthOrder.clear();
+	m_childCount = 0;
+	m_bHierarchyChanged = false;
+}
+
+/***********************************************************
+ *  Set()
+ *
+ *  This method is used for replacing the values of a
+ *  transform.  Unchanged values leave the cached world
+ *  matrix valid.
+ ***********************************************************/
+void TransformCache::Set(size_t index, const glm::vec3& position, const glm::vec3& rotation, const glm::vec3& scale)
+{
+	if ((m_positions[index] == position) &&
+		(m_rotations[index] == rotation) &&
+		(m_scales[index] == scale))
+	{
+		return;
+	}
+
+	m_positions[index] = position;
+	m_rotations[index] = rotation;
+	m_scales[index] = scale;
+	MarkDirty(index);
+}
+
+/***********************************************************
+ *  SetParent()
+ *
+ *  This method is used for attaching a transform to a new
+ *  parent.  The values of the transform are kept, so they
+ *  are now read relative to the new parent.  A parent
+ *  that is the transform itself or one of its descendants
+ *  would make a cycle and is refused.
+ ***********************************************************/
+bool TransformCache::SetParent(size_t index, uint32_t parent)
+{
+	if (parent != NO_PARENT)
+	{
+		if (parent >= Size())
+		{
+			return(false);
+		}
+		for (uint32_t ancestor = parent; ancestor != NO_PARENT; ancestor = m_parents[ancestor])
+		{
+			if (ancestor == index)
+			{
+				return(false);
+			}
+		}
+	}
+
+	if (m_parents[index] == parent)
+	{
+		return(true);
+	}
+
+	if (m_parents[index] != NO_PARENT)
+	{
+		UnlinkChild((uint32_t)index);
+		m_childCount--;
+	}
+	m_parents[index] = parent;
+	if (parent != NO_PARENT)
+	{
+		LinkChild((uint32_t)index);
+		m_childCount++;
+	}
+	m_bHierarchyChanged = true;
+	MarkDirty(index);
+
+	return(true);
+}
+
+/***********************************************************
+ *  RotateAllY()
+ *
+ *  This method is used for turning every root transform
+ *  around its Y axis, which makes every root dirty.  The
+ *  children turn with their parents.
+ ***********************************************************/
+void TransformCache::RotateAllY(float degrees)
+{
+	for (size_t i = 0; i < m_rotations.size(); i++)
+	{
+		if (m_parents[i] != NO_PARENT)
+		{
+			continue;
+		}
+		m_rotations[i].y += degrees;
+		if (m_rotations[i].y > 360.0f)
+		{
+			m_rotations[i].y -= 360.0f;
+		}
+		MarkDirty(i);
+	}
+}
+
+/***********************************************************
+ *  LinkChild()
+ *
+ *  This method is used for adding a transform to the front
+ *  of the child list of its parent.
+ ***********************************************************/
+void TransformCache::LinkChild(uint32_t index)
+{
+	uint32_t parent = m_parents[index];
+	uint32_t next = m_firstChildren[parent];
+
+	m_previousSiblings[index] = NO_PARENT;
+	m_nextSiblings[index] = next;
+	if (next != NO_PARENT)
+	{
+		m_previousSiblings[next] = index;
+	}
+	m_firstChildren[parent] = index;
+}
+
+/***********************************************************
+ *  UnlinkChild()
+ *
+ *  This method is used for taking a transform out of the
+ *  child list of its parent.  The parent index itself is
+ *  left to the caller.
+ ***********************************************************/
+void TransformCache::UnlinkChild(uint32_t index)
+{
+	uint32_t previous = m_previousSiblings[index];
+	uint32_t next = m_nextSiblings[index];
+
+	if (previous != NO_PARENT)
+	{
+		m_nextSiblings[previous] = next;
+	}
+	else
+	{
+		m_firstChildren[m_parents[index]] = next;
+	}
+	if (next != NO_PARENT)
+	{
+		m_previousSiblings[next] = previous;
+	}
+	m_previousSiblings[index] = NO_PARENT;
+	m_nextSiblings[index] = NO_PARENT;
+}
+
+/***********************************************************
+ *  BuildHierarchy()
+ *
+ *  This method is used for rebuilding the breadth first
+ *  order after parents changed, walking the child lists
+ *  down from the roots.
+ ***********************************************************/
+void TransformCache::BuildHierarchy()
+{
+	size_t count = Size();
+
+	// breadth first from the roots, parents always come
+	// before their children
+	m_queue.clear();
+	for (size_t i = 0; i < count; i++)
+	{
+		if (m_parents[i] == NO_PARENT)
+		{
+			m_queue.push_back((uint32_t)i);
+		}
+	}
+	m_depthOrder.resize(count);
+	for (size_t head = 0; head < m_queue.size(); head++)
+	{
+		uint32_t index = m_queue[head];
+		m_depthOrder[index] = (uint32_t)head;
+		for (uint32_t child = m_firstChildren[index]; child != NO_PARENT; child = m_nextSiblings[child])
+		{
+			m_queue.push_back(child);
+		}
+	}
+
+	m_bHierarchyChanged = false;
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for recomputing the world matrices
+ *  of the dirty transforms.  The dirty list is first
+ *  compacted, dropping indices that were removed or listed
+ *  twice, then handed to the batched kernel to compose the
+ *  local matrices.
+ *
+ *  The dirty transforms are then visited parents first,
+ *  and the world matrices of each one's subtree are
+ *  recomputed breadth first, so a parent is always done
+ *  before its children read it.  A dirty transform inside
+ *  a subtree that was already recomputed this pass is
+ *  skipped.
+ ***********************************************************/
+size_t TransformCache::Update()
+{
+	size_t count = 0;
+	for (size_t i = 0; i < m_dirtyIndices.size(); i++)
+	{
+		uint32_t index = m_dirtyIndices[i];
+		if ((index < m_dirty.size()) && m_dirty[index])
+		{
+			m_dirty[index] = 0;
+			m_dirtyIndices[count++] = index;
+		}
+	}
+
+	ComposeLocalMatrices(m_positions.data(), m_rotations.data(), m_scales.data(),
+		m_dirtyIndices.data(), count, m_localMatrices.data());
+	if (count > 0)
+	{
+		m_worldVersion++;
+	}
+
+	// without parents every world matrix is its local matrix
+	if (m_childCount == 0)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			uint32_t index = m_dirtyIndices[i];
+			m_worldMatrices[index] = m_localMatrices[index];
+			MarkMoved(index);
+		}
+		m_dirtyIndices.clear();
+
+		return(count);
+	}
+
+	if (m_bHierarchyChanged)
+	{
+		BuildHierarchy();
+	}
+
+	const std::vector<uint32_t>& depthOrder = m_depthOrder;
+	std::sort(m_dirtyIndices.begin(), m_dirtyIndices.begin() + count,
+		[&depthOrder](uint32_t a, uint32_t b) { return depthOrder[a] < depthOrder[b]; });
+
+	// a new pass number marks what this update recomputed,
+	// the marks are reset when the counter wraps
+	if (++m_updatePass == 0)
+	{
+		std::fill(m_updatePasses.begin(), m_updatePasses.end(), 0);
+		m_updatePass = 1;
+	}
+
+	size_t updated = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		uint32_t root = m_dirtyIndices[i];
+		if (m_updatePasses[root] == m_updatePass)
+		{
+			continue;
+		}
+
+		m_queue.clear();
+		m_queue.push_back(root);
+		for (size_t head = 0; head < m_queue.size(); head++)
+		{
+			uint32_t index = m_queue[head];
+			uint32_t parent = m_parents[index];
+			if (parent == NO_PARENT)
+			{
+				m_worldMatrices[index] = m_localMatrices[index];
+			}
+			else
+			{
+				m_worldMatrices[index] = m_worldMatrices[parent] * m_localMatrices[index];
+			}
+			m_updatePasses[index] = m_updatePass;
+			MarkMoved(index);
+
+			for (uint32_t child = m_firstChildren[index]; child != NO_PARENT; child = m_nextSiblings[child])
+			{
+				m_queue.push_back(child);
+			}
+		}
+		updated += m_queue.size();
+	}
+
+	m_dirtyIndices.clear();
+
+	return(updated);
+}
+
+/***********************************************************
+ *  TakeMoved()
+ *
+ *  This method is used for handing over the world matrices
+ *  recomputed since the last call and clearing their marks.
+ *  Indices left past the end by removals are dropped.
+ ***********************************************************/
+void TransformCache::TakeMoved(std::vector<uint32_t>& indices)
+{
+	indices.clear();
+	for (size_t i = 0; i < m_movedIndices.size(); i++)
+	{
+		uint32_t index = m_movedIndices[i];
+		if ((index < m_moved.size()) && m_moved[index])
+		{
+			m_moved[index] = 0;
+			indices.push_back(index);
+		}
+	}
+	m_movedIndices.clear();
+}
+
+/***********************************************************
+ *  ComposeLocalMatrices()
+ *
+ *  This function is used for composing the local matrix of
+ *  every listed transform.  The product of the three axis
+ *  rotations is expanded into closed form, so each matrix
+ *  costs three sine and cosine pairs and a few multiplies
+ *  instead of four 4x4 matrix products.  With SSE2 four
+ *  transforms are processed per iteration, one per lane;
+ *  the last group repeats its final index to fill the
+ *  lanes.
+ ***********************************************************/
+void ComposeLocalMatrices(
+	const glm::vec3* positions,
+	const glm::vec3* rotations,
+	const glm::vec3* scales,
+	const uint32_t* indices,
+	size_t count,
+	glm::mat4* localMatrices)
+{
+	size_t i = 0;
+
+#ifdef TRANSFORM_CACHE_SSE2
+	const __m128 toRadians = _mm_set1_ps(g_DegreesToRadians);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	for (; i < count; i += 4)
+	{
+		uint32_t group[4];
+		for (int lane = 0; lane < 4; lane++)
+		{
+			group[lane] = indices[((i + lane) < count) ? (i + lane) : (count - 1)];
+		}
+
+		const glm::vec3& r0 = rotations[group[0]];
+		const glm::vec3& r1 = rotations[group[1]];
+		const glm::vec3& r2 = rotations[group[2]];
+		const glm::vec3& r3 = rotations[group[3]];
+
+		__m128 sx, cx, sy, cy, sz, cz;
+		SinCos4(_mm_mul_ps(_mm_set_ps(r3.x, r2.x, r1.x, r0.x), toRadians), &sx, &cx);
+		SinCos4(_mm_mul_ps(_mm_set_ps(r3.y, r2.y, r1.y, r0.y), toRadians), &sy, &cy);
+		SinCos4(_mm_mul_ps(_mm_set_ps(r3.z, r2.z, r1.z, r0.z), toRadians), &sz, &cz);
+
+		const glm::vec3& s0 = scales[group[0]];
+		const glm::vec3& s1 = scales[group[1]];
+		const glm::vec3& s2 = scales[group[2]];
+		const glm::vec3& s3 = scales[group[3]];
+		__m128 scaleX = _mm_set_ps(s3.x, s2.x, s1.x, s0.x);
+		__m128 scaleY = _mm_set_ps(s3.y, s2.y, s1.y, s0.y);
+		__m128 scaleZ = _mm_set_ps(s3.z, s2.z, s1.z, s0.z);
+
+		__m128 sxsy = _mm_mul_ps(sx, sy);
+		__m128 cxsy = _mm_mul_ps(cx, sy);
+
+		// first column, rotated X axis
+		StoreColumns(
+			_mm_mul_ps(_mm_mul_ps(cy, cz), scaleX),
+			_mm_mul_ps(_mm_add_ps(_mm_mul_ps(cx, sz), _mm_mul_ps(sxsy, cz)), scaleX),
+			_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(sx, sz), _mm_mul_ps(cxsy, cz)), scaleX),
+			zero, localMatrices, group, 0);
+
+		// second column, rotated Y axis
+		StoreColumns(
+			_mm_mul_ps(_mm_sub_ps(zero, _mm_mul_ps(cy, sz)), scaleY),
+			_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(cx, cz), _mm_mul_ps(sxsy, sz)), scaleY),
+			_mm_mul_ps(_mm_add_ps(_mm_mul_ps(sx, cz), _mm_mul_ps(cxsy, sz)), scaleY),
+			zero, localMatrices, group, 1);
+
+		// third column, rotated Z axis
+		StoreColumns(
+			_mm_mul_ps(sy, scaleZ),
+			_mm_mul_ps(_mm_sub_ps(zero, _mm_mul_ps(sx, cy)), scaleZ),
+			_mm_mul_ps(_mm_mul_ps(cx, cy), scaleZ),
+			zero, localMatrices, group, 2);
+
+		// fourth column, translation
+		const glm::vec3& p0 = positions[group[0]];
+		const glm::vec3& p1 = positions[group[1]];
+		const glm::vec3& p2 = positions[group[2]];
+		const glm::vec3& p3 = positions[group[3]];
+		StoreColumns(
+			_mm_set_ps(p3.x, p2.x, p1.x, p0.x),
+			_mm_set_ps(p3.y, p2.y, p1.y, p0.y),
+			_mm_set_ps(p3.z, p2.z, p1.z, p0.z),
+			one, localMatrices, group, 3);
+	}
+#endif
+
+	// scalar path of the same closed form
+	for (; i < count; i++)
+	{
+		uint32_t index = indices[i];
+		const glm::vec3& rotation = rotations[index];
+		const glm::vec3& scale = scales[index];
+
+		float sx = std::sin(rotation.x * g_DegreesToRadians);
+		float cx = std::cos(rotation.x * g_DegreesToRadians);
+		float sy = std::sin(rotation.y * g_DegreesToRadians);
+		float cy = std::cos(rotation.y * g_DegreesToRadians);
+		float sz = std::sin(rotation.z * g_DegreesToRadians);
+		float cz = std::cos(rotation.z * g_DegreesToRadians);
+
+		glm::mat4& local = localMatrices[index];
+		local[0] = glm::vec4(cy * cz, cx * sz + sx * sy * cz, sx * sz - cx * sy * cz, 0.0f) * scale.x;
+		local[1] = glm::vec4(-cy * sz, cx * cz - sx * sy * sz, sx * cz + cx * sy * sz, 0.0f) * scale.y;
+		local[2] = glm::vec4(sy, -sx * cy, cx * cy, 0.0f) * scale.z;
+		local[3] = glm::vec4(positions[index], 1.0f);
+	}
+}
@@ -0,0 +1,179 @@
+///////////////////////////////////////////////////////////////////////////////
+// TransformCache.h
+// ============
+// keep the world matrix of every object and recompute it only after its
+// position, rotation or scale, or that of one of its parents, changed
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  TransformCache
+ *
+ *  This class contains the position, Euler rotation in
+ *  degrees and scale of a set of objects in contiguous
+ *  arrays, together with the local matrix composed from
+ *  them and the world matrix.  Changing a transform marks
+ *  it dirty, and Update() recomputes all the dirty local
+ *  matrices in one batch.
+ *
+ *  The local matrix is translate * rotateX * rotateY *
+ *  rotateZ * scale.  A transform may have a parent, its
+ *  values are then relative to the parent and its world
+ *  matrix is the parent world matrix * the local matrix.
+ *  World matrices are only propagated down the subtrees of
+ *  dirty transforms, breadth first, so moving a parent
+ *  touches its descendants and nothing else.
+ *
+ *  The children of every transform are kept as an intrusive
+ *  list, first child and previous and next siblings, so
+ *  attaching, detaching and removing a transform only
+ *  touches its own links and those of its neighbours.
+ ***********************************************************/
+class TransformCache
+{
+public:
+	// index of the parent of a root transform
+	static const uint32_t NO_PARENT = 0xFFFFFFFF;
+
+	// append a transform, its world matrix is computed by
+	// the next update
+	size_t Add(const glm::vec3& position, const glm::vec3& rotation, const glm::vec3& scale,
+		uint32_t parent = NO_PARENT);
+	// remove a transform, the last transform takes its index -
+	// children of the removed transform become roots; costs the
+	// number of children of the two transforms involved
+	void Remove(size_t index);
+	// remove all transforms
+	void Clear();
+
+	// number of transforms
+	inline size_t Size() const { return m_positions.size(); }
+
+	// replace a transform, it is only marked dirty when
+	// one of the values differs from the cached ones
+	void Set(size_t index, const glm::vec3& position, const glm::vec3& rotation, const glm::vec3& scale);
+
+	// writable access marks the transform dirty
+	inline glm::vec3& Position(size_t index) { MarkDirty(index); return m_positions[index]; }
+	inline glm::vec3& Rotation(size_t index) { MarkDirty(index); return m_rotations[index]; }
+	inline glm::vec3& Scale(size_t index) { MarkDirty(index); return m_scales[index]; }
+
+	// read-only access
+	inline const glm::vec3& GetPosition(size_t index) const { return m_positions[index]; }
+	inline const glm::vec3& GetRotation(size_t index) const { return m_rotations[index]; }
+	inline const glm::vec3& GetScale(size_t index) const { return m_scales[index]; }
+	inline const glm::vec3* GetPositions() const { return m_positions.data(); }
+	inline const glm::vec3* GetRotations() const { return m_rotations.data(); }
+	inline const glm::vec3* GetScales() const { return m_scales.data(); }
+
+	// attach a transform to a parent, or make it a root with
+	// NO_PARENT; fails when the parent is the transform itself
+	// or one of its descendants
+	bool SetParent(size_t index, uint32_t parent);
+	inline uint32_t GetParent(size_t index) const { return m_parents[index]; }
+	// walk the children of a transform, NO_PARENT ends the list
+	inline uint32_t GetFirstChild(size_t index) const { return m_firstChildren[index]; }
+	inline uint32_t GetNextSibling(size_t index) const { return m_nextSiblings[index]; }
+	// number of transforms that have a parent
+	inline size_t GetChildCount() const { return m_childCount; }
+
+	// rotate every root transform around its Y axis, keeping
+	// the angle within one full turn - children turn with
+	// their parent
+	void RotateAllY(float degrees);
+
+	// recompute the dirty local matrices and the world matrices
+	// below them, returns how many world matrices were recomputed
+	size_t Update();
+	// changes whenever an update recomputed world matrices
+	inline uint32_t GetWorldVersion() const { return m_worldVersion; }
+	// hand over the indices of the world matrices recomputed since
+	// the last call, for the one consumer that mirrors them
+	void TakeMoved(std::vector<uint32_t>& indices);
+
+	// world matrix as of the last update
+	inline const glm::mat4& GetWorld(size_t index) const { return m_worldMatrices[index]; }
+	inline const glm::mat4* GetWorldMatrices() const { return m_worldMatrices.data(); }
+
+private:
+	// rebuild the breadth first order
+	void BuildHierarchy();
+	// add a transform to the front of the child list of its
+	// parent, or take it out of that list
+	void LinkChild(uint32_t index);
+	void UnlinkChild(uint32_t index);
+
+	inline void MarkDirty(size_t index)
+	{
+		if (!m_dirty[index])
+		{
+			m_dirty[index] = 1;
+			m_dirtyIndices.push_back((uint32_t)index);
+		}
+	}
+
+	inline void MarkMoved(uint32_t index)
+	{
+		if (!m_moved[index])
+		{
+			m_moved[index] = 1;
+			m_movedIndices.push_back(index);
+		}
+	}
+
+	// transform inputs
+	std::vector<glm::vec3> m_positions;
+	std::vector<glm::vec3> m_rotations;
+	std::vector<glm::vec3> m_scales;
+	// composed local matrices and the world matrices
+	std::vector<glm::mat4> m_localMatrices;
+	std::vector<glm::mat4> m_worldMatrices;
+	// parent index of every transform, and the links of the
+	// child lists, NO_PARENT where there is no such transform
+	std::vector<uint32_t> m_parents;
+	std::vector<uint32_t> m_firstChildren;
+	std::vector<uint32_t> m_previousSiblings;
+	std::vector<uint32_t> m_nextSiblings;
+	// number of transforms that have a parent, while it is
+	// zero every world matrix is its local matrix
+	size_t m_childCount = 0;
+	// dirty flag of every transform and the list of the
+	// dirty indices, so an update never scans clean ones
+	std::vector<uint8_t> m_dirty;
+	std::vector<uint32_t> m_dirtyIndices;
+	// moved flag of every world matrix recomputed since the last
+	// TakeMoved(), and the list of them
+	std::vector<uint8_t> m_moved;
+	std::vector<uint32_t> m_movedIndices;
+
+	// position of every transform in breadth first order,
+	// rebuilt by the first update after a change
+	std::vector<uint32_t> m_depthOrder;
+	bool m_bHierarchyChanged = false;
+	// update pass that last recomputed each world matrix
+	std::vector<uint32_t> m_updatePasses;
+	uint32_t m_updatePass = 0;
+	// breadth first queue of the propagation
+	std::vector<uint32_t> m_queue;
+	// number of updates that recomputed world matrices
+	uint32_t m_worldVersion = 0;
+};
+
+// compose the local matrices of the listed transforms - the
+// batched kernel behind TransformCache::Update(), processing
+// four transforms per iteration with SSE2 where available
+void ComposeLocalMatrices(
+	const glm::vec3* positions,
+	const glm::vec3* rotations,
+	const glm::vec3* scales,
+	const uint32_t* indices,
+	size_t count,
+	glm::mat4* localMatrices);
@@ -16,14 +16,15 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/type_ptr.hpp>    
 
+#include <algorithm>
+#include <cstring>
+
 // declaration of the global variables and defines
 namespace
 {
 	// Variables for window width and height
 	const int WINDOW_WIDTH = 1280;
 	const int WINDOW_HEIGHT = 720;
-	const char* g_ViewName = "view";
-	const char* g_ProjectionName = "projection";
 
 	// camera object used for viewing and interacting with
 	// the 3D scene
@@ -54,6 +55,8 @@ ViewManager::ViewManager(
 	// initialize the member variables
 	m_pShaderManager = pShaderManager;
 	m_pWindow = NULL;
+	m_frameConstantsUBO = 0;
+	memset(&m_frameConstants, 0, sizeof(m_frameConstants));
 	g_pCamera = new Camera();
 	// default camera view parameters
 	g_pCamera->Position = glm::vec3(0.2f, 5.0f, 18.0f);
@@ -71,6 +74,11 @@ ViewManager::~ViewManager()
 	// free up allocated memory
 	m_pShaderManager = NULL;
 	m_pWindow = NULL;
+	if (0 != m_frameConstantsUBO)
+	{
+		glDeleteBuffers(1, &m_frameConstantsUBO);
+		m_frameConstantsUBO = 0;
+	}
 	if (NULL != g_pCamera)
 	{
 		delete g_pCamera;
@@ -281,11 +289,59 @@ void ViewManager::PrepareSceneView()
 	// if the shader manager object is valid
 	if (NULL != m_pShaderManager)
 	{
-		// set the view matrix into the shader for proper rendering
-		m_pShaderManager->setMat4Value(g_ViewName, view);
-		// set the view matrix into the shader for proper rendering
-		m_pShaderManager->setMat4Value(g_ProjectionName, projection);
-		// set the view position of the camera into the shader for proper rendering
-		m_pShaderManager->setVec3Value("viewPosition", g_pCamera->Position);
+		FRAME_CONSTANTS frameConstants;
+		frameConstants.view = view;
+		frameConstants.projection = projection;
+		frameConstants.viewPosition = glm::vec4(g_pCamera->Position, 1.0f);
+
+		// the uniform buffer is created on the first rendered frame
+		// since the OpenGL context does not exist at construction
+		bool bCreated = false;
+		if (0 == m_frameConstantsUBO)
+		{
+			m_frameConstantsUBO = m_pShaderManager->CreateUniformBuffer(
+				FRAME_CONSTANTS_BINDING, sizeof(FRAME_CONSTANTS));
+			bCreated = true;
+		}
+
+		// only upload the camera state when it has changed - a still
+		// camera costs no uniform traffic at all
+		if ((bCreated == true) ||
+			(memcmp(&frameConstants, &m_frameConstants, sizeof(FRAME_CONSTANTS)) != 0))
+		{
+			m_frameConstants = frameConstants;
+			m_pShaderManager->UpdateUniformBuffer(
+				m_frameConstantsUBO, &m_frameConstants, sizeof(FRAME_CONSTANTS));
+		}
 	}
-}
\ No newline at end of file
+}
+/***********************************************************
+ *  GetPickRay()
+ *
+ *  This method is used for getting the ray from the camera
+ *  through a point of the window.  The point is moved to
+ *  normalized device coordinates and unprojected onto the
+ *  near and far planes of the current view, so the ray
+ *  follows both the perspective and orthographic views.
+ ***********************************************************/
+void ViewManager::GetPickRay(float windowX, float windowY, glm::vec3& origin, glm::vec3& direction) const
+{
+	int width = WINDOW_WIDTH;
+	int height = WINDOW_HEIGHT;
+	if (NULL != m_pWindow)
+	{
+		glfwGetWindowSize(m_pWindow, &width, &height);
+	}
+	width = std::max(width, 1);
+	height = std::max(height, 1);
+
+	float x = (2.0f * windowX / width) - 1.0f;
+	float y = 1.0f - (2.0f * windowY / height);
+
+	glm::mat4 inverse = glm::inverse(GetViewProjection());
+	glm::vec4 nearPoint = inverse * glm::vec4(x, y, -1.0f, 1.0f);
+	glm::vec4 farPoint = inverse * glm::vec4(x, y, 1.0f, 1.0f);
+
+	origin = glm::vec3(nearPoint) / nearPoint.w;
+	direction = glm::normalize((glm::vec3(farPoint) / farPoint.w) - origin);
+}
@@ -37,6 +37,19 @@ private:
 	// active OpenGL display window
 	GLFWwindow* m_pWindow;
 
+	// std140 mirror of the FrameConstants uniform block
+	struct FRAME_CONSTANTS
+	{
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::vec4 viewPosition;
+	};
+
+	// last camera state written into the uniform buffer
+	FRAME_CONSTANTS m_frameConstants;
+	// uniform buffer object backing the FrameConstants block
+	GLuint m_frameConstantsUBO;
+
 	// process keyboard events for interaction with the 3D scene
 	void ProcessKeyboardEvents();
 
@@ -46,4 +59,15 @@ public:
 	
 	// prepare the conversion from 3D object display to 2D scene display
 	void PrepareSceneView();
+
+	// camera position of the prepared view
+	glm::vec3 GetViewPosition() const { return glm::vec3(m_frameConstants.viewPosition); }
+	// view and projection of the current frame
+	glm::mat4 GetView() const { return m_frameConstants.view; }
+	glm::mat4 GetProjection() const { return m_frameConstants.projection; }
+	// projection * view of the current frame
+	glm::mat4 GetViewProjection() const { return m_frameConstants.projection * m_frameConstants.view; }
+	// world space ray from the camera through a point of the
+	// window, in window coordinates with the origin top left
+	void GetPickRay(float windowX, float windowY, glm::vec3& origin, glm::vec3& direction) const;
 };
\ No newline at end of file
@@ -0,0 +1,123 @@
+///////////////////////////////////////////////////////////////////////////////
+// GLStateCache.cpp
+// ============
+// track the bound OpenGL state so that redundant state changes are skipped
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GLStateCache.h"
+
+#include <string.h>
+
+/***********************************************************
+ *  GLStateCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+GLStateCache::GLStateCache()
+{
+	memset(&m_counters, 0, sizeof(m_counters));
+	memset(&m_lastFrameCounters, 0, sizeof(m_lastFrameCounters));
+	Invalidate();
+}
+
+/***********************************************************
+ *  Invalidate()
+ *
+ *  This method is used for forgetting the cached state, so
+ *  the next call of each kind is always sent to GL.
+ ***********************************************************/
+void GLStateCache::Invalidate()
+{
+	m_program = UNKNOWN_STATE;
+	m_vertexArray = UNKNOWN_STATE;
+	m_activeTextureUnit = UNKNOWN_STATE;
+	for (int i = 0; i < MAX_TEXTURE_UNITS; i++)
+	{
+		m_textureTargets[i] = GL_NONE;
+		m_textures[i] = UNKNOWN_STATE;
+	}
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for starting the counters of a new
+ *  frame.  The cached state is invalidated because the UI
+ *  and resource loading bind GL objects directly.
+ ***********************************************************/
+void GLStateCache::BeginFrame()
+{
+	m_lastFrameCounters = m_counters;
+	memset(&m_counters, 0, sizeof(m_counters));
+	Invalidate();
+}
+
+/***********************************************************
+ *  UseProgram()
+ *
+ *  This method is used for binding a shader program when
+ *  it is not already bound.
+ ***********************************************************/
+void GLStateCache::UseProgram(GLuint program)
+{
+	if (program == m_program)
+	{
+		Record(STATE_CALL_PROGRAM, false);
+		return;
+	}
+
+	glUseProgram(program);
+	m_program = program;
+	Record(STATE_CALL_PROGRAM, true);
+}
+
+/***********************************************************
+ *  BindVertexArray()
+ *
+ *  This method is used for binding a vertex array object
+ *  when it is not already bound.
+ ***********************************************************/
+void GLStateCache::BindVertexArray(GLuint vao)
+{
+	if (vao == m_vertexArray)
+	{
+		Record(STATE_CALL_VERTEX_ARRAY, false);
+		return;
+	}
+
+	glBindVertexArray(vao);
+	m_vertexArray = vao;
+	Record(STATE_CALL_VERTEX_ARRAY, true);
+}
+
+/***********************************************************
+ *  BindTexture()
+ *
+ *  This method is used for binding a texture to a texture
+ *  unit.  The active unit is only switched when the bound
+ *  texture actually changes.
+ ***********************************************************/
+void GLStateCache::BindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+	if ((unit < (GLuint)MAX_TEXTURE_UNITS) &&
+		(m_textures[unit] == texture) && (m_textureTargets[unit] == target))
+	{
+		Record(STATE_CALL_TEXTURE, false);
+		return;
+	}
+
+	if (unit != m_activeTextureUnit)
+	{
+		glActiveTexture(GL_TEXTURE0 + unit);
+		m_activeTextureUnit = unit;
+	}
+	glBindTexture(target, texture);
+	Record(STATE_CALL_TEXTURE, true);
+
+	if (unit < (GLuint)MAX_TEXTURE_UNITS)
+	{
+		m_textureTargets[unit] = target;
+		m_textures[unit] = texture;
+	}
+}
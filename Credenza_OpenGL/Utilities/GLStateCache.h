@@ -0,0 +1,97 @@
+///////////////////////////////////////////////////////////////////////////////
+// GLStateCache.h
+// ============
+// track the bound OpenGL state so that redundant state changes are skipped
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+// kinds of state changes that go through the cache
+enum GLStateCall
+{
+	STATE_CALL_PROGRAM = 0,
+	STATE_CALL_VERTEX_ARRAY,
+	STATE_CALL_TEXTURE,
+	STATE_CALL_UNIFORM,
+	STATE_CALL_COUNT
+};
+
+// number of state changes sent to GL and skipped as no-ops
+struct GL_STATE_COUNTERS
+{
+	unsigned int issued[STATE_CALL_COUNT];
+	unsigned int elided[STATE_CALL_COUNT];
+};
+
+/***********************************************************
+ *  GLStateCache
+ *
+ *  This class contains the last state that was sent to GL
+ *  for the bound program, vertex array and texture units,
+ *  and skips the calls that would not change anything.
+ ***********************************************************/
+class GLStateCache
+{
+public:
+	// number of texture units that are tracked - the 16 scene
+	// texture slots plus the G-buffer and occlusion units above
+	// them, well inside the 80 units GL 4 guarantees
+	static const int MAX_TEXTURE_UNITS = 32;
+
+	// constructor
+	GLStateCache();
+
+	// forget all cached state - used when other code may have
+	// changed GL state behind the back of the cache
+	void Invalidate();
+
+	// start a new frame - the counters of the finished frame are
+	// kept for display and the cached state is invalidated
+	void BeginFrame();
+
+	// bind a shader program
+	void UseProgram(GLuint program);
+	// bind a vertex array object
+	void BindVertexArray(GLuint vao);
+	// bind a texture to a texture unit
+	void BindTexture(GLuint unit, GLenum target, GLuint texture);
+
+	// count a uniform write made by the caller or skipped as unchanged
+	inline void RecordUniform(bool bIssued)
+	{
+		Record(STATE_CALL_UNIFORM, bIssued);
+	}
+
+	// counters of the frame in progress and of the last finished frame
+	const GL_STATE_COUNTERS& GetCounters() const { return m_counters; }
+	const GL_STATE_COUNTERS& GetLastFrameCounters() const { return m_lastFrameCounters; }
+
+private:
+	// value meaning the cached state is not known
+	static const GLuint UNKNOWN_STATE = 0xFFFFFFFF;
+
+	GLuint m_program;
+	GLuint m_vertexArray;
+	GLuint m_activeTextureUnit;
+	GLenum m_textureTargets[MAX_TEXTURE_UNITS];
+	GLuint m_textures[MAX_TEXTURE_UNITS];
+
+	GL_STATE_COUNTERS m_counters;
+	GL_STATE_COUNTERS m_lastFrameCounters;
+
+	// add one call to the counters
+	inline void Record(GLStateCall call, bool bIssued)
+	{
+		if (bIssued)
+		{
+			m_counters.issued[call]++;
+		}
+		else
+		{
+			m_counters.elided[call]++;
+		}
+	}
+};
@@ -14,27 +14,100 @@ using namespace std;
 
 #include "ShaderManager.h"
 
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+	// identifies a program binary cache file written by this class
+	const unsigned int g_BinaryCacheMagic = 0x42505343; // "CSPB"
+	const unsigned int g_BinaryCacheVersion = 1;
+
+	// header stored in front of the driver program binary
+	struct BINARY_CACHE_HEADER
+	{
+		unsigned int magic;
+		unsigned int version;
+		unsigned int format;
+		unsigned int length;
+	};
+
+	// 64-bit FNV-1a hash, chained through the seed value
+	unsigned long long HashString(const std::string& text, unsigned long long seed)
+	{
+		unsigned long long hash = seed;
+		for (size_t i = 0; i < text.size(); i++)
+		{
+			hash ^= (unsigned char)text[i];
+			hash *= 0x100000001b3ULL;
+		}
+		// separate consecutive strings so "ab"+"c" != "a"+"bc"
+		hash ^= 0xff;
+		hash *= 0x100000001b3ULL;
+		return(hash);
+	}
+
+	// read a whole text file into a string
+	bool ReadTextFile(const char* filePath, std::string& text)
+	{
+		std::ifstream stream(filePath, std::ios::in);
+		if (!stream.is_open())
+		{
+			return(false);
+		}
+		std::stringstream sstr;
+		sstr << stream.rdbuf();
+		text = sstr.str();
+		return(true);
+	}
+
+	// get a driver string, empty when not available
+	std::string GetGLString(GLenum name)
+	{
+		const GLubyte* value = glGetString(name);
+		return (value != NULL) ? std::string((const char*)value) : std::string();
+	}
+}
+
+/***********************************************************
+ *  ShaderManager()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ShaderManager::ShaderManager()
+{
+	m_programID = 0;
+	m_pCurrentVariant = NULL;
+	m_currentVariantKey = 0;
+	m_binaryCacheDirectory = "ShaderCache";
+}
+
+/***********************************************************
+ *  ~ShaderManager()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ShaderManager::~ShaderManager()
+{
+	DestroyVariants();
+}
+
 /***********************************************************
  *  LoadShaders()
  *
  *  This method is called to load the shader data from 
- *  external GLSL compatible files.
+ *  external GLSL compatible files.  The sources are kept
+ *  so that shader variants can be compiled from them on
+ *  demand, and the base variant (no features) is bound.
  ***********************************************************/
 GLuint ShaderManager::LoadShaders(const char * vertex_file_path,const char * fragment_file_path){
 
-	// Create the shaders
-	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
-
 	// Read the Vertex Shader code from the file
 	std::string VertexShaderCode;
-	std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
-	if(VertexShaderStream.is_open()){
-		std::stringstream sstr;
-		sstr << VertexShaderStream.rdbuf();
-		VertexShaderCode = sstr.str();
-		VertexShaderStream.close();
-	}else{
+	if (ReadTextFile(vertex_file_path, VertexShaderCode) == false){
 		printf("Impossible to open %s. Are you in the right directory ? Don't forget to read the FAQ !\n", vertex_file_path);
 		getchar();
 		return 0;
@@ -42,13 +115,260 @@ GLuint ShaderManager::LoadShaders(const char * vertex_file_path,const char * fra
 
 	// Read the Fragment Shader code from the file
 	std::string FragmentShaderCode;
-	std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
-	if(FragmentShaderStream.is_open()){
-		std::stringstream sstr;
-		sstr << FragmentShaderStream.rdbuf();
-		FragmentShaderCode = sstr.str();
-		FragmentShaderStream.close();
+	ReadTextFile(fragment_file_path, FragmentShaderCode);
+
+	// variants built from the previous sources are no longer valid
+	DestroyVariants();
+
+	m_vertexFilePath = vertex_file_path;
+	m_fragmentFilePath = fragment_file_path;
+	m_vertexSource = VertexShaderCode;
+	m_fragmentSource = FragmentShaderCode;
+
+	UseVariant(MakeShaderVariantKey(0, 0));
+
+	return m_programID;
+}
+
+/***********************************************************
+ *  LoadComputeShader()
+ *
+ *  This method is called to build a compute program from
+ *  an external GLSL file.  Compute programs are not shader
+ *  variants, they are not cached and the caller binds and
+ *  deletes them.  Compute shaders need GL 4.3, so 0 is
+ *  returned right away on older contexts.
+ ***********************************************************/
+GLuint ShaderManager::LoadComputeShader(const char* compute_file_path) const
+{
+	if (!GLEW_VERSION_4_3)
+	{
+		return 0;
+	}
+
+	std::string ComputeShaderCode;
+	if (ReadTextFile(compute_file_path, ComputeShaderCode) == false){
+		printf("Impossible to open %s.\n", compute_file_path);
+		return 0;
+	}
+
+	GLint Result = GL_FALSE;
+	int InfoLogLength;
+
+	// Compile Compute Shader
+	printf("Compiling shader : %s...", compute_file_path);
+	GLuint ComputeShaderID = glCreateShader(GL_COMPUTE_SHADER);
+	char const * ComputeSourcePointer = ComputeShaderCode.c_str();
+	glShaderSource(ComputeShaderID, 1, &ComputeSourcePointer, NULL);
+	glCompileShader(ComputeShaderID);
+
+	// Check Compute Shader
+	glGetShaderiv(ComputeShaderID, GL_COMPILE_STATUS, &Result);
+	glGetShaderiv(ComputeShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	if ( InfoLogLength > 1 ){
+		std::vector<char> ComputeShaderErrorMessage(InfoLogLength+1);
+		glGetShaderInfoLog(ComputeShaderID, InfoLogLength, NULL, &ComputeShaderErrorMessage[0]);
+		printf("\n%s\n", &ComputeShaderErrorMessage[0]);
+	}
+	if (Result != GL_TRUE){
+		glDeleteShader(ComputeShaderID);
+		return 0;
+	}
+
+	printf("success\n");
+
+	// Link the program
+	printf("Linking shader program...");
+	GLuint ProgramID = glCreateProgram();
+	glAttachShader(ProgramID, ComputeShaderID);
+	glLinkProgram(ProgramID);
+
+	// Check the program
+	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
+	glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	if ( InfoLogLength > 1 ){
+		std::vector<char> ProgramErrorMessage(InfoLogLength+1);
+		glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
+		printf("\n%s\n", &ProgramErrorMessage[0]);
+	}
+
+	glDetachShader(ProgramID, ComputeShaderID);
+	glDeleteShader(ComputeShaderID);
+
+	if (Result != GL_TRUE){
+		glDeleteProgram(ProgramID);
+		return 0;
+	}
+
+	printf("success\n");
+
+	return ProgramID;
+}
+
+/***********************************************************
+ *  UseVariant()
+ *
+ *  This method is used for binding the shader variant for
+ *  the passed in key.  Variants are compiled the first time
+ *  they are requested and kept for the rest of the run.
+ *  Any uniform value that was set while another variant
+ *  was bound is uploaded into this variant before use.
+ ***********************************************************/
+void ShaderManager::UseVariant(unsigned int variantKey)
+{
+	if ((NULL != m_pCurrentVariant) && (variantKey == m_currentVariantKey))
+	{
+		m_stateCache.UseProgram(m_programID);
+		return;
+	}
+
+	auto it = m_variants.find(variantKey);
+	if (it == m_variants.end())
+	{
+		if (m_vertexSource.empty())
+		{
+			return;
+		}
+
+		SHADER_VARIANT variant;
+		variant.programID = BuildVariant(variantKey);
+		// resolve all of the uniform locations once so that the
+		// per-draw uniform calls never query the driver by name
+		CacheActiveUniforms(variant.programID, variant.uniformLocations);
+		it = m_variants.insert(std::make_pair(variantKey, variant)).first;
+	}
+
+	m_pCurrentVariant = &it->second;
+	m_currentVariantKey = variantKey;
+	m_programID = m_pCurrentVariant->programID;
+	m_stateCache.UseProgram(m_programID);
+
+	ApplyUniformSlots(*m_pCurrentVariant);
+}
+
+/***********************************************************
+ *  GetVariantDefines()
+ *
+ *  This method is used for building the preprocessor
+ *  definitions that select the features of a variant.
+ ***********************************************************/
+std::string ShaderManager::GetVariantDefines(unsigned int variantKey) const
+{
+	std::string defines;
+
+	if (variantKey & SHADER_FEATURE_TEXTURE)
+	{
+		defines += "#define FEATURE_TEXTURE\n";
+	}
+	if (variantKey & SHADER_FEATURE_LIGHTING)
+	{
+		defines += "#define FEATURE_LIGHTING\n";
+	}
+	if (variantKey & SHADER_FEATURE_ALPHA)
+	{
+		defines += "#define FEATURE_ALPHA\n";
 	}
+	if (variantKey & SHADER_FEATURE_GBUFFER)
+	{
+		defines += "#define FEATURE_GBUFFER\n";
+	}
+	if (variantKey & SHADER_FEATURE_DEFERRED)
+	{
+		defines += "#define FEATURE_DEFERRED\n";
+	}
+	defines += "#define LIGHT_COUNT " +
+		std::to_string(variantKey >> SHADER_LIGHT_COUNT_SHIFT) + "\n";
+
+	return(defines);
+}
+
+/***********************************************************
+ *  BuildVariant()
+ *
+ *  This method is used for creating the program of one
+ *  shader variant.  The variant defines are injected after
+ *  the #version line of both shader sources.  A previously
+ *  linked program binary is reused when the sources and
+ *  the driver have not changed.
+ ***********************************************************/
+GLuint ShaderManager::BuildVariant(unsigned int variantKey)
+{
+	std::string defines = GetVariantDefines(variantKey);
+
+	// keep the reported line numbers matching the shader files
+	std::string injected = defines + "#line 2\n";
+
+	std::string VertexShaderCode = m_vertexSource;
+	std::string FragmentShaderCode = m_fragmentSource;
+	std::string* sources[2] = { &VertexShaderCode, &FragmentShaderCode };
+	for (int i = 0; i < 2; i++)
+	{
+		size_t version = sources[i]->find("#version");
+		size_t lineEnd = (version != std::string::npos) ? sources[i]->find('\n', version) : std::string::npos;
+		if (lineEnd != std::string::npos)
+		{
+			sources[i]->insert(lineEnd + 1, injected);
+		}
+		else
+		{
+			sources[i]->insert(0, defines);
+		}
+	}
+
+	// the cache key covers everything that changes the linked program
+	unsigned long long cacheKey = 0xcbf29ce484222325ULL;
+	cacheKey = HashString(VertexShaderCode, cacheKey);
+	cacheKey = HashString(FragmentShaderCode, cacheKey);
+	cacheKey = HashString(GetGLString(GL_VENDOR), cacheKey);
+	cacheKey = HashString(GetGLString(GL_RENDERER), cacheKey);
+	cacheKey = HashString(GetGLString(GL_VERSION), cacheKey);
+
+	GLuint ProgramID = LoadProgramBinary(cacheKey);
+	if (ProgramID == 0)
+	{
+		printf("Building shader variant 0x%x\n", variantKey);
+		ProgramID = CompileProgram(
+			m_vertexFilePath.c_str(), VertexShaderCode,
+			m_fragmentFilePath.c_str(), FragmentShaderCode);
+		SaveProgramBinary(cacheKey, ProgramID);
+	}
+
+	return ProgramID;
+}
+
+/***********************************************************
+ *  DestroyVariants()
+ *
+ *  This method is used for deleting every compiled shader
+ *  variant program.
+ ***********************************************************/
+void ShaderManager::DestroyVariants()
+{
+	for (auto& entry : m_variants)
+	{
+		if (0 != entry.second.programID)
+		{
+			glDeleteProgram(entry.second.programID);
+		}
+	}
+	m_variants.clear();
+	m_pCurrentVariant = NULL;
+	m_programID = 0;
+}
+
+/***********************************************************
+ *  CompileProgram()
+ *
+ *  This method is called to compile and link the passed in
+ *  shader source code into a new program.
+ ***********************************************************/
+GLuint ShaderManager::CompileProgram(
+	const char* vertex_file_path, const std::string& VertexShaderCode,
+	const char* fragment_file_path, const std::string& FragmentShaderCode)
+{
+	// Create the shaders
+	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
+	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
 
 	GLint Result = GL_FALSE;
 	int InfoLogLength;
@@ -91,9 +411,13 @@ GLuint ShaderManager::LoadShaders(const char * vertex_file_path,const char * fra
 	// Link the program
 	printf("Linking shader program...");
 	GLuint ProgramID = glCreateProgram();
-	m_programID = ProgramID;
 	glAttachShader(ProgramID, VertexShaderID);
 	glAttachShader(ProgramID, FragmentShaderID);
+	// ask the driver to keep the linked binary available for the cache
+	if (SupportsProgramBinary())
+	{
+		glProgramParameteri(ProgramID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
 	glLinkProgram(ProgramID);
 
 	// Check the program
@@ -116,4 +440,438 @@ GLuint ShaderManager::LoadShaders(const char * vertex_file_path,const char * fra
 	return ProgramID;
 }
 
+/***********************************************************
+ *  GetBinaryCachePath()
+ *
+ *  This method is used for building the file path of the
+ *  program binary cache entry for the passed in key.
+ ***********************************************************/
+std::string ShaderManager::GetBinaryCachePath(unsigned long long cacheKey) const
+{
+	char fileName[32];
+	snprintf(fileName, sizeof(fileName), "%016llx.bin", cacheKey);
+
+	if (m_binaryCacheDirectory.empty())
+	{
+		return(std::string(fileName));
+	}
+	return(m_binaryCacheDirectory + "/" + fileName);
+}
+
+/***********************************************************
+ *  SupportsProgramBinary()
+ *
+ *  This method is used for checking that the context has
+ *  program binaries, from GL 4.1 or the extension, and at
+ *  least one binary format to save them in.
+ ***********************************************************/
+bool ShaderManager::SupportsProgramBinary() const
+{
+	if (!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary)
+	{
+		return(false);
+	}
+
+	GLint formatCount = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	return(formatCount > 0);
+}
+
+/***********************************************************
+ *  LoadProgramBinary()
+ *
+ *  This method is used for creating a program from a cached
+ *  program binary.  Zero is returned when there is no cache
+ *  entry or the driver rejects it, so that the caller falls
+ *  back to compiling the shader sources.
+ ***********************************************************/
+GLuint ShaderManager::LoadProgramBinary(unsigned long long cacheKey)
+{
+	if (!SupportsProgramBinary())
+	{
+		return(0);
+	}
+
+	std::ifstream file(GetBinaryCachePath(cacheKey), std::ios::in | std::ios::binary);
+	if (!file.is_open())
+	{
+		return(0);
+	}
+
+	BINARY_CACHE_HEADER header;
+	file.read((char*)&header, sizeof(header));
+	if (!file || header.magic != g_BinaryCacheMagic ||
+		header.version != g_BinaryCacheVersion || header.length == 0)
+	{
+		return(0);
+	}
+
+	std::vector<char> binary(header.length);
+	file.read(&binary[0], header.length);
+	if (!file)
+	{
+		return(0);
+	}
+
+	GLuint ProgramID = glCreateProgram();
+	glProgramBinary(ProgramID, (GLenum)header.format, &binary[0], (GLsizei)header.length);
+
+	// the driver may reject a binary after an update - check the link
+	GLint Result = GL_FALSE;
+	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
+	if (Result != GL_TRUE)
+	{
+		printf("Cached shader program was rejected, recompiling\n");
+		glDeleteProgram(ProgramID);
+		return(0);
+	}
+
+	printf("Loaded shader program from binary cache\n");
+	return(ProgramID);
+}
+
+/***********************************************************
+ *  SaveProgramBinary()
+ *
+ *  This method is used for writing the binary of a linked
+ *  program into the cache directory.
+ ***********************************************************/
+void ShaderManager::SaveProgramBinary(unsigned long long cacheKey, GLuint programID)
+{
+	GLint linked = GL_FALSE;
+	glGetProgramiv(programID, GL_LINK_STATUS, &linked);
+	if (!SupportsProgramBinary() || linked != GL_TRUE)
+	{
+		return;
+	}
+
+	GLint length = 0;
+	glGetProgramiv(programID, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+	{
+		return;
+	}
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(programID, length, NULL, &format, &binary[0]);
+
+	if (!m_binaryCacheDirectory.empty())
+	{
+#ifdef _WIN32
+		_mkdir(m_binaryCacheDirectory.c_str());
+#else
+		mkdir(m_binaryCacheDirectory.c_str(), 0755);
+#endif
+	}
+
+	std::ofstream file(GetBinaryCachePath(cacheKey), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		return;
+	}
+
+	BINARY_CACHE_HEADER header;
+	header.magic = g_BinaryCacheMagic;
+	header.version = g_BinaryCacheVersion;
+	header.format = (unsigned int)format;
+	header.length = (unsigned int)length;
+	file.write((const char*)&header, sizeof(header));
+	file.write(&binary[0], length);
+}
+
+/***********************************************************
+ *  CacheActiveUniforms()
+ *
+ *  This method is called after linking to read every active
+ *  uniform of a variant program into its location table.  Arrays
+ *  of basic types are registered under the base name and
+ *  under each indexed element name.
+ ***********************************************************/
+void ShaderManager::CacheActiveUniforms(GLuint programID, std::unordered_map<std::string, GLint>& locations)
+{
+	locations.clear();
+
+	GLint uniformCount = 0;
+	GLint maxNameLength = 0;
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORMS, &uniformCount);
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+	std::vector<GLchar> nameBuffer(maxNameLength + 1);
+	for (GLint i = 0; i < uniformCount; i++)
+	{
+		GLint arraySize = 0;
+		GLenum type = GL_NONE;
+		GLsizei nameLength = 0;
+		glGetActiveUniform(programID, (GLuint)i, (GLsizei)nameBuffer.size(),
+			&nameLength, &arraySize, &type, &nameBuffer[0]);
+
+		std::string name(&nameBuffer[0], nameLength);
+		GLint location = glGetUniformLocation(programID, name.c_str());
+
+		// members of uniform blocks have no location
+		if (location < 0)
+		{
+			continue;
+		}
+		locations[name] = location;
+
+		// arrays report their first element as "name[0]"
+		size_t bracket = name.rfind("[0]");
+		if ((bracket != std::string::npos) && (bracket + 3 == name.size()))
+		{
+			std::string baseName = name.substr(0, bracket);
+			locations[baseName] = location;
+			for (GLint element = 1; element < arraySize; element++)
+			{
+				std::string elementName = baseName + "[" + std::to_string(element) + "]";
+				locations[elementName] = glGetUniformLocation(programID, elementName.c_str());
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  CreateUniformBuffer()
+ *
+ *  This method is used for creating a uniform buffer object
+ *  of the passed in size and attaching it to the uniform
+ *  block binding point shared with the shader code.
+ ***********************************************************/
+GLuint ShaderManager::CreateUniformBuffer(GLuint bindingPoint, GLsizeiptr size) const
+{
+	GLuint buffer = 0;
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
+	glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, buffer);
+
+	return(buffer);
+}
+
+/***********************************************************
+ *  UpdateUniformBuffer()
+ *
+ *  This method is used for writing data into a uniform
+ *  buffer object with a single buffer upload.
+ ***********************************************************/
+void ShaderManager::UpdateUniformBuffer(GLuint buffer, const void* data, GLsizeiptr size, GLintptr offset) const
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+/***********************************************************
+ *  GetUniformHandle()
+ *
+ *  This method is used for registering a uniform name as
+ *  a slot and returning a handle that can be reused on the
+ *  per-draw path.  The slot is resolved in each variant.
+ ***********************************************************/
+UniformHandle ShaderManager::GetUniformHandle(const std::string& name)
+{
+	UniformHandle handle;
+
+	auto it = m_uniformSlotIndex.find(name);
+	if (it != m_uniformSlotIndex.end())
+	{
+		handle.slot = it->second;
+		return(handle);
+	}
+
+	UNIFORM_SLOT slot;
+	slot.name = name;
+	memset(slot.floatValues, 0, sizeof(slot.floatValues));
+	m_uniformSlots.push_back(slot);
+
+	handle.slot = (int)m_uniformSlots.size() - 1;
+	m_uniformSlotIndex[name] = handle.slot;
+	return(handle);
+}
+
+/***********************************************************
+ *  SetUniformValue()
+ *
+ *  This method is used for storing a uniform value in its
+ *  slot and uploading it into the bound variant.  Other
+ *  variants pick up the value when they are next bound.
+ ***********************************************************/
+void ShaderManager::SetUniformValue(UniformHandle handle, int type, const void* data)
+{
+	if ((handle.IsValid() == false) || (handle.slot >= (int)m_uniformSlots.size()))
+	{
+		return;
+	}
+
+	UNIFORM_SLOT& slot = m_uniformSlots[handle.slot];
+	size_t floatCount = GetUniformFloatCount(type);
+
+	// a value equal to the last one written only needs an upload
+	// when the bound variant has not received it yet
+	bool bChanged = (slot.type != type);
+	if (bChanged == false)
+	{
+		bChanged = (type == UNIFORM_INT) ?
+			(slot.intValue != *(const GLint*)data) :
+			(memcmp(slot.floatValues, data, floatCount * sizeof(GLfloat)) != 0);
+	}
+
+	if (bChanged)
+	{
+		slot.type = type;
+		if (type == UNIFORM_INT)
+		{
+			slot.intValue = *(const GLint*)data;
+		}
+		else
+		{
+			memcpy(slot.floatValues, data, floatCount * sizeof(GLfloat));
+		}
+		slot.version++;
+	}
+
+	if (NULL == m_pCurrentVariant)
+	{
+		return;
+	}
+
+	SHADER_VARIANT& variant = *m_pCurrentVariant;
+	if (handle.slot >= (int)variant.slotLocations.size())
+	{
+		ResolveUniformSlots(variant);
+	}
+	if (variant.slotVersions[handle.slot] == slot.version)
+	{
+		m_stateCache.RecordUniform(false);
+		return;
+	}
+	variant.slotVersions[handle.slot] = slot.version;
+	if (variant.slotLocations[handle.slot] >= 0)
+	{
+		UploadUniform(variant.slotLocations[handle.slot], slot);
+	}
+}
+
+/***********************************************************
+ *  GetUniformFloatCount()
+ *
+ *  This method is used for getting the number of floats
+ *  stored for a uniform value type.
+ ***********************************************************/
+size_t ShaderManager::GetUniformFloatCount(int type)
+{
+	switch (type)
+	{
+	case UNIFORM_FLOAT:
+		return(1);
+	case UNIFORM_VEC2:
+		return(2);
+	case UNIFORM_VEC3:
+		return(3);
+	case UNIFORM_VEC4:
+	case UNIFORM_MAT2:
+		return(4);
+	case UNIFORM_MAT3:
+		return(9);
+	case UNIFORM_MAT4:
+		return(16);
+	}
+	return(0);
+}
+
+/***********************************************************
+ *  ResolveUniformSlots()
+ *
+ *  This method is used for looking up the locations of the
+ *  uniform slots registered after the variant was built.
+ ***********************************************************/
+void ShaderManager::ResolveUniformSlots(SHADER_VARIANT& variant)
+{
+	size_t resolved = variant.slotLocations.size();
+	if (resolved >= m_uniformSlots.size())
+	{
+		return;
+	}
+
+	variant.slotLocations.resize(m_uniformSlots.size(), -1);
+	variant.slotVersions.resize(m_uniformSlots.size(), 0);
+	for (size_t i = resolved; i < m_uniformSlots.size(); i++)
+	{
+		auto it = variant.uniformLocations.find(m_uniformSlots[i].name);
+		if (it != variant.uniformLocations.end())
+		{
+			variant.slotLocations[i] = it->second;
+		}
+	}
+}
+
+/***********************************************************
+ *  ApplyUniformSlots()
+ *
+ *  This method is used for uploading the uniform slot
+ *  values that changed since the variant last received
+ *  them, so switching variants keeps every value set.
+ ***********************************************************/
+void ShaderManager::ApplyUniformSlots(SHADER_VARIANT& variant)
+{
+	ResolveUniformSlots(variant);
+
+	for (size_t i = 0; i < m_uniformSlots.size(); i++)
+	{
+		const UNIFORM_SLOT& slot = m_uniformSlots[i];
+		if (variant.slotVersions[i] == slot.version)
+		{
+			continue;
+		}
+		variant.slotVersions[i] = slot.version;
+
+		// uniforms compiled out of this variant are skipped
+		if (variant.slotLocations[i] >= 0)
+		{
+			UploadUniform(variant.slotLocations[i], slot);
+		}
+	}
+}
+
+/***********************************************************
+ *  UploadUniform()
+ *
+ *  This method is used for uploading a slot value into a
+ *  uniform location of the bound program.
+ ***********************************************************/
+void ShaderManager::UploadUniform(GLint location, const UNIFORM_SLOT& slot)
+{
+	m_stateCache.RecordUniform(true);
+
+	switch (slot.type)
+	{
+	case UNIFORM_INT:
+		glUniform1i(location, slot.intValue);
+		break;
+	case UNIFORM_FLOAT:
+		glUniform1fv(location, 1, slot.floatValues);
+		break;
+	case UNIFORM_VEC2:
+		glUniform2fv(location, 1, slot.floatValues);
+		break;
+	case UNIFORM_VEC3:
+		glUniform3fv(location, 1, slot.floatValues);
+		break;
+	case UNIFORM_VEC4:
+		glUniform4fv(location, 1, slot.floatValues);
+		break;
+	case UNIFORM_MAT2:
+		glUniformMatrix2fv(location, 1, GL_FALSE, slot.floatValues);
+		break;
+	case UNIFORM_MAT3:
+		glUniformMatrix3fv(location, 1, GL_FALSE, slot.floatValues);
+		break;
+	case UNIFORM_MAT4:
+		glUniformMatrix4fv(location, 1, GL_FALSE, slot.floatValues);
+		break;
+	}
+}
@@ -2,6 +2,8 @@
 
 #include <GL/glew.h>        // GLEW library
 
+#include "GLStateCache.h"
+
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -10,94 +12,344 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <unordered_map>
+
+// handle to a uniform slot registered with the shader manager - the
+// slot is resolved once per shader variant, so setting a value
+// through a handle never looks up the uniform by name
+struct UniformHandle
+{
+	int slot = -1;
+
+	inline bool IsValid() const { return slot >= 0; }
+};
+
+// feature bits of a shader variant - each bit turns into a #define
+// injected into the shader sources when the variant is compiled
+enum ShaderFeature
+{
+	SHADER_FEATURE_TEXTURE = 1 << 0,	// FEATURE_TEXTURE - sample objectTexture
+	SHADER_FEATURE_LIGHTING = 1 << 1,	// FEATURE_LIGHTING - phong lighting
+	SHADER_FEATURE_ALPHA = 1 << 2,		// FEATURE_ALPHA - keep the surface alpha
+	SHADER_FEATURE_GBUFFER = 1 << 3,	// FEATURE_GBUFFER - write the surface to the G-buffer
+	SHADER_FEATURE_DEFERRED = 1 << 4	// FEATURE_DEFERRED - light the G-buffer over the screen
+};
+
+// the number of lights evaluated by a variant is stored above the feature bits
+const unsigned int SHADER_LIGHT_COUNT_SHIFT = 8;
+
+// build the key of a shader variant from feature bits and a light count
+inline unsigned int MakeShaderVariantKey(unsigned int features, unsigned int lightCount)
+{
+	return(features | (lightCount << SHADER_LIGHT_COUNT_SHIFT));
+}
+
+// uniform block binding points - these must match the
+// layout(binding = N) qualifiers declared in the GLSL files
+enum UniformBlockBinding
+{
+	FRAME_CONSTANTS_BINDING = 0,
+	LIGHT_BLOCK_BINDING = 1,
+	MATERIAL_BLOCK_BINDING = 2
+};
+
+// shader storage block binding points of the lit variants - the
+// culling compute shader binds its own buffers to the same points,
+// so these are bound again before the draws
+enum StorageBlockBinding
+{
+	POINT_LIGHTS_BINDING = 0,
+	LIGHT_CLUSTERS_BINDING = 1,
+	LIGHT_INDICES_BINDING = 2
+};
 
 class ShaderManager
 {
 public:
+	// constructor
+	ShaderManager();
+	// destructor
+	~ShaderManager();
+
 	unsigned int m_programID;
 	
 	GLuint LoadShaders(
 		const char* vertex_file_path, 
 		const char* fragment_file_path);
 
+	// compile and link a compute shader file into a program of its
+	// own, kept apart from the variants - 0 when it fails, the
+	// caller deletes the program
+	GLuint LoadComputeShader(const char* compute_file_path) const;
+
+	// set the directory used for the program binary cache,
+	// an empty string keeps the cache files in the working directory
+	inline void SetBinaryCacheDirectory(const std::string& directory)
+	{
+		m_binaryCacheDirectory = directory;
+	}
+
+	// bind the shader variant for the passed in key, compiling it
+	// on first use - uniform values set through the manager are
+	// carried over to the newly bound variant
+	void UseVariant(unsigned int variantKey);
+	// key of the currently bound shader variant
+	inline unsigned int GetVariantKey() const { return m_currentVariantKey; }
+	// number of shader variants compiled so far
+	inline size_t GetVariantCount() const { return m_variants.size(); }
+
+	// register a uniform name and get a handle for repeated use
+	UniformHandle GetUniformHandle(const std::string& name);
+
+	// create a uniform buffer object attached to a block binding point
+	GLuint CreateUniformBuffer(GLuint bindingPoint, GLsizeiptr size) const;
+	// write data into a previously created uniform buffer object
+	void UpdateUniformBuffer(GLuint buffer, const void* data, GLsizeiptr size, GLintptr offset = 0) const;
+
+	// look up the location of a uniform by name in the bound variant, -1 if not active
+	inline GLint GetUniformLocation(const std::string& name) const
+	{
+		if (NULL == m_pCurrentVariant)
+		{
+			return(-1);
+		}
+		auto it = m_pCurrentVariant->uniformLocations.find(name);
+		return (it != m_pCurrentVariant->uniformLocations.end()) ? it->second : -1;
+	}
+
 	// activate the shader
 	// ------------------------------------------------------------------------
 	inline void use()
 	{
-		glUseProgram(m_programID);
+		m_stateCache.UseProgram(m_programID);
 	}
 
+	// cache of the bound GL state shared by the renderers
+	inline GLStateCache* GetStateCache() { return &m_stateCache; }
+
 	// utility uniform functions
 	// ------------------------------------------------------------------------
-	inline void setBoolValue(const std::string &name, bool value) const
+	inline void setBoolValue(const std::string &name, bool value)
 	{
-		glUniform1i(glGetUniformLocation(m_programID, name.c_str()), (int)value);
+		setBoolValue(GetUniformHandle(name), value);
 	}
 
 	// ------------------------------------------------------------------------
-	inline void setIntValue(const std::string &name, int value) const
+	inline void setIntValue(const std::string &name, int value)
 	{
-		glUniform1i(glGetUniformLocation(m_programID, name.c_str()), value);
+		setIntValue(GetUniformHandle(name), value);
 	}
 
 	// ------------------------------------------------------------------------
-	inline void setFloatValue(const std::string &name, float value) const
+	inline void setFloatValue(const std::string &name, float value)
 	{
-		glUniform1f(glGetUniformLocation(m_programID, name.c_str()), value);
+		setFloatValue(GetUniformHandle(name), value);
 	}
 
 	// ------------------------------------------------------------------------
-	inline void setVec2Value(const std::string &name, const glm::vec2 &value) const
+	inline void setVec2Value(const std::string &name, const glm::vec2 &value)
 	{
-		glUniform2fv(glGetUniformLocation(m_programID, name.c_str()), 1, &value[0]);
+		setVec2Value(GetUniformHandle(name), value);
 	}
 
-	inline void setVec2Value(const std::string &name, float x, float y) const
+	inline void setVec2Value(const std::string &name, float x, float y)
 	{
-		glUniform2f(glGetUniformLocation(m_programID, name.c_str()), x, y);
+		setVec2Value(GetUniformHandle(name), glm::vec2(x, y));
 	}
 
 	// ------------------------------------------------------------------------
-	inline void setVec3Value(const std::string &name, const glm::vec3 &value) const
+	inline void setVec3Value(const std::string &name, const glm::vec3 &value)
 	{
-		glUniform3fv(glGetUniformLocation(m_programID, name.c_str()), 1, &value[0]);
+		setVec3Value(GetUniformHandle(name), value);
 	}
-	inline void setVec3Value(const std::string &name, float x, float y, float z) const
+	inline void setVec3Value(const std::string &name, float x, float y, float z)
 	{
-		glUniform3f(glGetUniformLocation(m_programID, name.c_str()), x, y, z);
+		setVec3Value(GetUniformHandle(name), glm::vec3(x, y, z));
 	}
 
 	// ------------------------------------------------------------------------
-	inline void setVec4Value(const std::string &name, const glm::vec4 &value) const
+	inline void setVec4Value(const std::string &name, const glm::vec4 &value)
 	{
-		glUniform4fv(glGetUniformLocation(m_programID, name.c_str()), 1, &value[0]);
+		setVec4Value(GetUniformHandle(name), value);
 	}
 	inline void setVec4Value(const std::string &name, float x, float y, float z, float w)
 	{
-		glUniform4f(glGetUniformLocation(m_programID, name.c_str()), x, y, z, w);
+		setVec4Value(GetUniformHandle(name), glm::vec4(x, y, z, w));
+	}
+
+	// ------------------------------------------------------------------------
+	inline void setMat2Value(const std::string &name, const glm::mat2 &mat)
+	{
+		SetUniformValue(GetUniformHandle(name), UNIFORM_MAT2, &mat[0][0]);
 	}
 
 	// ------------------------------------------------------------------------
-	inline void setMat2Value(const std::string &name, const glm::mat2 &mat) const
+	inline void setMat3Value(const std::string &name, const glm::mat3 &mat)
 	{
-		glUniformMatrix2fv(glGetUniformLocation(m_programID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		setMat3Value(GetUniformHandle(name), mat);
 	}
 
 	// ------------------------------------------------------------------------
-	inline void setMat3Value(const std::string &name, const glm::mat3 &mat) const
+	inline void setMat4Value(const std::string &name, const glm::mat4 &mat)
 	{
-		glUniformMatrix3fv(glGetUniformLocation(m_programID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		setMat4Value(GetUniformHandle(name), mat);
 	}
 
 	// ------------------------------------------------------------------------
-	inline void setMat4Value(const std::string &name, const glm::mat4 &mat) const
+	inline void setSampler2DValue(const std::string& name, const int &value)
 	{
-		glUniformMatrix4fv(glGetUniformLocation(m_programID, name.c_str()), 1, GL_FALSE, glm::value_ptr(mat));
+		setSampler2DValue(GetUniformHandle(name), value);
 	}
 
+	// handle based uniform functions for the per-draw path
 	// ------------------------------------------------------------------------
-	inline void setSampler2DValue(const std::string& name, const int &value) const
+	inline void setBoolValue(UniformHandle handle, bool value)
 	{
-		glUniform1i(glGetUniformLocation(m_programID, name.c_str()), value);
+		GLint intValue = (GLint)value;
+		SetUniformValue(handle, UNIFORM_INT, &intValue);
 	}
+
+	// ------------------------------------------------------------------------
+	inline void setIntValue(UniformHandle handle, int value)
+	{
+		GLint intValue = (GLint)value;
+		SetUniformValue(handle, UNIFORM_INT, &intValue);
+	}
+
+	// ------------------------------------------------------------------------
+	inline void setFloatValue(UniformHandle handle, float value)
+	{
+		SetUniformValue(handle, UNIFORM_FLOAT, &value);
+	}
+
+	// ------------------------------------------------------------------------
+	inline void setVec2Value(UniformHandle handle, const glm::vec2 &value)
+	{
+		SetUniformValue(handle, UNIFORM_VEC2, &value[0]);
+	}
+
+	// ------------------------------------------------------------------------
+	inline void setVec3Value(UniformHandle handle, const glm::vec3 &value)
+	{
+		SetUniformValue(handle, UNIFORM_VEC3, &value[0]);
+	}
+
+	// ------------------------------------------------------------------------
+	inline void setVec4Value(UniformHandle handle, const glm::vec4 &value)
+	{
+		SetUniformValue(handle, UNIFORM_VEC4, &value[0]);
+	}
+
+	// ------------------------------------------------------------------------
+	inline void setMat3Value(UniformHandle handle, const glm::mat3 &mat)
+	{
+		SetUniformValue(handle, UNIFORM_MAT3, &mat[0][0]);
+	}
+
+	// ------------------------------------------------------------------------
+	inline void setMat4Value(UniformHandle handle, const glm::mat4 &mat)
+	{
+		SetUniformValue(handle, UNIFORM_MAT4, glm::value_ptr(mat));
+	}
+
+	// ------------------------------------------------------------------------
+	inline void setSampler2DValue(UniformHandle handle, int value)
+	{
+		GLint intValue = (GLint)value;
+		SetUniformValue(handle, UNIFORM_INT, &intValue);
+	}
+
+private:
+	// value types that can be stored in a uniform slot
+	enum UniformType
+	{
+		UNIFORM_NONE = 0,
+		UNIFORM_INT,
+		UNIFORM_FLOAT,
+		UNIFORM_VEC2,
+		UNIFORM_VEC3,
+		UNIFORM_VEC4,
+		UNIFORM_MAT2,
+		UNIFORM_MAT3,
+		UNIFORM_MAT4
+	};
+
+	// last value set for a registered uniform, shared by all variants
+	struct UNIFORM_SLOT
+	{
+		std::string name;
+		int type = UNIFORM_NONE;
+		GLint intValue = 0;
+		GLfloat floatValues[16];
+		// bumped on every write so variants can tell a stale value
+		unsigned int version = 0;
+	};
+
+	// a compiled permutation of the shader program
+	struct SHADER_VARIANT
+	{
+		GLuint programID = 0;
+		// active uniform locations keyed by name
+		std::unordered_map<std::string, GLint> uniformLocations;
+		// location of every registered uniform slot in this program
+		std::vector<GLint> slotLocations;
+		// slot value version last uploaded into this program
+		std::vector<unsigned int> slotVersions;
+	};
+
+	// paths and sources of the loaded shader files
+	std::string m_vertexFilePath;
+	std::string m_fragmentFilePath;
+	std::string m_vertexSource;
+	std::string m_fragmentSource;
+
+	// compiled shader variants keyed by feature bits and light count
+	std::unordered_map<unsigned int, SHADER_VARIANT> m_variants;
+	// currently bound variant
+	SHADER_VARIANT* m_pCurrentVariant;
+	unsigned int m_currentVariantKey;
+
+	// registered uniform slots and their index by name
+	std::vector<UNIFORM_SLOT> m_uniformSlots;
+	std::unordered_map<std::string, int> m_uniformSlotIndex;
+
+	// directory holding the cached program binaries
+	std::string m_binaryCacheDirectory;
+
+	// bound program and uniform write tracking
+	GLStateCache m_stateCache;
+
+	// build the #define block for the passed in variant key
+	std::string GetVariantDefines(unsigned int variantKey) const;
+	// compile or load from the binary cache one shader variant
+	GLuint BuildVariant(unsigned int variantKey);
+	// compile and link shader source code into a new program
+	GLuint CompileProgram(
+		const char* vertex_file_path, const std::string& VertexShaderCode,
+		const char* fragment_file_path, const std::string& FragmentShaderCode);
+	// check that the context can save and load program binaries
+	bool SupportsProgramBinary() const;
+	// create a program from the binary cache, 0 when missing or rejected
+	GLuint LoadProgramBinary(unsigned long long cacheKey);
+	// write the binary of a linked program into the cache
+	void SaveProgramBinary(unsigned long long cacheKey, GLuint programID);
+	// file path of the cache entry for a key
+	std::string GetBinaryCachePath(unsigned long long cacheKey) const;
+	// delete every compiled shader variant
+	void DestroyVariants();
+
+	// read every active uniform of a linked program into a location table
+	void CacheActiveUniforms(GLuint programID, std::unordered_map<std::string, GLint>& locations);
+
+	// store a uniform value and upload it into the bound variant
+	void SetUniformValue(UniformHandle handle, int type, const void* data);
+	// resolve the slots registered after a variant was built
+	void ResolveUniformSlots(SHADER_VARIANT& variant);
+	// upload the slot values that are stale in the passed in variant
+	void ApplyUniformSlots(SHADER_VARIANT& variant);
+	// upload one slot value at a location of the bound program
+	void UploadUniform(GLint location, const UNIFORM_SLOT& slot);
+	// number of floats stored for a uniform value type
+	static size_t GetUniformFloatCount(int type);
 };
\ No newline at end of file
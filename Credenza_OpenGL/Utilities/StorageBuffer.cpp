@@ -0,0 +1,110 @@
+///////////////////////////////////////////////////////////////////////////////
+// StorageBuffer.cpp
+// ============
+// grow and write the shader storage buffers shared by the compute and
+// lighting passes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "StorageBuffer.h"
+
+#include <algorithm>
+
+/***********************************************************
+ *  ReserveStorageBuffer()
+ *
+ *  This function is used for making a buffer hold at least
+ *  the passed in size, doubling it when it grows.
+ ***********************************************************/
+void ReserveStorageBuffer(STORAGE_BUFFER& storage, size_t bytes)
+{
+	if (0 == storage.buffer)
+	{
+		glGenBuffers(1, &storage.buffer);
+	}
+	if (bytes <= storage.capacity)
+	{
+		return;
+	}
+
+	storage.capacity = std::max(bytes, storage.capacity * 2);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, storage.buffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, storage.capacity, NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/***********************************************************
+ *  GrowStorageBuffer()
+ *
+ *  This function is used for making a buffer hold at least
+ *  the passed in size without losing what it holds.  A
+ *  larger buffer is cleared to zero, the old contents are
+ *  copied to its start and the old buffer is deleted.
+ ***********************************************************/
+void GrowStorageBuffer(STORAGE_BUFFER& storage, size_t bytes)
+{
+	if ((0 != storage.buffer) && (bytes <= storage.capacity))
+	{
+		return;
+	}
+
+	STORAGE_BUFFER grown = { 0, 0 };
+	ReserveStorageBuffer(grown, std::max(bytes, storage.capacity * 2));
+	GLuint zero = 0;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, grown.buffer);
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+	if (0 != storage.buffer)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, storage.buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_SHADER_STORAGE_BUFFER, 0, 0, storage.capacity);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glDeleteBuffers(1, &storage.buffer);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	storage = grown;
+}
+
+/***********************************************************
+ *  WriteStorageBuffer()
+ *
+ *  This function is used for writing data into a buffer at
+ *  an offset.
+ ***********************************************************/
+void WriteStorageBuffer(const STORAGE_BUFFER& storage, const void* data, size_t bytes, size_t offset)
+{
+	if (0 == bytes)
+	{
+		return;
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, storage.buffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, offset, bytes, data);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/***********************************************************
+ *  UploadStorageBuffer()
+ *
+ *  This function is used for writing data to the start of
+ *  a buffer, growing it first.
+ ***********************************************************/
+void UploadStorageBuffer(STORAGE_BUFFER& storage, const void* data, size_t bytes)
+{
+	ReserveStorageBuffer(storage, bytes);
+	WriteStorageBuffer(storage, data, bytes, 0);
+}
+
+/***********************************************************
+ *  DeleteStorageBuffer()
+ *
+ *  This function is used for deleting a buffer.
+ ***********************************************************/
+void DeleteStorageBuffer(STORAGE_BUFFER& storage)
+{
+	if (0 != storage.buffer)
+	{
+		glDeleteBuffers(1, &storage.buffer);
+	}
+	storage.buffer = 0;
+	storage.capacity = 0;
+}
@@ -0,0 +1,34 @@
+///////////////////////////////////////////////////////////////////////////////
+// StorageBuffer.h
+// ============
+// grow and write the shader storage buffers shared by the compute and
+// lighting passes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <stddef.h>
+
+// shader storage buffer and its size in bytes, zero for both until
+// it is first reserved
+struct STORAGE_BUFFER
+{
+	GLuint buffer;
+	size_t capacity;
+};
+
+// grow a buffer to hold at least the passed in size, the contents
+// are lost when it grows
+void ReserveStorageBuffer(STORAGE_BUFFER& storage, size_t bytes);
+// grow a buffer to hold at least the passed in size, keeping its
+// contents and setting the bytes past them to zero
+void GrowStorageBuffer(STORAGE_BUFFER& storage, size_t bytes);
+// write data into a buffer at an offset
+void WriteStorageBuffer(const STORAGE_BUFFER& storage, const void* data, size_t bytes, size_t offset);
+// write data to the start of a buffer, growing it first
+void UploadStorageBuffer(STORAGE_BUFFER& storage, const void* data, size_t bytes);
+// delete the buffer and set its size back to zero
+void DeleteStorageBuffer(STORAGE_BUFFER& storage);
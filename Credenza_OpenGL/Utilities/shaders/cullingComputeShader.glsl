@@ -0,0 +1,244 @@
+#version 430 core
+layout (local_size_x = 64) in;
+
+// object to cull, laid out to match GpuCuller::GPU_CULL_ITEM
+struct CullItem
+{
+   mat4 model;
+   vec4 color;
+   vec4 boxMin;      // local box, w is the U scale
+   vec4 boxMax;      // w is the V scale
+   vec4 sphere;      // local bounding sphere of the full geometry
+   int materialIndex;
+   uint pass;
+   uint lodSlot;
+   uint firstLevel;
+   uint levelCount;
+   uint padding0;
+   uint padding1;
+   uint padding2;
+};
+
+// laid out to match ShapeMeshes::DRAW_ELEMENTS_COMMAND
+struct DrawCommand
+{
+   uint count;
+   uint instanceCount;
+   uint firstIndex;
+   int baseVertex;
+   uint baseInstance;
+};
+
+// laid out to match ShapeMeshes::INSTANCE_DATA
+struct InstanceData
+{
+   mat4 model;
+   vec4 color;
+   vec2 uvScale;
+   int materialIndex;
+   int padding;
+};
+
+layout(std430, binding = 0) readonly buffer CullItems { CullItem items[]; };
+layout(std430, binding = 1) readonly buffer LevelCommands { DrawCommand levels[]; };
+layout(std430, binding = 2) readonly buffer PassFirsts { uint passFirsts[]; };
+// the draw count of every pass, followed by the statistics
+layout(std430, binding = 3) buffer DrawCounts { uint drawCounts[]; };
+layout(std430, binding = 4) writeonly buffer Commands { DrawCommand commands[]; };
+layout(std430, binding = 5) writeonly buffer Instances { InstanceData instances[]; };
+layout(std430, binding = 6) buffer LodLevels { uint lodLevels[]; };
+layout(std430, binding = 7) writeonly buffer Results { uint results[]; };
+
+uniform vec4 frustumPlanes[6];
+uniform mat4 viewProjection;
+uniform float lodProjectionScale;
+uniform float lodThresholds[3];
+uniform float lodHysteresis;
+uniform int lodSelection;
+uniform uint itemCount;
+
+// statistics counters after the draw counts, laid out to match
+// GpuCuller::GPU_CULL_STATS - the tested count is uploaded
+uniform uint statsOffset;
+const uint STATS_CULLED = 1u;
+const uint STATS_OCCLUDED = 2u;
+const uint STATS_FULL_TRIANGLES = 3u;
+const uint STATS_LOD_TRIANGLES = 4u;
+
+// depth pyramid of the occlusion culler, every level one after the
+// other, and the offset, width and height of each level - no level
+// when occlusion culling is off
+uniform samplerBuffer occlusionDepths;
+uniform uvec4 occlusionLevels[16];
+uniform uint occlusionLevelCount;
+
+// world box holding the local box of an object, as
+// FrustumCuller::AddBox() computes it on the CPU
+void GetWorldBox(CullItem item, out vec3 worldCenter, out vec3 worldExtent)
+{
+   vec3 center = (item.boxMin.xyz + item.boxMax.xyz) * 0.5;
+   vec3 extent = (item.boxMax.xyz - item.boxMin.xyz) * 0.5;
+   worldCenter = vec3(item.model * vec4(center, 1.0));
+   worldExtent = abs(item.model[0].xyz) * extent.x +
+      abs(item.model[1].xyz) * extent.y +
+      abs(item.model[2].xyz) * extent.z;
+}
+
+// the same box test as CullBoxes() on the CPU
+bool IsInsideFrustum(vec3 worldCenter, vec3 worldExtent)
+{
+   for (int p = 0; p < 6; p++)
+   {
+      vec4 plane = frustumPlanes[p];
+      float centerDistance = plane.x * worldCenter.x + plane.y * worldCenter.y + plane.z * worldCenter.z + plane.w;
+      float radius = abs(plane.x) * worldExtent.x + abs(plane.y) * worldExtent.y + abs(plane.z) * worldExtent.z;
+      if ((centerDistance + radius) < 0.0)
+      {
+         return false;
+      }
+   }
+   return true;
+}
+
+// the same test as OcclusionCuller::IsVisible(), true when the
+// box is hidden behind the occluders
+bool IsOccluded(vec3 worldCenter, vec3 worldExtent)
+{
+   if (occlusionLevelCount == 0u)
+   {
+      return false;
+   }
+
+   ivec2 bufferSize = ivec2(occlusionLevels[0].yz);
+   vec2 screenMin = vec2(bufferSize);
+   vec2 screenMax = vec2(0.0);
+   float nearest = 1.0;
+   for (int corner = 0; corner < 8; corner++)
+   {
+      vec3 side = vec3(((corner & 1) != 0) ? 1.0 : -1.0,
+         ((corner & 2) != 0) ? 1.0 : -1.0,
+         ((corner & 4) != 0) ? 1.0 : -1.0);
+      vec4 clip = viewProjection * vec4(worldCenter + worldExtent * side, 1.0);
+      if ((clip.w < 1e-5) || (clip.z < -clip.w))
+      {
+         return false;
+      }
+
+      vec2 screen = ((clip.xy / clip.w) * 0.5 + 0.5) * vec2(bufferSize);
+      screenMin = min(screenMin, screen);
+      screenMax = max(screenMax, screen);
+      nearest = min(nearest, (clip.z / clip.w) * 0.5 + 0.5);
+   }
+
+   // boxes off the buffer are left to the frustum test
+   if (any(lessThan(screenMax, vec2(0.0))) || any(greaterThanEqual(screenMin, vec2(bufferSize))))
+   {
+      return false;
+   }
+
+   ivec2 texelMin = max(ivec2(floor(screenMin)) - 1, ivec2(0));
+   ivec2 texelMax = min(ivec2(floor(screenMax)) + 1, bufferSize - 1);
+   int level = 0;
+   while ((level + 1 < int(occlusionLevelCount)) &&
+      any(greaterThan((texelMax >> level) - (texelMin >> level), ivec2(1))))
+   {
+      level++;
+   }
+
+   int offset = int(occlusionLevels[level].x);
+   int width = int(occlusionLevels[level].y);
+   float farthest = 0.0;
+   for (int y = (texelMin.y >> level); y <= (texelMax.y >> level); y++)
+   {
+      for (int x = (texelMin.x >> level); x <= (texelMax.x >> level); x++)
+      {
+         farthest = max(farthest, texelFetch(occlusionDepths, offset + y * width + x).r);
+      }
+   }
+   return nearest > farthest;
+}
+
+// the same selection as SceneManager::SelectLodLevel()
+uint SelectLodLevel(CullItem item, uint currentLevel)
+{
+   vec4 center = item.model * vec4(item.sphere.xyz, 1.0);
+   float scale = max(length(item.model[0].xyz),
+      max(length(item.model[1].xyz), length(item.model[2].xyz)));
+   float radius = item.sphere.w * scale;
+
+   // the camera is inside the sphere
+   float distance = (viewProjection * center).w;
+   if (distance <= radius)
+   {
+      return 0u;
+   }
+   float size = radius * lodProjectionScale / distance;
+
+   uint level = min(currentLevel, item.levelCount - 1u);
+   while ((level + 1u < item.levelCount) && (size < lodThresholds[level] * (1.0 - lodHysteresis)))
+   {
+      level++;
+   }
+   while ((level > 0u) && (size > lodThresholds[level - 1u] * (1.0 + lodHysteresis)))
+   {
+      level--;
+   }
+   return level;
+}
+
+void main()
+{
+   uint id = gl_GlobalInvocationID.x;
+   if (id >= itemCount)
+   {
+      return;
+   }
+
+   CullItem item = items[id];
+   vec3 worldCenter;
+   vec3 worldExtent;
+   GetWorldBox(item, worldCenter, worldExtent);
+   if (!IsInsideFrustum(worldCenter, worldExtent))
+   {
+      results[id] = 0u;
+      atomicAdd(drawCounts[statsOffset + STATS_CULLED], 1u);
+      return;
+   }
+   if (IsOccluded(worldCenter, worldExtent))
+   {
+      results[id] = 2u;
+      atomicAdd(drawCounts[statsOffset + STATS_OCCLUDED], 1u);
+      return;
+   }
+
+   // the level drawn last frame is kept per object for the hysteresis
+   uint previousLevel = 0u;
+   uint level = 0u;
+   if (item.levelCount > 1u)
+   {
+      previousLevel = lodLevels[item.lodSlot];
+      if (lodSelection != 0)
+      {
+         level = SelectLodLevel(item, previousLevel);
+      }
+      lodLevels[item.lodSlot] = level;
+   }
+   results[id] = 1u | (previousLevel << 8) | (level << 16);
+
+   // append the draw to the commands of its pass
+   uint index = passFirsts[item.pass] + atomicAdd(drawCounts[item.pass], 1u);
+   DrawCommand command = levels[item.firstLevel + level];
+   atomicAdd(drawCounts[statsOffset + STATS_FULL_TRIANGLES], levels[item.firstLevel].count / 3u);
+   atomicAdd(drawCounts[statsOffset + STATS_LOD_TRIANGLES], command.count / 3u);
+   command.instanceCount = 1u;
+   command.baseInstance = index;
+   commands[index] = command;
+
+   InstanceData instance;
+   instance.model = item.model;
+   instance.color = item.color;
+   instance.uvScale = vec2(item.boxMin.w, item.boxMax.w);
+   instance.materialIndex = item.materialIndex;
+   instance.padding = 0;
+   instances[index] = instance;
+}
@@ -19,63 +19,210 @@ struct LightSource
     float specularIntensity;
 };
 
+struct PointLight
+{
+    vec3 position;
+    float radius;
+    vec3 color;
+    float intensity;
+};
+
 #define TOTAL_LIGHTS 4
+#define MAX_MATERIALS 32
+
+// shader variants are selected by ShaderManager, which injects
+// FEATURE_TEXTURE, FEATURE_LIGHTING, FEATURE_ALPHA, FEATURE_GBUFFER,
+// FEATURE_DEFERRED and LIGHT_COUNT - the G-buffer variants write the
+// surface of deferred shading, the deferred variant lights it
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT TOTAL_LIGHTS
+#endif
+
+#ifdef FEATURE_DEFERRED
+flat in mat4 fragmentInverseViewProjection;
 
+// surface of every pixel, laid out as described in GBuffer.h
+uniform sampler2D gbufferAlbedo;
+uniform sampler2D gbufferNormal;
+uniform sampler2D gbufferDepth;
+#else
 in vec3 fragmentPosition;
 in vec3 fragmentVertexNormal;
 in vec2 fragmentTextureCoordinate;
+flat in vec4 fragmentObjectColor;
+#ifdef FEATURE_LIGHTING
+flat in int fragmentMaterialIndex;
+#endif
+#endif
 
+#ifdef FEATURE_GBUFFER
+layout(location = 0) out vec4 outAlbedo;
+layout(location = 1) out vec2 outNormal;
+
+// function prototypes
+vec2 EncodeNormal(vec3 normal);
+#else
 out vec4 outFragmentColor;
+#endif
 
-uniform bool bUseTexture=false;
-uniform bool bUseLighting=false;
-uniform vec4 objectColor = vec4(1.0f);
+#ifdef FEATURE_TEXTURE
 uniform sampler2D objectTexture;
-uniform vec3 viewPosition;
-uniform vec2 UVscale = vec2(1.0f, 1.0f);
-uniform LightSource lightSources[TOTAL_LIGHTS];
-uniform Material material;
+#endif
+
+#if defined(FEATURE_LIGHTING) && !defined(FEATURE_GBUFFER)
+// per-frame camera state, shared with the vertex shader
+layout(std140, binding = 0) uniform FrameConstants
+{
+   mat4 view;
+   mat4 projection;
+   vec4 viewPosition;
+};
+
+// scene lights, laid out to match SceneManager::LIGHT_SOURCE
+layout(std140, binding = 1) uniform LightBlock
+{
+   LightSource lightSources[TOTAL_LIGHTS];
+};
+
+// every defined object material, selected per instance by its material index
+layout(std140, binding = 2) uniform MaterialBlock
+{
+   Material materials[MAX_MATERIALS];
+};
+
+// point lights, laid out to match LightClusterer::POINT_LIGHT
+layout(std430, binding = 0) readonly buffer PointLights
+{
+   PointLight pointLights[];
+};
+
+// grid of clusters over the view frustum: the tile counts, the
+// slice count and the number of lights, the near and far depths
+// and the slices per unit of the logarithm of the depth, then the
+// offset and count of the light indices listed by every cluster
+layout(std430, binding = 1) readonly buffer LightClusters
+{
+   uvec4 clusterGrid;
+   vec4 clusterDepth;
+   uvec2 clusterRanges[];
+};
+
+// point lights of every cluster, in cluster order
+layout(std430, binding = 2) readonly buffer LightIndices
+{
+   uint lightIndices[];
+};
+
+Material material;
 
 // function prototypes
 vec3 CalcLightSource(LightSource light, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection);
+vec3 CalcPointLight(PointLight light, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection);
+uint FindCluster(vec3 worldPosition);
+#ifdef FEATURE_DEFERRED
+vec3 DecodeNormal(vec2 encoded);
+#endif
+#endif
 
 void main()
 {
-   if(bUseLighting == true)
+#ifdef FEATURE_DEFERRED
+   // read the surface back from the G-buffer, pixels the geometry
+   // pass left at the far depth keep the cleared screen
+   ivec2 pixel = ivec2(gl_FragCoord.xy);
+   float depth = texelFetch(gbufferDepth, pixel, 0).r;
+   if (depth >= 1.0)
    {
-      // properties
-      vec3 lightNormal = normalize(fragmentVertexNormal);
-      vec3 viewDirection = normalize(viewPosition - fragmentPosition);
-      vec3 phongResult = vec3(0.0f);
+      discard;
+   }
+   gl_FragDepth = depth;
 
-      for(int i = 0; i < TOTAL_LIGHTS; i++)
-      {
-         phongResult += CalcLightSource(lightSources[i], lightNormal, fragmentPosition, viewDirection); 
-      }   
-    
-      if(bUseTexture == true)
-      {
-         vec4 textureColor = texture(objectTexture, fragmentTextureCoordinate * UVscale);
-         outFragmentColor = vec4(phongResult * textureColor.xyz, 1.0);
-      }
-      else
-      {
-         outFragmentColor = vec4(phongResult * objectColor.xyz, objectColor.w);
-      }
+   vec4 albedo = texelFetch(gbufferAlbedo, pixel, 0);
+   vec4 surfaceColor = vec4(albedo.rgb, 1.0);
+   int materialSlot = int(albedo.a * 255.0 + 0.5);
+   if (materialSlot == 0)
+   {
+      outFragmentColor = surfaceColor;
+      return;
    }
-   else 
+
+   vec2 ndc = gl_FragCoord.xy / vec2(textureSize(gbufferDepth, 0)) * 2.0 - 1.0;
+   vec4 worldPoint = fragmentInverseViewProjection * vec4(ndc, depth * 2.0 - 1.0, 1.0);
+   vec3 surfacePosition = worldPoint.xyz / worldPoint.w;
+   vec3 surfaceNormal = DecodeNormal(texelFetch(gbufferNormal, pixel, 0).xy);
+#else
+#ifdef FEATURE_TEXTURE
+   vec4 surfaceColor = texture(objectTexture, fragmentTextureCoordinate);
+#else
+   vec4 surfaceColor = fragmentObjectColor;
+#endif
+#ifdef FEATURE_LIGHTING
+   int materialSlot = fragmentMaterialIndex + 1;
+#else
+   int materialSlot = 0;
+#endif
+   vec3 surfacePosition = fragmentPosition;
+   vec3 surfaceNormal = fragmentVertexNormal;
+#endif
+
+#ifdef FEATURE_GBUFFER
+   // the material slot is the material index plus one, 0 when unlit
+   outAlbedo = vec4(surfaceColor.rgb, float(materialSlot) / 255.0);
+   outNormal = EncodeNormal(normalize(surfaceNormal));
+#else
+#ifdef FEATURE_LIGHTING
+   material = materials[materialSlot - 1];
+
+   // properties
+   vec3 lightNormal = normalize(surfaceNormal);
+   vec3 viewDirection = normalize(viewPosition.xyz - surfacePosition);
+   vec3 phongResult = vec3(0.0f);
+
+   for(int i = 0; i < LIGHT_COUNT; i++)
    {
-      if(bUseTexture == true)
-      {
-         outFragmentColor = texture(objectTexture, fragmentTextureCoordinate * UVscale);
-      }
-      else
+      phongResult += CalcLightSource(lightSources[i], lightNormal, surfacePosition, viewDirection); 
+   }
+
+   // only the point lights listed by the cluster of the fragment
+   if (clusterGrid.w > 0u)
+   {
+      uvec2 range = clusterRanges[FindCluster(surfacePosition)];
+      for(uint i = 0u; i < range.y; i++)
       {
-         outFragmentColor = objectColor;
+         phongResult += CalcPointLight(pointLights[lightIndices[range.x + i]], lightNormal, surfacePosition, viewDirection);
       }
    }
+
+   vec3 color = phongResult * surfaceColor.xyz;
+#else
+   vec3 color = surfaceColor.xyz;
+#endif
+
+#ifdef FEATURE_ALPHA
+   outFragmentColor = vec4(color, surfaceColor.w);
+#else
+   outFragmentColor = vec4(color, 1.0);
+#endif
+#endif
 }
 
+#ifdef FEATURE_GBUFFER
+// folds a unit normal onto the octahedron and its lower half over the
+// upper half, so two components hold any direction
+vec2 EncodeNormal(vec3 normal)
+{
+   normal /= abs(normal.x) + abs(normal.y) + abs(normal.z);
+   vec2 encoded = normal.xy;
+   if (normal.z < 0.0)
+   {
+      vec2 signs = vec2(encoded.x >= 0.0 ? 1.0 : -1.0, encoded.y >= 0.0 ? 1.0 : -1.0);
+      encoded = (1.0 - abs(encoded.yx)) * signs;
+   }
+   return(encoded);
+}
+#endif
+
+#if defined(FEATURE_LIGHTING) && !defined(FEATURE_GBUFFER)
 // calculates the color when using a directional light.
 vec3 CalcLightSource(LightSource light, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection)
 {
@@ -105,4 +252,59 @@ vec3 CalcLightSource(LightSource light, vec3 lightNormal, vec3 vertexPosition, v
    specular = (light.specularIntensity * material.shininess) * specularComponent * material.specularColor;
   
    return(ambient + diffuse + specular);
-}
\ No newline at end of file
+}
+
+// calculates the color added by a point light, which fades out
+// smoothly to nothing at its radius
+vec3 CalcPointLight(PointLight light, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection)
+{
+   vec3 toLight = light.position - vertexPosition;
+   float distance = length(toLight);
+   if (distance >= light.radius)
+   {
+      return(vec3(0.0));
+   }
+
+   float ratio = distance / light.radius;
+   float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+   float attenuation = light.intensity * window * window / (distance * distance + 1.0);
+
+   vec3 lightDirection = toLight / max(distance, 0.0001);
+   float impact = max(dot(lightNormal, lightDirection), 0.0);
+   vec3 diffuse = impact * material.diffuseColor;
+
+   vec3 reflectDir = reflect(-lightDirection, lightNormal);
+   float specularComponent = pow(max(dot(viewDirection, reflectDir), 0.0), max(material.shininess, 1.0));
+   vec3 specular = specularComponent * material.specularColor;
+
+   return((diffuse + specular) * light.color * attenuation);
+}
+
+// finds the cluster holding a fragment from its tile on screen and
+// the depth slice of its view depth, as LightClusterer does
+uint FindCluster(vec3 worldPosition)
+{
+   vec4 viewPoint = view * vec4(worldPosition, 1.0);
+   vec4 clipPoint = projection * viewPoint;
+   vec2 screen = (clipPoint.xy / clipPoint.w) * 0.5 + 0.5;
+
+   uvec3 cluster;
+   cluster.xy = uvec2(clamp(ivec2(floor(screen * vec2(clusterGrid.xy))), ivec2(0), ivec2(clusterGrid.xy) - 1));
+   float depth = max(-viewPoint.z, clusterDepth.x);
+   cluster.z = uint(clamp(int(floor(log(depth / clusterDepth.x) * clusterDepth.z)), 0, int(clusterGrid.z) - 1));
+
+   return((cluster.z * clusterGrid.y + cluster.y) * clusterGrid.x + cluster.x);
+}
+
+#ifdef FEATURE_DEFERRED
+// unfolds a normal written by EncodeNormal
+vec3 DecodeNormal(vec2 encoded)
+{
+   vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+   float fold = max(-normal.z, 0.0);
+   normal.x += (normal.x >= 0.0) ? -fold : fold;
+   normal.y += (normal.y >= 0.0) ? -fold : fold;
+   return(normalize(normal));
+}
+#endif
+#endif
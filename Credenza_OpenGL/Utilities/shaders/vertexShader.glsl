@@ -1,20 +1,47 @@
-#version 330 core
+#version 440 core
 layout (location = 0) in vec3 inVertexPosition;
 layout (location = 1) in vec3 inVertexNormal;
 layout (location = 2) in vec2 inTextureCoordinate;
 
+// per-instance data, laid out to match ShapeMeshes::INSTANCE_DATA
+layout (location = 3) in mat4 instanceModel;
+layout (location = 7) in vec4 instanceColor;
+layout (location = 8) in vec2 instanceUVScale;
+layout (location = 9) in int instanceMaterialIndex;
+
+#ifdef FEATURE_DEFERRED
+flat out mat4 fragmentInverseViewProjection;
+#else
 out vec3 fragmentPosition;
 out vec3 fragmentVertexNormal;
 out vec2 fragmentTextureCoordinate;
+flat out vec4 fragmentObjectColor;
+flat out int fragmentMaterialIndex;
+#endif
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// per-frame camera state, shared with the fragment shader
+layout(std140, binding = 0) uniform FrameConstants
+{
+   mat4 view;
+   mat4 projection;
+   vec4 viewPosition;
+};
 
 void main()
 {
-   fragmentPosition = vec3(model * vec4(inVertexPosition, 1.0));
-   gl_Position = projection * view * model * vec4(inVertexPosition, 1.0f);
-   fragmentVertexNormal = inVertexNormal;
-   fragmentTextureCoordinate = inTextureCoordinate;
+#ifdef FEATURE_DEFERRED
+   // one triangle covering the screen, placed by the vertex index,
+   // for the lighting pass of deferred shading
+   vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+   gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+   fragmentInverseViewProjection = inverse(projection * view);
+#else
+   fragmentPosition = vec3(instanceModel * vec4(inVertexPosition, 1.0));
+   gl_Position = projection * view * instanceModel * vec4(inVertexPosition, 1.0f);
+   // the normal matrix keeps normals perpendicular under non-uniform scale
+   fragmentVertexNormal = transpose(inverse(mat3(instanceModel))) * inVertexNormal;
+   fragmentTextureCoordinate = inTextureCoordinate * instanceUVScale;
+   fragmentObjectColor = instanceColor;
+   fragmentMaterialIndex = instanceMaterialIndex;
+#endif
 }